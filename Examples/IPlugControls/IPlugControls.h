@@ -39,7 +39,7 @@ public:
   void ProcessBlock(sample** inputs, sample** outputs, int nFrames) override;
   void OnIdle() override;
 private:
-  IBufferSender<2> mScopeSender;
-  IPeakSender<2> mMeterSender;
+  IBufferSnapshotSender<2> mScopeSender;
+  IPeakSnapshotSender<2> mMeterSender;
 #endif
 };
@@ -62,6 +62,7 @@ void IPlugFaustDSP::OnParamChange(int paramIdx)
 
 void IPlugFaustDSP::OnIdle()
 {
+  mFaustProcessor.OnIdle();
   mScopeSender.TransmitData(*this);
 }
 #endif
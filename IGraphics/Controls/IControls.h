@@ -21,6 +21,8 @@
 #include "IVKeyboardControl.h"
 #include "IVMeterControl.h"
 #include "IVScopeControl.h"
+#include "IVWaveformControl.h"
+#include "IVSpectrumControl.h"
 #include "IVMultiSliderControl.h"
 #include "IRTTextControl.h"
 #include "IVDisplayControl.h"
@@ -0,0 +1,84 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+#pragma once
+
+/**
+ * @file
+ * @ingroup SpecialControls
+ * @copydoc IProfilerDisplayControl
+ */
+
+#include "IControl.h"
+#include "IGraphicsProfiler.h"
+
+BEGIN_IPLUG_NAMESPACE
+BEGIN_IGRAPHICS_NAMESPACE
+
+/** Overlay showing the data collected by IGraphicsProfiler: the cost of the stages of the last frame and the slowest controls.
+ *  This is a special control that lives outside the main IGraphics control stack, see IGraphics::ShowProfilerDisplay()
+ * @ingroup SpecialControls */
+class IProfilerDisplayControl : public IControl
+{
+public:
+  IProfilerDisplayControl(const IRECT& bounds, int maxControls = 8)
+  : IControl(bounds)
+  , mMaxControls(maxControls)
+  {
+    mIgnoreMouse = true;
+    mText = IText(12, COLOR_WHITE, DEFAULT_FONT, EAlign::Near, EVAlign::Top);
+  }
+
+  bool IsDirty() override
+  {
+    return true;
+  }
+
+  void Draw(IGraphics& g) override
+  {
+    const IGraphicsProfiler* pProfiler = g.GetProfiler();
+
+    g.FillRect(COLOR_BLACK.WithOpacity(0.75f), mRECT);
+
+    if (!pProfiler)
+      return;
+
+    const IGraphicsProfiler::FrameStats& frame = pProfiler->GetLastFrameStats();
+    pProfiler->GetSlowestControls(mStats, mMaxControls);
+
+    IRECT line = mRECT.GetPadded(-4.f).GetFromTop(mText.mSize + 2.f);
+    WDL_String str;
+
+    auto drawLine = [&]() {
+      g.DrawText(mText, str.Get(), line);
+      line.Translate(0.f, line.H());
+    };
+
+    str.SetFormatted(128, "frame %.2f ms  animate %.2f ms  isdirty %.2f ms  endframe %.2f ms",
+                     frame.frameTime * 1000., frame.animateTime * 1000., frame.isDirtyTime * 1000., frame.endFrameTime * 1000.);
+    drawLine();
+
+    str.SetFormatted(128, "%i regions  %i control draws  %i overlapping", frame.nRegions, frame.nControlDraws, frame.nOverlappingDraws);
+    drawLine();
+
+    for (const auto& s : mStats)
+    {
+      str.SetFormatted(128, "%.3f ms (max %.3f)  x%i  %s [%i]", s.avgTime * 1000., s.maxTime * 1000., s.overlappingDraws + 1, s.name, s.ctrlTag);
+      drawLine();
+    }
+  }
+
+private:
+  int mMaxControls;
+  std::vector<IGraphicsProfiler::ControlStats> mStats;
+};
+
+END_IGRAPHICS_NAMESPACE
+END_IPLUG_NAMESPACE
@@ -15,6 +15,8 @@
  * @copydoc IVPresetManagerControl
  */
 
+#include <vector>
+
 #include "IControl.h"
 
 BEGIN_IPLUG_NAMESPACE
@@ -22,10 +24,15 @@ BEGIN_IGRAPHICS_NAMESPACE
 
 /** A "meta control" for a "preset manager" for disk-based preset files
  * It adds several child buttons 
+ * Without a preset path, it browses the plug-in's presets instead (see IPluginBase::NPresets()), including the presets of a preset library,
+ * which are only loaded when they are chosen, and the user presets in a submenu. The presets are listed and restored by messages to the editor delegate
+ * (see IPluginBase::OnPresetMsgFromUI()), so that it works with distributed plug-ins. The replies are sent to the control's tag, so in this mode it must be attached with one.
  * @ingroup IControls */
 class IVPresetManagerControl : public IDirBrowseControlBase
 {
 public:
+  static constexpr int kMaxPresetsPerMenu = 128;
+
   IVPresetManagerControl(const IRECT& bounds, const char* presetPath, const char* fileExtension, const IVStyle& style = DEFAULT_STYLE)
   : IDirBrowseControlBase(bounds, fileExtension)
   , mStyle(style)
@@ -34,6 +41,15 @@ public:
     AddPath(presetPath, "");
     SetupMenu();
   }
+
+  /** Constructs a preset manager for the plug-in's presets. Attach it with a control tag */
+  IVPresetManagerControl(const IRECT& bounds, const IVStyle& style = DEFAULT_STYLE)
+  : IDirBrowseControlBase(bounds, "")
+  , mStyle(style)
+  , mPluginPresets(true)
+  {
+    mIgnoreMouse = true;
+  }
   
   void Draw(IGraphics& g) override
   {
@@ -47,7 +63,7 @@ public:
 
       if (pItem)
       {
-        mSelectedIndex = mItems.Find(pItem);
+        mSelectedIndex = mPluginPresets ? pItem->GetTag() : mItems.Find(pItem);
         LoadPresetAtCurrentIndex();
       }
     }
@@ -61,7 +77,7 @@ public:
       mSelectedIndex--;
 
       if (mSelectedIndex < 0)
-        mSelectedIndex = NItems() - 1;
+        mSelectedIndex = NPresetItems() - 1;
 
       LoadPresetAtCurrentIndex();
     };
@@ -69,7 +85,7 @@ public:
     auto nextPresetFunc = [&](IControl* pCaller) {
       mSelectedIndex++;
 
-      if (mSelectedIndex >= NItems())
+      if (mSelectedIndex >= NPresetItems())
         mSelectedIndex = 0;
 
       LoadPresetAtCurrentIndex();
@@ -78,22 +94,50 @@ public:
     auto loadPresetFunc = [&](IControl* pCaller) {
       WDL_String fileName;
       WDL_String path;
-      pCaller->GetUI()->PromptForFile(fileName, path, EFileAction::Open, mExtension.Get());
+      pCaller->GetUI()->PromptForFile(fileName, path, EFileAction::Open, mPluginPresets ? "ipresets" : mExtension.Get());
 
-      if (fileName.GetLength())
+      if (!fileName.GetLength())
+        return;
+
+      if (mPluginPresets)
+      {
+        // the container's presets are added to the user presets
+        IByteChunk path;
+        path.PutStr(fileName.Get());
+        GetDelegate()->SendArbitraryMsgFromUI(kMsgTagAddUserPresetFile, GetTag(), path.Size(), path.GetData());
+      }
+      else
         mPresetNameButton->SetLabelStr(fileName.Get());
     };
 
-    auto choosePresetFunc = [&](IControl* pCaller) { pCaller->GetUI()->CreatePopupMenu(*this, mMainMenu, pCaller->GetRECT()); };
+    auto choosePresetFunc = [&](IControl* pCaller) {
+      if (mPluginPresets)
+        RequestPluginPresets(); // the editor side answers straight away, rebuilding the menu
+
+      pCaller->GetUI()->CreatePopupMenu(*this, mMainMenu, pCaller->GetRECT());
+    };
 
     GetUI()->AttachControl(new IVButtonControl(sections.ReduceFromLeft(50), SplashClickActionFunc, "<", mStyle))->SetAnimationEndActionFunction(prevPresetFunc);
     GetUI()->AttachControl(new IVButtonControl(sections.ReduceFromLeft(50), SplashClickActionFunc, ">", mStyle))->SetAnimationEndActionFunction(nextPresetFunc);
     GetUI()->AttachControl(new IVButtonControl(sections.ReduceFromRight(100), SplashClickActionFunc, "Load", mStyle))->SetAnimationEndActionFunction(loadPresetFunc);
     GetUI()->AttachControl(mPresetNameButton = new IVButtonControl(sections, SplashClickActionFunc, "Preset...", mStyle))->SetAnimationEndActionFunction(choosePresetFunc);
+
+    // The list is requested once here and when the menu is opened, the replies to restores only carry it again if the presets have changed
+    if (mPluginPresets)
+      RequestPluginPresets();
   }
 
   void LoadPresetAtCurrentIndex()
   {
+    if (mPluginPresets)
+    {
+      // the label is set when the restore is confirmed, see OnMsgFromDelegate()
+      if (mSelectedIndex > -1 && mSelectedIndex < NPresetItems())
+        GetDelegate()->SendArbitraryMsgFromUI(kMsgTagRestorePreset, GetTag(), sizeof(int), &mSelectedIndex);
+
+      return;
+    }
+
     if (mSelectedIndex > -1 && mSelectedIndex < mItems.GetSize())
     {
       IPopupMenu::Item* pItem = mItems.Get(mSelectedIndex);
@@ -107,9 +151,103 @@ public:
     }
   }
 
+  void OnMsgFromDelegate(int msgTag, int dataSize, const void* pData) override
+  {
+    if (!mPluginPresets || (msgTag != kMsgTagPresetList && msgTag != kMsgTagPresetRestored))
+      return;
+
+    IByteStream stream(pData, dataSize);
+    int nPresets = 0, nUserPresets = 0, currentIdx = -1, restoredIdx = -1;
+
+    if (msgTag == kMsgTagPresetRestored)
+    {
+      if (stream.Get(&restoredIdx, stream.Get(&currentIdx, 0)) > 0)
+        SetRestoredPreset(restoredIdx);
+
+      return;
+    }
+
+    int pos = stream.Get(&nPresets, 0);
+    pos = stream.Get(&nUserPresets, pos);
+    pos = stream.Get(&currentIdx, pos);
+    pos = stream.Get(&restoredIdx, pos);
+
+    if (pos < 0)
+      return;
+
+    mPresetNames.resize(std::max(0, nPresets + nUserPresets));
+
+    for (size_t i = 0; i < mPresetNames.size() && pos >= 0; i++)
+      pos = stream.GetStr(mPresetNames[i], pos);
+
+    mNPresets = nPresets;
+    SetupPluginPresetsMenu(currentIdx);
+    SetRestoredPreset(restoredIdx);
+  }
+
 private:
+  void SetRestoredPreset(int restoredIdx)
+  {
+    if (restoredIdx > -1 && restoredIdx < NPresetItems())
+    {
+      mSelectedIndex = restoredIdx;
+      mPresetNameButton->SetLabelStr(mPresetNames[restoredIdx].Get());
+    }
+  }
+
+  int NPresetItems()
+  {
+    if (mPluginPresets)
+      return static_cast<int>(mPresetNames.size());
+
+    return NItems();
+  }
+
+  /** Asks the editor delegate for the plug-in's preset names, which may have changed if user presets have been indexed */
+  void RequestPluginPresets()
+  {
+    GetDelegate()->SendArbitraryMsgFromUI(kMsgTagRequestPresets, GetTag());
+  }
+
+  /** Rebuilds the menu from the plug-in's preset names, with the user presets in a submenu. Large lists are split into submenus */
+  void SetupPluginPresetsMenu(int currentIdx)
+  {
+    mMainMenu.Clear();
+
+    auto addPresets = [&](IPopupMenu& menu, int first, int count) {
+      IPopupMenu* pMenu = &menu;
+
+      for (int i = 0; i < count; i++)
+      {
+        if (count > kMaxPresetsPerMenu && (i % kMaxPresetsPerMenu) == 0)
+        {
+          WDL_String range;
+          range.SetFormatted(64, "%i - %i", i + 1, std::min(i + kMaxPresetsPerMenu, count));
+          pMenu = new IPopupMenu();
+          menu.AddItem(range.Get(), pMenu);
+        }
+
+        const int idx = first + i;
+        pMenu->AddItem(new IPopupMenu::Item(mPresetNames[idx].Get(), idx == currentIdx ? IPopupMenu::Item::kChecked : IPopupMenu::Item::kNoFlags, idx));
+      }
+    };
+
+    const int nUserPresets = NPresetItems() - mNPresets;
+    addPresets(mMainMenu, 0, mNPresets);
+
+    if (nUserPresets > 0)
+    {
+      IPopupMenu* pUserMenu = new IPopupMenu();
+      addPresets(*pUserMenu, mNPresets, nUserPresets);
+      mMainMenu.AddItem("User", pUserMenu);
+    }
+  }
+
   IVButtonControl* mPresetNameButton = nullptr;
   IVStyle mStyle;
+  bool mPluginPresets = false;
+  int mNPresets = 0;
+  std::vector<WDL_String> mPresetNames; // the presets, followed by the user presets
 };
 
 END_IGRAPHICS_NAMESPACE
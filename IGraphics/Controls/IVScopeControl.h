@@ -57,26 +57,12 @@ public:
     
     IRECT r = mWidgetBounds.GetPadded(-mPadding);
 
-    const float maxY = (r.H() / 2.f); // y +/- centre
-
-    float xPerData = r.W() / (float) MAXBUF;
-
     for (int c = 0; c < mBuf.nChans; c++)
     {
-      float xHi = 0.f;
-      float yHi = mBuf.vals[c][0] * maxY;
-      yHi = Clip(yHi, -maxY, maxY);
-
-      g.PathMoveTo(r.L + xHi, r.MH() - yHi);
-      for (int s = 1; s < MAXBUF; s++)
-      {
-        xHi = ((float) s * xPerData);
-        yHi = mBuf.vals[c][s] * maxY;
-        yHi = Clip(yHi, -maxY, maxY);
-        g.PathLineTo(r.L + xHi, r.MH() - yHi);
-      }
-      
-      g.PathStroke(GetColor(kFG), mTrackSize, IStrokeOptions(), &mBlend);
+      for (int s = 0; s < MAXBUF; s++)
+        mNormY[s] = 0.5f + 0.5f * Clip(mBuf.vals[c][s], -1.f, 1.f);
+
+      g.DrawData(GetColor(kFG), r, mNormY.data(), MAXBUF, nullptr, &mBlend, mTrackSize);
     }
   }
   
@@ -101,6 +87,7 @@ public:
 
 private:
   ISenderData<MAXNC, std::array<float, MAXBUF>> mBuf;
+  std::array<float, MAXBUF> mNormY;
   float mPadding = 2.f;
 };
 
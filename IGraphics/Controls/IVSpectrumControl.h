@@ -0,0 +1,138 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+#pragma once
+
+/**
+ * @file
+ * @ingroup Controls
+ * @copydoc IVSpectrumControl
+ */
+
+#include "IControl.h"
+#include "ISpectrumSender.h"
+
+BEGIN_IPLUG_NAMESPACE
+BEGIN_IGRAPHICS_NAMESPACE
+
+/** Vectorial multichannel capable spectrum analyzer, for magnitude spectra sent by an ISpectrumSender.
+ * Frequency is drawn on a logarithmic axis, with one vertex per pixel column, however large FFTSIZE is. A column that spans several bins draws the loudest,
+ * and at the low end, where columns are narrower than a bin, they interpolate between the bins either side
+ * @ingroup IControls */
+template <int MAXNC = 1, int FFTSIZE = 4096>
+class IVSpectrumControl : public IControl
+                        , public IVectorBase
+{
+public:
+  static constexpr int kNumBins = FFTSIZE / 2;
+
+  /** Constructs an IVSpectrumControl
+   * @param bounds The rectangular area that the control occupies
+   * @param label A CString to label the control
+   * @param style, /see IVStyle
+   * @param lowDB The level in dB at the bottom of the display
+   * @param highDB The level in dB at the top of the display */
+  IVSpectrumControl(const IRECT& bounds, const char* label = "", const IVStyle& style = DEFAULT_STYLE, float lowDB = -90.f, float highDB = 0.f)
+  : IControl(bounds)
+  , IVectorBase(style)
+  , mLowDB(lowDB)
+  , mHighDB(highDB)
+  {
+    AttachIControl(this, label);
+  }
+
+  void Draw(IGraphics& g) override
+  {
+    DrawBackGround(g, mRECT);
+    DrawWidget(g);
+    DrawLabel(g);
+
+    if(mStyle.drawFrame)
+      g.DrawRect(GetColor(kFR), mWidgetBounds, &mBlend, mStyle.frameThickness);
+  }
+
+  void DrawWidget(IGraphics& g) override
+  {
+    IRECT r = mWidgetBounds.GetPadded(-mPadding);
+
+    const int nPixelCols = Clip((int) std::ceil(r.W() * g.GetTotalScale()), 2, kNumBins);
+    const float xPerPixel = r.W() / (float) (nPixelCols - 1);
+    const float logBins = std::log((float) kNumBins);
+
+    auto getY = [&](float mag) {
+      const float db = 20.f * std::log10(std::max(mag, 1e-9f));
+      return r.B - Clip((db - mLowDB) / (mHighDB - mLowDB), 0.f, 1.f) * r.H();
+    };
+
+    for (int c = mBuf.chanOffset; c < mBuf.chanOffset + mBuf.nChans; c++)
+    {
+      for (int p = 0; p < nPixelCols; p++)
+      {
+        // This pixel column covers fractional bins [lo, hi) on a log frequency axis
+        const float lo = std::exp(logBins * p / (float) nPixelCols);
+        const float hi = std::exp(logBins * (p + 1) / (float) nPixelCols);
+        const int first = (int) std::ceil(lo);
+        const int last = std::min((int) std::ceil(hi), kNumBins);
+        float mag = 0.f;
+
+        if (first < last)
+        {
+          for (int bin = first; bin < last; bin++)
+            mag = std::max(mag, mBuf.vals[c][bin]);
+        }
+        else
+        {
+          // The column is narrower than a bin, so neighbouring columns interpolate between the same two bins
+          const float centre = std::sqrt(lo * hi);
+          const int bin = std::min((int) centre, kNumBins - 2);
+          const float frac = centre - bin;
+          mag = mBuf.vals[c][bin] + frac * (mBuf.vals[c][bin + 1] - mBuf.vals[c][bin]);
+        }
+
+        const float x = r.L + p * xPerPixel;
+
+        if(p == 0)
+          g.PathMoveTo(x, getY(mag));
+        else
+          g.PathLineTo(x, getY(mag));
+      }
+
+      g.PathStroke(GetColor((EVColor) (kX1 + (c % 3))), mTrackSize, IStrokeOptions(), &mBlend);
+    }
+  }
+
+  void OnResize() override
+  {
+    SetTargetRECT(MakeRects(mRECT));
+    SetDirty(false);
+  }
+
+  void OnMsgFromDelegate(int msgTag, int dataSize, const void* pData) override
+  {
+    if (!IsDisabled() && msgTag == ISpectrumSender<>::kUpdateMessage)
+    {
+      IByteStream stream(pData, dataSize);
+
+      int pos = 0;
+      pos = stream.Get(&mBuf, pos);
+
+      SetDirty(false);
+    }
+  }
+
+private:
+  typename ISpectrumSender<MAXNC, FFTSIZE>::Data mBuf;
+  float mLowDB;
+  float mHighDB;
+  float mPadding = 2.f;
+};
+
+END_IGRAPHICS_NAMESPACE
+END_IPLUG_NAMESPACE
@@ -0,0 +1,128 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+#pragma once
+
+/**
+ * @file
+ * @ingroup Controls
+ * @copydoc IVWaveformControl
+ */
+
+#include "IControl.h"
+#include "IWaveformSender.h"
+
+BEGIN_IPLUG_NAMESPACE
+BEGIN_IGRAPHICS_NAMESPACE
+
+/** Vectorial multichannel capable waveform display, for min/max column data sent by an IWaveformSender.
+ * The columns are merged to at most one vertex pair per pixel column, so the cost of drawing depends on the width of the control, not on the duration displayed
+ * @ingroup IControls */
+template <int MAXNC = 1, int NCOLUMNS = 512>
+class IVWaveformControl : public IControl
+                        , public IVectorBase
+{
+public:
+  /** Constructs an IVWaveformControl
+   * @param bounds The rectangular area that the control occupies
+   * @param label A CString to label the control
+   * @param style, /see IVStyle */
+  IVWaveformControl(const IRECT& bounds, const char* label = "", const IVStyle& style = DEFAULT_STYLE)
+  : IControl(bounds)
+  , IVectorBase(style)
+  {
+    AttachIControl(this, label);
+  }
+
+  void Draw(IGraphics& g) override
+  {
+    DrawBackGround(g, mRECT);
+    DrawWidget(g);
+    DrawLabel(g);
+
+    if(mStyle.drawFrame)
+      g.DrawRect(GetColor(kFR), mWidgetBounds, &mBlend, mStyle.frameThickness);
+  }
+
+  void DrawWidget(IGraphics& g) override
+  {
+    g.DrawHorizontalLine(GetColor(kSH), mWidgetBounds, 0.5, &mBlend, mStyle.frameThickness);
+
+    IRECT r = mWidgetBounds.GetPadded(-mPadding);
+
+    const float maxY = (r.H() / 2.f); // y +/- centre
+    const int nPixelCols = Clip((int) std::ceil(r.W() * g.GetTotalScale()), 2, NCOLUMNS);
+    const float colsPerPixel = (float) NCOLUMNS / (float) nPixelCols;
+    const float xPerPixel = r.W() / (float) (nPixelCols - 1);
+
+    auto getY = [&](float v) { return r.MH() - Clip(v * maxY, -maxY, maxY); };
+
+    for (int c = mBuf.chanOffset; c < mBuf.chanOffset + mBuf.nChans; c++)
+    {
+      // reduce the columns to one min/max pair per pixel
+      for (int p = 0; p < nPixelCols; p++)
+      {
+        const int start = (int) (p * colsPerPixel);
+        const int end = std::max(start + 1, (int) ((p + 1) * colsPerPixel));
+        float lo = mBuf.vals[c][start * 2];
+        float hi = mBuf.vals[c][start * 2 + 1];
+
+        for (int col = start + 1; col < end; col++)
+        {
+          lo = std::min(lo, mBuf.vals[c][col * 2]);
+          hi = std::max(hi, mBuf.vals[c][col * 2 + 1]);
+        }
+
+        mMin[p] = lo;
+        mMax[p] = hi;
+      }
+
+      // envelope: along the maxima, and back along the minima
+      g.PathMoveTo(r.L, getY(mMax[0]));
+
+      for (int p = 1; p < nPixelCols; p++)
+        g.PathLineTo(r.L + p * xPerPixel, getY(mMax[p]));
+
+      for (int p = nPixelCols - 1; p >= 0; p--)
+        g.PathLineTo(r.L + p * xPerPixel, getY(mMin[p]) + 0.5f); // ensure a visible line for a silent signal
+
+      g.PathClose();
+      g.PathFill(GetColor(kFG), IFillOptions(), &mBlend);
+    }
+  }
+
+  void OnResize() override
+  {
+    SetTargetRECT(MakeRects(mRECT));
+    SetDirty(false);
+  }
+
+  void OnMsgFromDelegate(int msgTag, int dataSize, const void* pData) override
+  {
+    if (!IsDisabled() && msgTag == IWaveformSender<>::kUpdateMessage)
+    {
+      IByteStream stream(pData, dataSize);
+
+      int pos = 0;
+      pos = stream.Get(&mBuf, pos);
+
+      SetDirty(false);
+    }
+  }
+
+private:
+  typename IWaveformSender<MAXNC, NCOLUMNS>::Data mBuf;
+  std::array<float, NCOLUMNS> mMin;
+  std::array<float, NCOLUMNS> mMax;
+  float mPadding = 2.f;
+};
+
+END_IGRAPHICS_NAMESPACE
+END_IPLUG_NAMESPACE
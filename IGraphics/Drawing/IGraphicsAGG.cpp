@@ -124,37 +124,31 @@ static agg::pixel_map* CreatePixmap(int w, int h)
 
 #pragma mark - Rasterizing
 
-template <typename Rasterizer, typename FuncType, typename ColorArrayType>
-static void GradientRasterize(Rasterizer& rasterizer, const FuncType& gradientFunc, agg::trans_affine& xform, ColorArrayType& colors, agg::comp_op_e op)
+/** AGG span generator for linear and radial gradients, which fills spans from a cached IGradientLUT with GradientSpan */
+class GradientSpanGenerator
 {
-  using InterpolatorType = agg::span_interpolator_linear<>;
-  using SpanGradientType = agg::span_gradient<agg::rgba8, InterpolatorType, FuncType, ColorArrayType>;
-  
-  InterpolatorType spanInterpolator(xform);
-  SpanGradientType spanGradient(spanInterpolator, gradientFunc, colors, 0, 512);
-  rasterizer.Rasterize(spanGradient, op);
-}
+public:
+  /** @param pattern The gradient pattern
+   * @param mtx The transform from pixels to the pattern space
+   * @param lut The pattern's gradient table */
+  GradientSpanGenerator(const IPattern& pattern, const agg::trans_affine& mtx, const IGradientLUT& lut)
+  : mType(pattern.mType), mExtend(pattern.mExtend), mMapping{mtx.sx, mtx.shy, mtx.shx, mtx.sy, mtx.tx, mtx.ty}, mLUT(lut.Get())
+  {}
 
-template <typename Rasterizer, typename FuncType, typename ColorArrayType>
-static void GradientRasterizeAdapt(Rasterizer& rasterizer, EPatternExtend extend, const FuncType& gradientFunc, agg::trans_affine& xform, ColorArrayType& colors, agg::comp_op_e op)
-{
-  using reflect = agg::gradient_reflect_adaptor<FuncType>;
-  using repeat = agg::gradient_repeat_adaptor<FuncType>;
-    
-  switch (extend)
+  void prepare() {}
+
+  void generate(agg::rgba8* span, int x, int y, unsigned len)
   {
-    case EPatternExtend::None: //TODO:  extend none
-    case EPatternExtend::Pad:
-      GradientRasterize(rasterizer, gradientFunc, xform, colors, op);
-      break;
-    case EPatternExtend::Reflect:
-      GradientRasterize(rasterizer, reflect(gradientFunc), xform, colors, op);
-      break;
-    case EPatternExtend::Repeat:
-      GradientRasterize(rasterizer, repeat(gradientFunc), xform, colors, op);
-      break;
+    static_assert(sizeof(agg::rgba8) == sizeof(uint32_t), "agg::rgba8 must be 4 bytes");
+    GradientSpan::Fill(mType, reinterpret_cast<uint32_t*>(span), x, y, len, mMapping, mLUT, mExtend);
   }
-}
+
+private:
+  EPatternType mType;
+  EPatternExtend mExtend;
+  GradientSpan::Mapping mMapping;
+  const uint32_t* mLUT;
+};
 
 void IGraphicsAGG::Rasterizer::Rasterize(const IPattern& pattern, agg::comp_op_e op, float opacity, EFillRule rule)
 {
@@ -168,32 +162,14 @@ void IGraphicsAGG::Rasterizer::Rasterize(const IPattern& pattern, agg::comp_op_e
     case EPatternType::Linear:
     case EPatternType::Radial:
     {
-      // Common gradient objects
+      // agg::rgba8 is non pre-multiplied, with r, g, b, a in memory order
+      const IGradientLUT& lut = mGraphics.mGradientCache.Get(pattern, opacity, IGradientLUT::Format());
       const IMatrix& m = pattern.mTransform;
       
       agg::trans_affine gradientMTX(m.mXX, m.mYX , m.mXY, m.mYY, m.mTX, m.mTY);
-      agg::gradient_lut<agg::color_interpolator<agg::rgba8>, 512> colors;
-      
-      // Scaling
-      gradientMTX = (agg::trans_affine() / mGraphics.mTransform) * gradientMTX * agg::trans_affine_scaling(512.0);
+      gradientMTX = (agg::trans_affine() / mGraphics.mTransform) * gradientMTX;
       
-      // Make gradient lut
-      colors.remove_all();
-      
-      for (int i = 0; i < pattern.NStops(); i++)
-      {
-        const IColorStop& stop = pattern.GetStop(i);
-        float offset = stop.mOffset;
-        colors.add_color(offset, AGGColor(stop.mColor, opacity));
-      }
-      
-      colors.build_lut();
-      
-      // Rasterize
-      if (pattern.mType == EPatternType::Linear)
-        GradientRasterizeAdapt(*this, pattern.mExtend, agg::gradient_y(), gradientMTX, colors, op);
-      else
-        GradientRasterizeAdapt(*this, pattern.mExtend, agg::gradient_radial_d(), gradientMTX, colors, op);
+      Rasterize(GradientSpanGenerator(pattern, gradientMTX, lut), op);
     }
     break;
   }
@@ -205,7 +181,7 @@ IGraphicsAGG::IGraphicsAGG(IGEditorDelegate& dlg, int w, int h, int fps, float s
 : IGraphicsPathBase(dlg, w, h, fps, scale)
 , mRasterizer(*this)
 , mFontEngine()
-, mFontManager(mFontEngine)
+, mFontManager(mFontEngine, 128)
 , mFontCurves(mFontManager.path_adaptor())
 , mFontCurvesTransformed(mFontCurves, mTransform)
 {
@@ -273,6 +249,9 @@ bool CheckTransform(const agg::trans_affine& mtx)
 
 void IGraphicsAGG::DrawBitmap(const IBitmap& bitmap, const IRECT& dest, int srcX, int srcY, const IBlend* pBlend)
 {
+  if (bitmap.GetPackedFrame(1))
+    return DrawBitmap(GetUnpackedBitmap(bitmap), dest, srcX, srcY, pBlend);
+
   bool preMultiplied = static_cast<Bitmap*>(bitmap.GetAPIBitmap())->IsPreMultiplied();
   IRECT bounds = mClipRECT.Intersect(dest);
   bounds.Scale(GetBackingPixelScale());
@@ -503,6 +482,18 @@ void IGraphicsAGG::GetLayerBitmapData(const ILayerPtr& layer, RawBitmapData& dat
     memcpy(data.Get(), pBitmap->GetBitmap()->buf(), size);
 }
 
+bool IGraphicsAGG::SetLayerBitmapData(ILayerPtr& layer, RawBitmapData& data)
+{
+  const APIBitmap* pBitmap = layer->GetAPIBitmap();
+  int size = pBitmap->GetBitmap()->height() * pBitmap->GetBitmap()->row_bytes();
+    
+  if (data.GetSize() < size)
+    return false;
+    
+  memcpy(pBitmap->GetBitmap()->buf(), data.Get(), size);
+  return true;
+}
+
 void IGraphicsAGG::ApplyShadowMask(ILayerPtr& layer, RawBitmapData& mask, const IShadow& shadow)
 {
   const APIBitmap* pBitmap = layer->GetAPIBitmap();
@@ -556,34 +547,41 @@ void IGraphicsAGG::EndFrame()
 #endif
 }
 
-bool IGraphicsAGG::SetFont(const char* fontID, IFontData* pFont) const
+bool IGraphicsAGG::SetFont(const char* fontID, IFontData* pFont, float size, agg::glyph_rendering rendering) const
 {
-  agg::glyph_rendering render = agg::glyph_ren_outline;
-  return mFontEngine.load_font(fontID, pFont->GetFaceIdx(), render, (char*) pFont->Get(), pFont->GetSize());
+  if (!mFontEngine.load_font(fontID, pFont->GetFaceIdx(), rendering, (char*) pFont->Get(), pFont->GetSize()))
+    return false;
+  
+  const bool textHinting = false;
+  
+  // Set dpi to 72 to allow finer resolution of text sizes
+  mFontEngine.resolution(72);
+  mFontEngine.hinting(textHinting);
+  mFontEngine.height(size * pFont->GetHeightEMRatio());
+  mFontEngine.flip_y(true);
+  return true;
 }
 
-void IGraphicsAGG::PrepareAndMeasureText(const IText& text, const char* str, IRECT& r, double& x, double & y) const
+const IGraphicsAGG::TextLayout& IGraphicsAGG::GetTextLayout(const IText& text, const char* str) const
 {
+  TextLayout* pLayout = mTextLayoutCache.Find(text.mFont, text.mSize, 1.0, str);
+  
+  if (pLayout)
+    return *pLayout;
+  
   StaticStorage<IFontData>::Accessor storage(sFontCache);
   IFontData* pFont = storage.Find(text.mFont);
   
-  if (!pFont || !SetFont(text.mFont, pFont))
+  if (!pFont || !SetFont(text.mFont, pFont, text.mSize))
   {
     assert(0 && "No font found - did you forget to load it?");
   }
-    
-  const bool textHinting = false;
-    
-  // Set dpi to 72 to allow finer resolution of text sizes
-  mFontEngine.resolution(72);
-  mFontEngine.hinting(textHinting);
-  mFontEngine.height(text.mSize * pFont->GetHeightEMRatio());
-  mFontEngine.flip_y(true);
   
-  const double textHeight = text.mSize;
+  TextLayout layout;
   const double EMHeight = pFont->GetAscender() - pFont->GetDescender();
-  const double ascender = text.mSize * pFont->GetAscender() / EMHeight;
-  const double descender = text.mSize * pFont->GetDescender() / EMHeight;
+  layout.pFont = pFont;
+  layout.ascender = text.mSize * pFont->GetAscender() / EMHeight;
+  layout.descender = text.mSize * pFont->GetDescender() / EMHeight;
   
   mFontManager.reset_last_glyph();
   double textWidth = 0.0;
@@ -600,9 +598,24 @@ void IGraphicsAGG::PrepareAndMeasureText(const IText& text, const char* str, IRE
       textWidth += dx;
     }
     
-    textWidth += pGlyph->advance_x;
+    layout.glyphX.push_back(textWidth);
+    textWidth += pGlyph ? pGlyph->advance_x : 0.0;
   }
   
+  layout.width = textWidth;
+  
+  return mTextLayoutCache.Add(text.mFont, text.mSize, 1.0, str, std::move(layout));
+}
+
+const IGraphicsAGG::TextLayout& IGraphicsAGG::PrepareAndMeasureText(const IText& text, const char* str, IRECT& r, double& x, double & y) const
+{
+  const TextLayout& layout = GetTextLayout(text, str);
+  
+  const double textHeight = text.mSize;
+  const double textWidth = layout.width;
+  const double ascender = layout.ascender;
+  const double descender = layout.descender;
+  
   switch (text.mAlign)
   {
     case EAlign::Near:     x = r.L;                          break;
@@ -618,6 +631,8 @@ void IGraphicsAGG::PrepareAndMeasureText(const IText& text, const char* str, IRE
   }
   
   r = IRECT((float) x, (float) y - ascender, (float) (x + textWidth), (float) (y + textHeight - ascender));
+  
+  return layout;
 }
 
 float IGraphicsAGG::DoMeasureText(const IText& text, const char* str, IRECT& bounds) const
@@ -629,34 +644,101 @@ float IGraphicsAGG::DoMeasureText(const IText& text, const char* str, IRECT& bou
   return bounds.W();
 }
 
+void IGraphicsAGG::DrawCachedGlyphs(const IText& text, const char* str, const TextLayout& layout, double x, double y, agg::rgba8 color, agg::comp_op_e op)
+{
+  // Glyphs are rasterized once per font, size, scale and sub-pixel offset into the font cache (as gray8 scanlines) and then blitted.
+  // The sub-pixel offset is part of the font engine transform, so each offset has its own cache, and glyphs are drawn grouped by offset
+  
+  const double sx = mTransform.sx;
+  const double sy = mTransform.sy;
+  const double deviceY = std::round(mTransform.ty + sy * y);
+  
+  SetFont(text.mFont, layout.pFont, text.mSize, agg::glyph_ren_agg_gray8);
+  
+  for (int step = 0; step < kGlyphSubpixelSteps; step++)
+  {
+    bool transformSet = false;
+    
+    for (size_t c = 0; str[c]; c++)
+    {
+      const double deviceX = mTransform.tx + sx * (x + layout.glyphX[c]);
+      const double pixelX = std::floor(deviceX);
+      
+      if (static_cast<int>((deviceX - pixelX) * kGlyphSubpixelSteps) != step)
+        continue;
+      
+      if (!transformSet)
+      {
+        mFontEngine.transform(agg::trans_affine_scaling(sx, sy) * agg::trans_affine_translation(step / static_cast<double>(kGlyphSubpixelSteps), 0.0));
+        transformSet = true;
+      }
+      
+      const agg::glyph_cache* pGlyph = mFontManager.glyph(str[c]);
+      
+      if (pGlyph)
+      {
+        mFontManager.init_embedded_adaptors(pGlyph, pixelX, deviceY);
+        mRasterizer.RasterizeScanlines(mFontManager.gray8_adaptor(), mFontManager.gray8_scanline(), color, op);
+      }
+    }
+  }
+  
+  // Restore the engine for measuring
+  mFontEngine.transform(agg::trans_affine());
+  SetFont(text.mFont, layout.pFont, text.mSize);
+}
+
+void IGraphicsAGG::DoDrawData(const IColor& color, const float* x, const float* y, int nPoints, const IBlend* pBlend, float thickness)
+{
+  mPath.remove_all();
+
+  for (auto i = 0; i < nPoints; i++)
+  {
+    double xd = x[i];
+    double yd = y[i];
+
+    mTransform.transform(&xd, &yd);
+
+    if (i)
+      mPath.line_to(xd, yd);
+    else
+      mPath.move_to(xd, yd);
+  }
+
+  PathStroke(color, thickness, GetDataStrokeOptions(), pBlend);
+}
+
 void IGraphicsAGG::DoDrawText(const IText& text, const char* str, const IRECT& bounds, const IBlend* pBlend)
 {
   IRECT measured = bounds;
   double x, y;
   
   agg::rgba8 color(AGGColor(text.mFGColor, BlendWeight(pBlend)));
-  mFontManager.reset_last_glyph();
   
-  PrepareAndMeasureText(text, str, measured, x, y);
+  const TextLayout& layout = PrepareAndMeasureText(text, str, measured, x, y);
   PathTransformSave();
   DoTextRotation(text, bounds, measured);
-
-  for (size_t c = 0; str[c]; c++)
+  
+  // Cached glyph bitmaps can be used whenever the transform is only a scale and translation
+  if (mTransform.shx == 0.0 && mTransform.shy == 0.0 && mTransform.sx > 0.0 && mTransform.sy > 0.0)
   {
-    const agg::glyph_cache* pGlyph = mFontManager.glyph(str[c]);
+    DrawCachedGlyphs(text, str, layout, x, y, color, AGGBlendMode(pBlend));
+  }
+  else
+  {
+    SetFont(text.mFont, layout.pFont, text.mSize);
     
-    if (pGlyph)
+    for (size_t c = 0; str[c]; c++)
     {
-      if (textKerning)
+      const agg::glyph_cache* pGlyph = mFontManager.glyph(str[c]);
+      
+      if (pGlyph)
       {
-        mFontManager.add_kerning(&x, &y);
+        mFontManager.init_embedded_adaptors(pGlyph, x + layout.glyphX[c], y);
+        mRasterizer.Rasterize(mFontCurvesTransformed, color, AGGBlendMode(pBlend));
       }
-      
-      mFontManager.init_embedded_adaptors(pGlyph, x, y);
-      mRasterizer.Rasterize(mFontCurvesTransformed, color, AGGBlendMode(pBlend));
     }
-    x += pGlyph->advance_x;
-    y += pGlyph->advance_y;
   }
+  
   PathTransformRestore();
 }
@@ -11,6 +11,7 @@
 #pragma once
 
 #include "IGraphicsPathBase.h"
+#include "IGraphicsGradient.h"
 #include "IGraphicsAGG_src.h"
 
 #include "heapbuf.h"
@@ -187,13 +188,28 @@ private:
     
     void Rasterize(const IPattern& pattern, agg::comp_op_e op, float opacity, EFillRule rule = EFillRule::Winding);
 
+    /** Renders pre-rasterized scanlines (e.g. cached gray8 glyphs) directly, without going through the rasterizer */
+    template <typename ScanlineSourceType, typename ScanlineType>
+    void RasterizeScanlines(ScanlineSourceType& source, ScanlineType& scanline, agg::rgba8 color, agg::comp_op_e op)
+    {
+      using RenderType = agg::renderer_scanline_aa_solid<RenbaseType>;
+      
+      const IRECT clip = GetClipBounds();
+      mRenBase.clip_box((int) std::floor(clip.L), (int) std::floor(clip.T), (int) std::ceil(clip.R) - 1, (int) std::ceil(clip.B) - 1);
+      
+      RenderType renderer(mRenBase);
+      renderer.color(color);
+      mPixf.comp_op(op);
+      agg::render_scanlines(source, scanline, renderer);
+      
+      mRenBase.reset_clipping(true);
+    }
+    
     template <typename VertexSourceType>
     void SetPath(VertexSourceType& path)
     {
       // Clip
-      IRECT clip = mGraphics.mClipRECT;
-      clip.Translate(mGraphics.XTranslate(), mGraphics.YTranslate());
-      clip.Scale(mGraphics.GetBackingPixelScale());
+      const IRECT clip = GetClipBounds();
       mRasterizer.clip_box(clip.L, clip.T, clip.R, clip.B);
       
       // Add path
@@ -202,6 +218,14 @@ private:
     }
 
   private:
+    IRECT GetClipBounds() const
+    {
+      IRECT clip = mGraphics.mClipRECT;
+      clip.Translate(mGraphics.XTranslate(), mGraphics.YTranslate());
+      clip.Scale(mGraphics.GetBackingPixelScale());
+      return clip;
+    }
+    
     template <typename RendererType>
     void Render(RendererType& renderer, agg::comp_op_e op)
     {
@@ -274,17 +298,34 @@ protected:
   bool FlippedBitmap() const override { return false; }
 
   void GetLayerBitmapData(const ILayerPtr& layer, RawBitmapData& data) override;
+  bool SetLayerBitmapData(ILayerPtr& layer, RawBitmapData& data) override;
   void ApplyShadowMask(ILayerPtr& layer, RawBitmapData& mask, const IShadow& shadow) override;
 
   float DoMeasureText(const IText& text, const char* str, IRECT& bounds) const override;
   void DoDrawText(const IText& text, const char* str, const IRECT& bounds, const IBlend* pBlend) override;
+  void DoDrawData(const IColor& color, const float* x, const float* y, int nPoints, const IBlend* pBlend, float thickness) override;
 
 private:
-  void PrepareAndMeasureText(const IText& text, const char* str, IRECT& r, double& x, double & y) const;
-  bool SetFont(const char* fontID, IFontData* pFont) const;
+  /** The measurements of a string, in unscaled units */
+  struct TextLayout
+  {
+    IFontData* pFont = nullptr;
+    double width = 0.0;
+    double ascender = 0.0;
+    double descender = 0.0;
+    std::vector<double> glyphX; // pen position of each glyph relative to the start of the string, including kerning
+  };
+  
+  /** Glyph bitmaps are cached for this many horizontal sub-pixel positions */
+  static constexpr int kGlyphSubpixelSteps = 4;
+  
+  const TextLayout& GetTextLayout(const IText& text, const char* str) const;
+  const TextLayout& PrepareAndMeasureText(const IText& text, const char* str, IRECT& r, double& x, double & y) const;
+  bool SetFont(const char* fontID, IFontData* pFont, float size, agg::glyph_rendering rendering = agg::glyph_ren_outline) const;
+  void DrawCachedGlyphs(const IText& text, const char* str, const TextLayout& layout, double x, double y, agg::rgba8 color, agg::comp_op_e op);
 
-  double XTranslate()  { return mLayers.empty() ? 0 : -mLayers.top()->Bounds().L; }
-  double YTranslate()  { return mLayers.empty() ? 0 : -mLayers.top()->Bounds().T; }
+  double XTranslate() const { return mLayers.empty() ? 0 : -mLayers.top()->Bounds().L; }
+  double YTranslate() const { return mLayers.empty() ? 0 : -mLayers.top()->Bounds().T; }
   
   void PathTransformSetMatrix(const IMatrix& m) override
   {
@@ -299,11 +340,13 @@ private:
   IRECT mClipRECT;
   mutable FontEngineType mFontEngine;
   mutable FontManagerType mFontManager;
+  mutable TextLayoutCache<TextLayout> mTextLayoutCache;
   agg::rendering_buffer mRenBuf;
   agg::path_storage mPath;
   agg::trans_affine mTransform;
   PixelMapType mPixelMap;
   Rasterizer mRasterizer;
+  IGradientLUTCache mGradientCache;
 
   //pipeline to process the vectors glyph paths(curves + contour)
   agg::conv_curve<FontManagerType::path_adaptor_type> mFontCurves;
@@ -8,7 +8,11 @@
  ==============================================================================
 */
 
+#include <algorithm>
 #include <cmath>
+#include <cstring>
+#include <list>
+#include <unordered_map>
 
 #include "png.h"
 
@@ -20,12 +24,208 @@ using namespace igraphics;
 
 #pragma mark - Private Classes and Structs
 
+/** Image surfaces of layers that have been freed, kept so that layers of the same size can reuse them rather than allocating and zeroing new ones on every frame */
+class IGraphicsCairo::SurfacePool
+{
+public:
+  static constexpr int kMaxSurfaces = 16;
+  static constexpr size_t kMaxBytes = 64 * 1024 * 1024;
+
+  SurfacePool() {}
+  ~SurfacePool() { Clear(); }
+
+  SurfacePool(const SurfacePool&) = delete;
+  SurfacePool& operator=(const SurfacePool&) = delete;
+
+  /** @return A cleared surface of the given size, reused if one is available */
+  cairo_surface_t* Acquire(cairo_surface_t* pSurfaceType, int width, int height)
+  {
+    for (auto it = mSurfaces.begin(); it != mSurfaces.end(); ++it)
+    {
+      cairo_surface_t* pSurface = *it;
+
+      if (cairo_image_surface_get_width(pSurface) == width && cairo_image_surface_get_height(pSurface) == height)
+      {
+        mSurfaces.erase(it);
+        mBytes -= Bytes(pSurface);
+        cairo_surface_flush(pSurface);
+        memset(cairo_image_surface_get_data(pSurface), 0, Bytes(pSurface));
+        cairo_surface_mark_dirty(pSurface);
+        return pSurface;
+      }
+    }
+
+    if (pSurfaceType)
+      return cairo_surface_create_similar_image(pSurfaceType, CAIRO_FORMAT_ARGB32, width, height);
+    else
+      return cairo_image_surface_create(CAIRO_FORMAT_ARGB32, width, height);
+  }
+
+  /** Takes back a surface, destroying the least recently released ones if the pool is full. Surfaces that are still referenced elsewhere,
+   * by a pattern or a context that hasn't been destroyed yet, are only dereferenced, since clearing them on reuse would change what the other owner draws */
+  void Release(cairo_surface_t* pSurface)
+  {
+    if (cairo_surface_get_reference_count(pSurface) != 1 || cairo_surface_status(pSurface) != CAIRO_STATUS_SUCCESS
+        || cairo_surface_get_type(pSurface) != CAIRO_SURFACE_TYPE_IMAGE || Bytes(pSurface) > kMaxBytes)
+    {
+      cairo_surface_destroy(pSurface);
+      return;
+    }
+
+    mSurfaces.push_front(pSurface);
+    mBytes += Bytes(pSurface);
+
+    while (mSurfaces.size() > kMaxSurfaces || mBytes > kMaxBytes)
+    {
+      mBytes -= Bytes(mSurfaces.back());
+      cairo_surface_destroy(mSurfaces.back());
+      mSurfaces.pop_back();
+    }
+  }
+
+  void Clear()
+  {
+    for (cairo_surface_t* pSurface : mSurfaces)
+      cairo_surface_destroy(pSurface);
+
+    mSurfaces.clear();
+    mBytes = 0;
+  }
+
+private:
+  static size_t Bytes(cairo_surface_t* pSurface)
+  {
+    return static_cast<size_t>(cairo_image_surface_get_stride(pSurface)) * cairo_image_surface_get_height(pSurface);
+  }
+
+  std::list<cairo_surface_t*> mSurfaces;
+  size_t mBytes = 0;
+};
+
+/** Copies of the paths built by PathRoundRect() and PathArc(), so that controls that draw the same shapes on every frame
+ * don't flatten the arcs into curves again. Keyed by the shape arguments and the linear part of the transform,
+ * which decides how many curves cairo uses, and limited in size by evicting the least recently used */
+class IGraphicsCairo::PathCache
+{
+public:
+  static constexpr int kMaxArgs = 10;
+  static constexpr int kMaxPaths = 256;
+
+  struct Key
+  {
+    float mData[kMaxArgs + 5] = {};
+    int mSize = 0;
+
+    bool operator==(const Key& other) const
+    {
+      return mSize == other.mSize && !memcmp(mData, other.mData, mSize * sizeof(float));
+    }
+  };
+
+  PathCache() {}
+  ~PathCache() { Clear(); }
+
+  PathCache(const PathCache&) = delete;
+  PathCache& operator=(const PathCache&) = delete;
+
+  static Key MakeKey(cairo_t* pContext, const float* args, int nArgs)
+  {
+    Key key;
+    cairo_matrix_t m;
+    double sx, sy;
+
+    cairo_get_matrix(pContext, &m);
+    cairo_surface_get_device_scale(cairo_get_target(pContext), &sx, &sy);
+
+    for (int i = 0; i < nArgs; i++)
+      key.mData[key.mSize++] = args[i];
+
+    key.mData[key.mSize++] = static_cast<float>(m.xx * sx);
+    key.mData[key.mSize++] = static_cast<float>(m.yx * sy);
+    key.mData[key.mSize++] = static_cast<float>(m.xy * sx);
+    key.mData[key.mSize++] = static_cast<float>(m.yy * sy);
+
+    return key;
+  }
+
+  /** @return The cached path, or nullptr */
+  cairo_path_t* Find(const Key& key)
+  {
+    auto it = mPaths.find(Hash(key));
+
+    if (it == mPaths.end() || !(it->second->mKey == key))
+      return nullptr;
+
+    mEntries.splice(mEntries.begin(), mEntries, it->second);
+    return it->second->mPath;
+  }
+
+  /** Takes ownership of a path */
+  void Add(const Key& key, cairo_path_t* pPath)
+  {
+    const uint64_t hash = Hash(key);
+    auto it = mPaths.find(hash);
+
+    if (it != mPaths.end())
+      Remove(it);
+
+    mEntries.push_front({key, hash, pPath});
+    mPaths[hash] = mEntries.begin();
+
+    if (mEntries.size() > kMaxPaths)
+      Remove(mPaths.find(mEntries.back().mHash));
+  }
+
+  void Clear()
+  {
+    for (Entry& entry : mEntries)
+      cairo_path_destroy(entry.mPath);
+
+    mEntries.clear();
+    mPaths.clear();
+  }
+
+private:
+  struct Entry
+  {
+    Key mKey;
+    uint64_t mHash;
+    cairo_path_t* mPath;
+  };
+
+  using EntryList = std::list<Entry>;
+
+  void Remove(std::unordered_map<uint64_t, EntryList::iterator>::iterator it)
+  {
+    cairo_path_destroy(it->second->mPath);
+    mEntries.erase(it->second);
+    mPaths.erase(it);
+  }
+
+  static uint64_t Hash(const Key& key)
+  {
+    uint64_t hash = 14695981039346656037ull;
+    const uint8_t* pBytes = reinterpret_cast<const uint8_t*>(key.mData);
+
+    for (size_t i = 0; i < key.mSize * sizeof(float); i++)
+      hash = (hash ^ pBytes[i]) * 1099511628211ull;
+
+    return hash;
+  }
+
+  EntryList mEntries;
+  std::unordered_map<uint64_t, EntryList::iterator> mPaths;
+};
+
 class IGraphicsCairo::Bitmap : public APIBitmap
 {
 public:
   Bitmap(cairo_surface_t* pSurface, int scale, float drawScale);
-  Bitmap(cairo_surface_t* pSurfaceType, int width, int height, int scale, float drawScale);
+  Bitmap(const std::shared_ptr<SurfacePool>& pool, cairo_surface_t* pSurfaceType, int width, int height, int scale, float drawScale);
   virtual ~Bitmap();
+
+private:
+  std::shared_ptr<SurfacePool> mPool;
 };
 
 IGraphicsCairo::Bitmap::Bitmap(cairo_surface_t* pSurface, int scale, float drawScale)
@@ -37,14 +237,10 @@ IGraphicsCairo::Bitmap::Bitmap(cairo_surface_t* pSurface, int scale, float drawS
   SetBitmap(pSurface, width, height, scale, drawScale);
 }
 
-IGraphicsCairo::Bitmap::Bitmap(cairo_surface_t* pSurfaceType, int width, int height, int scale, float drawScale)
+IGraphicsCairo::Bitmap::Bitmap(const std::shared_ptr<SurfacePool>& pool, cairo_surface_t* pSurfaceType, int width, int height, int scale, float drawScale)
+: mPool(pool)
 {
-  cairo_surface_t* pSurface;
-  
-  if (pSurfaceType)
-    pSurface = cairo_surface_create_similar_image(pSurfaceType, CAIRO_FORMAT_ARGB32, width, height);
-  else
-    pSurface = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, width, height);
+  cairo_surface_t* pSurface = mPool->Acquire(pSurfaceType, width, height);
   
   cairo_surface_set_device_scale(pSurface, scale * drawScale, scale * drawScale);
   
@@ -53,7 +249,10 @@ IGraphicsCairo::Bitmap::Bitmap(cairo_surface_t* pSurfaceType, int width, int hei
 
 IGraphicsCairo::Bitmap::~Bitmap()
 {
-  cairo_surface_destroy(GetBitmap());
+  if (mPool)
+    mPool->Release(GetBitmap());
+  else
+    cairo_surface_destroy(GetBitmap());
 }
 
 class IGraphicsCairo::Font
@@ -210,9 +409,15 @@ IGraphicsCairo::IGraphicsCairo(IGEditorDelegate& dlg, int w, int h, int fps, flo
 : IGraphicsPathBase(dlg, w, h, fps, scale)
 , mSurface(nullptr)
 , mContext(nullptr)
+, mSurfacePool(new SurfacePool())
+, mPathCache(new PathCache())
 {
   DBGMSG("IGraphics Cairo @ %i FPS\n", fps);
   
+#ifdef OS_LINUX
+  mOffscreen = true;
+#endif
+  
   StaticStorage<Font>::Accessor storage(sFontCache);
   storage.Retain();
 }
@@ -229,6 +434,13 @@ IGraphicsCairo::~IGraphicsCairo()
 void IGraphicsCairo::DrawResize()
 {
   SetPlatformContext(nullptr);
+  
+  if (mOffscreen)
+  {
+    CreateOffscreenSurface();
+    return;
+  }
+  
 #ifdef OS_WIN
   HWND window = static_cast<HWND>(GetWindow());
   if (window)
@@ -264,7 +476,7 @@ APIBitmap* IGraphicsCairo::LoadAPIBitmap(const char* fileNameOrResID, int scale,
 
 APIBitmap* IGraphicsCairo::CreateAPIBitmap(int width, int height, int scale, double drawScale)
 {
-  return new Bitmap(mSurface, width, height, scale, drawScale);
+  return new Bitmap(mSurfacePool, mSurface, width, height, scale, drawScale);
 }
 
 bool IGraphicsCairo::BitmapExtSupported(const char* ext)
@@ -311,9 +523,27 @@ void IGraphicsCairo::GetLayerBitmapData(const ILayerPtr& layer, RawBitmapData& d
     cairo_paint(pContext);
     cairo_pattern_destroy(pPattern);
     cairo_destroy(pContext);
+    cairo_surface_destroy(pSurface);
   }
 }
 
+bool IGraphicsCairo::SetLayerBitmapData(ILayerPtr& layer, RawBitmapData& data)
+{
+  const APIBitmap* pBitmap = layer->GetAPIBitmap();
+  cairo_surface_t *pSurface = CreateCairoDataSurface(pBitmap, data, false);
+  
+  if (!pSurface)
+    return false;
+  
+  cairo_t* pContext = cairo_create(pBitmap->GetBitmap());
+  cairo_set_source_surface(pContext, pSurface, 0, 0);
+  cairo_set_operator(pContext, CAIRO_OPERATOR_SOURCE);
+  cairo_paint(pContext);
+  cairo_destroy(pContext);
+  cairo_surface_destroy(pSurface);
+  return true;
+}
+
 void IGraphicsCairo::ApplyShadowMask(ILayerPtr& layer, RawBitmapData& mask, const IShadow& shadow)
 {
   const APIBitmap* pBitmap = layer->GetAPIBitmap();
@@ -340,11 +570,15 @@ void IGraphicsCairo::ApplyShadowMask(ILayerPtr& layer, RawBitmapData& mask, cons
     cairo_translate(pContext, shadow.mXOffset, shadow.mYOffset);
     cairo_mask_surface(pContext, pSurface, 0.0, 0.0);
     cairo_destroy(pContext);
+    cairo_surface_destroy(pSurface);
   }  
 }
 
 void IGraphicsCairo::DrawBitmap(const IBitmap& bitmap, const IRECT& dest, int srcX, int srcY, const IBlend* pBlend)
 {
+  if (bitmap.GetPackedFrame(1))
+    return DrawBitmap(GetUnpackedBitmap(bitmap), dest, srcX, srcY, pBlend);
+
   cairo_save(mContext);
   cairo_rectangle(mContext, dest.L, dest.T, dest.W(), dest.H());
   cairo_clip(mContext);
@@ -366,12 +600,57 @@ void IGraphicsCairo::PathClose()
   cairo_close_path(mContext);
 }
 
-void IGraphicsCairo::PathArc(float cx, float cy, float r, float a1, float a2, EWinding winding)
+template <typename BuildFunc>
+void IGraphicsCairo::CachedPath(const float* args, int nArgs, BuildFunc build)
 {
-  if (winding == EWinding::CW)
-    cairo_arc(mContext, cx, cy, r, DegToRad(a1 - 90.f), DegToRad(a2 - 90.f));
+  // Only a path that starts a new sub-path can be replayed, arcs that continue a sub-path depend on the current point
+  if (cairo_has_current_point(mContext) || nArgs > PathCache::kMaxArgs)
+  {
+    build();
+    return;
+  }
+  
+  const PathCache::Key key = PathCache::MakeKey(mContext, args, nArgs);
+  
+  if (cairo_path_t* pPath = mPathCache->Find(key))
+  {
+    cairo_append_path(mContext, pPath);
+    return;
+  }
+  
+  // Build the shape on its own, so that the copy holds just this shape, then put back what was there before
+  cairo_path_t* pPrevious = cairo_copy_path(mContext);
+  cairo_new_path(mContext);
+  build();
+  cairo_path_t* pPath = cairo_copy_path(mContext);
+  cairo_new_path(mContext);
+  cairo_append_path(mContext, pPrevious);
+  cairo_append_path(mContext, pPath);
+  cairo_path_destroy(pPrevious);
+  
+  if (pPath->status == CAIRO_STATUS_SUCCESS)
+    mPathCache->Add(key, pPath);
   else
-    cairo_arc_negative(mContext, cx, cy, r, DegToRad(a1 - 90.f), DegToRad(a2 - 90.f));
+    cairo_path_destroy(pPath);
+}
+
+void IGraphicsCairo::PathRoundRect(const IRECT& bounds, float ctl, float ctr, float cbl, float cbr)
+{
+  const float args[] = { 0.f, bounds.L, bounds.T, bounds.R, bounds.B, ctl, ctr, cbl, cbr };
+  
+  CachedPath(args, 9, [&]() { IGraphicsPathBase::PathRoundRect(bounds, ctl, ctr, cbl, cbr); });
+}
+
+void IGraphicsCairo::PathArc(float cx, float cy, float r, float a1, float a2, EWinding winding)
+{
+  const float args[] = { 1.f, cx, cy, r, a1, a2, winding == EWinding::CW ? 1.f : 0.f };
+  
+  CachedPath(args, 7, [&]() {
+    if (winding == EWinding::CW)
+      cairo_arc(mContext, cx, cy, r, DegToRad(a1 - 90.f), DegToRad(a2 - 90.f));
+    else
+      cairo_arc_negative(mContext, cx, cy, r, DegToRad(a1 - 90.f), DegToRad(a2 - 90.f));
+  });
 }
 
 void IGraphicsCairo::PathMoveTo(float x, float y)
@@ -620,7 +899,7 @@ void IGraphicsCairo::SetPlatformContext(void* pContext)
   {
     UpdateCairoMainSurface(nullptr);
   }
-  else if(!mSurface)
+  else if(!mSurface && !mOffscreen)
   {
 #ifdef OS_MAC
     mSurface = cairo_quartz_surface_create_for_cg_context(CGContextRef(pContext), WindowWidth(), WindowHeight());
@@ -628,6 +907,8 @@ void IGraphicsCairo::SetPlatformContext(void* pContext)
 #elif defined OS_WIN
     mSurface = cairo_win32_surface_create_with_ddb((HDC) pContext, CAIRO_FORMAT_ARGB32, WindowWidth() * GetScreenScale(), WindowHeight() * GetScreenScale());
     cairo_surface_set_device_scale(mSurface, GetBackingPixelScale(), GetBackingPixelScale());
+#elif defined OS_LINUX
+    CreateOffscreenSurface(); // there is no platform surface, see SetOffscreen()
 #else
   #error NOT IMPLEMENTED
 #endif
@@ -645,8 +926,44 @@ void IGraphicsCairo::SetPlatformContext(void* pContext)
   IGraphics::SetPlatformContext(pContext);
 }
 
+void IGraphicsCairo::CreateOffscreenSurface()
+{
+  const int w = static_cast<int>(std::ceil(WindowWidth() * GetScreenScale()));
+  const int h = static_cast<int>(std::ceil(WindowHeight() * GetScreenScale()));
+  
+  cairo_surface_t* pSurface = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, std::max(w, 1), std::max(h, 1));
+  cairo_surface_set_device_scale(pSurface, GetBackingPixelScale(), GetBackingPixelScale());
+  UpdateCairoMainSurface(pSurface);
+  
+  if (mContext)
+  {
+    cairo_set_source_rgba(mContext, 1.0, 1.0, 1.0, 1.0);
+    cairo_rectangle(mContext, 0, 0, Width(), Height());
+    cairo_fill(mContext);
+  }
+}
+
+void IGraphicsCairo::SetOffscreen(bool offscreen)
+{
+  mOffscreen = offscreen;
+  UpdateCairoMainSurface(nullptr);
+  
+  if (mOffscreen)
+    CreateOffscreenSurface();
+  else
+    DrawResize();
+}
+
 void IGraphicsCairo::EndFrame()
 {
+  if (mOffscreen)
+  {
+    if (mSurface)
+      cairo_surface_flush(mSurface);
+    
+    return;
+  }
+  
 #ifdef OS_MAC
 #elif defined OS_WIN
   cairo_surface_flush(mSurface);
@@ -656,6 +973,8 @@ void IGraphicsCairo::EndFrame()
   HDC cdc = cairo_win32_surface_get_dc(mSurface);
   BitBlt(dc, 0, 0, WindowWidth() * GetScreenScale(), WindowHeight() * GetScreenScale(), cdc, 0, 0, SRCCOPY);
   EndPaint(hWnd, &ps);
+#elif defined OS_LINUX
+  cairo_surface_flush(mSurface);
 #else
 #error NOT IMPLEMENTED
 #endif
@@ -668,6 +987,7 @@ bool IGraphicsCairo::LoadAPIFont(const char* fontID, const PlatformFontPtr& font
   if (storage.Find(fontID))
     return true;
 
+#if defined OS_MAC || defined OS_WIN
   IFontDataPtr data = font->GetFontData();
   
   if (!data->IsValid())
@@ -680,7 +1000,8 @@ bool IGraphicsCairo::LoadAPIFont(const char* fontID, const PlatformFontPtr& font
     storage.Add(cairoFont.release(), fontID);
     return true;
   }
-    
+#endif
+  // There are no platform fonts on Linux yet, so only offscreen drawing without text is possible there
   return false;
 }
 
@@ -28,12 +28,16 @@
 
   #include "cairo/src/cairo.h"
   #include "cairo/src/cairo-win32.h"
+#elif defined OS_LINUX
+  #include "cairo/cairo.h"
 #else
   #error NOT IMPLEMENTED
 #endif
 
 #include "IGraphicsPathBase.h"
 
+#include <memory>
+
 BEGIN_IPLUG_NAMESPACE
 BEGIN_IGRAPHICS_NAMESPACE
 
@@ -54,6 +58,8 @@ private:
   class Bitmap;
   class Font;
   struct OSFont;
+  class SurfacePool;
+  class PathCache;
 #ifdef OS_WIN
   class PNGStream;
 #endif
@@ -67,6 +73,8 @@ public:
       
   void PathClear() override;
   void PathClose() override;
+  using IGraphicsPathBase::PathRoundRect;
+  void PathRoundRect(const IRECT& bounds, float ctl, float ctr, float cbl, float cbr) override;
   void PathArc(float cx, float cy, float r, float a1, float a2, EWinding winding) override;
   void PathMoveTo(float x, float y) override;
   void PathLineTo(float x, float y) override;
@@ -84,6 +92,18 @@ public:
 
   bool BitmapExtSupported(const char* ext) override;
 
+  /** Draws into an image surface instead of the platform context, so that the UI can be rendered without a window, e.g. to benchmark frame times headlessly.
+   * The surface is sized like the window, and recreated on resize. Drive the drawing with IsDirty() and Draw(), then read the pixels from GetOffscreenSurface().
+   * On Linux this is the only mode, since there is no platform surface
+   * @param offscreen \c true to draw offscreen */
+  void SetOffscreen(bool offscreen);
+
+  /** @return \c true if drawing into an image surface, see SetOffscreen() */
+  bool IsOffscreen() const { return mOffscreen; }
+
+  /** @return The image surface that is drawn into in offscreen mode, or nullptr */
+  cairo_surface_t* GetOffscreenSurface() const { return mOffscreen ? mSurface : nullptr; }
+
 protected:
   APIBitmap* LoadAPIBitmap(const char* fileNameOrResID, int scale, EResourceLocation location, const char* ext) override;
   APIBitmap* CreateAPIBitmap(int width, int height, int scale, double drawScale) override;
@@ -94,6 +114,7 @@ protected:
   bool FlippedBitmap() const override { return false; }
 
   void GetLayerBitmapData(const ILayerPtr& layer, RawBitmapData& data) override;
+  bool SetLayerBitmapData(ILayerPtr& layer, RawBitmapData& data) override;
   void ApplyShadowMask(ILayerPtr& layer, RawBitmapData& mask, const IShadow& shadow) override;
     
   float DoMeasureText(const IText& text, const char* str, IRECT& bounds) const override;
@@ -112,9 +133,17 @@ private:
   void UpdateLayer() override { UpdateCairoContext(); }
     
   cairo_surface_t* CreateCairoDataSurface(const APIBitmap* pBitmap, RawBitmapData& data, bool resize);
+  void CreateOffscreenSurface();
+
+  /** Adds a path to the current path, from the path cache if it has been built before with the same arguments and transform, otherwise by calling build() */
+  template <typename BuildFunc>
+  void CachedPath(const float* args, int nArgs, BuildFunc build);
     
   cairo_t* mContext;
   cairo_surface_t* mSurface;
+  bool mOffscreen = false;
+  std::shared_ptr<SurfacePool> mSurfacePool; // shared with the layer bitmaps, which may outlive the graphics
+  std::unique_ptr<PathCache> mPathCache;
 
   static StaticStorage<Font> sFontCache;
 };
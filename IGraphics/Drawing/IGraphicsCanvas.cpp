@@ -102,6 +102,9 @@ IGraphicsCanvas::~IGraphicsCanvas()
 
 void IGraphicsCanvas::DrawBitmap(const IBitmap& bitmap, const IRECT& bounds, int srcX, int srcY, const IBlend* pBlend)
 {
+  if (bitmap.GetPackedFrame(1))
+    return DrawBitmap(GetUnpackedBitmap(bitmap), bounds, srcX, srcY, pBlend);
+
   val context = GetContext();
   val img = *bitmap.GetAPIBitmap()->GetBitmap();
   context.call<void>("save");
@@ -12,6 +12,7 @@
 
 #include "IGraphicsLice.h"
 #include "ITextEntryControl.h"
+#include "IGraphicsLicePreMul.h"
 
 #include "lice_combine.h"
 
@@ -112,62 +113,10 @@ END_IPLUG_NAMESPACE
 
 #pragma mark - Pre-Multiplied Utilites
 
-// Utilities for pre-multiplied blits (LICE assumes sources are not pre-multiplied)
-static inline void PreMulCompositeSourceOver(LICE_pixel_chan* out, LICE_pixel_chan* in)
+// LICE assumes sources are not pre-multiplied, so pre-multiplied bitmaps are composited with the kernels in IGraphicsLicePreMul.h
+static void PreMulBlit(LICE_IBitmap *dest, LICE_IBitmap *src, int dstx, int dsty, int srcx, int srcy, int srcw, int srch, float alpha, EBlend method)
 {
-  unsigned int alphaCmp = 256 - in[LICE_PIXEL_A];
-  
-  unsigned int A = in[LICE_PIXEL_A] + ((out[LICE_PIXEL_A] * alphaCmp) >> 8);
-  unsigned int R = in[LICE_PIXEL_R] + ((out[LICE_PIXEL_R] * alphaCmp) >> 8);
-  unsigned int G = in[LICE_PIXEL_G] + ((out[LICE_PIXEL_G] * alphaCmp) >> 8);
-  unsigned int B = in[LICE_PIXEL_B] + ((out[LICE_PIXEL_B] * alphaCmp) >> 8);
-  
-  _LICE_MakePixelClamp(out, R, G, B, A);
-}
-
-static inline void PreMulCompositeAdd(LICE_pixel_chan* out, LICE_pixel_chan* in)
-{
-  unsigned int alpha = in[LICE_PIXEL_A];
-  
-  unsigned int A = out[LICE_PIXEL_A] + (255 * in[LICE_PIXEL_A] / alpha);
-  unsigned int R = out[LICE_PIXEL_R] + (255 * in[LICE_PIXEL_R] / alpha);
-  unsigned int G = out[LICE_PIXEL_G] + (255 * in[LICE_PIXEL_G] / alpha);
-  unsigned int B = out[LICE_PIXEL_B] + (255 * in[LICE_PIXEL_B] / alpha);
-  
-  _LICE_MakePixelClamp(out, R, G, B, A);
-}
-
-static void PreMulBlit(LICE_IBitmap *dest, LICE_IBitmap *src, int dstx, int dsty, int srcx, int srcy, int srcw, int srch, float alpha, int mode)
-{
-  srcx = dstx < 0 ? srcx - dstx : srcx;
-  srcy = dsty < 0 ? srcy - dsty : srcy;
-  dstx = std::max(dstx, 0);
-  dsty = std::max(dsty, 0);
-  srcw = std::min(srcw, dest->getWidth() - dstx);
-  srch = std::min(srch, dest->getHeight() - dsty);
-  
-  int inStride = src->getRowSpan() * 4;
-  int outStride = dest->getRowSpan() * 4;
-  
-  LICE_pixel_chan* in = ((LICE_pixel_chan*) src->getBits()) + (srcy * inStride) + (srcx * 4);
-  LICE_pixel_chan* out = ((LICE_pixel_chan*) dest->getBits()) + (dsty * outStride) + (dstx * 4);
-  
-  if ((mode & LICE_BLIT_MODE_MASK) == LICE_BLIT_MODE_ADD)
-  {
-    for (int i = 0; i < srch; i++, in += inStride, out += outStride)
-    {
-      for (int j = 0; j < srcw; j++)
-        PreMulCompositeAdd(out + j * 4, in + j * 4);
-    }
-  }
-  else
-  {
-    for (int i = 0; i < srch; i++, in += inStride, out += outStride)
-    {
-      for (int j = 0; j < srcw; j++)
-        PreMulCompositeSourceOver(out + j * 4, in + j * 4);
-    }
-  }
+  LicePreMul::Blit(dest, src, dstx, dsty, srcx, srcy, srcw, srch, alpha, method);
 }
 
 #pragma mark -
@@ -241,6 +190,9 @@ void IGraphicsLice::DrawRotatedSVG(const ISVG& svg, float destCtrX, float destCt
 
 void IGraphicsLice::DrawBitmap(const IBitmap& bitmap, const IRECT& bounds, int srcX, int srcY, const IBlend* pBlend)
 {
+  if (bitmap.GetPackedFrame(1))
+    return DrawBitmap(GetUnpackedBitmap(bitmap), bounds, srcX, srcY, pBlend);
+
   bool preMultiplied = static_cast<Bitmap*>(bitmap.GetAPIBitmap())->IsPreMultiplied();
   const int ds = GetScreenScale();
   
@@ -251,13 +203,16 @@ void IGraphicsLice::DrawBitmap(const IBitmap& bitmap, const IRECT& bounds, int s
   srcY = (srcY * ds) + r.T - sr.T;
   
   if (preMultiplied)
-    PreMulBlit(mRenderBitmap, bitmap.GetAPIBitmap()->GetBitmap(), r.L, r.T, srcX, srcY, r.W(), r.H(), BlendWeight(pBlend), LiceBlendMode(pBlend));
+    PreMulBlit(mRenderBitmap, bitmap.GetAPIBitmap()->GetBitmap(), r.L, r.T, srcX, srcY, r.W(), r.H(), BlendWeight(pBlend), pBlend ? pBlend->mMethod : EBlend::SrcOver);
   else
     LICE_Blit(mRenderBitmap, bitmap.GetAPIBitmap()->GetBitmap(), r.L, r.T, srcX, srcY, r.W(), r.H(), BlendWeight(pBlend), LiceBlendMode(pBlend));
 }
 
 void IGraphicsLice::DrawRotatedBitmap(const IBitmap& bitmap, float destCtrX, float destCtrY, double angle, int yOffsetZeroDeg, const IBlend* pBlend)
 {
+  if (bitmap.GetPackedFrame(1))
+    return DrawRotatedBitmap(GetUnpackedBitmap(bitmap), destCtrX, destCtrY, angle, yOffsetZeroDeg, pBlend);
+
   const int ds = GetScreenScale();
   LICE_IBitmap* pLB = bitmap.GetAPIBitmap()->GetBitmap();
   
@@ -271,6 +226,9 @@ void IGraphicsLice::DrawRotatedBitmap(const IBitmap& bitmap, float destCtrX, flo
 
 void IGraphicsLice::DrawFittedBitmap(const IBitmap& bitmap, const IRECT& bounds, const IBlend* pBlend)
 {
+  if (bitmap.GetPackedFrame(1))
+    return DrawFittedBitmap(GetUnpackedBitmap(bitmap), bounds, pBlend);
+
   NeedsClipping();
   // TODO - clipping
   IRECT r = TransformRECT(bounds);
@@ -538,14 +496,25 @@ IColor IGraphicsLice::GetPoint(int x, int y)
 
 void IGraphicsLice::PrepareAndMeasureText(const IText& text, const char* str, IRECT& r, LICE_IFont*& pFont) const
 {
-  pFont = CacheFont(text);
-  RECT R = {0, 0, 0, 0};
-  UINT fmt = DT_NOCLIP | DT_TOP | DT_LEFT | LICE_DT_USEFGALPHA;
+  const TextLayout* pLayout = mTextLayoutCache.Find(text.mFont, text.mSize, GetScreenScale(), str);
+  
+  if (!pLayout)
+  {
+    TextLayout layout;
+    RECT R = {0, 0, 0, 0};
+    UINT fmt = DT_NOCLIP | DT_TOP | DT_LEFT | LICE_DT_USEFGALPHA;
+    
+    layout.pFont = CacheFont(text);
+    layout.pFont->DrawText(mRenderBitmap, str, -1, &R, fmt | DT_CALCRECT);
+    layout.width = R.right;
+    layout.height = R.bottom;
+    pLayout = &mTextLayoutCache.Add(text.mFont, text.mSize, GetScreenScale(), str, std::move(layout));
+  }
   
-  pFont->DrawText(mRenderBitmap, str, -1, &R, fmt | DT_CALCRECT);
+  pFont = pLayout->pFont;
   
-  const float textWidth = R.right / static_cast<float>(GetScreenScale());
-  const float textHeight = R.bottom / static_cast<float>(GetScreenScale());
+  const float textWidth = pLayout->width / static_cast<float>(GetScreenScale());
+  const float textHeight = pLayout->height / static_cast<float>(GetScreenScale());
   float x = 0.f;
   float y = 0.f;
 
@@ -683,11 +652,10 @@ void IGraphicsLice::CompleteRegion(const IRECT& r)
 {
   if (mClippingLayer)
   {
-    const int mode = LICE_BLIT_MODE_COPY | LICE_BLIT_USE_ALPHA;
     LICE_IBitmap* bitmap = mClippingLayer->GetAPIBitmap()->GetBitmap();
     int x = mDrawOffsetX * GetScreenScale();
     int y = mDrawOffsetY * GetScreenScale();
-    PreMulBlit(mDrawBitmap.get(), bitmap, x, y, 0, 0, bitmap->getWidth(), bitmap->getHeight(), 1.f, mode);
+    PreMulBlit(mDrawBitmap.get(), bitmap, x, y, 0, 0, bitmap->getWidth(), bitmap->getHeight(), 1.f, EBlend::SrcOver);
     mClippingLayer = nullptr;
   }
   UpdateLayer();
@@ -852,6 +820,18 @@ void IGraphicsLice::GetLayerBitmapData(const ILayerPtr& layer, RawBitmapData& da
     memcpy(data.Get(), pBitmap->GetBitmap()->getBits(), size);
 }
 
+bool IGraphicsLice::SetLayerBitmapData(ILayerPtr& layer, RawBitmapData& data)
+{
+  const APIBitmap* pBitmap = layer->GetAPIBitmap();
+  int size = pBitmap->GetBitmap()->getHeight() * pBitmap->GetBitmap()->getRowSpan() * sizeof(LICE_pixel);
+  
+  if (data.GetSize() < size)
+    return false;
+  
+  memcpy(pBitmap->GetBitmap()->getBits(), data.Get(), size);
+  return true;
+}
+
 void IGraphicsLice::ApplyShadowMask(ILayerPtr& layer, RawBitmapData& mask, const IShadow& shadow)
 {
   const APIBitmap* pBitmap = layer->GetAPIBitmap();
@@ -869,6 +849,12 @@ void IGraphicsLice::ApplyShadowMask(ILayerPtr& layer, RawBitmapData& mask, const
     LICE_pixel_chan* in = mask.Get() + (std::max(-x, 0) * 4) + (std::max(-y, 0) * stride);
     LICE_pixel_chan* out = ((LICE_pixel_chan*) pLayerBitmap->getBits()) + (std::max(x, 0) * 4) + (std::max(y, 0) * stride);
     
+    if (shadow.mPattern.mType != EPatternType::Solid)
+    {
+      ApplyGradientShadowMask(pLayerBitmap, in, out, stride, nRows, nCols, layer->Bounds(), std::max(-x, 0), std::max(-y, 0), shadow);
+      return;
+    }
+    
     // Pre-multiply color components
     IColor color = shadow.mPattern.GetStop(0).mColor;
     color.Clamp();
@@ -921,6 +907,64 @@ void IGraphicsLice::ApplyShadowMask(ILayerPtr& layer, RawBitmapData& mask, const
   }
 }
 
+void IGraphicsLice::ApplyGradientShadowMask(LICE_IBitmap* pLayerBitmap, const LICE_pixel_chan* in, LICE_pixel_chan* out, int stride, int nRows, int nCols, const IRECT& bounds, int maskX, int maskY, const IShadow& shadow)
+{
+  const IPattern& pattern = shadow.mPattern;
+
+  IGradientLUT::Format format;
+  format.mR = LICE_PIXEL_R;
+  format.mG = LICE_PIXEL_G;
+  format.mB = LICE_PIXEL_B;
+  format.mA = LICE_PIXEL_A;
+  format.mPreMultiplied = true;
+
+  const IGradientLUT& lut = mGradientCache.Get(pattern, Clip(shadow.mOpacity, 0.f, 1.f), format);
+  
+  // Like the path backends, the pattern is evaluated at the mask pixels, where pixel (px, py) is the point (px / scale + L, py / scale + T)
+  const IMatrix& m = pattern.mTransform;
+  const double s = 1.0 / GetScreenScale();
+  const GradientSpan::Mapping mapping { m.mXX * s, m.mYX * s, m.mXY * s, m.mYY * s, m.mXX * bounds.L + m.mXY * bounds.T + m.mTX, m.mYX * bounds.L + m.mYY * bounds.T + m.mTY };
+  
+  std::vector<uint32_t> colors(std::max(nCols, 0));
+  
+  if (!shadow.mDrawForeground)
+    LICE_Clear(pLayerBitmap, 0);
+  
+  for (int i = 0; i < nRows; i++, in += stride, out += stride)
+  {
+    GradientSpan::Fill(pattern.mType, colors.data(), maskX, maskY + i, nCols, mapping, lut.Get(), pattern.mExtend);
+    
+    const LICE_pixel_chan* color = (const LICE_pixel_chan*) colors.data();
+    LICE_pixel_chan* chans = out;
+    
+    for (int j = 0; j < nCols; j++, chans += 4, color += 4)
+    {
+      unsigned int maskAlpha = in[j * 4 + LICE_PIXEL_A] * 257; // 0 to 65535, the pre-multiplied colors are 0 to 255
+      
+      if (!shadow.mDrawForeground)
+      {
+        unsigned int A = (color[LICE_PIXEL_A] * maskAlpha) >> 16;
+        unsigned int R = (color[LICE_PIXEL_R] * maskAlpha) >> 16;
+        unsigned int G = (color[LICE_PIXEL_G] * maskAlpha) >> 16;
+        unsigned int B = (color[LICE_PIXEL_B] * maskAlpha) >> 16;
+        
+        _LICE_MakePixelNoClamp(chans, R, G, B, A);
+      }
+      else
+      {
+        unsigned int alphaCmp = 255 - chans[LICE_PIXEL_A];
+        
+        unsigned int A = chans[LICE_PIXEL_A] + ((alphaCmp * color[LICE_PIXEL_A] * maskAlpha) >> 24);
+        unsigned int R = chans[LICE_PIXEL_R] + ((alphaCmp * color[LICE_PIXEL_R] * maskAlpha) >> 24);
+        unsigned int G = chans[LICE_PIXEL_G] + ((alphaCmp * color[LICE_PIXEL_G] * maskAlpha) >> 24);
+        unsigned int B = chans[LICE_PIXEL_B] + ((alphaCmp * color[LICE_PIXEL_B] * maskAlpha) >> 24);
+        
+        _LICE_MakePixelClamp(chans, R, G, B, A);
+      }
+    }
+  }
+}
+
 void IGraphicsLice::EndFrame()
 {
 #ifdef OS_MAC
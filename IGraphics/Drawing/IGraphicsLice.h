@@ -26,6 +26,7 @@
 
 #include "IGraphicsLice_src.h"
 #include "IGraphics.h"
+#include "IGraphicsGradient.h"
 
 #include <memory>
 
@@ -104,6 +105,7 @@ protected:
   bool FlippedBitmap() const override { return false; }
 
   void GetLayerBitmapData(const ILayerPtr& layer, RawBitmapData& data) override;
+  bool SetLayerBitmapData(ILayerPtr& layer, RawBitmapData& data) override;
   void ApplyShadowMask(ILayerPtr& layer, RawBitmapData& mask, const IShadow& shadow) override;
 
   float DoMeasureText(const IText& text, const char* str, IRECT& bounds) const override;
@@ -114,7 +116,18 @@ protected:
   float GetBackingPixelScale() const override { return (float) GetScreenScale(); };
 
 private:
+  /** The font and pixel size of a string, as measured by LICE */
+  struct TextLayout
+  {
+    LICE_IFont* pFont = nullptr;
+    int width = 0;
+    int height = 0;
+  };
+  
   void PrepareAndMeasureText(const IText& text, const char* str, IRECT& r, LICE_IFont*& pFont) const;
+  
+  /** ApplyShadowMask() for linear and radial patterns, filling each row of the shadow from a cached gradient table */
+  void ApplyGradientShadowMask(LICE_IBitmap* pLayerBitmap, const LICE_pixel_chan* in, LICE_pixel_chan* out, int stride, int nRows, int nCols, const IRECT& bounds, int maskX, int maskY, const IShadow& shadow);
     
   bool OpacityCheck(const IColor& color, const IBlend* pBlend)
   {
@@ -165,6 +178,10 @@ private:
     
   ILayerPtr mClippingLayer;
   
+  IGradientLUTCache mGradientCache;
+  
+  mutable TextLayoutCache<TextLayout> mTextLayoutCache;
+  
   static StaticStorage<LICE_IFont> sFontCache;
   static StaticStorage<FontInfo> sFontInfoCache;
     
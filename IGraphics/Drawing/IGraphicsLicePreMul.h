@@ -0,0 +1,405 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+#pragma once
+
+/**
+ * @file
+ * @brief Compositing of premultiplied LICE bitmaps, with SSE2, AVX2 and NEON kernels selected at runtime
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+#include "IPlugPlatform.h"
+#include "IPlugUtilities.h"
+#include "IGraphicsConstants.h"
+#include "lice.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+  #define IGRAPHICS_PREMUL_SSE2 1
+  #include <emmintrin.h>
+  #if defined(__GNUC__) || defined(__clang__) || defined(_MSC_VER)
+    #define IGRAPHICS_PREMUL_AVX2 1
+    #include <immintrin.h>
+    #ifdef _MSC_VER
+      #include <intrin.h>
+      #define IGRAPHICS_PREMUL_AVX2_TARGET
+    #else
+      #define IGRAPHICS_PREMUL_AVX2_TARGET __attribute__((target("avx2")))
+    #endif
+  #endif
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__) || defined(_M_ARM64)
+  #define IGRAPHICS_PREMUL_NEON 1
+  #include <arm_neon.h>
+#endif
+
+BEGIN_IPLUG_NAMESPACE
+BEGIN_IGRAPHICS_NAMESPACE
+
+/** Compositing of premultiplied RGBA rows for IGraphicsLice, since LICE's own blits assume that sources are not premultiplied.
+ * Each EBlend mode is the Porter-Duff equation out = src * Fa + dst * Fb, with each term computed as (x * F) >> 8 and the sum clamped to 255.
+ * The factors are 0, 256, alpha or 256 - alpha, where alpha + (alpha >> 7) maps 255 to 256. SrcOver uses 256 - srcAlpha for Fb, which is bit-exact with the original scalar blit.
+ * All the kernels give bit-identical results, the SIMD ones differ only in how many pixels they process at once. */
+namespace LicePreMul
+{
+  /** Instruction sets, in order of preference */
+  enum class EISA { Scalar, SSE2, AVX2, NEON };
+
+  /** A row kernel
+   * @param pDst The destination pixels, composited in place
+   * @param pSrc The premultiplied source pixels
+   * @param n The number of pixels
+   * @param weight The global opacity of the source, 0 to 256 */
+  using RowFunc = void (*)(LICE_pixel* pDst, const LICE_pixel* pSrc, int n, int weight);
+
+  enum EFactor { kZero, kOne, kAlpha, kInvAlpha, kInvAlphaSrcOver };
+
+  static inline unsigned Factor(int f, unsigned alpha)
+  {
+    switch (f)
+    {
+      case kZero: return 0;
+      case kOne: return 256;
+      case kAlpha: return alpha + (alpha >> 7);
+      case kInvAlpha: return 256 - (alpha + (alpha >> 7));
+      default: return 256 - alpha;
+    }
+  }
+
+  /** The reference kernel */
+  template <int FA, int FB>
+  void CompositeRowScalar(LICE_pixel* pDst, const LICE_pixel* pSrc, int n, int weight)
+  {
+    for (auto i = 0; i < n; i++)
+    {
+      LICE_pixel_chan* pD = reinterpret_cast<LICE_pixel_chan*>(pDst + i);
+      const LICE_pixel_chan* pS = reinterpret_cast<const LICE_pixel_chan*>(pSrc + i);
+
+      unsigned s[4];
+
+      for (auto c = 0; c < 4; c++)
+        s[c] = (pS[c] * weight) >> 8;
+
+      const unsigned fa = Factor(FA, pD[LICE_PIXEL_A]);
+      const unsigned fb = Factor(FB, s[LICE_PIXEL_A]);
+
+      for (auto c = 0; c < 4; c++)
+      {
+        const unsigned v = ((s[c] * fa) >> 8) + ((pD[c] * fb) >> 8);
+        pD[c] = v > 255 ? 255 : static_cast<LICE_pixel_chan>(v);
+      }
+    }
+  }
+
+#ifdef IGRAPHICS_PREMUL_SSE2
+  #define IGRAPHICS_PREMUL_SHUFFLE_A _MM_SHUFFLE(LICE_PIXEL_A, LICE_PIXEL_A, LICE_PIXEL_A, LICE_PIXEL_A)
+
+  /** @param a 16 bit channels of two pixels
+   * @return The alpha of each pixel, in all four of its channels */
+  static inline __m128i BroadcastAlphaSSE2(__m128i a)
+  {
+    return _mm_shufflehi_epi16(_mm_shufflelo_epi16(a, IGRAPHICS_PREMUL_SHUFFLE_A), IGRAPHICS_PREMUL_SHUFFLE_A);
+  }
+
+  template <int F>
+  static inline __m128i FactorSSE2(__m128i alpha)
+  {
+    const __m128i k256 = _mm_set1_epi16(256);
+
+    switch (F)
+    {
+      case kZero: return _mm_setzero_si128();
+      case kOne: return k256;
+      case kAlpha: return _mm_add_epi16(alpha, _mm_srli_epi16(alpha, 7));
+      case kInvAlpha: return _mm_sub_epi16(k256, _mm_add_epi16(alpha, _mm_srli_epi16(alpha, 7)));
+      default: return _mm_sub_epi16(k256, alpha);
+    }
+  }
+
+  /** Composites two pixels, as 16 bit channels */
+  template <int FA, int FB>
+  static inline __m128i Composite2SSE2(__m128i s, __m128i d, __m128i weight)
+  {
+    s = _mm_srli_epi16(_mm_mullo_epi16(s, weight), 8);
+    __m128i r = _mm_setzero_si128();
+
+    if (FA != kZero)
+      r = FA == kOne ? s : _mm_srli_epi16(_mm_mullo_epi16(s, FactorSSE2<FA>(BroadcastAlphaSSE2(d))), 8);
+
+    if (FB != kZero)
+      r = _mm_add_epi16(r, FB == kOne ? d : _mm_srli_epi16(_mm_mullo_epi16(d, FactorSSE2<FB>(BroadcastAlphaSSE2(s))), 8));
+
+    return r;
+  }
+
+  template <int FA, int FB>
+  void CompositeRowSSE2(LICE_pixel* pDst, const LICE_pixel* pSrc, int n, int weight)
+  {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i w = _mm_set1_epi16(static_cast<short>(weight));
+    int i = 0;
+
+    for (; i + 4 <= n; i += 4)
+    {
+      const __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pSrc + i));
+      const __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pDst + i));
+      const __m128i lo = Composite2SSE2<FA, FB>(_mm_unpacklo_epi8(s, zero), _mm_unpacklo_epi8(d, zero), w);
+      const __m128i hi = Composite2SSE2<FA, FB>(_mm_unpackhi_epi8(s, zero), _mm_unpackhi_epi8(d, zero), w);
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(pDst + i), _mm_packus_epi16(lo, hi)); // saturates to 255
+    }
+
+    CompositeRowScalar<FA, FB>(pDst + i, pSrc + i, n - i, weight);
+  }
+#endif
+
+#ifdef IGRAPHICS_PREMUL_AVX2
+  template <int F>
+  IGRAPHICS_PREMUL_AVX2_TARGET static inline __m256i FactorAVX2(__m256i alpha)
+  {
+    const __m256i k256 = _mm256_set1_epi16(256);
+
+    switch (F)
+    {
+      case kZero: return _mm256_setzero_si256();
+      case kOne: return k256;
+      case kAlpha: return _mm256_add_epi16(alpha, _mm256_srli_epi16(alpha, 7));
+      case kInvAlpha: return _mm256_sub_epi16(k256, _mm256_add_epi16(alpha, _mm256_srli_epi16(alpha, 7)));
+      default: return _mm256_sub_epi16(k256, alpha);
+    }
+  }
+
+  IGRAPHICS_PREMUL_AVX2_TARGET static inline __m256i BroadcastAlphaAVX2(__m256i a)
+  {
+    return _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(a, IGRAPHICS_PREMUL_SHUFFLE_A), IGRAPHICS_PREMUL_SHUFFLE_A);
+  }
+
+  /** Composites four pixels, as 16 bit channels */
+  template <int FA, int FB>
+  IGRAPHICS_PREMUL_AVX2_TARGET static inline __m256i Composite4AVX2(__m256i s, __m256i d, __m256i weight)
+  {
+    s = _mm256_srli_epi16(_mm256_mullo_epi16(s, weight), 8);
+    __m256i r = _mm256_setzero_si256();
+
+    if (FA != kZero)
+      r = FA == kOne ? s : _mm256_srli_epi16(_mm256_mullo_epi16(s, FactorAVX2<FA>(BroadcastAlphaAVX2(d))), 8);
+
+    if (FB != kZero)
+      r = _mm256_add_epi16(r, FB == kOne ? d : _mm256_srli_epi16(_mm256_mullo_epi16(d, FactorAVX2<FB>(BroadcastAlphaAVX2(s))), 8));
+
+    return r;
+  }
+
+  template <int FA, int FB>
+  IGRAPHICS_PREMUL_AVX2_TARGET void CompositeRowAVX2(LICE_pixel* pDst, const LICE_pixel* pSrc, int n, int weight)
+  {
+    const __m256i w = _mm256_set1_epi16(static_cast<short>(weight));
+    int i = 0;
+
+    for (; i + 8 <= n; i += 8)
+    {
+      const __m128i* pS = reinterpret_cast<const __m128i*>(pSrc + i);
+      const __m128i* pD = reinterpret_cast<const __m128i*>(pDst + i);
+      const __m256i lo = Composite4AVX2<FA, FB>(_mm256_cvtepu8_epi16(_mm_loadu_si128(pS)), _mm256_cvtepu8_epi16(_mm_loadu_si128(pD)), w);
+      const __m256i hi = Composite4AVX2<FA, FB>(_mm256_cvtepu8_epi16(_mm_loadu_si128(pS + 1)), _mm256_cvtepu8_epi16(_mm_loadu_si128(pD + 1)), w);
+      // packus works within 128 bit lanes, so the 64 bit quarters come out as lo0, hi0, lo1, hi1
+      const __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi16(lo, hi), _MM_SHUFFLE(3, 1, 2, 0));
+      _mm256_storeu_si256(reinterpret_cast<__m256i*>(pDst + i), packed);
+    }
+
+    CompositeRowSSE2<FA, FB>(pDst + i, pSrc + i, n - i, weight);
+  }
+#endif
+
+#ifdef IGRAPHICS_PREMUL_NEON
+  template <int F>
+  static inline uint16x8_t FactorNEON(uint16x8_t alpha)
+  {
+    const uint16x8_t k256 = vdupq_n_u16(256);
+
+    switch (F)
+    {
+      case kZero: return vdupq_n_u16(0);
+      case kOne: return k256;
+      case kAlpha: return vaddq_u16(alpha, vshrq_n_u16(alpha, 7));
+      case kInvAlpha: return vsubq_u16(k256, vaddq_u16(alpha, vshrq_n_u16(alpha, 7)));
+      default: return vsubq_u16(k256, alpha);
+    }
+  }
+
+  /** Composites one channel of eight pixels. s is already weighted */
+  template <int FA, int FB>
+  static inline uint16x8_t Composite8NEON(uint16x8_t s, uint16x8_t d, uint16x8_t fa, uint16x8_t fb)
+  {
+    uint16x8_t r = vdupq_n_u16(0);
+
+    if (FA != kZero)
+      r = FA == kOne ? s : vshrq_n_u16(vmulq_u16(s, fa), 8);
+
+    if (FB != kZero)
+      r = vaddq_u16(r, FB == kOne ? d : vshrq_n_u16(vmulq_u16(d, fb), 8));
+
+    return r;
+  }
+
+  template <int FA, int FB>
+  void CompositeRowNEON(LICE_pixel* pDst, const LICE_pixel* pSrc, int n, int weight)
+  {
+    const uint16x8_t w = vdupq_n_u16(static_cast<uint16_t>(weight));
+    int i = 0;
+
+    for (; i + 16 <= n; i += 16)
+    {
+      // vld4 splits the channels, so alpha needs no shuffling
+      const uint8x16x4_t s = vld4q_u8(reinterpret_cast<const uint8_t*>(pSrc + i));
+      uint8x16x4_t d = vld4q_u8(reinterpret_cast<const uint8_t*>(pDst + i));
+      uint16x8_t sLo[4], sHi[4];
+
+      for (auto c = 0; c < 4; c++)
+      {
+        sLo[c] = vshrq_n_u16(vmulq_u16(vmovl_u8(vget_low_u8(s.val[c])), w), 8);
+        sHi[c] = vshrq_n_u16(vmulq_u16(vmovl_u8(vget_high_u8(s.val[c])), w), 8);
+      }
+
+      const uint16x8_t dALo = vmovl_u8(vget_low_u8(d.val[LICE_PIXEL_A])), dAHi = vmovl_u8(vget_high_u8(d.val[LICE_PIXEL_A]));
+      const uint16x8_t faLo = FactorNEON<FA>(dALo), faHi = FactorNEON<FA>(dAHi);
+      const uint16x8_t fbLo = FactorNEON<FB>(sLo[LICE_PIXEL_A]), fbHi = FactorNEON<FB>(sHi[LICE_PIXEL_A]);
+
+      for (auto c = 0; c < 4; c++)
+      {
+        const uint16x8_t lo = Composite8NEON<FA, FB>(sLo[c], vmovl_u8(vget_low_u8(d.val[c])), faLo, fbLo);
+        const uint16x8_t hi = Composite8NEON<FA, FB>(sHi[c], vmovl_u8(vget_high_u8(d.val[c])), faHi, fbHi);
+        d.val[c] = vcombine_u8(vqmovn_u16(lo), vqmovn_u16(hi)); // saturates to 255
+      }
+
+      vst4q_u8(reinterpret_cast<uint8_t*>(pDst + i), d);
+    }
+
+    CompositeRowScalar<FA, FB>(pDst + i, pSrc + i, n - i, weight);
+  }
+#endif
+
+  /** @return \c true if this CPU and build support the instruction set */
+  static inline bool Supports(EISA isa)
+  {
+    switch (isa)
+    {
+      case EISA::Scalar:
+        return true;
+#ifdef IGRAPHICS_PREMUL_SSE2
+      case EISA::SSE2:
+        return true;
+      case EISA::AVX2:
+      {
+  #ifdef _MSC_VER
+        int info[4];
+        __cpuid(info, 0);
+
+        if (info[0] < 7)
+          return false;
+
+        __cpuid(info, 1);
+
+        if (!(info[2] & (1 << 27)) || (_xgetbv(0) & 6) != 6) // the OS saves the AVX registers
+          return false;
+
+        __cpuidex(info, 7, 0);
+        return (info[1] & (1 << 5)) != 0;
+  #else
+        return __builtin_cpu_supports("avx2");
+  #endif
+      }
+#endif
+#ifdef IGRAPHICS_PREMUL_NEON
+      case EISA::NEON:
+        return true;
+#endif
+      default:
+        return false;
+    }
+  }
+
+  /** @return The best instruction set that this CPU and build support, determined once */
+  static inline EISA GetBestISA()
+  {
+    static const EISA isa = Supports(EISA::AVX2) ? EISA::AVX2 : Supports(EISA::NEON) ? EISA::NEON : Supports(EISA::SSE2) ? EISA::SSE2 : EISA::Scalar;
+    return isa;
+  }
+
+  template <int FA, int FB>
+  RowFunc SelectRowFunc(EISA isa)
+  {
+    switch (isa)
+    {
+#ifdef IGRAPHICS_PREMUL_SSE2
+      case EISA::SSE2: return &CompositeRowSSE2<FA, FB>;
+#endif
+#ifdef IGRAPHICS_PREMUL_AVX2
+      case EISA::AVX2: return &CompositeRowAVX2<FA, FB>;
+#endif
+#ifdef IGRAPHICS_PREMUL_NEON
+      case EISA::NEON: return &CompositeRowNEON<FA, FB>;
+#endif
+      default: return &CompositeRowScalar<FA, FB>;
+    }
+  }
+
+  /** @param method The blend mode
+   * @param isa The instruction set, which must be supported, see Supports()
+   * @return The row kernel */
+  static inline RowFunc GetRowFunc(EBlend method, EISA isa = GetBestISA())
+  {
+    switch (method)
+    {
+      case EBlend::SrcIn:   return SelectRowFunc<kAlpha, kZero>(isa);
+      case EBlend::SrcOut:  return SelectRowFunc<kInvAlpha, kZero>(isa);
+      case EBlend::SrcAtop: return SelectRowFunc<kAlpha, kInvAlpha>(isa);
+      case EBlend::DstOver: return SelectRowFunc<kInvAlpha, kOne>(isa);
+      case EBlend::DstIn:   return SelectRowFunc<kZero, kAlpha>(isa);
+      case EBlend::DstOut:  return SelectRowFunc<kZero, kInvAlpha>(isa);
+      case EBlend::DstAtop: return SelectRowFunc<kInvAlpha, kAlpha>(isa);
+      case EBlend::Add:     return SelectRowFunc<kOne, kOne>(isa);
+      case EBlend::XOR:     return SelectRowFunc<kInvAlpha, kInvAlpha>(isa);
+      case EBlend::SrcOver:
+      default:              return SelectRowFunc<kOne, kInvAlphaSrcOver>(isa);
+    }
+  }
+
+  /** Composites a premultiplied bitmap onto another, clipping to the destination
+   * @param weight The global opacity, 0 to 1 */
+  static inline void Blit(LICE_IBitmap* pDest, LICE_IBitmap* pSrc, int dstx, int dsty, int srcx, int srcy, int srcw, int srch, float weight, EBlend method)
+  {
+    srcx = dstx < 0 ? srcx - dstx : srcx;
+    srcy = dsty < 0 ? srcy - dsty : srcy;
+    srcw = dstx < 0 ? srcw + dstx : srcw;
+    srch = dsty < 0 ? srch + dsty : srch;
+    dstx = std::max(dstx, 0);
+    dsty = std::max(dsty, 0);
+    srcw = std::min(std::min(srcw, pDest->getWidth() - dstx), pSrc->getWidth() - srcx);
+    srch = std::min(std::min(srch, pDest->getHeight() - dsty), pSrc->getHeight() - srcy);
+
+    if (srcw <= 0 || srch <= 0)
+      return;
+
+    const int w = static_cast<int>(std::round(std::min(std::max(weight, 0.f), 1.f) * 256.f));
+    const RowFunc func = GetRowFunc(method);
+    const int inSpan = pSrc->getRowSpan();
+    const int outSpan = pDest->getRowSpan();
+    const LICE_pixel* pIn = pSrc->getBits() + srcy * inSpan + srcx;
+    LICE_pixel* pOut = pDest->getBits() + dsty * outSpan + dstx;
+
+    for (auto i = 0; i < srch; i++, pIn += inSpan, pOut += outSpan)
+      func(pOut, pIn, srcw, w);
+  }
+}
+
+END_IGRAPHICS_NAMESPACE
+END_IPLUG_NAMESPACE
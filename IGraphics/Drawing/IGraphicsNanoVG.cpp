@@ -274,6 +274,11 @@ IBitmap IGraphicsNanoVG::LoadBitmap(const char* name, int nStates, bool framesAr
   if (targetScale == 0)
     targetScale = GetScreenScale();
 
+  IBitmap packedBitmap = LoadPackedBitmap(name, nStates, framesAreHorizontal, targetScale);
+
+  if (packedBitmap.IsValid())
+    return packedBitmap;
+
   // NanoVG does not use the global static cache, since bitmaps are textures linked to a context
   StaticStorage<APIBitmap>::Accessor storage(mBitmapCache);
   APIBitmap* pAPIBitmap = storage.Find(name, targetScale);
@@ -307,6 +312,18 @@ IBitmap IGraphicsNanoVG::LoadBitmap(const char* name, int nStates, bool framesAr
   return IBitmap(pAPIBitmap, nStates, framesAreHorizontal, name);
 }
 
+void IGraphicsNanoVG::ReleasePackedSource(const IBitmap& bitmap)
+{
+  StaticStorage<APIBitmap>::Accessor storage(mBitmapCache);
+  storage.Remove(bitmap.GetAPIBitmap());
+}
+
+bool IGraphicsNanoVG::BitmapIsCached(const char* name, int scale)
+{
+  StaticStorage<APIBitmap>::Accessor storage(mBitmapCache);
+  return storage.Find(name, scale) != nullptr;
+}
+
 APIBitmap* IGraphicsNanoVG::LoadAPIBitmap(const char* fileNameOrResID, int scale, EResourceLocation location, const char* ext)
 {
   int idx = 0;
@@ -380,6 +397,18 @@ void IGraphicsNanoVG::GetLayerBitmapData(const ILayerPtr& layer, RawBitmapData&
   }
 }
 
+bool IGraphicsNanoVG::SetLayerBitmapData(ILayerPtr& layer, RawBitmapData& data)
+{
+  const APIBitmap* pBitmap = layer->GetAPIBitmap();
+  int size = pBitmap->GetWidth() * pBitmap->GetHeight() * 4;
+  
+  if (data.GetSize() < size)
+    return false;
+  
+  nvgUpdateImage(mVG, pBitmap->GetBitmap(), data.Get());
+  return true;
+}
+
 void IGraphicsNanoVG::ApplyShadowMask(ILayerPtr& layer, RawBitmapData& mask, const IShadow& shadow)
 {
   const APIBitmap* pBitmap = layer->GetAPIBitmap();
@@ -440,6 +469,7 @@ void IGraphicsNanoVG::OnViewDestroyed()
 {
   // need to remove all the controls to free framebuffers, before deleting context
   RemoveAllControls();
+  mBitmapAtlas.Clear();
 
   StaticStorage<APIBitmap>::Accessor storage(mBitmapCache);
   storage.Clear();
@@ -523,6 +553,9 @@ void IGraphicsNanoVG::EndFrame()
 
 void IGraphicsNanoVG::DrawBitmap(const IBitmap& bitmap, const IRECT& dest, int srcX, int srcY, const IBlend* pBlend)
 {
+  if (bitmap.GetPackedFrame(1))
+    return DrawBitmap(GetUnpackedBitmap(bitmap), dest, srcX, srcY, pBlend);
+
   APIBitmap* pAPIBitmap = bitmap.GetAPIBitmap();
   
   assert(pAPIBitmap);
@@ -639,6 +672,17 @@ float IGraphicsNanoVG::DoMeasureText(const IText& text, const char* str, IRECT&
   return bounds.W();
 }
 
+void IGraphicsNanoVG::DoDrawData(const IColor& color, const float* x, const float* y, int nPoints, const IBlend* pBlend, float thickness)
+{
+  nvgBeginPath(mVG);
+  nvgMoveTo(mVG, x[0], y[0]);
+
+  for (auto i = 1; i < nPoints; i++)
+    nvgLineTo(mVG, x[i], y[i]);
+
+  PathStroke(color, thickness, GetDataStrokeOptions(), pBlend);
+}
+
 void IGraphicsNanoVG::DoDrawText(const IText& text, const char* str, const IRECT& bounds, const IBlend* pBlend)
 {
   IRECT measured = bounds;
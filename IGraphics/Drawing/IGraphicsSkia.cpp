@@ -433,6 +433,9 @@ void IGraphicsSkia::EndFrame()
 
 void IGraphicsSkia::DrawBitmap(const IBitmap& bitmap, const IRECT& dest, int srcX, int srcY, const IBlend* pBlend)
 {
+  if (bitmap.GetPackedFrame(1))
+    return DrawBitmap(GetUnpackedBitmap(bitmap), dest, srcX, srcY, pBlend);
+
   SkPaint p;
   
   p.setFilterQuality(kHigh_SkFilterQuality);
@@ -574,6 +577,20 @@ float IGraphicsSkia::DoMeasureText(const IText& text, const char* str, IRECT& bo
   return bounds.W();
 }
 
+void IGraphicsSkia::DoDrawData(const IColor& color, const float* x, const float* y, int nPoints, const IBlend* pBlend, float thickness)
+{
+  mDataPoints.resize(nPoints);
+
+  for (auto i = 0; i < nPoints; i++)
+    mDataPoints[i].set(x[i], y[i]);
+
+  // Transform and add the points as one batch, rather than one PathLineTo() at a time
+  mMatrix.mapPoints(mDataPoints.data(), nPoints);
+  mMainPath.reset();
+  mMainPath.addPoly(mDataPoints.data(), nPoints, false);
+  PathStroke(color, thickness, GetDataStrokeOptions(), pBlend);
+}
+
 void IGraphicsSkia::DoDrawText(const IText& text, const char* str, const IRECT& bounds, const IBlend* pBlend)
 {
   IRECT measured = bounds;
@@ -816,6 +833,20 @@ void IGraphicsSkia::GetLayerBitmapData(const ILayerPtr& layer, RawBitmapData& da
   }
 }
 
+bool IGraphicsSkia::SetLayerBitmapData(ILayerPtr& layer, RawBitmapData& data)
+{
+  SkiaDrawable* pDrawable = layer->GetAPIBitmap()->GetBitmap();
+  size_t rowBytes = CalcRowBytes(pDrawable->mSurface->width());
+  int size = pDrawable->mSurface->height() * static_cast<int>(rowBytes);
+    
+  if (data.GetSize() < size)
+    return false;
+    
+  SkImageInfo info = SkImageInfo::MakeN32Premul(pDrawable->mSurface->width(), pDrawable->mSurface->height());
+  pDrawable->mSurface->writePixels(SkPixmap(info, data.Get(), rowBytes), 0, 0);
+  return true;
+}
+
 void IGraphicsSkia::ApplyShadowMask(ILayerPtr& layer, RawBitmapData& mask, const IShadow& shadow)
 {
   SkiaDrawable* pDrawable = layer->GetAPIBitmap()->GetBitmap();
@@ -201,6 +201,9 @@ void IControl::SetDirty(bool triggerAction, int valIdx)
   ForValIdx(valIdx, setValue);
   
   mDirty = true;
+
+  if (mGraphics)
+    mGraphics->WakeDrawLoop();
   
   if (triggerAction)
   {
@@ -427,10 +430,21 @@ void IControl::OnEndAnimation()
     mAnimationEndActionFunc(this);
 }
 
+void IControl::SetAnimation(IAnimationFunction func)
+{
+  mAnimationFunc = func;
+
+  if (mAnimationFunc && mGraphics)
+    mGraphics->WakeDrawLoop();
+}
+
 void IControl::StartAnimation(int duration)
 {
   mAnimationStartTime = std::chrono::high_resolution_clock::now();
   mAnimationDuration = Milliseconds(duration);
+
+  if (mGraphics)
+    mGraphics->WakeDrawLoop();
 }
 
 double IControl::GetAnimationProgress() const
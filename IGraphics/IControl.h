@@ -33,6 +33,7 @@
 #include "ptrlist.h"
 
 #include "IGraphics.h"
+#include "IGraphicsDisplayList.h"
 
 BEGIN_IPLUG_NAMESPACE
 BEGIN_IGRAPHICS_NAMESPACE
@@ -182,6 +183,24 @@ public:
    * @param g The graphics context to which this control belongs. */
   virtual void Draw(IGraphics& g) = 0;
 
+  /** Implement this to record the control's drawing into a display list, for controls that use one (see SetUseDisplayList()).
+   * The IGraphics draw loop calls this instead of Draw() when the control is dirty, and otherwise replays the list.
+   * @param g The graphics context to which this control belongs, e.g. for measuring text
+   * @param list The display list to record into, which has been cleared */
+  virtual void RecordDisplayList(IGraphics& g, IDisplayList& list) {}
+
+  /** Makes the IGraphics draw loop draw this control via an IDisplayList, recorded with RecordDisplayList() when the control is dirty and replayed,
+   * culled to each dirty region, when the control is redrawn because of other controls.
+   * @param use \c true to draw via a display list */
+  void SetUseDisplayList(bool use)
+  {
+    if (use != (mDisplayList != nullptr))
+      mDisplayList = use ? std::make_unique<IDisplayList>() : nullptr;
+  }
+
+  /** @return The control's display list, or nullptr if it doesn't use one */
+  IDisplayList* GetDisplayList() { return mDisplayList.get(); }
+
   /** Implement this to customise how a colored highlight is drawn on the control in ProTools (AAX format only), when a control is linked to a parameter that is automated.
    * @param g The graphics context to which this control belongs. */
   virtual void DrawPTHighlight(IGraphics& g);
@@ -476,7 +495,7 @@ public:
   
   /** Set the animation function
    * @param func A std::function conforming to IAnimationFunction */
-  void SetAnimation(IAnimationFunction func) { mAnimationFunc = func;}
+  void SetAnimation(IAnimationFunction func);
   
   /** Set the animation function and starts it
    * @param func A std::function conforming to IAnimationFunction
@@ -486,6 +505,9 @@ public:
   /** Get the control's animation function, if it exists */
   IAnimationFunction GetAnimationFunction() { return mAnimationFunc; }
 
+  /** @return \c true if the control has an animation function, which keeps the draw loop at its full rate, see IGraphics::SetFrameRatePolicy() */
+  bool IsAnimating() const { return mAnimationFunc != nullptr; }
+
   /** Get the control's action function, if it exists */
   IActionFunction GetActionFunction() { return mActionFunc; }
 
@@ -576,6 +598,7 @@ private:
   std::vector<ParamTuple> mVals { {kNoParameter, 0.} };
   std::unordered_map<EGestureType, IGestureFunc> mGestureFuncs;
   EGestureType mLastGesture = EGestureType::Unknown;
+  std::unique_ptr<IDisplayList> mDisplayList;
 };
 
 #pragma mark - Base Controls
@@ -31,7 +31,10 @@ using VST3_API_BASE = iplug::IPlugVST3Controller;
 #include "IControl.h"
 #include "IControls.h"
 #include "IGraphicsLiveEdit.h"
+#include "IGraphicsBitmapResample.h"
 #include "IFPSDisplayControl.h"
+#include "IProfilerDisplayControl.h"
+#include "IGraphicsProfiler.h"
 #include "ICornerResizerControl.h"
 #include "IPopupMenuControl.h"
 #include "ITextEntryControl.h"
@@ -56,6 +59,7 @@ IGraphics::IGraphics(IGEditorDelegate& dlg, int w, int h, int fps, float scale)
 , mMaxHeight(h * 2)
 {
   mFPS = (fps > 0 ? fps : DEFAULT_FPS);
+  mTimerFPS = mFPS;
     
   StaticStorage<APIBitmap>::Accessor bitmapStorage(sBitmapCache);
   bitmapStorage.Retain();
@@ -70,6 +74,7 @@ IGraphics::~IGraphics()
 #endif
   
   RemoveAllControls();
+  mBitmapAtlas.Clear();
     
   StaticStorage<APIBitmap>::Accessor bitmapStorage(sBitmapCache);
   bitmapStorage.Release();
@@ -83,6 +88,7 @@ void IGraphics::SetScreenScale(int scale)
   PlatformResize(GetDelegate()->EditorResizeFromUI(WindowWidth() * GetPlatformWindowScale(), WindowHeight() * GetPlatformWindowScale()));
   ForAllControls(&IControl::OnRescale);
   SetAllControlsDirty();
+  mSVGRasterCache.Clear();
   DrawResize();
 }
 
@@ -107,6 +113,7 @@ void IGraphics::Resize(int w, int h, float scale)
   PlatformResize(GetDelegate()->EditorResizeFromUI(WindowWidth() * GetPlatformWindowScale(), WindowHeight() * GetPlatformWindowScale()));
   ForAllControls(&IControl::OnResize);
   SetAllControlsDirty();
+  mSVGRasterCache.Clear();
   DrawResize();
   
   if(mLayoutOnResize)
@@ -143,6 +150,9 @@ void IGraphics::RemoveControls(int fromIdx)
     if (pControl == mInPopupMenu)
       mInPopupMenu = nullptr;
     
+    if (mProfiler)
+      mProfiler->RemoveControl(pControl);
+    
     mControls.Delete(idx--, true);
   }
   
@@ -158,6 +168,13 @@ void IGraphics::RemoveAllControls()
   mTextEntryControl = nullptr;
   mCornerResizer = nullptr;
   mPerfDisplay = nullptr;
+  mProfilerDisplay = nullptr;
+  
+  if (mProfiler)
+    mProfiler->Reset();
+  
+  // cached SVG rasters are layers, which must be freed with the controls, before a GPU context is deleted
+  mSVGRasterCache.Clear();
     
 #if !defined(NDEBUG)
   mLiveEdit = nullptr;
@@ -344,6 +361,47 @@ void IGraphics::ShowFPSDisplay(bool enable)
   SetAllControlsDirty();
 }
 
+void IGraphics::EnableProfiler(bool enable)
+{
+  if (enable)
+  {
+    if (!mProfiler)
+      mProfiler = std::make_unique<IGraphicsProfiler>();
+  }
+  else
+  {
+    mProfilerDisplay = nullptr;
+    mProfiler = nullptr;
+  }
+  
+  SetAllControlsDirty();
+}
+
+void IGraphics::ShowProfilerDisplay(bool enable)
+{
+  if (enable)
+  {
+    EnableProfiler(true);
+    
+    if (!mProfilerDisplay)
+    {
+      mProfilerDisplay = std::make_unique<IProfilerDisplayControl>(GetBounds().GetPadded(-10).GetFromTRHC(360, 160));
+      mProfilerDisplay->SetDelegate(*GetDelegate());
+    }
+  }
+  else
+    mProfilerDisplay = nullptr;
+
+  SetAllControlsDirty();
+}
+
+void IGraphics::InvalidateSVGRasterCache(const ISVG& svg)
+{
+#ifndef IGRAPHICS_SKIA
+  mSVGRasterCache.Remove(svg.mImage);
+#endif
+}
+
 IControl* IGraphics::GetControlWithTag(int ctrlTag)
 {
   for (auto c = 0; c < NControls(); c++)
@@ -410,6 +468,9 @@ void IGraphics::ForAllControlsFunc(std::function<void(IControl& control)> func)
   if (mPerfDisplay)
     func(*mPerfDisplay);
   
+  if (mProfilerDisplay)
+    func(*mProfilerDisplay);
+  
 #if !defined(NDEBUG)
   if (mLiveEdit)
     func(*mLiveEdit);
@@ -557,6 +618,9 @@ void IGraphics::DrawText(const IText& text, const char* str, float x, float y, c
 
 void IGraphics::DrawBitmap(const IBitmap& bitmap, const IRECT& bounds, int bmpState, const IBlend* pBlend)
 {
+  if (const IBitmapFrame* pFrame = bitmap.GetPackedFrame(bmpState))
+    return DrawBitmap(*pFrame->mPage, bounds, pFrame->mX, pFrame->mY, pBlend);
+
   int srcX = 0;
   int srcY = 0;
 
@@ -702,7 +766,85 @@ void IGraphics::DrawGrid(const IColor& color, const IRECT& bounds, float gridSiz
 
 void IGraphics::DrawData(const IColor& color, const IRECT& bounds, float* normYPoints, int nPoints, float* normXPoints, const IBlend* pBlend, float thickness)
 {
-  //TODO:
+  if (nPoints < 2)
+    return;
+
+  const int n = DecimateData(bounds, normYPoints, nPoints, normXPoints);
+  DoDrawData(color, mDataX.data(), mDataY.data(), n, pBlend, thickness);
+}
+
+void IGraphics::DoDrawData(const IColor& color, const float* x, const float* y, int nPoints, const IBlend* pBlend, float thickness)
+{
+  for (auto i = 1; i < nPoints; i++)
+    DrawLine(color, x[i - 1], y[i - 1], x[i], y[i], pBlend, thickness);
+}
+
+int IGraphics::DecimateData(const IRECT& bounds, const float* normYPoints, int nPoints, const float* normXPoints)
+{
+  // Each run of points is reduced to at most 4 points, so the output can't be larger than the input
+  if (static_cast<int>(mDataX.size()) < nPoints)
+  {
+    mDataX.resize(nPoints);
+    mDataY.resize(nPoints);
+  }
+
+  const float pixelScale = GetBackingPixelScale();
+  const float xStep = nPoints > 1 ? bounds.W() / static_cast<float>(nPoints - 1) : 0.f;
+  const float h = bounds.H();
+  float* pX = mDataX.data();
+  float* pY = mDataY.data();
+  int n = 0;
+
+  auto getX = [&](int i) { return normXPoints ? bounds.L + bounds.W() * normXPoints[i] : bounds.L + xStep * static_cast<float>(i); };
+  auto getColumn = [&](float x) { return static_cast<int>(std::floor((x - bounds.L) * pixelScale)); };
+  auto emit = [&](float x, float y) { pX[n] = x; pY[n] = y; n++; };
+
+  int i = 0;
+  float x = getX(0);
+  int column = getColumn(x);
+
+  while (i < nPoints)
+  {
+    // Find the run of consecutive points in the same pixel column
+    const float firstX = x;
+    const int first = i;
+    int last = i, minIdx = i, maxIdx = i;
+    float minY = normYPoints[i], maxY = normYPoints[i];
+    int nextColumn = column;
+
+    for (i++; i < nPoints; i++)
+    {
+      x = getX(i);
+      nextColumn = getColumn(x);
+
+      if (nextColumn != column)
+        break;
+
+      const float y = normYPoints[i];
+      last = i;
+
+      if (y < minY) { minY = y; minIdx = i; }
+      if (y > maxY) { maxY = y; maxIdx = i; }
+    }
+
+    column = nextColumn;
+
+    // Emit the extremes in the order they occur, so the line still connects correctly
+    const int lo = std::min(minIdx, maxIdx);
+    const int hi = std::max(minIdx, maxIdx);
+    int prev = -1;
+
+    for (int idx : {first, lo, hi, last})
+    {
+      if (idx != prev)
+      {
+        emit(idx == first ? firstX : getX(idx), bounds.B - h * normYPoints[idx]);
+        prev = idx;
+      }
+    }
+  }
+
+  return n;
 }
 
 bool IGraphics::IsDirty(IRECTList& rects)
@@ -710,21 +852,33 @@ bool IGraphics::IsDirty(IRECTList& rects)
   if (mDisplayTickFunc)
     mDisplayTickFunc();
 
-  ForAllControlsFunc([](IControl& control) { control.Animate(); } );
+  {
+    IGraphicsProfiler::ScopedEvent profile(mProfiler.get(), IGraphicsProfiler::EEventType::Animate);
+    ForAllControlsFunc([](IControl& control) { control.Animate(); } );
+  }
 
   bool dirty = false;
+  bool animating = false;
     
-  auto func = [&dirty, &rects](IControl& control)
+  auto func = [&dirty, &animating, &rects](IControl& control)
   {
+    animating |= control.IsAnimating();
+
     if (control.IsDirty())
     {
       // N.B padding outlines for single line outlines
       rects.Add(control.GetRECT().GetPadded(0.75));
       dirty = true;
+
+      if (IDisplayList* pList = control.GetDisplayList())
+        pList->Invalidate();
     }
   };
-    
-  ForAllControlsFunc(func);
+  
+  {
+    IGraphicsProfiler::ScopedEvent profile(mProfiler.get(), IGraphicsProfiler::EEventType::IsDirty);
+    ForAllControlsFunc(func);
+  }
 
 #ifdef USE_IDLE_CALLS
   if (dirty)
@@ -747,9 +901,56 @@ bool IGraphics::IsDirty(IRECTList& rects)
   }
 #endif
 
+  // A display tick function or platform text entry may need the ticks even when no control is dirty
+  UpdateFrameRate(dirty || animating || mDisplayTickFunc || mInTextEntry);
+
   return dirty;
 }
 
+void IGraphics::SetFrameRatePolicy(EFrameRatePolicy policy, int idleFPS, int idleDelayMs)
+{
+  mFrameRatePolicy = policy;
+  mIdleFPS = Clip(idleFPS, 1, mFPS);
+  mIdleDelay = std::max(idleDelayMs, 0) / 1000.;
+  WakeDrawLoop();
+}
+
+void IGraphics::WakeDrawLoop()
+{
+  if (mFrameRatePolicy == EFrameRatePolicy::Fixed && mTimerFPS == mFPS)
+    return;
+
+  mLastActiveTime = GetTimestamp();
+
+  if (mTimerFPS != mFPS)
+  {
+    mTimerFPS = mFPS;
+    PlatformSetFrameRate(mFPS);
+  }
+}
+
+void IGraphics::UpdateFrameRate(bool active)
+{
+  if (mFrameRatePolicy == EFrameRatePolicy::Fixed)
+    return;
+
+  const double now = GetTimestamp();
+
+  if (active)
+    mLastActiveTime = now;
+
+  int fps = mFPS;
+
+  if (now - mLastActiveTime >= mIdleDelay)
+    fps = mFrameRatePolicy == EFrameRatePolicy::Adaptive ? mIdleFPS : 0;
+
+  if (fps != mTimerFPS)
+  {
+    mTimerFPS = fps;
+    PlatformSetFrameRate(fps);
+  }
+}
+
 void IGraphics::BeginFrame()
 {
   if(mPerfDisplay)
@@ -773,8 +974,23 @@ void IGraphics::DrawControl(IControl* pControl, const IRECT& bounds, float scale
     if (clipBounds.W() <= 0.0 || clipBounds.H() <= 0)
       return;
     
+    IGraphicsProfiler::ScopedEvent profile(mProfiler.get(), IGraphicsProfiler::EEventType::Control, clipBounds, pControl,
+                                           mProfiler ? IGraphicsProfiler::GetControlName(*pControl) : "", pControl->GetTag());
+    
     PrepareRegion(clipBounds);
-    pControl->Draw(*this);
+
+    if (IDisplayList* pList = pControl->GetDisplayList())
+    {
+      if (!pList->IsValid())
+      {
+        pList->Clear(controlBounds);
+        pControl->RecordDisplayList(*this, *pList);
+      }
+
+      pList->Replay(*this, clipBounds);
+    }
+    else
+      pControl->Draw(*this);
 #ifdef AAX_API
     pControl->DrawPTHighlight(*this);
 #endif
@@ -792,6 +1008,8 @@ void IGraphics::DrawControl(IControl* pControl, const IRECT& bounds, float scale
 
 void IGraphics::Draw(const IRECT& bounds, float scale)
 {
+  IGraphicsProfiler::ScopedEvent profile(mProfiler.get(), IGraphicsProfiler::EEventType::Region, bounds);
+  
   ForAllControlsFunc([this, bounds, scale](IControl& control) { DrawControl(&control, bounds, scale); });
 
 #ifndef NDEBUG
@@ -812,7 +1030,10 @@ void IGraphics::Draw(IRECTList& rects)
     return;
   
   float scale = GetBackingPixelScale();
-    
+  
+  if (mProfiler)
+    mProfiler->BeginFrame();
+  
   BeginFrame();
     
   if (mStrict)
@@ -830,7 +1051,13 @@ void IGraphics::Draw(IRECTList& rects)
       Draw(rects.Get(i), scale);
   }
   
-  EndFrame();
+  {
+    IGraphicsProfiler::ScopedEvent profile(mProfiler.get(), IGraphicsProfiler::EEventType::EndFrame);
+    EndFrame();
+  }
+  
+  if (mProfiler)
+    mProfiler->EndFrame();
 }
 
 void IGraphics::SetStrictDrawing(bool strict)
@@ -841,6 +1068,8 @@ void IGraphics::SetStrictDrawing(bool strict)
 
 void IGraphics::OnMouseDown(const std::vector<IMouseInfo>& points)
 {
+  WakeDrawLoop();
+
 //  Trace("IGraphics::OnMouseDown", __LINE__, "x:%0.2f, y:%0.2f, mod:LRSCA: %i%i%i%i%i", x, y, mod.L, mod.R, mod.S, mod.C, mod.A);
 
   bool singlePoint = points.size() == 1;
@@ -942,6 +1171,8 @@ void IGraphics::OnMouseDown(const std::vector<IMouseInfo>& points)
 
 void IGraphics::OnMouseUp(const std::vector<IMouseInfo>& points)
 {
+  WakeDrawLoop();
+
 //  Trace("IGraphics::OnMouseUp", __LINE__, "x:%0.2f, y:%0.2f, mod:LRSCA: %i%i%i%i%i", x, y, mod.L, mod.R, mod.S, mod.C, mod.A);
   
   if (ControlIsCaptured())
@@ -991,6 +1222,8 @@ void IGraphics::OnMouseUp(const std::vector<IMouseInfo>& points)
 
 void IGraphics::OnTouchCancelled(const std::vector<IMouseInfo>& points)
 {
+  WakeDrawLoop();
+
   if (ControlIsCaptured())
   {
     //work out which of mCapturedMap controls the cancel relates to
@@ -1016,6 +1249,8 @@ void IGraphics::OnTouchCancelled(const std::vector<IMouseInfo>& points)
 
 bool IGraphics::OnMouseOver(float x, float y, const IMouseMod& mod)
 {
+  WakeDrawLoop();
+
   Trace("IGraphics::OnMouseOver", __LINE__, "x:%0.2f, y:%0.2f, mod:LRSCA: %i%i%i%i%i",
         x, y, mod.L, mod.R, mod.S, mod.C, mod.A);
   
@@ -1043,6 +1278,8 @@ bool IGraphics::OnMouseOver(float x, float y, const IMouseMod& mod)
 
 void IGraphics::OnMouseOut()
 {
+  WakeDrawLoop();
+
   Trace("IGraphics::OnMouseOut", __LINE__, "");
 
   // Store the old cursor type so this gets restored when the mouse enters again
@@ -1053,6 +1290,8 @@ void IGraphics::OnMouseOut()
 
 void IGraphics::OnMouseDrag(const std::vector<IMouseInfo>& points)
 {
+  WakeDrawLoop();
+
 //  Trace("IGraphics::OnMouseDrag:", __LINE__, "x:%0.2f, y:%0.2f, dX:%0.2f, dY:%0.2f, mod:LRSCA: %i%i%i%i%i",
 //        x, y, dX, dY, mod.L, mod.R, mod.S, mod.C, mod.A);
 
@@ -1089,6 +1328,8 @@ void IGraphics::OnMouseDrag(const std::vector<IMouseInfo>& points)
 
 bool IGraphics::OnMouseDblClick(float x, float y, const IMouseMod& mod)
 {
+  WakeDrawLoop();
+
   Trace("IGraphics::OnMouseDblClick", __LINE__, "x:%0.2f, y:%0.2f, mod:LRSCA: %i%i%i%i%i",
         x, y, mod.L, mod.R, mod.S, mod.C, mod.A);
   
@@ -1125,6 +1366,8 @@ bool IGraphics::OnMouseDblClick(float x, float y, const IMouseMod& mod)
 
 void IGraphics::OnMouseWheel(float x, float y, const IMouseMod& mod, float d)
 {
+  WakeDrawLoop();
+
 #ifdef IGRAPHICS_IMGUI
     if(mImGuiRenderer)
     {
@@ -1140,6 +1383,8 @@ void IGraphics::OnMouseWheel(float x, float y, const IMouseMod& mod, float d)
 
 bool IGraphics::OnKeyDown(float x, float y, const IKeyPress& key)
 {
+  WakeDrawLoop();
+
   Trace("IGraphics::OnKeyDown", __LINE__, "x:%0.2f, y:%0.2f, key:%s",
         x, y, key.utf8);
 
@@ -1168,6 +1413,8 @@ bool IGraphics::OnKeyDown(float x, float y, const IKeyPress& key)
 
 bool IGraphics::OnKeyUp(float x, float y, const IKeyPress& key)
 {
+  WakeDrawLoop();
+
   Trace("IGraphics::OnKeyUp", __LINE__, "x:%0.2f, y:%0.2f, key:%s",
         x, y, key.utf8);
   
@@ -1196,6 +1443,8 @@ bool IGraphics::OnKeyUp(float x, float y, const IKeyPress& key)
 
 void IGraphics::OnDrop(const char* str, float x, float y)
 {
+  WakeDrawLoop();
+
   IControl* pControl = GetMouseControl(x, y, false);
   if (pControl) pControl->OnDrop(str);
 }
@@ -1406,9 +1655,25 @@ void IGraphics::OnDragResize(float x, float y)
 
 IBitmap IGraphics::GetScaledBitmap(IBitmap& src)
 {
-  //TODO: bug with # frames!
-//  return LoadBitmap(src.GetResourceName().Get(), src.N(), src.GetFramesAreHorizontal(), (GetScreenScale() == 1 && GetDrawScale() > 1.) ? 2 : 0 /* ??? */);
-  return LoadBitmap(src.GetResourceName().Get(), src.N(), src.GetFramesAreHorizontal(), GetScreenScale());
+  const char* name = src.GetResourceName().Get();
+  int targetScale = GetScreenScale();
+  const int backingScale = std::min(static_cast<int>(std::ceil(GetBackingPixelScale() - 0.01f)), MAX_IMG_SCALE);
+
+  // At intermediate draw scales use a denser level if there is a resource for one, scaling up to make it would only cost memory
+  if (backingScale > targetScale)
+  {
+    const char* ext = name + strlen(name) - 1;
+    while (ext >= name && *ext != '.') --ext;
+    ++ext;
+
+    WDL_String fullPath;
+    int sourceScale = 0;
+
+    if (SearchImageResource(name, ext, fullPath, backingScale, sourceScale) != EResourceLocation::kNotFound)
+      targetScale = std::max(targetScale, std::min(sourceScale, backingScale));
+  }
+
+  return LoadBitmap(name, src.N(), src.GetFramesAreHorizontal(), targetScale);
 }
 
 void IGraphics::EnableTooltips(bool enable)
@@ -1581,6 +1846,11 @@ IBitmap IGraphics::LoadBitmap(const char* name, int nStates, bool framesAreHoriz
   if (targetScale == 0)
     targetScale = GetScreenScale();
 
+  IBitmap packedBitmap = LoadPackedBitmap(name, nStates, framesAreHorizontal, targetScale);
+
+  if (packedBitmap.IsValid())
+    return packedBitmap;
+
   StaticStorage<APIBitmap>::Accessor storage(sBitmapCache);
   APIBitmap* pAPIBitmap = storage.Find(name, targetScale);
 
@@ -1638,6 +1908,172 @@ IBitmap IGraphics::LoadBitmap(const char* name, int nStates, bool framesAreHoriz
   return IBitmap(pAPIBitmap, nStates, framesAreHorizontal, name);
 }
 
+void IGraphics::PackBitmaps(const std::vector<IBitmapAtlasItem>& items)
+{
+  mBitmapAtlas.AddGroup(items);
+}
+
+bool IGraphics::BitmapIsCached(const char* name, int scale)
+{
+  StaticStorage<APIBitmap>::Accessor storage(sBitmapCache);
+  return storage.Find(name, scale) != nullptr;
+}
+
+IBitmap IGraphics::LoadPackedBitmap(const char* name, int nStates, bool framesAreHorizontal, int targetScale)
+{
+  if (mPackingBitmaps)
+    return IBitmap();
+
+  IBitmap bitmap = mBitmapAtlas.Find(name, nStates, framesAreHorizontal, targetScale);
+
+  if (!bitmap.IsValid())
+  {
+    const int group = mBitmapAtlas.FindGroup(name, nStates, framesAreHorizontal);
+
+    if (group >= 0 && PackBitmapGroup(group, targetScale))
+      bitmap = mBitmapAtlas.Find(name, nStates, framesAreHorizontal, targetScale);
+  }
+
+  return bitmap;
+}
+
+bool IGraphics::PackBitmapGroup(int group, int scale)
+{
+  const int nItems = mBitmapAtlas.GroupSize(group);
+  const bool flipped = FlippedBitmap();
+  const int screenScale = GetScreenScale();
+  const float drawScale = GetDrawScale();
+  std::vector<IBitmap> bitmaps(nItems);
+  std::vector<bool> release(nItems);
+  std::vector<std::vector<int>> blocks(nItems);
+  std::unique_ptr<RawBitmapData[]> pixels(new RawBitmapData[nItems]);
+  std::vector<ILayerPtr> pages;
+  IBitmapPacker packer(MAX_ATLAS_PAGE_SIZE, scale);
+  bool supported = true;
+
+  // Load the film-strips, only releasing them afterwards if nothing else had loaded them
+  mPackingBitmaps = true;
+
+  for (int i = 0; i < nItems; i++)
+  {
+    int nStates;
+    bool horizontal;
+    const char* name = mBitmapAtlas.GetGroupItem(group, i, nStates, horizontal);
+    release[i] = !BitmapIsCached(name, scale);
+    bitmaps[i] = LoadBitmap(name, nStates, horizontal, scale);
+  }
+
+  mPackingBitmaps = false;
+  mScreenScale = scale;
+  mDrawScale = 1.f;
+
+  // Draw each film-strip into a layer at the scale, to read its pixels in the layer format, and add its frames using the offsets that DrawBitmap() uses
+  for (int i = 0; i < nItems; i++)
+  {
+    const IBitmap& bitmap = bitmaps[i];
+
+    if (!bitmap.IsValid())
+      continue;
+
+    const IRECT bounds(0, 0, static_cast<float>(bitmap.W()), static_cast<float>(bitmap.H()));
+    StartLayer(nullptr, bounds);
+    DrawBitmap(bitmap, bounds, 0, 0, nullptr);
+    ILayerPtr layer = EndLayer();
+    GetLayerBitmapData(layer, pixels[i]);
+
+    const int w = bitmap.W() * scale, h = bitmap.H() * scale;
+
+    if (pixels[i].GetSize() < w * h * 4)
+      continue;
+
+    const int stride = flipped ? -pixels[i].GetSize() / h : pixels[i].GetSize() / h;
+    const uint8_t* pTop = pixels[i].Get() + (flipped ? (h - 1) * -stride : 0);
+    const int n = bitmap.N();
+    const int length = bitmap.GetFramesAreHorizontal() ? bitmap.W() : bitmap.H();
+
+    for (int f = 0; f < n; f++)
+    {
+      const int start = length * f / n;
+      const int size = length * (f + 1) / n - start;
+
+      if (bitmap.GetFramesAreHorizontal())
+        blocks[i].push_back(packer.Add(pTop + start * scale * 4, stride, size * scale, h));
+      else
+        blocks[i].push_back(packer.Add(pTop + start * scale * stride, stride, w, size * scale));
+    }
+  }
+
+  packer.Pack();
+
+  // Make the pages, which is where drawing APIs that can't write layer pixels give up
+  for (int p = 0; p < packer.NPages() && supported; p++)
+  {
+    StartLayer(nullptr, IRECT(0, 0, static_cast<float>(packer.GetPageWidth(p) / scale), static_cast<float>(packer.GetPageHeight(p) / scale)));
+    pages.push_back(EndLayer());
+
+    RawBitmapData data;
+    GetLayerBitmapData(pages.back(), data);
+
+    const int h = pages.back()->GetAPIBitmap()->GetHeight();
+    const int stride = data.GetSize() / h;
+
+    if (stride < packer.GetPageWidth(p) * 4)
+    {
+      supported = false;
+      break;
+    }
+
+    memset(data.Get(), 0, data.GetSize());
+    packer.CopyPage(p, flipped ? data.Get() + (h - 1) * stride : data.Get(), flipped ? -stride : stride);
+    supported = SetLayerBitmapData(pages.back(), data);
+  }
+
+  mScreenScale = screenScale;
+  mDrawScale = drawScale;
+
+  if (!supported)
+    return false;
+
+  std::vector<const IBitmap*> pageBitmaps;
+
+  for (ILayerPtr& page : pages)
+    pageBitmaps.push_back(mBitmapAtlas.AddPage(page));
+
+  for (int i = 0; i < nItems; i++)
+  {
+    const IBitmap& bitmap = bitmaps[i];
+
+    if (!bitmap.IsValid() || blocks[i].empty())
+      continue;
+
+    std::unique_ptr<IBitmapAtlas::Entry> pEntry(new IBitmapAtlas::Entry{bitmap.GetResourceName(), scale, bitmap.N(), bitmap.GetFramesAreHorizontal(), bitmap.W(), bitmap.H(), {}});
+
+    for (int idx : blocks[i])
+    {
+      const IBitmapPacker::Placement& placement = packer.GetPlacement(idx);
+      pEntry->mFrames.push_back({pageBitmaps[placement.mPage], placement.mX / scale, placement.mY / scale});
+    }
+
+    mBitmapAtlas.AddEntry(std::move(pEntry));
+
+    if (release[i])
+      ReleasePackedSource(bitmap);
+  }
+
+  DBGMSG("IGraphics: packed %i frames at %ix into %i pages, %i duplicate frames shared\n", packer.NBlocks() + packer.NDuplicates(), scale, packer.NPages(), packer.NDuplicates());
+
+  return true;
+}
+
+IBitmap IGraphics::GetUnpackedBitmap(const IBitmap& bitmap)
+{
+  mPackingBitmaps = true;
+  IBitmap unpacked = LoadBitmap(bitmap.GetResourceName().Get(), bitmap.N(), bitmap.GetFramesAreHorizontal(), bitmap.GetScale());
+  mPackingBitmaps = false;
+  assert(unpacked.IsValid() && !unpacked.GetPackedFrame(1));
+  return unpacked;
+}
+
 void IGraphics::ReleaseBitmap(const IBitmap& bitmap)
 {
   StaticStorage<APIBitmap>::Accessor storage(sBitmapCache);
@@ -1652,6 +2088,15 @@ void IGraphics::RetainBitmap(const IBitmap& bitmap, const char* cacheName)
 
 IBitmap IGraphics::ScaleBitmap(const IBitmap& inBitmap, const char* name, int scale)
 {
+  IBitmap outBitmap;
+
+  if (scale < inBitmap.GetScale() && inBitmap.GetDrawScale() == 1.f && DownsampleBitmap(inBitmap, scale, outBitmap))
+  {
+    outBitmap = IBitmap(outBitmap.GetAPIBitmap(), inBitmap.N(), inBitmap.GetFramesAreHorizontal(), name);
+    RetainBitmap(outBitmap, name);
+    return outBitmap;
+  }
+
   int screenScale = GetScreenScale();
   float drawScale = GetDrawScale();
 
@@ -1662,7 +2107,7 @@ IBitmap IGraphics::ScaleBitmap(const IBitmap& inBitmap, const char* name, int sc
   StartLayer(nullptr, bounds);
   DrawBitmap(inBitmap, bounds, 0, 0, nullptr);
   ILayerPtr layer = EndLayer();
-  IBitmap outBitmap = IBitmap(layer->mBitmap.release(), inBitmap.N(), inBitmap.GetFramesAreHorizontal(), name);
+  outBitmap = IBitmap(layer->mBitmap.release(), inBitmap.N(), inBitmap.GetFramesAreHorizontal(), name);
   RetainBitmap(outBitmap, name);
 
   mScreenScale = screenScale;
@@ -1671,6 +2116,70 @@ IBitmap IGraphics::ScaleBitmap(const IBitmap& inBitmap, const char* name, int sc
   return outBitmap;
 }
 
+bool IGraphics::DownsampleBitmap(const IBitmap& inBitmap, int targetScale, IBitmap& outBitmap)
+{
+  const int screenScale = GetScreenScale();
+  const float drawScale = GetDrawScale();
+  const int sourceScale = inBitmap.GetScale();
+  const IRECT bounds(0, 0, static_cast<float>(inBitmap.W()), static_cast<float>(inBitmap.H()));
+  RawBitmapData srcData, dstData;
+
+  // Make an empty layer at the target scale, and check that the drawing API can write to it
+  mScreenScale = targetScale;
+  mDrawScale = 1.f;
+  StartLayer(nullptr, bounds);
+  ILayerPtr dstLayer = EndLayer();
+  GetLayerBitmapData(dstLayer, dstData);
+
+  bool supported = dstData.GetSize() && SetLayerBitmapData(dstLayer, dstData);
+
+  // Draw the source into a layer at its own scale, to read its pixels in the layer format
+  if (supported)
+  {
+    mScreenScale = sourceScale;
+    StartLayer(nullptr, bounds);
+    DrawBitmap(inBitmap, bounds, 0, 0, nullptr);
+    ILayerPtr srcLayer = EndLayer();
+    GetLayerBitmapData(srcLayer, srcData);
+    supported = srcData.GetSize() > 0;
+  }
+
+  mScreenScale = screenScale;
+  mDrawScale = drawScale;
+
+  if (!supported)
+    return false;
+
+  const int n = inBitmap.N();
+  const bool horizontal = inBitmap.GetFramesAreHorizontal();
+  const int srcW = inBitmap.W() * sourceScale, srcH = inBitmap.H() * sourceScale;
+  const int dstW = inBitmap.W() * targetScale, dstH = inBitmap.H() * targetScale;
+  const bool flipped = FlippedBitmap();
+  const int srcStride = flipped ? -srcData.GetSize() / srcH : srcData.GetSize() / srcH;
+  const int dstStride = flipped ? -dstData.GetSize() / dstH : dstData.GetSize() / dstH;
+  const int length = horizontal ? inBitmap.W() : inBitmap.H();
+  const uint8_t* pSrc = srcData.Get() + (flipped ? (srcH - 1) * -srcStride : 0);
+  uint8_t* pDst = dstData.Get() + (flipped ? (dstH - 1) * -dstStride : 0);
+
+  // Each frame is filtered on its own, from the offsets that DrawBitmap() uses for it, so frames don't bleed into each other
+  for (int i = 0; i < n; i++)
+  {
+    const int start = length * i / n;
+    const int size = length * (i + 1) / n - start;
+
+    if (horizontal)
+      BitmapResample::Downsample(pSrc + start * sourceScale * 4, srcStride, size * sourceScale, srcH, pDst + start * targetScale * 4, dstStride, size * targetScale, dstH);
+    else
+      BitmapResample::Downsample(pSrc + start * sourceScale * srcStride, srcStride, srcW, size * sourceScale, pDst + start * targetScale * dstStride, dstStride, dstW, size * targetScale);
+  }
+
+  if (!SetLayerBitmapData(dstLayer, dstData))
+    return false;
+
+  outBitmap = IBitmap(dstLayer->mBitmap.release(), n, horizontal, inBitmap.GetResourceName().Get());
+  return true;
+}
+
 inline void IGraphics::SearchNextScale(int& sourceScale, int targetScale)
 {
   // Search downwards from MAX_IMG_SCALE, skipping targetScale before trying again
@@ -1944,7 +2453,7 @@ void IGraphics::ApplyLayerDropShadow(ILayerPtr& layer, const IShadow& shadow)
   kernel.Resize(iSize);
         
   for (int i = 0; i < iSize; i++)
-    kernel.Get()[i] = static_cast<uint8_t>(std::round(255.f * std::expf(-(i * i) * blurConst)));
+    kernel.Get()[i] = static_cast<uint8_t>(std::round(255.f * std::exp(-(i * i) * blurConst)));
   
   // Kernel normalisation
   int normFactor = kernel.Get()[0];
@@ -2136,6 +2645,8 @@ bool IGraphics::RespondsToGesture(float x, float y)
 
 void IGraphics::OnGestureRecognized(const IGestureInfo& info)
 {
+  WakeDrawLoop();
+
   IControl* pControl = GetMouseControl(info.x, info.y, false, false);
 
   if(pControl && pControl->GetWantsGestures())
@@ -46,6 +46,7 @@
 
 #include "IGraphicsConstants.h"
 #include "IGraphicsStructs.h"
+#include "IGraphicsBitmapAtlas.h"
 #include "IGraphicsPopupMenu.h"
 #include "IGraphicsEditorDelegate.h"
 
@@ -74,6 +75,8 @@ class IPopupMenuControl;
 class ITextEntryControl;
 class ICornerResizerControl;
 class IFPSDisplayControl;
+class IProfilerDisplayControl;
+class IGraphicsProfiler;
 class IBubbleControl;
 
 /**  The lowest level base class of an IGraphics context */
@@ -363,7 +366,9 @@ public:
   /** @return A CString representing the Drawing API in use e.g. "LICE" */
   virtual const char* GetDrawingAPIStr() = 0;
   
-  /** Returns a new IBitmap, an integer scaled version of the input, and adds it to the cache
+  /** Returns a new IBitmap, an integer scaled version of the input, and adds it to the cache.
+   * Multi-frame bitmaps are scaled a frame at a time, so that frames don't bleed into each other. When scaling down, and the drawing API supports
+   * SetLayerBitmapData(), each frame is box filtered on the CPU (see IGraphicsBitmapResample.h) rather than drawn, which doesn't alias at ratios over 2:1
    * @param inbitmap The source bitmap to be scaled
    * @param cacheName The name by which this bitmap is identified int the cache (along with targetScale)
    * @param targetScale An integer scale factor of the new bitmap
@@ -381,6 +386,8 @@ public:
 
   /** Get a version of the input bitmap from the cache that corresponds to the current screen scale
    * For example, when IControl::OnRescale() is called bitmap-based IControls can load in 
+   * If the drawing API draws at the draw scale, this is the smallest integer scale that is at least the backing pixel scale (up to MAX_IMG_SCALE),
+   * so that at intermediate draw scales the bitmap is only ever drawn smaller, by less than 2:1, and the levels are made once and cached
    * @param inBitmap The source bitmap to find a scaled version of
    * @return IBitmap The scaled bitmap */
   IBitmap GetScaledBitmap(IBitmap& inBitmap);
@@ -462,14 +469,15 @@ public:
    * @param thickness Optional line thickness */
   virtual void DrawGrid(const IColor& color, const IRECT& bounds, float gridSizeH, float gridSizeV, const IBlend* pBlend = 0, float thickness = 1.f);
 
-  /** /todo
-   * @param color /todo
-   * @param bounds /todo
-   * @param normYPoints /todo
-   * @param nPoints /todo
-   * @param normXPoints /todo
-   * @param pBlend /todo
-   * @param thickness /todo */
+  /** Draws a polyline of normalized data points, e.g. a waveform or a frequency response.
+   * Consecutive points that fall in the same pixel column are reduced to their first, minimum, maximum and last values, so the cost depends on the width in pixels rather than on nPoints
+   * @param color The color of the line
+   * @param bounds The rectangle that the normalized values map to, 0 is at the bottom
+   * @param normYPoints The normalized y values
+   * @param nPoints The number of points
+   * @param normXPoints The normalized x values, or nullptr to space the points evenly across the width
+   * @param pBlend Optional blend method
+   * @param thickness The line thickness */
   virtual void DrawData(const IColor& color, const IRECT& bounds, float* normYPoints, int nPoints, float* normXPoints = nullptr, const IBlend* pBlend = 0, float thickness = 1.f);
   
   /** Load a font to be used by the graphics context
@@ -532,6 +540,12 @@ public:
    * @param layer /todo
    * @param data /todo */
   virtual void GetLayerBitmapData(const ILayerPtr& layer, RawBitmapData& data) = 0;
+
+  /** Replaces the pixels of a layer, the inverse of GetLayerBitmapData()
+   * @param layer The layer to write to
+   * @param data Premultiplied pixels, in the format and size that GetLayerBitmapData() gives for the layer
+   * @return \c true if the pixels were written, drawing APIs that don't support this return \c false and IGraphics draws instead */
+  virtual bool SetLayerBitmapData(ILayerPtr& layer, RawBitmapData& data) { return false; }
   
   /** /todo
    * @param layer /todo
@@ -1009,6 +1023,24 @@ public:
    * @return A whole number representing the desired frame rate at which the graphics context is redrawn. NOTE: the actual frame rate might be different */
   int FPS() const { return mFPS; }
 
+  /** Sets how the draw loop ticks when no control is dirty or animating. With EFrameRatePolicy::Adaptive or EFrameRatePolicy::OnDemand, the platform timer
+   * drops to idleFPS or stops once the UI has been idle for idleDelayMs, and goes back to FPS() on input, SetDirty(), a new animation or a message from the delegate.
+   * Controls that poll state in Draw() without calling SetDirty() won't be redrawn while the timer is slowed down, so this is opt-in per editor
+   * @param policy The frame rate policy
+   * @param idleFPS The idle frame rate, with EFrameRatePolicy::Adaptive
+   * @param idleDelayMs How long the UI must be idle before the frame rate drops, in milliseconds */
+  void SetFrameRatePolicy(EFrameRatePolicy policy, int idleFPS = DEFAULT_IDLE_FPS, int idleDelayMs = DEFAULT_IDLE_DELAY);
+
+  /** @return The frame rate policy, see SetFrameRatePolicy() */
+  EFrameRatePolicy GetFrameRatePolicy() const { return mFrameRatePolicy; }
+
+  /** @return The rate the platform timer is currently set to, which is FPS() unless the frame rate policy has slowed it down, or 0 if it has been stopped */
+  int GetCurrentFPS() const { return mTimerFPS; }
+
+  /** Puts the draw loop back to its full rate, if the frame rate policy has slowed it down. This is called for input events, IControl::SetDirty(), new animations
+   * and messages from the delegate, call it if something else needs the ticks, e.g. before starting a display tick function. Must be called on the UI thread */
+  void WakeDrawLoop();
+
   /** Gets the graphics context scaling factor.
    * @return The scaling applied to the graphics context */
   float GetDrawScale() const { return mDrawScale; }
@@ -1132,6 +1164,14 @@ private:
   
   /** /todo */
   virtual void PlatformResize(bool parentHasResized) {}
+
+  /** Called when the frame rate policy changes the rate at which the platform should call IsDirty()
+   * @param fps The new rate, or 0 to stop the timer until the next call */
+  virtual void PlatformSetFrameRate(int fps) {}
+
+  /** Adjusts the platform timer according to the frame rate policy, called at the end of IsDirty()
+   * @param active \c true if something was dirty or animating in this tick */
+  void UpdateFrameRate(bool active);
   
   /** /todo */
   virtual void DrawResize() {}
@@ -1240,6 +1280,39 @@ public:
   /** @return \c true if performance display is shown */
   bool ShowingFPSDisplay() { return mPerfDisplay != nullptr; }
 
+  /** Enables recording of the time spent in each stage of drawing and in each control, see IGraphicsProfiler
+   * @param enable \c true to enable the profiler, \c false to disable it and discard the data recorded */
+  void EnableProfiler(bool enable);
+
+  /** @return The profiler, or nullptr if profiling is not enabled */
+  IGraphicsProfiler* GetProfiler() { return mProfiler.get(); }
+
+  /** Shows an overlay with the per-frame and per-control data recorded by the profiler. Showing the overlay enables the profiler
+   * @param enable \c true to show */
+  void ShowProfilerDisplay(bool enable);
+
+  /** @return \c true if the profiler overlay is shown */
+  bool ShowingProfilerDisplay() { return mProfilerDisplay != nullptr; }
+
+  /** Path based backends (other than Skia) rasterize SVGs once at the current draw and screen scale and then blit the cached raster.
+   * Set the memory budget of that cache, rasters are evicted least recently used first when it is exceeded
+   * @param bytes The maximum memory used by cached rasters, 0 disables the cache and SVGs are always drawn as paths */
+  void SetSVGRasterCacheBudget(size_t bytes) { mSVGRasterCache.SetBudget(bytes); }
+
+  /** By default rotated SVGs are drawn as paths. With rotation steps, DrawRotatedSVG() snaps the angle to one of a number of steps per revolution and caches a raster per step
+   * @param steps The number of angles cached per revolution, e.g. 256 for a knob. 0 disables caching of rotated SVGs */
+  void SetSVGRasterCacheRotationSteps(int steps) { mSVGRasterCacheRotationSteps = std::max(steps, 0); }
+
+  /** @return The number of angles per revolution that rotated SVGs are cached at, 0 if rotated SVGs are not cached */
+  int GetSVGRasterCacheRotationSteps() const { return mSVGRasterCacheRotationSteps; }
+
+  /** Discard the cached rasters of an SVG, call this if the SVG's image has been modified. SVGs that change continuously should opt out of caching instead, see ISVG::mRasterCache
+   * @param svg The SVG to discard */
+  void InvalidateSVGRasterCache(const ISVG& svg);
+
+  /** Discard all cached SVG rasters. This is done automatically when the UI is resized or rescaled */
+  void ClearSVGRasterCache() { mSVGRasterCache.Clear(); }
+
   /** Attach a control for text entry, to override platform text entry */
   void AttachTextEntryControl();
   
@@ -1473,6 +1546,14 @@ public:
    * @return An IBitmap representing the image */
   virtual IBitmap LoadBitmap(const char* fileNameOrResID, int nStates = 1, bool framesAreHorizontal = false, int targetScale = 0);
 
+  /** Registers a group of film-strip bitmaps to be packed together into shared atlas pages. The first time one of them is loaded at a scale,
+   * the whole group is loaded at that scale, identical frames are stored once, and the frames are packed into as few pages as possible.
+   * LoadBitmap() then returns bitmaps whose frames are drawn from the pages, and IGraphics::DrawBitmap() with a frame index works as before.
+   * Call this before loading the bitmaps, e.g. at the start of the layout function. Packed bitmaps should only be drawn by frame index, and the
+   * film-strips are released from the cache once packed, unless they were already loaded. Drawing APIs that don't support SetLayerBitmapData() load the film-strips as usual
+   * @param items The bitmaps, with the same number of states and orientation they will be loaded with */
+  void PackBitmaps(const std::vector<IBitmapAtlasItem>& items);
+
   /** Load an SVG from disk or from windows resource
    * @param fileNameOrResID A CString absolute path or resource ID
    * @return An ISVG representing the image */
@@ -1545,12 +1626,53 @@ protected:
    * @return  pointer to the bitmap in the cache,  or null pointer if not found */
   APIBitmap* SearchBitmapInCache(const char* fileName, int targetScale, int& sourceScale);
 
+  /** @return \c true if a bitmap is in the cache at a scale, used to decide whether a film-strip can be released once packed */
+  virtual bool BitmapIsCached(const char* name, int scale);
+
+  /** Releases a film-strip once its frames have been packed into the atlas. NanoVG overrides this, since its ReleaseBitmap() does nothing
+   * @param bitmap The film-strip */
+  virtual void ReleasePackedSource(const IBitmap& bitmap) { ReleaseBitmap(bitmap); }
+
+  /** Atlas pages can only be drawn a frame at a time, so drawing methods that take a whole bitmap or a source offset use this to draw packed bitmaps
+   * from the original film-strip instead, which is loaded again and stays cached
+   * @param bitmap A packed bitmap, see IBitmap::GetPackedFrame()
+   * @return The film-strip the bitmap was packed from, at the same scale */
+  IBitmap GetUnpackedBitmap(const IBitmap& bitmap);
+
+  /** Used by LoadBitmap() implementations, to get a bitmap from the atlas, packing its group at targetScale if needed, see PackBitmaps()
+   * @return The packed bitmap, or an invalid IBitmap if it is not in a group or can't be packed */
+  IBitmap LoadPackedBitmap(const char* name, int nStates, bool framesAreHorizontal, int targetScale);
+
+  /** Loads the bitmaps of a group at a scale and packs their frames into new atlas pages
+   * @return \c false if the drawing API can't write layer pixels */
+  bool PackBitmapGroup(int group, int scale);
+
+  /** Used by ScaleBitmap() to box filter a bitmap to a smaller scale, a frame at a time
+   * @param inBitmap The source bitmap, which must have a draw scale of 1
+   * @param targetScale The integer scale of the new bitmap, less than the scale of inBitmap
+   * @param outBitmap Receives the new bitmap
+   * @return \c false if the drawing API can't write layer pixels */
+  bool DownsampleBitmap(const IBitmap& inBitmap, int targetScale, IBitmap& outBitmap);
+
   /** /todo
    * @param text /todo
    * @param str /todo
    * @param bounds /todo
    * @return The width of the text */
   virtual float DoMeasureText(const IText& text, const char* str, IRECT& bounds) const = 0;
+
+  /** Draws a polyline for DrawData(), after decimation. The default implementation draws a line per segment, backends override it with a single path or vertex batch
+   * @param color The color of the line
+   * @param x The x coordinates
+   * @param y The y coordinates
+   * @param nPoints The number of points
+   * @param pBlend Optional blend method
+   * @param thickness The line thickness */
+  virtual void DoDrawData(const IColor& color, const float* x, const float* y, int nPoints, const IBlend* pBlend, float thickness);
+
+  /** Maps normalized data points to bounds and reduces each run of points within a pixel column to its first, minimum, maximum and last points, see DrawData()
+   * @return The number of points, which are in mDataX and mDataY */
+  int DecimateData(const IRECT& bounds, const float* normYPoints, int nPoints, const float* normXPoints);
     
   /** /todo
    * @param text /todo
@@ -1592,6 +1714,8 @@ private:
   WDL_PtrList<IBubbleControl> mBubbleControls;
   std::unique_ptr<IPopupMenuControl> mPopupControl;
   std::unique_ptr<IFPSDisplayControl> mPerfDisplay;
+  std::unique_ptr<IProfilerDisplayControl> mProfilerDisplay;
+  std::unique_ptr<IGraphicsProfiler> mProfiler;
   std::unique_ptr<ITextEntryControl> mTextEntryControl;
   std::unique_ptr<IControl> mLiveEdit;
   
@@ -1607,6 +1731,12 @@ private:
   float mDrawScale = 1.f; // scale deviation from  default width and height i.e stretching the UI by dragging bottom right hand corner
 
   int mIdleTicks = 0;
+
+  EFrameRatePolicy mFrameRatePolicy = EFrameRatePolicy::Fixed;
+  int mIdleFPS = DEFAULT_IDLE_FPS;
+  double mIdleDelay = DEFAULT_IDLE_DELAY / 1000.; // seconds
+  int mTimerFPS; // the rate the platform timer is set to, 0 if it is stopped
+  double mLastActiveTime = 0.;
   
   std::vector<EGestureType> mRegisteredGestures; // All the types of gesture registered with the graphics context
   IRECTList mGestureRegions; // Rectangular regions linked to gestures (excluding IControls)
@@ -1657,6 +1787,15 @@ protected:
   friend class ITextEntryControl;
   
   std::stack<ILayer*> mLayers;
+
+  SVGRasterCache<ILayerPtr> mSVGRasterCache;
+  int mSVGRasterCacheRotationSteps = 0;
+
+  std::vector<float> mDataX; // scratch buffers for DrawData()
+  std::vector<float> mDataY;
+
+  IBitmapAtlas mBitmapAtlas;
+  bool mPackingBitmaps = false; // set while film-strips are loaded for packing or as unpacked copies, so that LoadBitmap() returns the film-strips
   
 #ifdef IGRAPHICS_IMGUI
 public:
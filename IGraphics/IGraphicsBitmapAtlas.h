@@ -0,0 +1,328 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+#pragma once
+
+/**
+ * @file
+ * @brief Packing of filmstrip frames into shared atlas pages, with deduplication of identical frames
+ */
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include "IPlugPlatform.h"
+#include "IGraphicsStructs.h"
+
+BEGIN_IPLUG_NAMESPACE
+BEGIN_IGRAPHICS_NAMESPACE
+
+/** A filmstrip to pack into an atlas, see IGraphics::PackBitmaps() */
+struct IBitmapAtlasItem
+{
+  const char* mName;
+  int mNStates = 1;
+  bool mFramesAreHorizontal = false;
+
+  IBitmapAtlasItem(const char* name, int nStates = 1, bool framesAreHorizontal = false)
+  : mName(name), mNStates(nStates), mFramesAreHorizontal(framesAreHorizontal)
+  {}
+};
+
+/** Packs blocks of 32 bit pixels into pages, with shelf packing, sharing one copy of blocks that have identical pixels.
+ * Blocks are referenced, not copied, so their pixels must stay valid until the pages have been copied with CopyPage().
+ * Positions and page sizes are multiples of the alignment, and blocks are separated by at least the alignment, so that
+ * with an alignment of the bitmap scale every position is a whole number of points and bilinear filtering doesn't pick up the neighbouring block. */
+class IBitmapPacker
+{
+public:
+  /** Where a block was placed, in pixels */
+  struct Placement
+  {
+    int mPage = 0;
+    int mX = 0;
+    int mY = 0;
+  };
+
+  /** @param maxPageSize The maximum page width and height in pixels, blocks that are larger get a page of their own
+   * @param alignment The alignment of positions and sizes, in pixels */
+  IBitmapPacker(int maxPageSize, int alignment)
+  : mMaxPageSize(maxPageSize), mAlignment(std::max(1, alignment))
+  {}
+
+  /** Adds a block of pixels
+   * @param pData The top row of the block
+   * @param stride The distance between rows in bytes, which is negative if the rows are stored bottom up
+   * @param w The width of the block in pixels
+   * @param h The height of the block in pixels
+   * @return The index of the block, which is the index of an earlier block if that one has the same size and pixels */
+  int Add(const uint8_t* pData, int stride, int w, int h)
+  {
+    const uint64_t hash = Hash(pData, stride, w, h);
+    std::vector<int>& candidates = mHashes[hash];
+
+    for (int idx : candidates)
+    {
+      if (Equal(mBlocks[idx], pData, stride, w, h))
+      {
+        mNDuplicates++;
+        return idx;
+      }
+    }
+
+    candidates.push_back(NBlocks());
+    mBlocks.push_back({pData, stride, w, h, Placement()});
+    return NBlocks() - 1;
+  }
+
+  /** Places the unique blocks, tallest first, into as few pages as possible */
+  void Pack()
+  {
+    std::vector<int> order(mBlocks.size());
+
+    for (int i = 0; i < NBlocks(); i++)
+      order[i] = i;
+
+    std::stable_sort(order.begin(), order.end(), [&](int a, int b) { return mBlocks[a].mH > mBlocks[b].mH; });
+
+    mPages.clear();
+    int x = 0, shelfY = 0, shelfH = 0;
+
+    for (int idx : order)
+    {
+      Block& block = mBlocks[idx];
+      const int w = Align(block.mW), h = Align(block.mH);
+
+      if (mPages.empty() || (x && x + w > mMaxPageSize))
+      {
+        // Start a new shelf, below the current one
+        shelfY += shelfH ? shelfH + mAlignment : 0;
+        shelfH = 0;
+        x = 0;
+      }
+
+      if (mPages.empty() || (shelfY && shelfY + h > mMaxPageSize))
+      {
+        mPages.push_back({0, 0});
+        shelfY = shelfH = x = 0;
+      }
+
+      block.mPlacement = {NPages() - 1, x, shelfY};
+      x += w + mAlignment;
+      shelfH = std::max(shelfH, h);
+
+      Page& page = mPages.back();
+      page.mW = std::max(page.mW, block.mPlacement.mX + w);
+      page.mH = std::max(page.mH, block.mPlacement.mY + h);
+    }
+  }
+
+  /** Copies the blocks of a page into its pixels, which should be cleared first
+   * @param page The page index
+   * @param pData The top row of the page, of at least GetPageWidth() by GetPageHeight() pixels
+   * @param stride The distance between rows in bytes, which is negative if the rows are stored bottom up */
+  void CopyPage(int page, uint8_t* pData, int stride) const
+  {
+    for (const Block& block : mBlocks)
+    {
+      if (block.mPlacement.mPage != page)
+        continue;
+
+      for (int y = 0; y < block.mH; y++)
+        memcpy(pData + (block.mPlacement.mY + y) * stride + block.mPlacement.mX * 4, block.mData + y * block.mStride, block.mW * 4);
+    }
+  }
+
+  /** @return The number of unique blocks */
+  int NBlocks() const { return static_cast<int>(mBlocks.size()); }
+
+  /** @return The number of blocks that were added, but shared the pixels of an earlier block */
+  int NDuplicates() const { return mNDuplicates; }
+
+  /** @return The number of pages, after Pack() */
+  int NPages() const { return static_cast<int>(mPages.size()); }
+
+  int GetPageWidth(int page) const { return mPages[page].mW; }
+  int GetPageHeight(int page) const { return mPages[page].mH; }
+
+  /** @param idx The index returned by Add()
+   * @return Where the block is, after Pack() */
+  const Placement& GetPlacement(int idx) const { return mBlocks[idx].mPlacement; }
+
+  /** 64 bit FNV-1a hash of the pixels of a block */
+  static uint64_t Hash(const uint8_t* pData, int stride, int w, int h)
+  {
+    uint64_t hash = 14695981039346656037ull ^ (static_cast<uint64_t>(w) << 32 | static_cast<uint32_t>(h));
+
+    for (int y = 0; y < h; y++)
+    {
+      const uint8_t* pRow = pData + y * stride;
+
+      for (int i = 0; i < w * 4; i++)
+        hash = (hash ^ pRow[i]) * 1099511628211ull;
+    }
+
+    return hash;
+  }
+
+private:
+  struct Block
+  {
+    const uint8_t* mData;
+    int mStride;
+    int mW;
+    int mH;
+    Placement mPlacement;
+  };
+
+  struct Page
+  {
+    int mW;
+    int mH;
+  };
+
+  int Align(int size) const { return (size + mAlignment - 1) / mAlignment * mAlignment; }
+
+  static bool Equal(const Block& block, const uint8_t* pData, int stride, int w, int h)
+  {
+    if (block.mW != w || block.mH != h)
+      return false;
+
+    for (int y = 0; y < h; y++)
+    {
+      if (memcmp(block.mData + y * block.mStride, pData + y * stride, w * 4))
+        return false;
+    }
+
+    return true;
+  }
+
+  int mMaxPageSize;
+  int mAlignment;
+  int mNDuplicates = 0;
+  std::vector<Block> mBlocks;
+  std::vector<Page> mPages;
+  std::unordered_map<uint64_t, std::vector<int>> mHashes;
+};
+
+/** The bitmaps that an IGraphics packs into atlases: the groups registered with IGraphics::PackBitmaps(), and for each scale they have been packed at,
+ * the atlas pages and the frame positions of each bitmap. Owned by IGraphics, and only accessed on the UI thread */
+class IBitmapAtlas
+{
+public:
+  /** A bitmap whose frames have been packed */
+  struct Entry
+  {
+    WDL_String mName;
+    int mScale;
+    int mN;
+    bool mFramesAreHorizontal;
+    int mW;
+    int mH;
+    std::vector<IBitmapFrame> mFrames;
+  };
+
+  /** Registers a group of bitmaps that are packed together
+   * @return The index of the group */
+  int AddGroup(const std::vector<IBitmapAtlasItem>& items)
+  {
+    mGroups.emplace_back();
+
+    for (const IBitmapAtlasItem& item : items)
+      mGroups.back().push_back({WDL_String(item.mName), item.mNStates, item.mFramesAreHorizontal});
+
+    return static_cast<int>(mGroups.size()) - 1;
+  }
+
+  /** @return The index of the group a bitmap was registered in, or -1 */
+  int FindGroup(const char* name, int nStates, bool framesAreHorizontal) const
+  {
+    for (int g = static_cast<int>(mGroups.size()) - 1; g >= 0; g--)
+    {
+      for (const Item& item : mGroups[g])
+      {
+        if (item.mNStates == nStates && item.mFramesAreHorizontal == framesAreHorizontal && !strcmp(item.mName.Get(), name))
+          return g;
+      }
+    }
+
+    return -1;
+  }
+
+  /** @return The number of bitmaps in a group */
+  int GroupSize(int group) const { return static_cast<int>(mGroups[group].size()); }
+
+  /** Gets a bitmap of a group
+   * @return The name of the bitmap */
+  const char* GetGroupItem(int group, int idx, int& nStates, bool& framesAreHorizontal) const
+  {
+    const Item& item = mGroups[group][idx];
+    nStates = item.mNStates;
+    framesAreHorizontal = item.mFramesAreHorizontal;
+    return item.mName.Get();
+  }
+
+  /** @return The bitmap for a packed entry, or an invalid IBitmap if it hasn't been packed at this scale */
+  IBitmap Find(const char* name, int nStates, bool framesAreHorizontal, int scale) const
+  {
+    for (const auto& pEntry : mEntries)
+    {
+      if (pEntry->mScale == scale && pEntry->mN == nStates && pEntry->mFramesAreHorizontal == framesAreHorizontal && !strcmp(pEntry->mName.Get(), name))
+        return IBitmap(pEntry->mFrames.data(), pEntry->mN, pEntry->mFramesAreHorizontal, pEntry->mW, pEntry->mH, pEntry->mName.Get());
+    }
+
+    return IBitmap();
+  }
+
+  /** Takes ownership of a page
+   * @return The bitmap for the page, which frames refer to */
+  const IBitmap* AddPage(ILayerPtr& page)
+  {
+    mPages.push_back(std::unique_ptr<Page>(new Page{std::move(page), IBitmap()}));
+    mPages.back()->mBitmap = mPages.back()->mLayer->GetBitmap();
+    return &mPages.back()->mBitmap;
+  }
+
+  /** Adds a packed bitmap, whose frames refer to pages that have been added */
+  void AddEntry(std::unique_ptr<Entry> pEntry) { mEntries.push_back(std::move(pEntry)); }
+
+  /** Frees the pages and entries, keeping the groups so that they are packed again the next time they are loaded.
+   * Bitmaps from the atlas must not be drawn after this, so it should be called after the controls have been removed */
+  void Clear()
+  {
+    mEntries.clear();
+    mPages.clear();
+  }
+
+private:
+  struct Item
+  {
+    WDL_String mName;
+    int mNStates;
+    bool mFramesAreHorizontal;
+  };
+
+  struct Page
+  {
+    ILayerPtr mLayer;
+    IBitmap mBitmap;
+  };
+
+  std::vector<std::vector<Item>> mGroups;
+  std::vector<std::unique_ptr<Entry>> mEntries;
+  std::vector<std::unique_ptr<Page>> mPages;
+};
+
+END_IGRAPHICS_NAMESPACE
+END_IPLUG_NAMESPACE
@@ -0,0 +1,216 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+#pragma once
+
+/**
+ * @file
+ * @brief Box filter downsampling of premultiplied 32 bit pixels, used to build the integer scale levels of bitmaps
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include "IPlugPlatform.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+  #define IGRAPHICS_RESAMPLE_SSE2 1
+  #include <emmintrin.h>
+#endif
+
+BEGIN_IPLUG_NAMESPACE
+BEGIN_IGRAPHICS_NAMESPACE
+
+/** Downsampling of 4 channel, 8 bit per channel pixels. The channel order does not matter, since every channel is filtered the same way,
+ * but the pixels should be premultiplied, so that transparent pixels don't bleed their colour into their neighbours.
+ * Each destination pixel is the area weighted average of the source pixels it covers, which is what a mip level is, and unlike the bilinear
+ * filtering of the drawing APIs it does not alias when the ratio is more than 2:1. An exact 2:1 reduction takes the Halve() fast path. */
+namespace BitmapResample
+{
+  /** Halves a block of pixels, each destination pixel is the rounded average of a 2x2 source block
+   * @param pSrc The source pixels, of at least dstW * 2 by dstH * 2
+   * @param srcStride The source row size in bytes
+   * @param pDst The destination pixels
+   * @param dstStride The destination row size in bytes
+   * @param dstW The destination width in pixels
+   * @param dstH The destination height in pixels */
+  static inline void HalveScalar(const uint8_t* pSrc, int srcStride, uint8_t* pDst, int dstStride, int dstW, int dstH)
+  {
+    for (int y = 0; y < dstH; y++)
+    {
+      const uint8_t* pRow0 = pSrc + 2 * y * srcStride;
+      const uint8_t* pRow1 = pRow0 + srcStride;
+      uint8_t* pOut = pDst + y * dstStride;
+
+      for (int i = 0; i < dstW * 4; i++)
+      {
+        const int c = i & 3, x = (i >> 2) * 8 + c;
+        pOut[i] = static_cast<uint8_t>((pRow0[x] + pRow0[x + 4] + pRow1[x] + pRow1[x + 4] + 2) >> 2);
+      }
+    }
+  }
+
+#ifdef IGRAPHICS_RESAMPLE_SSE2
+  /** @param r0 Two pixels of the upper row, as 16 bit channels
+   * @param r1 The two pixels below them
+   * @return The sum of the four pixels in the low half */
+  static inline __m128i Sum2x2SSE2(__m128i r0, __m128i r1)
+  {
+    const __m128i s = _mm_add_epi16(r0, r1);
+    return _mm_add_epi16(s, _mm_unpackhi_epi64(s, s));
+  }
+
+  /** SSE2 version of HalveScalar(), 4 destination pixels at a time, bit-identical */
+  static inline void HalveSSE2(const uint8_t* pSrc, int srcStride, uint8_t* pDst, int dstStride, int dstW, int dstH)
+  {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i two = _mm_set1_epi16(2);
+
+    for (int y = 0; y < dstH; y++)
+    {
+      const uint8_t* pRow0 = pSrc + 2 * y * srcStride;
+      const uint8_t* pRow1 = pRow0 + srcStride;
+      uint8_t* pOut = pDst + y * dstStride;
+      int x = 0;
+
+      for (; x + 4 <= dstW; x += 4)
+      {
+        const __m128i a0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pRow0 + x * 8));
+        const __m128i a1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pRow0 + x * 8 + 16));
+        const __m128i b0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pRow1 + x * 8));
+        const __m128i b1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pRow1 + x * 8 + 16));
+
+        const __m128i p0 = Sum2x2SSE2(_mm_unpacklo_epi8(a0, zero), _mm_unpacklo_epi8(b0, zero));
+        const __m128i p1 = Sum2x2SSE2(_mm_unpackhi_epi8(a0, zero), _mm_unpackhi_epi8(b0, zero));
+        const __m128i p2 = Sum2x2SSE2(_mm_unpacklo_epi8(a1, zero), _mm_unpacklo_epi8(b1, zero));
+        const __m128i p3 = Sum2x2SSE2(_mm_unpackhi_epi8(a1, zero), _mm_unpackhi_epi8(b1, zero));
+
+        const __m128i lo = _mm_srli_epi16(_mm_add_epi16(_mm_unpacklo_epi64(p0, p1), two), 2);
+        const __m128i hi = _mm_srli_epi16(_mm_add_epi16(_mm_unpacklo_epi64(p2, p3), two), 2);
+
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(pOut + x * 4), _mm_packus_epi16(lo, hi));
+      }
+
+      if (x < dstW)
+        HalveScalar(pRow0 + x * 8, srcStride, pOut + x * 4, dstStride, dstW - x, 1);
+    }
+  }
+#endif
+
+  /** Halves a block of pixels with the fastest available implementation, see HalveScalar() */
+  static inline void Halve(const uint8_t* pSrc, int srcStride, uint8_t* pDst, int dstStride, int dstW, int dstH)
+  {
+#ifdef IGRAPHICS_RESAMPLE_SSE2
+    HalveSSE2(pSrc, srcStride, pDst, dstStride, dstW, dstH);
+#else
+    HalveScalar(pSrc, srcStride, pDst, dstStride, dstW, dstH);
+#endif
+  }
+
+  /** The source pixels covered by the destination pixels along one axis, and how much of each is covered */
+  struct Coverage
+  {
+    std::vector<int> mFirst;
+    std::vector<int> mCount;
+    std::vector<int> mOffset;
+    std::vector<float> mWeights;
+
+    Coverage(int srcN, int dstN)
+    : mFirst(dstN), mCount(dstN), mOffset(dstN)
+    {
+      const double ratio = static_cast<double>(srcN) / dstN;
+
+      for (int i = 0; i < dstN; i++)
+      {
+        const double s0 = i * ratio;
+        const double s1 = std::min((i + 1) * ratio, static_cast<double>(srcN));
+        const int first = std::min(static_cast<int>(s0), srcN - 1);
+        const int last = std::max(first, static_cast<int>(std::ceil(s1)) - 1);
+
+        mFirst[i] = first;
+        mCount[i] = last - first + 1;
+        mOffset[i] = static_cast<int>(mWeights.size());
+
+        for (int j = first; j <= last; j++)
+          mWeights.push_back(static_cast<float>((std::min(s1, j + 1.0) - std::max(s0, static_cast<double>(j))) / (s1 - s0)));
+      }
+    }
+  };
+
+  /** Downsamples a block of pixels with a box filter, for any ratio
+   * @param pSrc The source pixels
+   * @param srcStride The source row size in bytes
+   * @param srcW The source width in pixels
+   * @param srcH The source height in pixels
+   * @param pDst The destination pixels
+   * @param dstStride The destination row size in bytes
+   * @param dstW The destination width in pixels
+   * @param dstH The destination height in pixels */
+  static inline void Box(const uint8_t* pSrc, int srcStride, int srcW, int srcH, uint8_t* pDst, int dstStride, int dstW, int dstH)
+  {
+    const Coverage cx(srcW, dstW);
+    const Coverage cy(srcH, dstH);
+    std::vector<float> acc(dstW * 4);
+
+    for (int y = 0; y < dstH; y++)
+    {
+      std::fill(acc.begin(), acc.end(), 0.f);
+
+      for (int j = 0; j < cy.mCount[y]; j++)
+      {
+        const uint8_t* pRow = pSrc + (cy.mFirst[y] + j) * srcStride;
+        const float wy = cy.mWeights[cy.mOffset[y] + j];
+
+        for (int x = 0; x < dstW; x++)
+        {
+          const uint8_t* pIn = pRow + cx.mFirst[x] * 4;
+          const float* pW = cx.mWeights.data() + cx.mOffset[x];
+          float r = 0.f, g = 0.f, b = 0.f, a = 0.f;
+
+          for (int i = 0; i < cx.mCount[x]; i++, pIn += 4)
+          {
+            r += pIn[0] * pW[i];
+            g += pIn[1] * pW[i];
+            b += pIn[2] * pW[i];
+            a += pIn[3] * pW[i];
+          }
+
+          float* pAcc = acc.data() + x * 4;
+          pAcc[0] += r * wy;
+          pAcc[1] += g * wy;
+          pAcc[2] += b * wy;
+          pAcc[3] += a * wy;
+        }
+      }
+
+      uint8_t* pOut = pDst + y * dstStride;
+
+      for (int i = 0; i < dstW * 4; i++)
+        pOut[i] = static_cast<uint8_t>(std::min(acc[i] + 0.5f, 255.f));
+    }
+  }
+
+  /** Downsamples a block of pixels, with Halve() for exact 2:1 reductions and Box() otherwise. See Box() for the arguments */
+  static inline void Downsample(const uint8_t* pSrc, int srcStride, int srcW, int srcH, uint8_t* pDst, int dstStride, int dstW, int dstH)
+  {
+    if (dstW <= 0 || dstH <= 0 || srcW <= 0 || srcH <= 0)
+      return;
+
+    if (srcW == dstW * 2 && srcH == dstH * 2)
+      Halve(pSrc, srcStride, pDst, dstStride, dstW, dstH);
+    else
+      Box(pSrc, srcStride, srcW, srcH, pDst, dstStride, dstW, dstH);
+  }
+}
+
+END_IGRAPHICS_NAMESPACE
+END_IPLUG_NAMESPACE
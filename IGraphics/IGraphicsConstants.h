@@ -23,6 +23,10 @@ static constexpr int IDLE_TICKS = 20;
 
 static constexpr int DEFAULT_ANIMATION_DURATION = 100;
 
+// With EFrameRatePolicy::Adaptive, the frame rate of an editor that has been idle for DEFAULT_IDLE_DELAY milliseconds
+static constexpr int DEFAULT_IDLE_FPS = 4;
+static constexpr int DEFAULT_IDLE_DELAY = 500;
+
 #ifndef CONTROL_BOUNDS_COLOR
 #define CONTROL_BOUNDS_COLOR COLOR_GREEN
 #endif
@@ -34,6 +38,7 @@ static constexpr float PARAM_EDIT_H = 16.f; // TODO: remove?
 #define MAX_NET_ERR_MSG_LEN 1024
 
 static constexpr int MAX_IMG_SCALE = 3;
+static constexpr int MAX_ATLAS_PAGE_SIZE = 2048; // in pixels, see IGraphics::PackBitmaps()
 static constexpr int DEFAULT_TEXT_ENTRY_LEN = 7;
 static constexpr double DEFAULT_GEARING = 4.0;
 
@@ -71,6 +76,14 @@ enum class EBlend
   Default = SrcOver
 };
 
+/** How the draw loop ticks when nothing is dirty or animating, see IGraphics::SetFrameRatePolicy() */
+enum class EFrameRatePolicy
+{
+  Fixed,    // always tick at IGraphics::FPS()
+  Adaptive, // drop to a low frame rate when idle
+  OnDemand  // stop ticking when idle, and restart on input, dirty controls or animations
+};
+
 /** /todo */
 enum class EFileAction { Open, Save };
 
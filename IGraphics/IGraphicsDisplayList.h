@@ -0,0 +1,772 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+#pragma once
+
+/**
+ * @file
+ * @copydoc IDisplayList
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <vector>
+
+#include "IPlugPlatform.h"
+#include "IGraphics.h"
+
+BEGIN_IPLUG_NAMESPACE
+BEGIN_IGRAPHICS_NAMESPACE
+
+/** IDisplayList records IGraphics drawing calls into a compact command buffer, which can be replayed into any backend through the IGraphics drawing interface.
+ * Recording methods have the same names and arguments as the IGraphics methods, so drawing code can be shared between the two, e.g. with a template.
+ * Every command stores the bounds it can touch, so Replay() can skip the commands that are outside of the region being drawn.
+ * Commands recorded under a transform, and text (which can overflow its rectangle), are never skipped.
+ * Arguments are copied when recorded, bitmaps and SVGs are referenced and must outlive the list.
+ * A control can draw via a display list by calling IControl::SetUseDisplayList() and implementing IControl::RecordDisplayList(),
+ * IGraphics then records the list when the control is dirty, and otherwise replays it, culled to each dirty region. */
+class IDisplayList
+{
+public:
+  enum class EOp : uint16_t
+  {
+    DrawLine, DrawDottedLine, DrawTriangle, DrawRect, DrawRoundRect, DrawRoundRect4, DrawArc, DrawCircle, DrawEllipse, DrawConvexPolygon, DrawDottedRect,
+    FillTriangle, FillRect, FillRoundRect, FillRoundRect4, FillArc, FillCircle, FillEllipse, FillConvexPolygon,
+    DrawText, DrawBitmap, DrawFittedBitmap, DrawRotatedBitmap, DrawSVG, DrawRotatedSVG,
+    PathClear, PathClose, PathMoveTo, PathLineTo, PathCubicBezierTo, PathQuadraticBezierTo, PathArc, PathRect, PathRoundRect, PathRoundRect4, PathCircle, PathEllipse,
+    PathStroke, PathFill,
+    PathTransformSave, PathTransformRestore, PathTransformReset, PathTransformTranslate, PathTransformScale, PathTransformRotate, PathClipRegion
+  };
+
+  IDisplayList() = default;
+
+  IDisplayList(const IDisplayList&) = delete;
+  IDisplayList& operator=(const IDisplayList&) = delete;
+
+  /** Removes all commands, keeping the allocated memory, and marks the list as valid
+   * @param bounds The bounds of the list's owner, used by GetBounds() for commands that can't be culled */
+  void Clear(const IRECT& bounds = IRECT())
+  {
+    mData.clear();
+    mBitmaps.clear();
+    mSVGs.clear();
+    mOwnerBounds = bounds;
+    mBounds = IRECT();
+    mPathBounds = IRECT();
+    mTransformStates.clear();
+    mTransformed = false;
+    mNCommands = 0;
+    mValid = true;
+  }
+
+  /** Marks the list as out of date, so that its owner records it again */
+  void Invalidate() { mValid = false; }
+
+  /** @return \c true if the list has been recorded since it was last invalidated */
+  bool IsValid() const { return mValid; }
+
+  /** @return The union of the bounds of all commands */
+  const IRECT& GetBounds() const { return mBounds; }
+
+  /** @return The number of recorded commands */
+  int NCommands() const { return mNCommands; }
+
+  /** @return The size of the command buffer in bytes */
+  size_t GetSize() const { return mData.size(); }
+
+  /** Replays the commands into a graphics context
+   * @param g The graphics context
+   * @param clip If not empty, commands that are entirely outside of this region are skipped
+   * @return The number of commands skipped */
+  int Replay(IGraphics& g, const IRECT& clip = IRECT()) const
+  {
+    Reader r(mData.data());
+    const uint8_t* pEnd = mData.data() + mData.size();
+    int nCulled = 0;
+
+    while (r.mPos < pEnd)
+    {
+      const Header header = r.Read<Header>();
+      const uint8_t* pNext = r.mPos + header.mSize;
+
+      if (header.mBounded && !clip.Empty() && !clip.Intersects(header.mBounds))
+      {
+        nCulled++;
+
+        // A skipped stroke or fill must still consume its path
+        if ((header.mOp == EOp::PathStroke || header.mOp == EOp::PathFill) && !header.mPreserve)
+          g.PathClear();
+
+        r.mPos = pNext;
+        continue;
+      }
+
+      Dispatch(g, header.mOp, r);
+      r.mPos = pNext;
+    }
+
+    return nCulled;
+  }
+
+#pragma mark - Recording
+
+  void DrawLine(const IColor& color, float x1, float y1, float x2, float y2, const IBlend* pBlend = 0, float thickness = 1.f)
+  {
+    Add(EOp::DrawLine, Stroked(PointBounds(x1, y1, x2, y2), thickness), color, x1, y1, x2, y2, Blend(pBlend), thickness);
+  }
+
+  void DrawDottedLine(const IColor& color, float x1, float y1, float x2, float y2, const IBlend* pBlend = 0, float thickness = 1.f, float dashLen = 2.f)
+  {
+    Add(EOp::DrawDottedLine, Stroked(PointBounds(x1, y1, x2, y2), thickness), color, x1, y1, x2, y2, Blend(pBlend), thickness, dashLen);
+  }
+
+  void DrawTriangle(const IColor& color, float x1, float y1, float x2, float y2, float x3, float y3, const IBlend* pBlend = 0, float thickness = 1.f)
+  {
+    Add(EOp::DrawTriangle, Stroked(PointBounds(x1, y1, x2, y2).Union(PointBounds(x3, y3, x3, y3)), thickness), color, x1, y1, x2, y2, x3, y3, Blend(pBlend), thickness);
+  }
+
+  void DrawRect(const IColor& color, const IRECT& bounds, const IBlend* pBlend = 0, float thickness = 1.f)
+  {
+    Add(EOp::DrawRect, Stroked(bounds, thickness), color, bounds, Blend(pBlend), thickness);
+  }
+
+  void DrawRoundRect(const IColor& color, const IRECT& bounds, float cornerRadius = 5.f, const IBlend* pBlend = 0, float thickness = 1.f)
+  {
+    Add(EOp::DrawRoundRect, Stroked(bounds, thickness), color, bounds, cornerRadius, Blend(pBlend), thickness);
+  }
+
+  void DrawRoundRect(const IColor& color, const IRECT& bounds, float cRTL, float cRTR, float cRBR, float cRBL, const IBlend* pBlend = 0, float thickness = 1.f)
+  {
+    Add(EOp::DrawRoundRect4, Stroked(bounds, thickness), color, bounds, cRTL, cRTR, cRBR, cRBL, Blend(pBlend), thickness);
+  }
+
+  void DrawArc(const IColor& color, float cx, float cy, float r, float a1, float a2, const IBlend* pBlend = 0, float thickness = 1.f)
+  {
+    Add(EOp::DrawArc, Stroked(CircleBounds(cx, cy, r), thickness), color, cx, cy, r, a1, a2, Blend(pBlend), thickness);
+  }
+
+  void DrawCircle(const IColor& color, float cx, float cy, float r, const IBlend* pBlend = 0, float thickness = 1.f)
+  {
+    Add(EOp::DrawCircle, Stroked(CircleBounds(cx, cy, r), thickness), color, cx, cy, r, Blend(pBlend), thickness);
+  }
+
+  void DrawEllipse(const IColor& color, const IRECT& bounds, const IBlend* pBlend = 0, float thickness = 1.f)
+  {
+    Add(EOp::DrawEllipse, Stroked(bounds, thickness), color, bounds, Blend(pBlend), thickness);
+  }
+
+  void DrawConvexPolygon(const IColor& color, float* x, float* y, int nPoints, const IBlend* pBlend = 0, float thickness = 1.f)
+  {
+    AddPolygon(EOp::DrawConvexPolygon, color, x, y, nPoints, pBlend, thickness);
+  }
+
+  void DrawDottedRect(const IColor& color, const IRECT& bounds, const IBlend* pBlend = 0, float thickness = 1.f, float dashLen = 2.f)
+  {
+    Add(EOp::DrawDottedRect, Stroked(bounds, thickness), color, bounds, Blend(pBlend), thickness, dashLen);
+  }
+
+  void FillTriangle(const IColor& color, float x1, float y1, float x2, float y2, float x3, float y3, const IBlend* pBlend = 0)
+  {
+    Add(EOp::FillTriangle, Filled(PointBounds(x1, y1, x2, y2).Union(PointBounds(x3, y3, x3, y3))), color, x1, y1, x2, y2, x3, y3, Blend(pBlend));
+  }
+
+  void FillRect(const IColor& color, const IRECT& bounds, const IBlend* pBlend = 0)
+  {
+    Add(EOp::FillRect, Filled(bounds), color, bounds, Blend(pBlend));
+  }
+
+  void FillRoundRect(const IColor& color, const IRECT& bounds, float cornerRadius = 5.f, const IBlend* pBlend = 0)
+  {
+    Add(EOp::FillRoundRect, Filled(bounds), color, bounds, cornerRadius, Blend(pBlend));
+  }
+
+  void FillRoundRect(const IColor& color, const IRECT& bounds, float cRTL, float cRTR, float cRBR, float cRBL, const IBlend* pBlend = 0)
+  {
+    Add(EOp::FillRoundRect4, Filled(bounds), color, bounds, cRTL, cRTR, cRBR, cRBL, Blend(pBlend));
+  }
+
+  void FillArc(const IColor& color, float cx, float cy, float r, float a1, float a2, const IBlend* pBlend = 0)
+  {
+    Add(EOp::FillArc, Filled(CircleBounds(cx, cy, r)), color, cx, cy, r, a1, a2, Blend(pBlend));
+  }
+
+  void FillCircle(const IColor& color, float cx, float cy, float r, const IBlend* pBlend = 0)
+  {
+    Add(EOp::FillCircle, Filled(CircleBounds(cx, cy, r)), color, cx, cy, r, Blend(pBlend));
+  }
+
+  void FillEllipse(const IColor& color, const IRECT& bounds, const IBlend* pBlend = 0)
+  {
+    Add(EOp::FillEllipse, Filled(bounds), color, bounds, Blend(pBlend));
+  }
+
+  void FillConvexPolygon(const IColor& color, float* x, float* y, int nPoints, const IBlend* pBlend = 0)
+  {
+    AddPolygon(EOp::FillConvexPolygon, color, x, y, nPoints, pBlend, -1.f);
+  }
+
+  void DrawText(const IText& text, const char* str, const IRECT& bounds, const IBlend* pBlend = 0)
+  {
+    const int len = str ? static_cast<int>(strlen(str)) : 0;
+    const size_t start = Begin(EOp::DrawText, IRECT(), false);
+    Write(text, bounds, Blend(pBlend), len);
+    WriteBytes(str, len + 1);
+    End(start);
+  }
+
+  void DrawBitmap(const IBitmap& bitmap, const IRECT& bounds, int srcX, int srcY, const IBlend* pBlend = 0)
+  {
+    Add(EOp::DrawBitmap, Filled(bounds), AddBitmap(bitmap), bounds, srcX, srcY, Blend(pBlend));
+  }
+
+  void DrawFittedBitmap(const IBitmap& bitmap, const IRECT& bounds, const IBlend* pBlend = 0)
+  {
+    Add(EOp::DrawFittedBitmap, Filled(bounds), AddBitmap(bitmap), bounds, Blend(pBlend));
+  }
+
+  void DrawRotatedBitmap(const IBitmap& bitmap, float destCentreX, float destCentreY, double angle, int yOffsetZeroDeg = 0, const IBlend* pBlend = 0)
+  {
+    const float radius = 0.5f * std::hypot(static_cast<float>(bitmap.W()), static_cast<float>(bitmap.H())) + std::abs(static_cast<float>(yOffsetZeroDeg));
+    Add(EOp::DrawRotatedBitmap, Filled(CircleBounds(destCentreX, destCentreY, radius)), AddBitmap(bitmap), destCentreX, destCentreY, angle, yOffsetZeroDeg, Blend(pBlend));
+  }
+
+  void DrawSVG(const ISVG& svg, const IRECT& bounds, const IBlend* pBlend = 0)
+  {
+    Add(EOp::DrawSVG, Filled(bounds), AddSVG(svg), bounds, Blend(pBlend));
+  }
+
+  void DrawRotatedSVG(const ISVG& svg, float destCentreX, float destCentreY, float width, float height, double angle, const IBlend* pBlend = 0)
+  {
+    const float radius = 0.5f * std::hypot(width, height);
+    Add(EOp::DrawRotatedSVG, Filled(CircleBounds(destCentreX, destCentreY, radius)), AddSVG(svg), destCentreX, destCentreY, width, height, angle, Blend(pBlend));
+  }
+
+  void PathClear()
+  {
+    mPathBounds = IRECT();
+    AddState(EOp::PathClear);
+  }
+
+  void PathClose() { AddState(EOp::PathClose); }
+
+  void PathMoveTo(float x, float y)
+  {
+    AddToPath(PointBounds(x, y, x, y));
+    AddState(EOp::PathMoveTo, x, y);
+  }
+
+  void PathLineTo(float x, float y)
+  {
+    AddToPath(PointBounds(x, y, x, y));
+    AddState(EOp::PathLineTo, x, y);
+  }
+
+  void PathCubicBezierTo(float c1x, float c1y, float c2x, float c2y, float x2, float y2)
+  {
+    // A bezier curve is contained in the convex hull of its control points
+    AddToPath(PointBounds(c1x, c1y, c2x, c2y).Union(PointBounds(x2, y2, x2, y2)));
+    AddState(EOp::PathCubicBezierTo, c1x, c1y, c2x, c2y, x2, y2);
+  }
+
+  void PathQuadraticBezierTo(float cx, float cy, float x2, float y2)
+  {
+    AddToPath(PointBounds(cx, cy, x2, y2));
+    AddState(EOp::PathQuadraticBezierTo, cx, cy, x2, y2);
+  }
+
+  void PathArc(float cx, float cy, float r, float a1, float a2, EWinding winding = EWinding::CW)
+  {
+    AddToPath(CircleBounds(cx, cy, r));
+    AddState(EOp::PathArc, cx, cy, r, a1, a2, winding);
+  }
+
+  void PathRect(const IRECT& bounds)
+  {
+    AddToPath(bounds);
+    AddState(EOp::PathRect, bounds);
+  }
+
+  void PathRoundRect(const IRECT& bounds, float cr = 5.f)
+  {
+    AddToPath(bounds);
+    AddState(EOp::PathRoundRect, bounds, cr);
+  }
+
+  void PathRoundRect(const IRECT& bounds, float ctl, float ctr, float cbl, float cbr)
+  {
+    AddToPath(bounds);
+    AddState(EOp::PathRoundRect4, bounds, ctl, ctr, cbl, cbr);
+  }
+
+  void PathCircle(float cx, float cy, float r)
+  {
+    AddToPath(CircleBounds(cx, cy, r));
+    AddState(EOp::PathCircle, cx, cy, r);
+  }
+
+  void PathEllipse(const IRECT& bounds)
+  {
+    AddToPath(bounds);
+    AddState(EOp::PathEllipse, bounds);
+  }
+
+  void PathStroke(const IPattern& pattern, float thickness, const IStrokeOptions& options = IStrokeOptions(), const IBlend* pBlend = 0)
+  {
+    // Miter joins can extend the stroke by up to miterLimit * thickness / 2
+    const float extent = thickness * std::max(options.mMiterLimit, 1.f);
+    const size_t start = Begin(EOp::PathStroke, Stroked(mPathBounds, extent), !mTransformed, options.mPreserve);
+    Write(pattern, thickness, options, Blend(pBlend));
+    End(start);
+
+    if (!options.mPreserve)
+      mPathBounds = IRECT();
+  }
+
+  void PathFill(const IPattern& pattern, const IFillOptions& options = IFillOptions(), const IBlend* pBlend = 0)
+  {
+    const size_t start = Begin(EOp::PathFill, Filled(mPathBounds), !mTransformed, options.mPreserve);
+    Write(pattern, options, Blend(pBlend));
+    End(start);
+
+    if (!options.mPreserve)
+      mPathBounds = IRECT();
+  }
+
+  void PathTransformSave()
+  {
+    mTransformStates.push_back(mTransformed);
+    AddState(EOp::PathTransformSave);
+  }
+
+  void PathTransformRestore()
+  {
+    if (!mTransformStates.empty())
+    {
+      mTransformed = mTransformStates.back();
+      mTransformStates.pop_back();
+    }
+
+    AddState(EOp::PathTransformRestore);
+  }
+
+  void PathTransformReset(bool clearStates = false)
+  {
+    if (clearStates)
+      mTransformStates.clear();
+
+    mTransformed = false;
+    AddState(EOp::PathTransformReset, clearStates);
+  }
+
+  void PathTransformTranslate(float x, float y)
+  {
+    mTransformed = true;
+    AddState(EOp::PathTransformTranslate, x, y);
+  }
+
+  void PathTransformScale(float scaleX, float scaleY)
+  {
+    mTransformed = true;
+    AddState(EOp::PathTransformScale, scaleX, scaleY);
+  }
+
+  void PathTransformScale(float scale) { PathTransformScale(scale, scale); }
+
+  void PathTransformRotate(float angle)
+  {
+    mTransformed = true;
+    AddState(EOp::PathTransformRotate, angle);
+  }
+
+  void PathClipRegion(const IRECT r = IRECT()) { AddState(EOp::PathClipRegion, r); }
+
+private:
+  struct Header
+  {
+    EOp mOp;
+    bool mBounded;
+    bool mPreserve; // for PathStroke and PathFill
+    uint32_t mSize; // of the arguments following the header
+    IRECT mBounds;
+  };
+
+  /** An optional IBlend, stored by value */
+  struct Blend
+  {
+    Blend(const IBlend* pBlend) : mValid(pBlend != nullptr), mBlend(pBlend ? *pBlend : IBlend()) {}
+    const IBlend* Get() const { return mValid ? &mBlend : nullptr; }
+
+    bool mValid;
+    IBlend mBlend;
+  };
+
+  /** Reads arguments in the order they were written */
+  struct Reader
+  {
+    Reader(const uint8_t* pPos) : mPos(pPos) {}
+
+    template <typename T>
+    T Read()
+    {
+      typename std::aligned_storage<sizeof(T), alignof(T)>::type storage;
+      memcpy(&storage, mPos, sizeof(T));
+      mPos += Padded(sizeof(T));
+      return *reinterpret_cast<T*>(&storage);
+    }
+
+    const uint8_t* ReadBytes(size_t size)
+    {
+      const uint8_t* pData = mPos;
+      mPos += Padded(size);
+      return pData;
+    }
+
+    const uint8_t* mPos;
+  };
+
+  static constexpr size_t kAlign = 8;
+
+  static size_t Padded(size_t size) { return (size + kAlign - 1) & ~(kAlign - 1); }
+
+  static IRECT PointBounds(float x1, float y1, float x2, float y2)
+  {
+    return IRECT(std::min(x1, x2), std::min(y1, y2), std::max(x1, x2), std::max(y1, y2));
+  }
+
+  static IRECT CircleBounds(float cx, float cy, float r) { return IRECT(cx - r, cy - r, cx + r, cy + r); }
+
+  // Antialiasing can touch one pixel outside of the geometry
+  static IRECT Filled(const IRECT& r) { return r.GetPadded(1.f); }
+
+  static IRECT Stroked(const IRECT& r, float thickness) { return r.GetPadded(thickness * 0.5f + 1.f); }
+
+  void AddToPath(const IRECT& r)
+  {
+    mPathBounds = mPathBounds.Empty() ? r : mPathBounds.Union(r);
+  }
+
+  template <typename T>
+  void Write(const T& value)
+  {
+    static_assert(std::is_trivially_copyable<T>::value, "IDisplayList arguments must be trivially copyable");
+    WriteBytes(&value, sizeof(T));
+  }
+
+  template <typename T, typename... Args>
+  void Write(const T& value, const Args&... args)
+  {
+    Write(value);
+    Write(args...);
+  }
+
+  void Write() {}
+
+  void WriteBytes(const void* pData, size_t size)
+  {
+    const size_t pos = mData.size();
+    mData.resize(pos + Padded(size));
+
+    if (size)
+      memcpy(mData.data() + pos, pData, size);
+  }
+
+  size_t Begin(EOp op, const IRECT& bounds, bool bounded, bool preserve = false)
+  {
+    const size_t start = mData.size();
+    Write(Header {op, bounded, preserve, 0, bounds});
+
+    // Unbounded commands are assumed to stay within the owner's bounds
+    const IRECT& r = bounded ? bounds : mOwnerBounds;
+    mBounds = mBounds.Empty() ? r : mBounds.Union(r);
+    mNCommands++;
+    return start;
+  }
+
+  void End(size_t start)
+  {
+    Header header;
+    memcpy(&header, mData.data() + start, sizeof(Header));
+    header.mSize = static_cast<uint32_t>(mData.size() - start - Padded(sizeof(Header)));
+    memcpy(mData.data() + start, &header, sizeof(Header));
+  }
+
+  template <typename... Args>
+  void Add(EOp op, const IRECT& bounds, const Args&... args)
+  {
+    const size_t start = Begin(op, bounds, !mTransformed);
+    Write(args...);
+    End(start);
+  }
+
+  /** State and path construction commands are never culled */
+  template <typename... Args>
+  void AddState(EOp op, const Args&... args)
+  {
+    const size_t start = mData.size();
+    Write(Header {op, false, false, 0, IRECT()});
+    Write(args...);
+    mNCommands++;
+    End(start);
+  }
+
+  void AddPolygon(EOp op, const IColor& color, const float* x, const float* y, int nPoints, const IBlend* pBlend, float thickness)
+  {
+    IRECT bounds;
+
+    for (auto i = 0; i < nPoints; i++)
+      bounds = i ? bounds.Union(PointBounds(x[i], y[i], x[i], y[i])) : PointBounds(x[i], y[i], x[i], y[i]);
+
+    const size_t start = Begin(op, thickness < 0.f ? Filled(bounds) : Stroked(bounds, thickness), !mTransformed);
+    Write(color, Blend(pBlend), thickness, nPoints);
+    WriteBytes(x, nPoints * sizeof(float));
+    WriteBytes(y, nPoints * sizeof(float));
+    End(start);
+  }
+
+  int AddBitmap(const IBitmap& bitmap)
+  {
+    mBitmaps.push_back(bitmap);
+    return static_cast<int>(mBitmaps.size()) - 1;
+  }
+
+  int AddSVG(const ISVG& svg)
+  {
+    mSVGs.push_back(svg);
+    return static_cast<int>(mSVGs.size()) - 1;
+  }
+
+  void Dispatch(IGraphics& g, EOp op, Reader& r) const
+  {
+    #define IDL_READ(T, name) const T name = r.Read<T>()
+
+    switch (op)
+    {
+      case EOp::DrawLine:
+      case EOp::DrawDottedLine:
+      {
+        IDL_READ(IColor, c); IDL_READ(float, x1); IDL_READ(float, y1); IDL_READ(float, x2); IDL_READ(float, y2); IDL_READ(Blend, b); IDL_READ(float, t);
+
+        if (op == EOp::DrawLine)
+          g.DrawLine(c, x1, y1, x2, y2, b.Get(), t);
+        else
+          g.DrawDottedLine(c, x1, y1, x2, y2, b.Get(), t, r.Read<float>());
+        break;
+      }
+      case EOp::DrawTriangle:
+      {
+        IDL_READ(IColor, c); IDL_READ(float, x1); IDL_READ(float, y1); IDL_READ(float, x2); IDL_READ(float, y2); IDL_READ(float, x3); IDL_READ(float, y3); IDL_READ(Blend, b);
+        g.DrawTriangle(c, x1, y1, x2, y2, x3, y3, b.Get(), r.Read<float>());
+        break;
+      }
+      case EOp::DrawRect:
+      case EOp::DrawEllipse:
+      {
+        IDL_READ(IColor, c); IDL_READ(IRECT, bounds); IDL_READ(Blend, b); IDL_READ(float, t);
+
+        if (op == EOp::DrawRect)
+          g.DrawRect(c, bounds, b.Get(), t);
+        else
+          g.DrawEllipse(c, bounds, b.Get(), t);
+        break;
+      }
+      case EOp::DrawRoundRect:
+      {
+        IDL_READ(IColor, c); IDL_READ(IRECT, bounds); IDL_READ(float, cr); IDL_READ(Blend, b);
+        g.DrawRoundRect(c, bounds, cr, b.Get(), r.Read<float>());
+        break;
+      }
+      case EOp::DrawRoundRect4:
+      {
+        IDL_READ(IColor, c); IDL_READ(IRECT, bounds); IDL_READ(float, tl); IDL_READ(float, tr); IDL_READ(float, br); IDL_READ(float, bl); IDL_READ(Blend, b);
+        g.DrawRoundRect(c, bounds, tl, tr, br, bl, b.Get(), r.Read<float>());
+        break;
+      }
+      case EOp::DrawArc:
+      case EOp::FillArc:
+      {
+        IDL_READ(IColor, c); IDL_READ(float, cx); IDL_READ(float, cy); IDL_READ(float, rad); IDL_READ(float, a1); IDL_READ(float, a2); IDL_READ(Blend, b);
+
+        if (op == EOp::DrawArc)
+          g.DrawArc(c, cx, cy, rad, a1, a2, b.Get(), r.Read<float>());
+        else
+          g.FillArc(c, cx, cy, rad, a1, a2, b.Get());
+        break;
+      }
+      case EOp::DrawCircle:
+      case EOp::FillCircle:
+      {
+        IDL_READ(IColor, c); IDL_READ(float, cx); IDL_READ(float, cy); IDL_READ(float, rad); IDL_READ(Blend, b);
+
+        if (op == EOp::DrawCircle)
+          g.DrawCircle(c, cx, cy, rad, b.Get(), r.Read<float>());
+        else
+          g.FillCircle(c, cx, cy, rad, b.Get());
+        break;
+      }
+      case EOp::DrawConvexPolygon:
+      case EOp::FillConvexPolygon:
+      {
+        IDL_READ(IColor, c); IDL_READ(Blend, b); IDL_READ(float, t); IDL_READ(int, n);
+        // The IGraphics API takes non-const arrays, copy them so that the buffer is never written to
+        mPolygonScratch.resize(2 * n);
+        memcpy(mPolygonScratch.data(), r.ReadBytes(n * sizeof(float)), n * sizeof(float));
+        memcpy(mPolygonScratch.data() + n, r.ReadBytes(n * sizeof(float)), n * sizeof(float));
+
+        if (op == EOp::DrawConvexPolygon)
+          g.DrawConvexPolygon(c, mPolygonScratch.data(), mPolygonScratch.data() + n, n, b.Get(), t);
+        else
+          g.FillConvexPolygon(c, mPolygonScratch.data(), mPolygonScratch.data() + n, n, b.Get());
+        break;
+      }
+      case EOp::DrawDottedRect:
+      {
+        IDL_READ(IColor, c); IDL_READ(IRECT, bounds); IDL_READ(Blend, b); IDL_READ(float, t);
+        g.DrawDottedRect(c, bounds, b.Get(), t, r.Read<float>());
+        break;
+      }
+      case EOp::FillTriangle:
+      {
+        IDL_READ(IColor, c); IDL_READ(float, x1); IDL_READ(float, y1); IDL_READ(float, x2); IDL_READ(float, y2); IDL_READ(float, x3); IDL_READ(float, y3);
+        g.FillTriangle(c, x1, y1, x2, y2, x3, y3, r.Read<Blend>().Get());
+        break;
+      }
+      case EOp::FillRect:
+      case EOp::FillEllipse:
+      {
+        IDL_READ(IColor, c); IDL_READ(IRECT, bounds); IDL_READ(Blend, b);
+
+        if (op == EOp::FillRect)
+          g.FillRect(c, bounds, b.Get());
+        else
+          g.FillEllipse(c, bounds, b.Get());
+        break;
+      }
+      case EOp::FillRoundRect:
+      {
+        IDL_READ(IColor, c); IDL_READ(IRECT, bounds); IDL_READ(float, cr);
+        g.FillRoundRect(c, bounds, cr, r.Read<Blend>().Get());
+        break;
+      }
+      case EOp::FillRoundRect4:
+      {
+        IDL_READ(IColor, c); IDL_READ(IRECT, bounds); IDL_READ(float, tl); IDL_READ(float, tr); IDL_READ(float, br); IDL_READ(float, bl);
+        g.FillRoundRect(c, bounds, tl, tr, br, bl, r.Read<Blend>().Get());
+        break;
+      }
+      case EOp::DrawText:
+      {
+        IDL_READ(IText, text); IDL_READ(IRECT, bounds); IDL_READ(Blend, b); IDL_READ(int, len);
+        g.DrawText(text, reinterpret_cast<const char*>(r.ReadBytes(len + 1)), bounds, b.Get());
+        break;
+      }
+      case EOp::DrawBitmap:
+      {
+        IDL_READ(int, idx); IDL_READ(IRECT, bounds); IDL_READ(int, srcX); IDL_READ(int, srcY);
+        g.DrawBitmap(mBitmaps[idx], bounds, srcX, srcY, r.Read<Blend>().Get());
+        break;
+      }
+      case EOp::DrawFittedBitmap:
+      {
+        IDL_READ(int, idx); IDL_READ(IRECT, bounds);
+        g.DrawFittedBitmap(mBitmaps[idx], bounds, r.Read<Blend>().Get());
+        break;
+      }
+      case EOp::DrawRotatedBitmap:
+      {
+        IDL_READ(int, idx); IDL_READ(float, cx); IDL_READ(float, cy); IDL_READ(double, angle); IDL_READ(int, yOffset);
+        g.DrawRotatedBitmap(mBitmaps[idx], cx, cy, angle, yOffset, r.Read<Blend>().Get());
+        break;
+      }
+      case EOp::DrawSVG:
+      {
+        IDL_READ(int, idx); IDL_READ(IRECT, bounds);
+        g.DrawSVG(mSVGs[idx], bounds, r.Read<Blend>().Get());
+        break;
+      }
+      case EOp::DrawRotatedSVG:
+      {
+        IDL_READ(int, idx); IDL_READ(float, cx); IDL_READ(float, cy); IDL_READ(float, w); IDL_READ(float, h); IDL_READ(double, angle);
+        g.DrawRotatedSVG(mSVGs[idx], cx, cy, w, h, angle, r.Read<Blend>().Get());
+        break;
+      }
+      case EOp::PathClear: g.PathClear(); break;
+      case EOp::PathClose: g.PathClose(); break;
+      case EOp::PathMoveTo: { IDL_READ(float, x); g.PathMoveTo(x, r.Read<float>()); break; }
+      case EOp::PathLineTo: { IDL_READ(float, x); g.PathLineTo(x, r.Read<float>()); break; }
+      case EOp::PathCubicBezierTo:
+      {
+        IDL_READ(float, c1x); IDL_READ(float, c1y); IDL_READ(float, c2x); IDL_READ(float, c2y); IDL_READ(float, x2); IDL_READ(float, y2);
+        g.PathCubicBezierTo(c1x, c1y, c2x, c2y, x2, y2);
+        break;
+      }
+      case EOp::PathQuadraticBezierTo:
+      {
+        IDL_READ(float, cx); IDL_READ(float, cy); IDL_READ(float, x2); IDL_READ(float, y2);
+        g.PathQuadraticBezierTo(cx, cy, x2, y2);
+        break;
+      }
+      case EOp::PathArc:
+      {
+        IDL_READ(float, cx); IDL_READ(float, cy); IDL_READ(float, rad); IDL_READ(float, a1); IDL_READ(float, a2);
+        g.PathArc(cx, cy, rad, a1, a2, r.Read<EWinding>());
+        break;
+      }
+      case EOp::PathRect: g.PathRect(r.Read<IRECT>()); break;
+      case EOp::PathRoundRect: { IDL_READ(IRECT, bounds); g.PathRoundRect(bounds, r.Read<float>()); break; }
+      case EOp::PathRoundRect4:
+      {
+        IDL_READ(IRECT, bounds); IDL_READ(float, tl); IDL_READ(float, tr); IDL_READ(float, bl); IDL_READ(float, br);
+        g.PathRoundRect(bounds, tl, tr, bl, br);
+        break;
+      }
+      case EOp::PathCircle: { IDL_READ(float, cx); IDL_READ(float, cy); g.PathCircle(cx, cy, r.Read<float>()); break; }
+      case EOp::PathEllipse: g.PathEllipse(r.Read<IRECT>()); break;
+      case EOp::PathStroke:
+      {
+        IDL_READ(IPattern, pattern); IDL_READ(float, t); IDL_READ(IStrokeOptions, options);
+        g.PathStroke(pattern, t, options, r.Read<Blend>().Get());
+        break;
+      }
+      case EOp::PathFill:
+      {
+        IDL_READ(IPattern, pattern); IDL_READ(IFillOptions, options);
+        g.PathFill(pattern, options, r.Read<Blend>().Get());
+        break;
+      }
+      case EOp::PathTransformSave: g.PathTransformSave(); break;
+      case EOp::PathTransformRestore: g.PathTransformRestore(); break;
+      case EOp::PathTransformReset: g.PathTransformReset(r.Read<bool>()); break;
+      case EOp::PathTransformTranslate: { IDL_READ(float, x); g.PathTransformTranslate(x, r.Read<float>()); break; }
+      case EOp::PathTransformScale: { IDL_READ(float, x); g.PathTransformScale(x, r.Read<float>()); break; }
+      case EOp::PathTransformRotate: g.PathTransformRotate(r.Read<float>()); break;
+      case EOp::PathClipRegion: g.PathClipRegion(r.Read<IRECT>()); break;
+    }
+
+    #undef IDL_READ
+  }
+
+  std::vector<uint8_t> mData;
+  std::vector<IBitmap> mBitmaps;
+  std::vector<ISVG> mSVGs;
+  mutable std::vector<float> mPolygonScratch;
+  std::vector<bool> mTransformStates; // whether the transform was set at each PathTransformSave()
+  IRECT mOwnerBounds;
+  IRECT mBounds;
+  IRECT mPathBounds; // of the path being recorded
+  int mNCommands = 0;
+  bool mTransformed = false;
+  bool mValid = false;
+};
+
+END_IGRAPHICS_NAMESPACE
+END_IPLUG_NAMESPACE
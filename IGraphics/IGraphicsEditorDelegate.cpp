@@ -89,6 +89,8 @@ void IGEditorDelegate::SendControlMsgFromDelegate(int ctrlTag, int msgTag, int d
   if(!mGraphics)
     return;
   
+  mGraphics->WakeDrawLoop();
+
   if (ctrlTag > kNoTag)
   {
     for (auto c = 0; c < mGraphics->NControls(); c++)
@@ -135,6 +137,8 @@ void IGEditorDelegate::SendMidiMsgFromDelegate(const IMidiMsg& msg)
 {
   if(mGraphics)
   {
+    mGraphics->WakeDrawLoop();
+
     for (auto c = 0; c < mGraphics->NControls(); c++) // TODO: could keep a map
     {
       IControl* pControl = mGraphics->GetControl(c);
@@ -0,0 +1,329 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+#pragma once
+
+/**
+ * @file
+ * @brief Gradient colour lookup tables and span filling, for the software drawing backends
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include "IPlugPlatform.h"
+#include "IGraphicsStructs.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+  #define IGRAPHICS_GRADIENT_SSE2 1
+  #include <emmintrin.h>
+#endif
+
+BEGIN_IPLUG_NAMESPACE
+BEGIN_IGRAPHICS_NAMESPACE
+
+/** The colours of a gradient IPattern sampled at kSize evenly spaced positions, as 32 bit pixels in a given channel order.
+ * Between stops the 8 bit channels are interpolated linearly, before the first stop and after the last one the colour of that stop is used */
+class IGradientLUT
+{
+public:
+  static constexpr int kSize = 256;
+
+  /** The layout of the pixels of a table */
+  struct Format
+  {
+    int mR = 0; // byte index of each channel
+    int mG = 1;
+    int mB = 2;
+    int mA = 3;
+    bool mPreMultiplied = false;
+  };
+
+  /** @param pattern The pattern, whose stops are used
+   * @param opacity An opacity that multiplies the alpha of every stop
+   * @param format The pixel layout */
+  IGradientLUT(const IPattern& pattern, float opacity, const Format& format)
+  {
+    const int nStops = std::max(pattern.NStops(), 1);
+
+    for (int i = 0, s = 0; i < kSize; i++)
+    {
+      const float t = (i + 0.5f) / kSize; // the centre of the range of positions that map to this entry, see GradientSpan::Index()
+
+      while (s < nStops - 1 && pattern.GetStop(s + 1).mOffset < t)
+        s++;
+
+      const IColorStop& s0 = pattern.GetStop(s);
+      const IColorStop& s1 = pattern.GetStop(std::min(s + 1, nStops - 1));
+      const float range = s1.mOffset - s0.mOffset;
+      const float f = range > 0.f ? Clip((t - s0.mOffset) / range, 0.f, 1.f) : (t < s0.mOffset ? 0.f : 1.f);
+
+      const float r = s0.mColor.R + f * (s1.mColor.R - s0.mColor.R);
+      const float g = s0.mColor.G + f * (s1.mColor.G - s0.mColor.G);
+      const float b = s0.mColor.B + f * (s1.mColor.B - s0.mColor.B);
+      const float a = (s0.mColor.A + f * (s1.mColor.A - s0.mColor.A)) * Clip(opacity, 0.f, 1.f);
+      const float m = format.mPreMultiplied ? a / 255.f : 1.f;
+
+      uint8_t* pPixel = reinterpret_cast<uint8_t*>(mTable + i);
+      pPixel[format.mR] = static_cast<uint8_t>(Clip(r * m + 0.5f, 0.f, 255.f));
+      pPixel[format.mG] = static_cast<uint8_t>(Clip(g * m + 0.5f, 0.f, 255.f));
+      pPixel[format.mB] = static_cast<uint8_t>(Clip(b * m + 0.5f, 0.f, 255.f));
+      pPixel[format.mA] = static_cast<uint8_t>(Clip(a + 0.5f, 0.f, 255.f));
+    }
+  }
+
+  const uint32_t* Get() const { return mTable; }
+
+private:
+  uint32_t mTable[kSize];
+};
+
+/** A cache of the gradient tables used by a graphics context, keyed by a hash of the stops, opacity and format, so that a pattern that is filled every frame is only sampled once.
+ * The least recently used table is dropped when the cache is full. Only accessed on the UI thread */
+class IGradientLUTCache
+{
+public:
+  /** @param maxSize The number of tables to keep */
+  IGradientLUTCache(int maxSize = 64)
+  : mMaxSize(maxSize)
+  {}
+
+  /** @return The table for a pattern, which stays valid until the next call */
+  const IGradientLUT& Get(const IPattern& pattern, float opacity, const IGradientLUT::Format& format)
+  {
+    Key key;
+    MakeKey(key, pattern, opacity, format);
+    const uint64_t hash = Hash(key);
+
+    auto it = mEntries.find(hash);
+
+    if (it != mEntries.end() && it->second.mKey.mSize == key.mSize && !memcmp(it->second.mKey.mData, key.mData, key.mSize * sizeof(float)))
+    {
+      it->second.mLastUse = ++mUseCount;
+      return *it->second.mLUT;
+    }
+
+    if (it == mEntries.end() && static_cast<int>(mEntries.size()) >= mMaxSize)
+    {
+      auto oldest = std::min_element(mEntries.begin(), mEntries.end(), [](const std::pair<const uint64_t, Entry>& a, const std::pair<const uint64_t, Entry>& b) {
+        return a.second.mLastUse < b.second.mLastUse;
+      });
+
+      mEntries.erase(oldest);
+    }
+
+    Entry& entry = mEntries[hash]; // a colliding key replaces the entry
+    entry.mKey = key;
+    entry.mLUT.reset(new IGradientLUT(pattern, opacity, format));
+    entry.mLastUse = ++mUseCount;
+    return *entry.mLUT;
+  }
+
+  void Clear() { mEntries.clear(); }
+
+  /** @return The number of cached tables */
+  int Size() const { return static_cast<int>(mEntries.size()); }
+
+private:
+  /** The opacity, format and stops, with room for the 16 stops of an IPattern */
+  struct Key
+  {
+    float mData[3 + 16 * 5];
+    int mSize = 0;
+
+    void Add(float value) { mData[mSize++] = value; }
+  };
+
+  struct Entry
+  {
+    Key mKey;
+    std::unique_ptr<IGradientLUT> mLUT;
+    uint64_t mLastUse = 0;
+  };
+
+  static void MakeKey(Key& key, const IPattern& pattern, float opacity, const IGradientLUT::Format& format)
+  {
+    key.Add(opacity);
+    key.Add(static_cast<float>(format.mR | format.mG << 2 | format.mB << 4 | format.mA << 6));
+    key.Add(format.mPreMultiplied ? 1.f : 0.f);
+
+    for (int i = 0; i < std::min(pattern.NStops(), 16); i++)
+    {
+      const IColorStop& stop = pattern.GetStop(i);
+      key.Add(stop.mOffset);
+      key.Add(static_cast<float>(stop.mColor.A));
+      key.Add(static_cast<float>(stop.mColor.R));
+      key.Add(static_cast<float>(stop.mColor.G));
+      key.Add(static_cast<float>(stop.mColor.B));
+    }
+  }
+
+  /** 64 bit FNV-1a hash of a key */
+  static uint64_t Hash(const Key& key)
+  {
+    uint64_t hash = 14695981039346656037ull;
+    const uint8_t* pData = reinterpret_cast<const uint8_t*>(key.mData);
+
+    for (size_t i = 0; i < key.mSize * sizeof(float); i++)
+      hash = (hash ^ pData[i]) * 1099511628211ull;
+
+    return hash;
+  }
+
+  int mMaxSize;
+  uint64_t mUseCount = 0;
+  std::unordered_map<uint64_t, Entry> mEntries;
+};
+
+/** Filling of horizontal spans of pixels from an IGradientLUT, four pixels at a time with SSE2 where available.
+ * The position of a pixel in the gradient is found from the centre of the pixel with an affine mapping to the pattern space of the IPattern, where a linear gradient
+ * runs along the y axis from 0 to 1, and a radial gradient is the distance from the origin. */
+namespace GradientSpan
+{
+  /** The affine mapping from pixel coordinates to pattern space, u = mXX * x + mXY * y + mTX and v = mYX * x + mYY * y + mTY */
+  struct Mapping
+  {
+    double mXX, mYX, mXY, mYY, mTX, mTY;
+  };
+
+  /** Wraps a gradient position according to the extend mode of the pattern, and scales it to a table index */
+  static inline int Index(float t, EPatternExtend extend)
+  {
+    switch (extend)
+    {
+      case EPatternExtend::Repeat: t -= std::floor(t); break;
+      case EPatternExtend::Reflect: t = std::abs(t - 2.f * std::floor(t * 0.5f + 0.5f)); break;
+      default: break;
+    }
+
+    return static_cast<int>(Clip(t * IGradientLUT::kSize, 0.f, static_cast<float>(IGradientLUT::kSize - 1)));
+  }
+
+#ifdef IGRAPHICS_GRADIENT_SSE2
+  /** SSE2 version of Index(), for four positions */
+  static inline __m128i Index4(__m128 t, EPatternExtend extend)
+  {
+    auto floor4 = [](__m128 x) {
+      const __m128 truncated = _mm_cvtepi32_ps(_mm_cvttps_epi32(x));
+      return _mm_sub_ps(truncated, _mm_and_ps(_mm_cmpgt_ps(truncated, x), _mm_set1_ps(1.f)));
+    };
+
+    switch (extend)
+    {
+      case EPatternExtend::Repeat:
+        t = _mm_sub_ps(t, floor4(t));
+        break;
+      case EPatternExtend::Reflect:
+      {
+        const __m128 d = _mm_sub_ps(t, _mm_mul_ps(_mm_set1_ps(2.f), floor4(_mm_add_ps(_mm_mul_ps(t, _mm_set1_ps(0.5f)), _mm_set1_ps(0.5f)))));
+        t = _mm_andnot_ps(_mm_set1_ps(-0.f), d);
+        break;
+      }
+      default:
+        break;
+    }
+
+    t = _mm_mul_ps(t, _mm_set1_ps(static_cast<float>(IGradientLUT::kSize)));
+    t = _mm_min_ps(_mm_max_ps(t, _mm_setzero_ps()), _mm_set1_ps(static_cast<float>(IGradientLUT::kSize - 1)));
+    return _mm_cvttps_epi32(t);
+  }
+
+  /** Looks up four table entries */
+  static inline void Gather4(uint32_t* pDst, const uint32_t* pLUT, __m128i idx)
+  {
+    alignas(16) int32_t i[4];
+    _mm_store_si128(reinterpret_cast<__m128i*>(i), idx);
+    pDst[0] = pLUT[i[0]];
+    pDst[1] = pLUT[i[1]];
+    pDst[2] = pLUT[i[2]];
+    pDst[3] = pLUT[i[3]];
+  }
+#endif
+
+  /** Fills a span of a linear gradient
+   * @param pDst The pixels to fill
+   * @param x The x coordinate of the first pixel
+   * @param y The y coordinate of the span
+   * @param len The number of pixels
+   * @param map The mapping to pattern space
+   * @param pLUT The gradient table
+   * @param extend How positions outside 0 to 1 are wrapped */
+  static inline void FillLinear(uint32_t* pDst, int x, int y, int len, const Mapping& map, const uint32_t* pLUT, EPatternExtend extend)
+  {
+    const double t0 = map.mYX * (x + 0.5) + map.mYY * (y + 0.5) + map.mTY;
+    const double dt = map.mYX;
+    int i = 0;
+
+    if (dt == 0.0) // e.g. a vertical gradient, the span is one colour
+    {
+      std::fill(pDst, pDst + len, pLUT[Index(static_cast<float>(t0), extend)]);
+      return;
+    }
+
+#ifdef IGRAPHICS_GRADIENT_SSE2
+    const __m128 step = _mm_set_ps(3.f, 2.f, 1.f, 0.f);
+
+    for (; i + 4 <= len; i += 4)
+    {
+      const __m128 t = _mm_add_ps(_mm_set1_ps(static_cast<float>(t0 + i * dt)), _mm_mul_ps(step, _mm_set1_ps(static_cast<float>(dt))));
+      Gather4(pDst + i, pLUT, Index4(t, extend));
+    }
+#endif
+
+    for (; i < len; i++)
+      pDst[i] = pLUT[Index(static_cast<float>(t0 + i * dt), extend)];
+  }
+
+  /** Fills a span of a radial gradient, see FillLinear() for the arguments */
+  static inline void FillRadial(uint32_t* pDst, int x, int y, int len, const Mapping& map, const uint32_t* pLUT, EPatternExtend extend)
+  {
+    const double u0 = map.mXX * (x + 0.5) + map.mXY * (y + 0.5) + map.mTX;
+    const double v0 = map.mYX * (x + 0.5) + map.mYY * (y + 0.5) + map.mTY;
+    const double du = map.mXX;
+    const double dv = map.mYX;
+    int i = 0;
+
+#ifdef IGRAPHICS_GRADIENT_SSE2
+    const __m128 step = _mm_set_ps(3.f, 2.f, 1.f, 0.f);
+
+    for (; i + 4 <= len; i += 4)
+    {
+      const __m128 u = _mm_add_ps(_mm_set1_ps(static_cast<float>(u0 + i * du)), _mm_mul_ps(step, _mm_set1_ps(static_cast<float>(du))));
+      const __m128 v = _mm_add_ps(_mm_set1_ps(static_cast<float>(v0 + i * dv)), _mm_mul_ps(step, _mm_set1_ps(static_cast<float>(dv))));
+      const __m128 t = _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(u, u), _mm_mul_ps(v, v)));
+      Gather4(pDst + i, pLUT, Index4(t, extend));
+    }
+#endif
+
+    for (; i < len; i++)
+    {
+      const float u = static_cast<float>(u0 + i * du);
+      const float v = static_cast<float>(v0 + i * dv);
+      pDst[i] = pLUT[Index(std::sqrt(u * u + v * v), extend)];
+    }
+  }
+
+  /** Fills a span of a linear or radial pattern, see FillLinear() */
+  static inline void Fill(EPatternType type, uint32_t* pDst, int x, int y, int len, const Mapping& map, const uint32_t* pLUT, EPatternExtend extend)
+  {
+    if (type == EPatternType::Radial)
+      FillRadial(pDst, x, y, len, map, pLUT, extend);
+    else
+      FillLinear(pDst, x, y, len, map, pLUT, extend);
+  }
+}
+
+END_IGRAPHICS_NAMESPACE
+END_IPLUG_NAMESPACE
@@ -16,6 +16,7 @@
  */
 
 #include <algorithm>
+#include <limits>
 #include <stack>
 
 #include "IGraphics.h"
@@ -86,27 +87,6 @@ public:
     PathStroke(color, thickness, IStrokeOptions(), pBlend);
   }
   
-  void DrawData(const IColor& color, const IRECT& bounds, float* normYPoints, int nPoints, float* normXPoints, const IBlend* pBlend, float thickness) override
-  {
-    PathClear();
-    
-    float xPos = bounds.L;
-
-    PathMoveTo(xPos, bounds.B - (bounds.H() * normYPoints[0]));
-
-    for (auto i = 1; i < nPoints; i++)
-    {
-      if(normXPoints)
-        xPos = bounds.L + (bounds.W() * normXPoints[i]);
-      else
-        xPos = bounds.L + ((bounds.W() / (float) (nPoints - 1) * i));
-      
-      PathLineTo(xPos, bounds.B - (bounds.H() * normYPoints[i]));
-    }
-    
-    PathStroke(color, thickness, IStrokeOptions(), pBlend);
-  }
-  
   void DrawDottedLine(const IColor& color, float x1, float y1, float x2, float y2, const IBlend* pBlend, float thickness, float dashLen) override
   {
     PathClear();
@@ -402,6 +382,7 @@ public:
     PathTransformSetMatrix(IMatrix());
     SetClipRegion(clip);
     PathTransformSetMatrix(mTransform);
+    mPathClip = clip;
   }
   
   void DrawFittedBitmap(const IBitmap& bitmap, const IRECT& bounds, const IBlend* pBlend) override
@@ -420,6 +401,9 @@ public:
     float yScale = dest.H() / svg.H();
     float scale = xScale < yScale ? xScale : yScale;
     
+    if (DrawCachedSVG(svg, dest.L, dest.T, 0.f, 0.f, scale, 0., pBlend))
+      return;
+    
     PathTransformSave();
     PathTransformTranslate(dest.L, dest.T);
     PathTransformScale(scale);
@@ -429,6 +413,13 @@ public:
   
   void DrawRotatedSVG(const ISVG& svg, float destCtrX, float destCtrY, float width, float height, double angle, const IBlend* pBlend) override
   {
+    float xScale = width / svg.W();
+    float yScale = height / svg.H();
+    float scale = xScale < yScale ? xScale : yScale;
+    
+    if (DrawCachedSVG(svg, destCtrX, destCtrY, -width * 0.5f, -height * 0.5f, scale, angle, pBlend))
+      return;
+    
     PathTransformSave();
     PathTransformTranslate(destCtrX, destCtrY);
     PathTransformRotate((float) angle);
@@ -437,6 +428,117 @@ public:
   }
 
 private:
+  /** Draws an SVG from the raster cache, rasterizing it first if needed. The SVG's origin is placed at offsetX, offsetY from a pivot at x, y,
+   * scaled and rotated around the pivot. Only transforms that a raster can be blitted with exactly (translations and, with rotation steps, rotations
+   * around the pivot) are cached, the rotation is snapped to the nearest step and the pivot is snapped to a quarter of a pixel.
+   * @return \c true if the SVG was drawn, \c false if it should be drawn as paths */
+  bool DrawCachedSVG(const ISVG& svg, float x, float y, float offsetX, float offsetY, float scale, double angle, const IBlend* pBlend)
+  {
+#ifdef IGRAPHICS_SKIA
+    return false;
+#else
+    static constexpr int kSubpixelSteps = 4;
+    
+    if (!svg.IsValid() || !svg.mRasterCache || !mSVGRasterCache.GetBudget() || scale <= 0.f)
+      return false;
+    
+    if (mTransform.mXX != 1.0 || mTransform.mYX != 0.0 || mTransform.mXY != 0.0 || mTransform.mYY != 1.0)
+      return false;
+    
+    int angleStep = 0;
+    
+    if (angle != 0.)
+    {
+      const int steps = GetSVGRasterCacheRotationSteps();
+      
+      if (!steps)
+        return false;
+      
+      angleStep = static_cast<int>(std::round(angle / 360. * steps)) % steps;
+      angleStep += angleStep < 0 ? steps : 0;
+      angle = angleStep * 360. / steps;
+    }
+    
+    const float pixelScale = GetBackingPixelScale();
+    const double px = (x + mTransform.mTX) * pixelScale;
+    const double py = (y + mTransform.mTY) * pixelScale;
+    double ix = std::floor(px);
+    double iy = std::floor(py);
+    int phaseX = static_cast<int>(std::round((px - ix) * kSubpixelSteps));
+    int phaseY = static_cast<int>(std::round((py - iy) * kSubpixelSteps));
+    
+    if (phaseX == kSubpixelSteps) { ix += 1.; phaseX = 0; }
+    if (phaseY == kSubpixelSteps) { iy += 1.; phaseY = 0; }
+    
+    const SVGRasterCache<ILayerPtr>::Key key {
+      svg.mImage,
+      static_cast<int>(std::round(scale * pixelScale * 4096.f)),
+      static_cast<int>(std::round(offsetX * pixelScale * 16.f)),
+      static_cast<int>(std::round(offsetY * pixelScale * 16.f)),
+      angleStep, phaseX, phaseY
+    };
+    
+    ILayerPtr* pLayer = mSVGRasterCache.Find(key);
+    
+    if (!pLayer)
+    {
+      // Rasterize relative to the whole pixel at the origin, so that the raster can be blitted at any pixel position with the same phase
+      const float pivotX = static_cast<float>(phaseX) / (kSubpixelSteps * pixelScale);
+      const float pivotY = static_cast<float>(phaseY) / (kSubpixelSteps * pixelScale);
+      const double rad = DegToRad(angle);
+      const float c = static_cast<float>(std::cos(rad));
+      const float s = static_cast<float>(std::sin(rad));
+      const IRECT content(offsetX, offsetY, offsetX + svg.W() * scale, offsetY + svg.H() * scale);
+      IRECT bounds(std::numeric_limits<float>::max(), std::numeric_limits<float>::max(), std::numeric_limits<float>::lowest(), std::numeric_limits<float>::lowest());
+      
+      for (auto i = 0; i < 4; i++)
+      {
+        const float cx = (i & 1) ? content.R : content.L;
+        const float cy = (i & 2) ? content.B : content.T;
+        const float rx = pivotX + cx * c - cy * s;
+        const float ry = pivotY + cx * s + cy * c;
+        bounds = IRECT(std::min(bounds.L, rx), std::min(bounds.T, ry), std::max(bounds.R, rx), std::max(bounds.B, ry));
+      }
+      
+      bounds.Pad(1.f / pixelScale);
+      
+      const size_t bytes = static_cast<size_t>(std::ceil(bounds.W() * pixelScale + 1.f) * std::ceil(bounds.H() * pixelScale + 1.f)) * 4;
+      
+      if (bytes > mSVGRasterCache.GetBudget())
+        return false;
+      
+      const IMatrix transform = mTransform;
+      const IRECT clip = mPathClip;
+      
+      StartLayer(nullptr, bounds);
+      PathTransformTranslate(pivotX, pivotY);
+      PathTransformRotate(static_cast<float>(angle));
+      PathTransformTranslate(offsetX, offsetY);
+      PathTransformScale(scale);
+      DoDrawSVG(svg);
+      ILayerPtr layer = EndLayer();
+      
+      // EndLayer() resets the transform and clip, restore the caller's state
+      mTransform = transform;
+      PathClipRegion(clip);
+      
+      if (!layer || !layer->GetAPIBitmap())
+        return false;
+      
+      const APIBitmap* pBitmap = layer->GetAPIBitmap();
+      pLayer = mSVGRasterCache.Add(key, std::move(layer), static_cast<size_t>(pBitmap->GetWidth()) * pBitmap->GetHeight() * 4);
+    }
+    
+    const IRECT dest = (*pLayer)->Bounds().GetTranslated(static_cast<float>(ix / pixelScale), static_cast<float>(iy / pixelScale));
+    
+    PathTransformSave();
+    PathTransformReset();
+    DrawBitmap((*pLayer)->GetBitmap(), dest, 0, 0, pBlend);
+    PathTransformRestore();
+    return true;
+#endif
+  }
+  
   IPattern GetSVGPattern(const NSVGpaint& paint, float opacity)
   {
     int alpha = std::min(255, std::max(int(roundf(opacity * 255.f)), 0));
@@ -596,6 +698,25 @@ protected:
   
   float GetBackingPixelScale() const override { return GetScreenScale() * GetDrawScale(); }
 
+  void DoDrawData(const IColor& color, const float* x, const float* y, int nPoints, const IBlend* pBlend, float thickness) override
+  {
+    PathClear();
+    PathMoveTo(x[0], y[0]);
+
+    for (auto i = 1; i < nPoints; i++)
+      PathLineTo(x[i], y[i]);
+
+    PathStroke(color, thickness, GetDataStrokeOptions(), pBlend);
+  }
+
+  /** Decimated data has vertical segments with sharp turns, which miter joins would draw as spikes */
+  static IStrokeOptions GetDataStrokeOptions()
+  {
+    IStrokeOptions options;
+    options.mJoinOption = ELineJoin::Bevel;
+    return options;
+  }
+
   IMatrix GetTransformMatrix() const { return mTransform; }
   
 private:
@@ -605,12 +726,14 @@ private:
     PathClear();
     SetClipRegion(r);
     mClipRECT = r;
+    mPathClip = r;
   }
   
   virtual void SetClipRegion(const IRECT& r) = 0;
   virtual void PathTransformSetMatrix(const IMatrix& matrix) = 0;
 
   IRECT mClipRECT;
+  IRECT mPathClip; // the current clip, set by PathClipRegion()
   IMatrix mTransform;
   std::stack<IMatrix> mTransformStates;
 };
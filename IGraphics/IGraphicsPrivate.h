@@ -18,6 +18,8 @@
 #include <codecvt>
 #include <string>
 #include <memory>
+#include <unordered_map>
+#include <list>
 
 #include "mutex.h"
 #include "wdlstring.h"
@@ -632,6 +634,189 @@ private:
   WDL_PtrList<DataKey> mDatas;
 };
 
+/** Caches the results of laying out or measuring strings, keyed by font, size, scale and string, so that labels and values that are
+ * drawn repeatedly are only measured once. Owned by a drawing class and only accessed on the UI thread, so there is no locking.
+ * When the cache is full it is cleared, which keeps lookups cheap for the common case of a limited set of strings. */
+template <class T>
+class TextLayoutCache
+{
+public:
+  TextLayoutCache(int maxEntries = 1024)
+  : mMaxEntries(maxEntries)
+  {
+  }
+
+  TextLayoutCache(const TextLayoutCache&) = delete;
+  TextLayoutCache& operator=(const TextLayoutCache&) = delete;
+
+  /** @return The cached layout, or nullptr if this string has not been laid out with this font, size and scale */
+  T* Find(const char* fontID, float size, double scale, const char* str)
+  {
+    MakeKey(fontID, size, scale, str);
+    auto it = mLayouts.find(mKey);
+    return it != mLayouts.end() ? &it->second : nullptr;
+  }
+
+  /** Adds a layout to the cache
+   * @return A reference to the cached layout, which remains valid until the next call to Add() or Clear() */
+  T& Add(const char* fontID, float size, double scale, const char* str, T&& layout)
+  {
+    if (static_cast<int>(mLayouts.size()) >= mMaxEntries)
+      mLayouts.clear();
+
+    MakeKey(fontID, size, scale, str);
+    return mLayouts[mKey] = std::move(layout);
+  }
+
+  void Clear()
+  {
+    mLayouts.clear();
+  }
+
+private:
+  void MakeKey(const char* fontID, float size, double scale, const char* str)
+  {
+    char params[64];
+    snprintf(params, 64, "\n%.2f\n%.2f\n", size, scale);
+    mKey = fontID;
+    mKey += params;
+    mKey += str;
+  }
+
+  int mMaxEntries;
+  std::string mKey;
+  std::unordered_map<std::string, T> mLayouts;
+};
+
+/** Caches SVGs that have been rasterized at a specific scale, rotation and subpixel position, so that static SVGs are only rendered as paths once
+ * and can afterwards be blitted. Entries are evicted least recently used first when the total size exceeds the memory budget.
+ * Owned by IGraphics and only accessed on the UI thread, so there is no locking. */
+template <class T>
+class SVGRasterCache
+{
+public:
+  /** The parameters that an SVG was rasterized with, scale, offsets and angle are quantized by the caller */
+  struct Key
+  {
+    const void* pImage;
+    int scale;
+    int offsetX;
+    int offsetY;
+    int angle;
+    int phaseX;
+    int phaseY;
+
+    bool operator==(const Key& other) const
+    {
+      return pImage == other.pImage && scale == other.scale && offsetX == other.offsetX && offsetY == other.offsetY
+          && angle == other.angle && phaseX == other.phaseX && phaseY == other.phaseY;
+    }
+  };
+
+  SVGRasterCache(size_t budget = 32 * 1024 * 1024)
+  : mBudget(budget)
+  {
+  }
+
+  SVGRasterCache(const SVGRasterCache&) = delete;
+  SVGRasterCache& operator=(const SVGRasterCache&) = delete;
+
+  /** @return The cached raster, or nullptr if there is none for this key. The entry becomes the most recently used one */
+  T* Find(const Key& key)
+  {
+    auto it = mMap.find(key);
+
+    if (it == mMap.end())
+      return nullptr;
+
+    mEntries.splice(mEntries.begin(), mEntries, it->second);
+    return &it->second->value;
+  }
+
+  /** Adds a raster to the cache, evicting the least recently used entries until it fits in the budget
+   * @param bytes The memory used by the raster
+   * @return A pointer to the cached raster, which remains valid until it is evicted */
+  T* Add(const Key& key, T&& value, size_t bytes)
+  {
+    while (!mEntries.empty() && mBytes + bytes > mBudget)
+      Evict();
+
+    mEntries.push_front({key, std::move(value), bytes});
+    mMap[key] = mEntries.begin();
+    mBytes += bytes;
+    return &mEntries.front().value;
+  }
+
+  /** Removes all the rasters of an image, e.g. after it has been modified */
+  void Remove(const void* pImage)
+  {
+    for (auto it = mEntries.begin(); it != mEntries.end();)
+    {
+      if (it->key.pImage == pImage)
+      {
+        mBytes -= it->bytes;
+        mMap.erase(it->key);
+        it = mEntries.erase(it);
+      }
+      else
+        ++it;
+    }
+  }
+
+  void Clear()
+  {
+    mMap.clear();
+    mEntries.clear();
+    mBytes = 0;
+  }
+
+  /** Set the maximum memory used by the cached rasters, 0 disables caching */
+  void SetBudget(size_t budget)
+  {
+    mBudget = budget;
+
+    while (!mEntries.empty() && mBytes > mBudget)
+      Evict();
+  }
+
+  size_t GetBudget() const { return mBudget; }
+
+  size_t GetBytes() const { return mBytes; }
+
+private:
+  struct Entry
+  {
+    Key key;
+    T value;
+    size_t bytes;
+  };
+
+  struct KeyHash
+  {
+    size_t operator()(const Key& k) const
+    {
+      size_t h = std::hash<const void*>()(k.pImage);
+
+      for (int v : {k.scale, k.offsetX, k.offsetY, k.angle, k.phaseX, k.phaseY})
+        h = h * 31 + std::hash<int>()(v);
+
+      return h;
+    }
+  };
+
+  void Evict()
+  {
+    mBytes -= mEntries.back().bytes;
+    mMap.erase(mEntries.back().key);
+    mEntries.pop_back();
+  }
+
+  size_t mBudget;
+  size_t mBytes = 0;
+  std::list<Entry> mEntries;
+  std::unordered_map<Key, typename std::list<Entry>::iterator, KeyHash> mMap;
+};
+
 struct IVec2
 {
   float x, y;
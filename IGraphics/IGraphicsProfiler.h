@@ -0,0 +1,379 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+#pragma once
+
+/**
+ * @file
+ * @copydoc IGraphicsProfiler
+ */
+
+#include "IPlugPlatform.h"
+#include "IGraphicsStructs.h"
+#include "IGraphicsUtilities.h"
+
+#include <atomic>
+#include <vector>
+#include <unordered_map>
+#include <typeinfo>
+#include <algorithm>
+#include <string>
+#include <cstdio>
+
+#if defined(__GNUC__) || defined(__clang__)
+#include <cxxabi.h>
+#include <cstdlib>
+#endif
+
+BEGIN_IPLUG_NAMESPACE
+BEGIN_IGRAPHICS_NAMESPACE
+
+class IControl;
+
+/** IGraphicsProfiler records the time spent in each stage of the IGraphics draw loop: control animation, dirty checking, every dirty region,
+ * every IControl::Draw() call and the backend's EndFrame() blit. Events are stored in a fixed size ring, which is written lock-free on the UI thread
+ * and can be read back at any time, e.g. to export a trace in the Chrome trace event format (chrome://tracing or https://ui.perfetto.dev).
+ * Per-control statistics are accumulated for IProfilerDisplayControl.
+ * Enable it with IGraphics::EnableProfiler(), when disabled the draw loop only pays for a null pointer check. */
+class IGraphicsProfiler
+{
+public:
+  enum class EEventType
+  {
+    Frame,
+    Animate,
+    IsDirty,
+    Region,
+    Control,
+    EndFrame
+  };
+
+  /** A single timed event, times are in seconds relative to GetTimestamp() */
+  struct Event
+  {
+    EEventType type = EEventType::Frame;
+    const char* name = ""; // static storage
+    int ctrlTag = kNoTag;
+    int frame = 0;
+    double start = 0.;
+    double duration = 0.;
+    IRECT bounds;
+  };
+
+  /** Accumulated statistics for a single control */
+  struct ControlStats
+  {
+    const char* name = "";
+    int ctrlTag = kNoTag;
+    double avgTime = 0.; // exponential moving average of the time per frame
+    double maxTime = 0.;
+    double frameTime = 0.; // time in the current frame
+    int drawsThisFrame = 0;
+    int lastFrameDrawn = -1;
+    int overlappingDraws = 0; // draws beyond the first in the last frame it was drawn
+  };
+
+  /** Statistics for the last complete frame */
+  struct FrameStats
+  {
+    double frameTime = 0.;
+    double animateTime = 0.;
+    double isDirtyTime = 0.;
+    double endFrameTime = 0.;
+    int nRegions = 0;
+    int nControlDraws = 0;
+    int nOverlappingDraws = 0;
+  };
+
+  /** Helper to time a scope */
+  class ScopedEvent
+  {
+  public:
+    ScopedEvent(IGraphicsProfiler* pProfiler, EEventType type, const IRECT& bounds = IRECT(), const IControl* pControl = nullptr, const char* name = "", int ctrlTag = kNoTag)
+    : mProfiler(pProfiler)
+    , mType(type)
+    , mBounds(bounds)
+    , mControl(pControl)
+    , mName(name)
+    , mCtrlTag(ctrlTag)
+    , mStart(pProfiler ? GetTimestamp() : 0.)
+    {
+    }
+
+    ~ScopedEvent()
+    {
+      if (mProfiler)
+        mProfiler->AddEvent(mType, mStart, GetTimestamp() - mStart, mBounds, mControl, mName, mCtrlTag);
+    }
+
+    ScopedEvent(const ScopedEvent&) = delete;
+    ScopedEvent& operator=(const ScopedEvent&) = delete;
+
+  private:
+    IGraphicsProfiler* mProfiler;
+    EEventType mType;
+    IRECT mBounds;
+    const IControl* mControl;
+    const char* mName;
+    int mCtrlTag;
+    double mStart;
+  };
+
+  /** @param maxEvents The capacity of the event ring, rounded up to a power of two */
+  IGraphicsProfiler(int maxEvents = 65536)
+  {
+    int capacity = 1;
+    while (capacity < maxEvents)
+      capacity *= 2;
+
+    mEvents.resize(capacity);
+  }
+
+  /** Starts a new frame, call before drawing the dirty regions */
+  void BeginFrame()
+  {
+    mFrameStart = GetTimestamp();
+    mCurrentFrame = {};
+    mCurrentFrame.animateTime = mPendingAnimateTime;
+    mCurrentFrame.isDirtyTime = mPendingIsDirtyTime;
+    mPendingAnimateTime = 0.;
+    mPendingIsDirtyTime = 0.;
+  }
+
+  /** Ends the current frame, call after the backend's EndFrame() */
+  void EndFrame()
+  {
+    const double end = GetTimestamp();
+    AddEvent(EEventType::Frame, mFrameStart, end - mFrameStart, IRECT(), nullptr, "Frame");
+
+    for (auto& pair : mControlStats)
+    {
+      ControlStats& s = pair.second;
+
+      if (s.lastFrameDrawn == mFrameIdx)
+      {
+        s.avgTime = s.avgTime * 0.9 + s.frameTime * 0.1;
+        s.maxTime = std::max(s.maxTime, s.frameTime);
+        s.overlappingDraws = s.drawsThisFrame - 1;
+      }
+
+      s.frameTime = 0.;
+      s.drawsThisFrame = 0;
+    }
+
+    mCurrentFrame.frameTime = end - mFrameStart;
+    mLastFrame = mCurrentFrame;
+    mFrameIdx++;
+  }
+
+  /** Record an event
+   * @param pControl The control drawn, for EEventType::Control events */
+  void AddEvent(EEventType type, double start, double duration, const IRECT& bounds, const IControl* pControl, const char* name, int ctrlTag = kNoTag)
+  {
+    switch (type)
+    {
+      case EEventType::Animate: mPendingAnimateTime += duration; name = "Animate"; break;
+      case EEventType::IsDirty: mPendingIsDirtyTime += duration; name = "IsDirty"; break;
+      case EEventType::EndFrame: mCurrentFrame.endFrameTime += duration; name = "EndFrame"; break;
+      case EEventType::Region: mCurrentFrame.nRegions++; name = "Region"; break;
+      case EEventType::Control:
+      {
+        ControlStats& s = mControlStats[pControl];
+        s.name = name;
+        s.ctrlTag = ctrlTag;
+        s.frameTime += duration;
+        s.lastFrameDrawn = mFrameIdx;
+
+        if (++s.drawsThisFrame > 1)
+          mCurrentFrame.nOverlappingDraws++;
+
+        mCurrentFrame.nControlDraws++;
+        break;
+      }
+      default:
+        break;
+    }
+
+    const uint64_t pos = mWritePos.load(std::memory_order_relaxed);
+    Event& e = mEvents[pos & (mEvents.size() - 1)];
+    e.type = type;
+    e.name = name;
+    e.ctrlTag = ctrlTag;
+    e.frame = mFrameIdx;
+    e.start = start;
+    e.duration = duration;
+    e.bounds = bounds;
+    mWritePos.store(pos + 1, std::memory_order_release);
+  }
+
+  /** Forget the statistics for a control, e.g. when it is removed */
+  void RemoveControl(const IControl* pControl)
+  {
+    mControlStats.erase(pControl);
+  }
+
+  /** Clears all the recorded data */
+  void Reset()
+  {
+    mControlStats.clear();
+    mWritePos.store(0);
+    mLastFrame = {};
+  }
+
+  /** @return Statistics for the last complete frame */
+  const FrameStats& GetLastFrameStats() const { return mLastFrame; }
+
+  /** Get the per-control statistics, sorted by decreasing average draw time
+   * @param stats Receives the statistics
+   * @param maxControls The maximum number of controls to return */
+  void GetSlowestControls(std::vector<ControlStats>& stats, int maxControls) const
+  {
+    stats.clear();
+
+    for (auto& pair : mControlStats)
+      stats.push_back(pair.second);
+
+    std::sort(stats.begin(), stats.end(), [](const ControlStats& a, const ControlStats& b) { return a.avgTime > b.avgTime; });
+
+    if (static_cast<int>(stats.size()) > maxControls)
+      stats.resize(maxControls);
+  }
+
+  /** Get the events currently in the ring, oldest first
+   * @param events Receives the events */
+  void GetEvents(std::vector<Event>& events) const
+  {
+    const uint64_t end = mWritePos.load(std::memory_order_acquire);
+    const uint64_t size = mEvents.size();
+    const uint64_t start = end > size ? end - size : 0;
+
+    events.clear();
+    events.reserve(end - start);
+
+    for (auto i = start; i < end; i++)
+      events.push_back(mEvents[i & (size - 1)]);
+  }
+
+  /** Writes the recorded events as a JSON trace, in the Chrome trace event format
+   * @param path The file to write
+   * @return \c true on success */
+  bool WriteChromeTrace(const char* path) const
+  {
+    FILE* fp = fopen(path, "w");
+
+    if (!fp)
+      return false;
+
+    std::vector<Event> events;
+    GetEvents(events);
+
+    fprintf(fp, "{\"traceEvents\":[\n");
+
+    for (size_t i = 0; i < events.size(); i++)
+    {
+      const Event& e = events[i];
+      fprintf(fp, "{\"name\":");
+      WriteJSONString(fp, e.name);
+      fprintf(fp, ",\"cat\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":1,\"ts\":%.3f,\"dur\":%.3f,"
+                  "\"args\":{\"frame\":%i,\"tag\":%i,\"rect\":[%.1f,%.1f,%.1f,%.1f]}}%s\n",
+              GetEventTypeStr(e.type), e.start * 1e6, e.duration * 1e6,
+              e.frame, e.ctrlTag, e.bounds.L, e.bounds.T, e.bounds.R, e.bounds.B, i + 1 < events.size() ? "," : "");
+    }
+
+    fprintf(fp, "]}\n");
+    fclose(fp);
+    return true;
+  }
+
+  /** Writes a string as a quoted JSON string, escaping quotes, backslashes and control characters */
+  static void WriteJSONString(FILE* fp, const char* str)
+  {
+    fputc('"', fp);
+
+    for (const char* p = str ? str : ""; *p; p++)
+    {
+      const unsigned char ch = static_cast<unsigned char>(*p);
+
+      if (ch == '"' || ch == '\\')
+        fprintf(fp, "\\%c", ch);
+      else if (ch < 0x20)
+        fprintf(fp, "\\u%04x", ch);
+      else
+        fputc(ch, fp);
+    }
+
+    fputc('"', fp);
+  }
+
+  static const char* GetEventTypeStr(EEventType type)
+  {
+    switch (type)
+    {
+      case EEventType::Frame: return "frame";
+      case EEventType::Animate: return "animate";
+      case EEventType::IsDirty: return "isdirty";
+      case EEventType::Region: return "region";
+      case EEventType::Control: return "control";
+      case EEventType::EndFrame: return "endframe";
+      default: return "";
+    }
+  }
+
+  /** Get a readable class name for a control, the returned string is cached and remains valid for the lifetime of the program
+   * @param control The control
+   * @return The unqualified class name */
+  template <typename T>
+  static const char* GetControlName(const T& control)
+  {
+    static std::unordered_map<const std::type_info*, std::string> sNames;
+    const std::type_info& info = typeid(control);
+    auto it = sNames.find(&info);
+
+    if (it != sNames.end())
+      return it->second.c_str();
+
+    std::string name = info.name();
+
+#if defined(__GNUC__) || defined(__clang__)
+    int status = 0;
+    char* demangled = abi::__cxa_demangle(info.name(), nullptr, nullptr, &status);
+
+    if (demangled)
+    {
+      name = demangled;
+      free(demangled);
+    }
+#endif
+
+    const size_t templateStart = name.find('<');
+    const size_t lastScope = name.rfind("::", templateStart);
+
+    if (lastScope != std::string::npos)
+      name = name.substr(lastScope + 2);
+    else if (name.compare(0, 6, "class ") == 0)
+      name = name.substr(6);
+
+    return (sNames[&info] = name).c_str();
+  }
+
+private:
+  std::vector<Event> mEvents;
+  std::atomic<uint64_t> mWritePos {0};
+  std::unordered_map<const IControl*, ControlStats> mControlStats;
+  FrameStats mCurrentFrame;
+  FrameStats mLastFrame;
+  double mFrameStart = 0.;
+  double mPendingAnimateTime = 0.;
+  double mPendingIsDirtyTime = 0.;
+  int mFrameIdx = 0;
+};
+
+END_IGRAPHICS_NAMESPACE
+END_IPLUG_NAMESPACE
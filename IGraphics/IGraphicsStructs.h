@@ -78,6 +78,18 @@ using MTLTexturePtr = void*;
 using Milliseconds = std::chrono::duration<double, std::chrono::milliseconds::period>;
 using TimePoint = std::chrono::time_point<std::chrono::high_resolution_clock, Milliseconds>;
 
+class IBitmap;
+
+/** Where a frame of a bitmap that has been packed into an atlas is, see IGraphics::PackBitmaps() */
+struct IBitmapFrame
+{
+  /** The atlas page */
+  const IBitmap* mPage = nullptr;
+  /** The position of the frame on the page, in points */
+  int mX = 0;
+  int mY = 0;
+};
+
 /** User-facing bitmap abstraction that you use to manage bitmap data, independant of draw class/platform.
  * IBitmap doesn't actually own the image data \see APIBitmap
  * An IBitmap's width and height are always in relation to a 1:1 (low dpi) screen. Any scaling happens at the drawing stage. */
@@ -99,6 +111,24 @@ public:
   {
   }
 
+  /** IBitmap Constructor, for a bitmap whose frames have been packed into atlas pages
+   @param pFrames The page and position of each frame, which must outlive the IBitmap
+   @param n Number of frames
+   @param framesAreHorizontal \c true if the frames were positioned horizontally in the original film-strip
+   @param w The width of the original film-strip
+   @param h The height of the original film-strip
+   @param name Resource name for the bitmap */
+  IBitmap(const IBitmapFrame* pFrames, int n, bool framesAreHorizontal, int w, int h, const char* name)
+  : mAPIBitmap(pFrames[0].mPage->GetAPIBitmap())
+  , mW(w)
+  , mH(h)
+  , mN(n)
+  , mFramesAreHorizontal(framesAreHorizontal)
+  , mResourceName(name, static_cast<int>(strlen(name)))
+  , mFrames(pFrames)
+  {
+  }
+
   IBitmap()
   : mAPIBitmap(nullptr)
   , mW(0)
@@ -141,6 +171,10 @@ public:
   /** @return \true if the bitmap has valid data */
   inline bool IsValid() const { return mAPIBitmap != nullptr; }
 
+  /** @param frame A frame index, starting at 1 as for IGraphics::DrawBitmap()
+   * @return Where the frame is, if the bitmap has been packed into an atlas, otherwise nullptr */
+  const IBitmapFrame* GetPackedFrame(int frame) const { return mFrames ? mFrames + (Clip(frame, 1, mN) - 1) : nullptr; }
+
 private:
   /** Pointer to the API specific bitmap */
   APIBitmap* mAPIBitmap;
@@ -154,6 +188,8 @@ private:
   bool mFramesAreHorizontal;
   /** Resource path/name for the bitmap */
   WDL_String mResourceName;
+  /** The frame positions, if the bitmap has been packed into an atlas */
+  const IBitmapFrame* mFrames = nullptr;
 };
 
 /** User-facing SVG abstraction that you use to manage SVG data
@@ -220,6 +256,9 @@ struct ISVG
   inline bool IsValid() const { return mImage != nullptr; }
   
   NSVGimage* mImage = nullptr;
+
+  /** Set to \c false for SVGs whose image is modified between draws (e.g. animated colors), so that they are always drawn as paths, rather than from a cached raster */
+  bool mRasterCache = true;
 };
 #endif
 
@@ -443,7 +482,7 @@ struct IColor
     };
 
     IColor col;
-    h = std::fmodf(h, 1.0f);
+    h = std::fmod(h, 1.0f);
     if (h < 0.0f) h += 1.0f;
     s = Clip(s, 0.0f, 1.0f);
     l = Clip(l, 0.0f, 1.0f);
@@ -18,7 +18,10 @@
 
 #include "IPlugPlatform.h"
 #include "IPlugQueue.h"
+#include "IPlugTripleBuffer.h"
 #include <array>
+#include <algorithm>
+#include <limits>
 
 BEGIN_IPLUG_NAMESPACE
 BEGIN_IGRAPHICS_NAMESPACE
@@ -79,9 +82,41 @@ private:
   IPlugQueue<ISenderData<MAXNC, T>> mQueue {QUEUE_SIZE};
 };
 
-/** IPeakSender is a utility class which can be used to defer peak data from sample buffers for sending to the GUI */
-template <int MAXNC = 1, int QUEUE_SIZE = 64>
-class IPeakSender : public ISender<MAXNC, QUEUE_SIZE, float>
+/** ISnapshotSender is an alternative to ISender, for data where only the most recent value is of interest (e.g. scopes and meters).
+ * Rather than queueing every packet, the newest packet is handed over via a wait-free IPlugTripleBuffer, so data is never dropped because a queue is full
+ * and TransmitData() sends at most one message per call, however many packets were pushed in between.
+ * Since older packets are overwritten, all data pushed to a single ISnapshotSender should be for the same control */
+template <int MAXNC = 1, typename T = float>
+class ISnapshotSender
+{
+public:
+  static constexpr int kUpdateMessage = 0;
+
+  /** Publishes a data element, overwriting any previous element that was not yet transmitted. This can be called on the realtime audio thread. */
+  void PushData(const ISenderData<MAXNC, T>& d)
+  {
+    mBuffer.Write(d);
+  }
+
+  /** Sends the most recent data element to the control, if it has not already been sent.
+   *  This must be called on the main thread - typically in MyPlugin::OnIdle() */
+  void TransmitData(IEditorDelegate& dlg)
+  {
+    if(mBuffer.Update())
+    {
+      const ISenderData<MAXNC, T>& d = mBuffer.GetReadBuffer();
+      dlg.SendControlMsgFromDelegate(d.ctrlTag, kUpdateMessage, sizeof(ISenderData<MAXNC, T>), (void*) &d);
+    }
+  }
+
+private:
+  IPlugTripleBuffer<ISenderData<MAXNC, T>> mBuffer;
+};
+
+/** IPeakSender is a utility class which can be used to defer peak data from sample buffers for sending to the GUI
+ * @tparam SENDER The transport used, ISender (queue, the default) or ISnapshotSender (latest value) */
+template <int MAXNC = 1, int QUEUE_SIZE = 64, class SENDER = ISender<MAXNC, QUEUE_SIZE, float>>
+class IPeakSender : public SENDER
 {
 public:
   /** Queue peaks from sample buffers into the sender, checking the data is over the required threshold. This can be called on the realtime audio thread. */
@@ -106,15 +141,33 @@ public:
     }
 
     if(sum > SENDER_THRESHOLD)
-      ISender<MAXNC, QUEUE_SIZE, float>::PushData(d);
+      SENDER::PushData(d);
   }
 };
 
-/** IBufferSender is a utility class which can be used to defer buffer data for sending to the GUI */
-template <int MAXNC = 1, int QUEUE_SIZE = 64, int MAXBUF = 128>
-class IBufferSender : public ISender<MAXNC, QUEUE_SIZE, std::array<float, MAXBUF>>
+/** IBufferSender is a utility class which can be used to defer buffer data for sending to the GUI
+ * @tparam SENDER The transport used, ISender (queue, the default) or ISnapshotSender (latest value) */
+template <int MAXNC = 1, int QUEUE_SIZE = 64, int MAXBUF = 128, class SENDER = ISender<MAXNC, QUEUE_SIZE, std::array<float, MAXBUF>>>
+class IBufferSender : public SENDER
 {
 public:
+  /** Set the number of input samples that are reduced to each column of the buffer. With the default of 1 every sample is sent as is.
+   * For values > 1 each column is reduced to its minimum and maximum on the audio thread, and they are written as consecutive pairs
+   * (min, max, min, max...), so each buffer holds MAXBUF / 2 columns spanning MAXBUF / 2 * samplesPerColumn samples.
+   * Drawn as a polyline, the pairs give the envelope of the signal, so long time windows can be displayed without sending every sample.
+   * Should be called when the audio thread is not running, e.g. in OnReset()
+   * @param samplesPerColumn The number of samples per column */
+  void SetSamplesPerColumn(int samplesPerColumn)
+  {
+    static_assert(MAXBUF % 2 == 0, "MAXBUF must be even to store min/max pairs");
+    mSamplesPerColumn = std::max(samplesPerColumn, 1);
+    mBufCount = 0;
+    mColumnCount = 0;
+    mRunningSum.fill(0.f);
+    mColumnMin.fill(std::numeric_limits<float>::max());
+    mColumnMax.fill(std::numeric_limits<float>::lowest());
+  }
+
   /** Queue sample buffers into the sender, checking the data is over the required threshold. This can be called on the realtime audio thread. */
   void ProcessBlock(sample** inputs, int nFrames, int ctrlTag, int nChans = MAXNC, int chanOffset = 0)
   {
@@ -134,26 +187,65 @@ public:
           mBuffer.ctrlTag = ctrlTag;
           mBuffer.nChans = nChans;
           mBuffer.chanOffset = chanOffset;
-          ISender<MAXNC, QUEUE_SIZE, std::array<float, MAXBUF>>::PushData(mBuffer);
+          SENDER::PushData(mBuffer);
         }
         
         mBufCount = 0;
       }
       
-      for (auto c = chanOffset; c < (chanOffset + nChans); c++)
+      if(mSamplesPerColumn == 1)
       {
-        mBuffer.vals[c][mBufCount] = (float) inputs[c][s];
-        mRunningSum[c] += std::fabs( (float) inputs[c][s]);
-      }
+        for (auto c = chanOffset; c < (chanOffset + nChans); c++)
+        {
+          mBuffer.vals[c][mBufCount] = (float) inputs[c][s];
+          mRunningSum[c] += std::fabs( (float) inputs[c][s]);
+        }
 
-      mBufCount++;
+        mBufCount++;
+      }
+      else
+      {
+        for (auto c = chanOffset; c < (chanOffset + nChans); c++)
+        {
+          const float x = (float) inputs[c][s];
+          mColumnMin[c] = std::min(mColumnMin[c], x);
+          mColumnMax[c] = std::max(mColumnMax[c], x);
+          mRunningSum[c] += std::fabs(x);
+        }
+        
+        if(++mColumnCount == mSamplesPerColumn)
+        {
+          for (auto c = chanOffset; c < (chanOffset + nChans); c++)
+          {
+            mBuffer.vals[c][mBufCount] = mColumnMin[c];
+            mBuffer.vals[c][mBufCount + 1] = mColumnMax[c];
+            mColumnMin[c] = std::numeric_limits<float>::max();
+            mColumnMax[c] = std::numeric_limits<float>::lowest();
+          }
+          
+          mColumnCount = 0;
+          mBufCount += 2;
+        }
+      }
     }
   }
 protected:
   ISenderData<MAXNC, std::array<float, MAXBUF>> mBuffer;
   int mBufCount = 0;
+  int mSamplesPerColumn = 1;
+  int mColumnCount = 0;
   std::array<float, MAXNC> mRunningSum {0.};
+  std::array<float, MAXNC> mColumnMin {0.};
+  std::array<float, MAXNC> mColumnMax {0.};
 };
 
+/** An IPeakSender that only transmits the most recent peak values, see ISnapshotSender */
+template <int MAXNC = 1>
+using IPeakSnapshotSender = IPeakSender<MAXNC, 1, ISnapshotSender<MAXNC, float>>;
+
+/** An IBufferSender that only transmits the most recent buffer, see ISnapshotSender */
+template <int MAXNC = 1, int MAXBUF = 128>
+using IBufferSnapshotSender = IBufferSender<MAXNC, 1, MAXBUF, ISnapshotSender<MAXNC, std::array<float, MAXBUF>>>;
+
 END_IPLUG_NAMESPACE
 END_IGRAPHICS_NAMESPACE
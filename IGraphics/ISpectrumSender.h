@@ -0,0 +1,237 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+#pragma once
+
+/**
+ * @file
+ * @copydoc ISpectrumSender
+ */
+
+#include "IPlugPlatform.h"
+#include "IPlugTripleBuffer.h"
+#include "ISender.h"
+
+#include <atomic>
+#include <vector>
+#include <complex>
+#include <cmath>
+#include <cstdint>
+
+#if !defined OS_WEB
+#include <thread>
+#include <chrono>
+#endif
+
+BEGIN_IPLUG_NAMESPACE
+BEGIN_IGRAPHICS_NAMESPACE
+
+/** ISpectrumSender computes averaged magnitude spectra of the audio passed to ProcessBlock(), for display in the GUI (see IVSpectrumControl)
+ * The realtime thread only copies samples into a lock-free ring. The FFT and averaging run on a worker thread, which publishes the newest spectrum via
+ * an IPlugTripleBuffer, so TransmitData() sends at most one spectrum per call. On the web, where there is no worker thread, the analysis runs in TransmitData().
+ * The data is sent as ISenderData<MAXNC, std::array<float, FFTSIZE / 2>> containing linear magnitudes, normalized so that a full scale sine is 1.
+ * @tparam FFTSIZE The FFT size, must be a power of two */
+template <int MAXNC = 1, int FFTSIZE = 4096>
+class ISpectrumSender
+{
+public:
+  static constexpr int kUpdateMessage = 0;
+  static constexpr int kNumBins = FFTSIZE / 2;
+  static constexpr int kRingSize = FFTSIZE * 4;
+
+  static_assert((FFTSIZE & (FFTSIZE - 1)) == 0, "FFTSIZE must be a power of two");
+
+  using Data = ISenderData<MAXNC, std::array<float, kNumBins>>;
+
+  /** Constructs the sender and starts the analysis thread
+   * @param intervalMs The interval at which the worker thread analyses new data (when there are at least hopSize new samples)
+   * @param hopSize The minimum number of new samples between two analyses */
+  ISpectrumSender(int intervalMs = 16, int hopSize = FFTSIZE / 4)
+  : mIntervalMs(intervalMs)
+  , mHopSize(hopSize)
+  {
+    for (auto c = 0; c < MAXNC; c++)
+      mRing[c].assign(kRingSize, 0.f);
+
+    mWindow.resize(FFTSIZE);
+    float windowSum = 0.f;
+
+    for (auto i = 0; i < FFTSIZE; i++) // Hann
+    {
+      mWindow[i] = 0.5f - 0.5f * std::cos(2.f * PI * i / FFTSIZE);
+      windowSum += mWindow[i];
+    }
+
+    for (auto& w : mWindow)
+      w *= 2.f / windowSum;
+
+    mTwiddles.resize(FFTSIZE / 2);
+    for (auto i = 0; i < FFTSIZE / 2; i++)
+      mTwiddles[i] = std::polar(1.f, (float) (-2. * PI * i / FFTSIZE));
+
+    mFFT.resize(FFTSIZE);
+    mAveraged.vals = {};
+
+#if !defined OS_WEB
+    mThread = std::thread([this]() { ThreadProc(); });
+#endif
+  }
+
+  ~ISpectrumSender()
+  {
+#if !defined OS_WEB
+    mRunning = false;
+    mThread.join();
+#endif
+  }
+
+  ISpectrumSender(const ISpectrumSender&) = delete;
+  ISpectrumSender& operator=(const ISpectrumSender&) = delete;
+
+  /** Set the amount of averaging between consecutive spectra. Can be called on any thread.
+   * @param averaging 0. for no averaging, values closer to 1. give slower, smoother spectra */
+  void SetAveraging(float averaging)
+  {
+    mAveraging.store(Clip(averaging, 0.f, 0.999f), std::memory_order_relaxed);
+  }
+
+  /** Add sample buffers to the analysis ring. This can be called on the realtime audio thread. */
+  void ProcessBlock(sample** inputs, int nFrames, int ctrlTag, int nChans = MAXNC, int chanOffset = 0)
+  {
+    mCtrlTag.store(ctrlTag, std::memory_order_relaxed);
+    mNChans.store(nChans, std::memory_order_relaxed);
+    mChanOffset.store(chanOffset, std::memory_order_relaxed);
+
+    int64_t pos = mWritePos.load(std::memory_order_relaxed);
+
+    for (auto s = 0; s < nFrames; s++, pos++)
+    {
+      for (auto c = chanOffset; c < (chanOffset + nChans); c++)
+        mRing[c][pos & (kRingSize - 1)] = (float) inputs[c][s];
+    }
+
+    mWritePos.store(pos, std::memory_order_release);
+  }
+
+  /** Sends the most recent spectrum to the control, if a new one is available.
+   *  This must be called on the main thread - typically in MyPlugin::OnIdle() */
+  void TransmitData(IEditorDelegate& dlg)
+  {
+#if defined OS_WEB
+    Analyse();
+#endif
+
+    if(mOutput.Update())
+    {
+      const Data& d = mOutput.GetReadBuffer();
+      dlg.SendControlMsgFromDelegate(d.ctrlTag, kUpdateMessage, sizeof(Data), (void*) &d);
+    }
+  }
+
+private:
+#if !defined OS_WEB
+  void ThreadProc()
+  {
+    while(mRunning)
+    {
+      Analyse();
+      std::this_thread::sleep_for(std::chrono::milliseconds(mIntervalMs));
+    }
+  }
+#endif
+
+  /** Computes a new spectrum if enough new samples have arrived, and publishes it. Called on the worker thread */
+  void Analyse()
+  {
+    const int64_t end = mWritePos.load(std::memory_order_acquire);
+
+    if(end < FFTSIZE || end - mLastAnalysed < mHopSize)
+      return;
+
+    mLastAnalysed = end;
+
+    const int nChans = mNChans.load(std::memory_order_relaxed);
+    const int chanOffset = mChanOffset.load(std::memory_order_relaxed);
+    const float averaging = mAveraging.load(std::memory_order_relaxed);
+
+    for (auto c = chanOffset; c < (chanOffset + nChans); c++)
+    {
+      for (auto i = 0; i < FFTSIZE; i++)
+        mFFT[i] = {mRing[c][(end - FFTSIZE + i) & (kRingSize - 1)] * mWindow[i], 0.f};
+
+      ComputeFFT();
+
+      for (auto k = 0; k < kNumBins; k++)
+      {
+        const float mag = std::abs(mFFT[k]);
+        mAveraged.vals[c][k] = averaging * mAveraged.vals[c][k] + (1.f - averaging) * mag;
+      }
+    }
+
+    mAveraged.ctrlTag = mCtrlTag.load(std::memory_order_relaxed);
+    mAveraged.nChans = nChans;
+    mAveraged.chanOffset = chanOffset;
+    mOutput.Write(mAveraged);
+  }
+
+  /** In-place iterative radix-2 FFT of mFFT */
+  void ComputeFFT()
+  {
+    for (int i = 1, j = 0; i < FFTSIZE; i++)
+    {
+      int bit = FFTSIZE >> 1;
+      for (; j & bit; bit >>= 1)
+        j ^= bit;
+      j ^= bit;
+
+      if(i < j)
+        std::swap(mFFT[i], mFFT[j]);
+    }
+
+    for (int len = 2; len <= FFTSIZE; len <<= 1)
+    {
+      const int step = FFTSIZE / len;
+
+      for (int i = 0; i < FFTSIZE; i += len)
+      {
+        for (int k = 0; k < len / 2; k++)
+        {
+          const std::complex<float> t = mTwiddles[k * step] * mFFT[i + k + len / 2];
+          mFFT[i + k + len / 2] = mFFT[i + k] - t;
+          mFFT[i + k] += t;
+        }
+      }
+    }
+  }
+
+  std::vector<float> mRing[MAXNC];
+  std::atomic<int64_t> mWritePos {0};
+  std::atomic<int> mCtrlTag {kNoTag};
+  std::atomic<int> mNChans {MAXNC};
+  std::atomic<int> mChanOffset {0};
+  std::atomic<float> mAveraging {0.8f};
+
+  int mIntervalMs;
+  int mHopSize;
+  int64_t mLastAnalysed = 0;
+  std::vector<float> mWindow;
+  std::vector<std::complex<float>> mTwiddles;
+  std::vector<std::complex<float>> mFFT;
+  Data mAveraged;
+  IPlugTripleBuffer<Data> mOutput;
+
+#if !defined OS_WEB
+  std::atomic<bool> mRunning {true};
+  std::thread mThread;
+#endif
+};
+
+END_IGRAPHICS_NAMESPACE
+END_IPLUG_NAMESPACE
@@ -0,0 +1,228 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+#pragma once
+
+/**
+ * @file
+ * @copydoc IWaveformSender
+ */
+
+#include "IPlugPlatform.h"
+#include "ISender.h"
+
+#include <atomic>
+#include <vector>
+#include <cmath>
+#include <cstdint>
+
+BEGIN_IPLUG_NAMESPACE
+BEGIN_IGRAPHICS_NAMESPACE
+
+/** IWaveformSender keeps a long history of audio on the realtime thread as a multi-resolution min/max summary (a "mipmap" of the signal),
+ * so that any time window, up to the maximum history, can be sent to the GUI as exactly NCOLUMNS min/max pairs.
+ * Level 0 holds the min/max of every kBaseBinSize samples, each following level combines two bins of the level below.
+ * The levels are updated incrementally in ProcessBlock() and published lock-free, TransmitData() picks the coarsest level that still has at least
+ * one bin per column, so its cost only depends on NCOLUMNS, regardless of the time window.
+ * The data is sent as ISenderData<MAXNC, std::array<float, NCOLUMNS * 2>> with consecutive (min, max) pairs per column, which can be drawn by IVWaveformControl */
+template <int MAXNC = 1, int NCOLUMNS = 512>
+class IWaveformSender
+{
+public:
+  static constexpr int kUpdateMessage = 0;
+  static constexpr int kBaseBinSize = 16;
+  static constexpr int kMaxLevels = 20;
+
+  using Data = ISenderData<MAXNC, std::array<float, NCOLUMNS * 2>>;
+
+  /** Allocates the history. This must not be called while ProcessBlock() or TransmitData() may run, e.g. call it in OnReset()
+   * @param sampleRate The sample rate of the data passed to ProcessBlock()
+   * @param maxSeconds The longest time window that will be displayed */
+  void SetMaxHistory(double sampleRate, double maxSeconds)
+  {
+    mSampleRate = sampleRate;
+    mMaxSeconds = maxSeconds;
+
+    const double maxSamples = std::max(sampleRate * maxSeconds, (double) kBaseBinSize);
+
+    mNumLevels = 0;
+
+    do
+    {
+      const int64_t historyBins = (int64_t) std::ceil(maxSamples / BinSize(mNumLevels));
+      int capacity = 64;
+
+      while(capacity < historyBins * 2) // headroom for bins written while the GUI is reading
+        capacity *= 2;
+
+      mCapacity[mNumLevels] = capacity;
+      mBins[mNumLevels].assign(capacity * MAXNC, {0.f, 0.f});
+      mCount[mNumLevels].store(0);
+      mNumLevels++;
+    }
+    while(mNumLevels < kMaxLevels && BinSize(mNumLevels - 1) * NCOLUMNS < maxSamples);
+
+    mAccCount = 0;
+    ResetAccumulator();
+    mTimeWindow = std::min(mTimeWindow, maxSeconds);
+    mLastTransmitted = -1;
+  }
+
+  /** Set the time window that will be sent to the GUI, this is clamped to the max history. Call on the main thread.
+   * @param seconds The duration of the signal displayed */
+  void SetTimeWindow(double seconds)
+  {
+    mTimeWindow = Clip(seconds, 0., mMaxSeconds);
+  }
+
+  /** Add sample buffers to the history. This can be called on the realtime audio thread. */
+  void ProcessBlock(sample** inputs, int nFrames, int ctrlTag, int nChans = MAXNC, int chanOffset = 0)
+  {
+    if(mNumLevels == 0)
+      return;
+
+    mCtrlTag.store(ctrlTag, std::memory_order_relaxed);
+    mNChans.store(nChans, std::memory_order_relaxed);
+    mChanOffset.store(chanOffset, std::memory_order_relaxed);
+
+    for (auto s = 0; s < nFrames; s++)
+    {
+      for (auto c = chanOffset; c < (chanOffset + nChans); c++)
+      {
+        const float x = (float) inputs[c][s];
+        mAcc[c].min = std::min(mAcc[c].min, x);
+        mAcc[c].max = std::max(mAcc[c].max, x);
+      }
+
+      if(++mAccCount == kBaseBinSize)
+      {
+        PushBin(0, mAcc);
+        ResetAccumulator();
+        mAccCount = 0;
+      }
+    }
+  }
+
+  /** Reduces the current time window to NCOLUMNS min/max pairs and sends them to the control, if new data has arrived.
+   *  This must be called on the main thread - typically in MyPlugin::OnIdle() */
+  void TransmitData(IEditorDelegate& dlg)
+  {
+    if(mNumLevels == 0)
+      return;
+
+    const int64_t written0 = mCount[0].load(std::memory_order_acquire);
+
+    if(written0 == mLastTransmitted)
+      return;
+
+    mLastTransmitted = written0;
+
+    const double samplesPerColumn = std::max(mTimeWindow * mSampleRate / NCOLUMNS, 1.);
+
+    int level = 0;
+    while(level + 1 < mNumLevels && BinSize(level + 1) <= samplesPerColumn)
+      level++;
+
+    const Bin* pBins = mBins[level].data();
+    const int64_t mask = mCapacity[level] - 1;
+    const int64_t written = mCount[level].load(std::memory_order_acquire);
+    const int64_t oldestValid = std::max((int64_t) 0, written - mCapacity[level] / 2);
+    const double binsPerColumn = samplesPerColumn / BinSize(level);
+    const double firstBin = (double) written - binsPerColumn * NCOLUMNS;
+
+    mData.ctrlTag = mCtrlTag.load(std::memory_order_relaxed);
+    mData.nChans = mNChans.load(std::memory_order_relaxed);
+    mData.chanOffset = mChanOffset.load(std::memory_order_relaxed);
+
+    for (auto col = 0; col < NCOLUMNS; col++)
+    {
+      const int64_t start = (int64_t) std::floor(firstBin + col * binsPerColumn);
+      const int64_t end = std::max(start + 1, (int64_t) std::floor(firstBin + (col + 1) * binsPerColumn));
+
+      for (auto c = mData.chanOffset; c < (mData.chanOffset + mData.nChans); c++)
+      {
+        Bin b = {std::numeric_limits<float>::max(), std::numeric_limits<float>::lowest()};
+
+        for (auto i = std::max(start, oldestValid); i < end; i++)
+        {
+          const Bin& src = pBins[(i & mask) * MAXNC + c];
+          b.min = std::min(b.min, src.min);
+          b.max = std::max(b.max, src.max);
+        }
+
+        if(b.min > b.max) // no data yet for this column
+          b = {0.f, 0.f};
+
+        mData.vals[c][col * 2] = b.min;
+        mData.vals[c][col * 2 + 1] = b.max;
+      }
+    }
+
+    dlg.SendControlMsgFromDelegate(mData.ctrlTag, kUpdateMessage, sizeof(Data), (void*) &mData);
+  }
+
+private:
+  struct Bin
+  {
+    float min;
+    float max;
+  };
+
+  static double BinSize(int level)
+  {
+    return (double) kBaseBinSize * (double) (int64_t(1) << level);
+  }
+
+  void ResetAccumulator()
+  {
+    for (auto& b : mAcc)
+      b = {std::numeric_limits<float>::max(), std::numeric_limits<float>::lowest()};
+  }
+
+  /** Writes a completed bin at a level, and when that completes a pair, combines the pair into the next level */
+  void PushBin(int level, const std::array<Bin, MAXNC>& bin)
+  {
+    const int64_t count = mCount[level].load(std::memory_order_relaxed);
+    const int64_t mask = mCapacity[level] - 1;
+    Bin* pBins = mBins[level].data();
+
+    std::copy(bin.begin(), bin.end(), pBins + (count & mask) * MAXNC);
+    mCount[level].store(count + 1, std::memory_order_release);
+
+    if((count & 1) && level + 1 < mNumLevels)
+    {
+      const Bin* pPrev = pBins + ((count - 1) & mask) * MAXNC;
+      std::array<Bin, MAXNC> combined;
+
+      for (auto c = 0; c < MAXNC; c++)
+        combined[c] = {std::min(pPrev[c].min, bin[c].min), std::max(pPrev[c].max, bin[c].max)};
+
+      PushBin(level + 1, combined);
+    }
+  }
+
+  double mSampleRate = 44100.;
+  double mMaxSeconds = 0.;
+  double mTimeWindow = 1.;
+  int mNumLevels = 0;
+  int mCapacity[kMaxLevels] = {};
+  std::vector<Bin> mBins[kMaxLevels];
+  std::atomic<int64_t> mCount[kMaxLevels] = {};
+  std::array<Bin, MAXNC> mAcc;
+  int mAccCount = 0;
+  std::atomic<int> mCtrlTag {kNoTag};
+  std::atomic<int> mNChans {MAXNC};
+  std::atomic<int> mChanOffset {0};
+  int64_t mLastTransmitted = -1;
+  Data mData;
+};
+
+END_IGRAPHICS_NAMESPACE
+END_IPLUG_NAMESPACE
@@ -31,6 +31,7 @@ public:
   void CloseWindow() override;
   bool WindowIsOpen() override;
   void PlatformResize(bool parentHasResized) override;
+  void PlatformSetFrameRate(int fps) override;
 
   void GetMouseLocation(float& x, float&y) const override { /* NO-OP */ };
 
@@ -146,6 +146,18 @@ void IGraphicsIOS::PlatformResize(bool parentHasResized)
   }
 }
 
+void IGraphicsIOS::PlatformSetFrameRate(int fps)
+{
+  if (mView)
+  {
+    CADisplayLink* pDisplayLink = [(IGRAPHICS_VIEW*) mView displayLink];
+    pDisplayLink.paused = (fps == 0);
+
+    if (fps > 0)
+      pDisplayLink.preferredFramesPerSecond = fps;
+  }
+}
+
 EMsgBoxResult IGraphicsIOS::ShowMessageBox(const char* str, const char* caption, EMsgBoxType type, IMsgBoxCompletionHanderFunc completionHandler)
 {
   ReleaseMouseCapture();
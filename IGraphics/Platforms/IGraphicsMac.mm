@@ -170,6 +170,12 @@ void IGraphicsMac::PlatformResize(bool parentHasResized)
   }  
 }
 
+void IGraphicsMac::PlatformSetFrameRate(int fps)
+{
+  if (mView)
+    [(IGRAPHICS_VIEW*) mView setFrameRate: fps];
+}
+
 void IGraphicsMac::PointToScreen(float& x, float& y) const
 {
   if (mView)
@@ -130,6 +130,7 @@ using namespace igraphics;
 - (void) render;
 - (void) onTimer: (NSTimer*) pTimer;
 - (void) killTimer;
+- (void) setFrameRate: (int) fps;
 //mouse
 - (void) getMouseXY: (NSEvent*) pEvent : (float&) x : (float&) y;
 - (IMouseInfo) getMouseLeft: (NSEvent*) pEvent;
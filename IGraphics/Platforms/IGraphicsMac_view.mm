@@ -472,9 +472,7 @@ extern StaticStorage<CoreTextFontDescriptor> sFontDescriptorCache;
   
   [self registerForDraggedTypes:[NSArray arrayWithObjects: NSFilenamesPboardType, nil]];
 
-  double sec = 1.0 / (double) pGraphics->FPS();
-  mTimer = [NSTimer timerWithTimeInterval:sec target:self selector:@selector(onTimer:) userInfo:nil repeats:YES];
-  [[NSRunLoop currentRunLoop] addTimer: mTimer forMode: (NSString*) kCFRunLoopCommonModes];
+  [self setFrameRate: pGraphics->FPS()];
 
   return self;
 }
@@ -1006,6 +1004,18 @@ static void MakeCursorFromName(NSCursor*& cursor, const char *name)
   mTimer = 0;
 }
 
+- (void) setFrameRate: (int) fps
+{
+  [self killTimer];
+
+  if (fps > 0)
+  {
+    double sec = 1.0 / (double) fps;
+    mTimer = [NSTimer timerWithTimeInterval:sec target:self selector:@selector(onTimer:) userInfo:nil repeats:YES];
+    [[NSRunLoop currentRunLoop] addTimer: mTimer forMode: (NSString*) kCFRunLoopCommonModes];
+  }
+}
+
 - (void) removeFromSuperview
 {
   if (mTextFieldView)
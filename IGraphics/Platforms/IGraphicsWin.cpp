@@ -201,6 +201,28 @@ void IGraphicsWin::DestroyEditWindow()
  }
 }
 
+// static
+UINT IGraphicsWin::TimerInterval(int fps)
+{
+  // its best to get below 16ms because the windows time quanta is slightly above 15ms.
+  int mSec = static_cast<int>(std::floorf(1000.0f / fps));
+  if (mSec < 20) mSec = 15;
+  return mSec;
+}
+
+void IGraphicsWin::PlatformSetFrameRate(int fps)
+{
+#ifndef IGRAPHICS_VSYNC // the VBLANK thread keeps posting at the display rate
+  if (!mPlugWnd)
+    return;
+
+  if (fps > 0)
+    SetTimer(mPlugWnd, IPLUG_TIMER_ID, TimerInterval(fps), NULL); // replaces the existing timer
+  else
+    KillTimer(mPlugWnd, IPLUG_TIMER_ID);
+#endif
+}
+
 void IGraphicsWin::OnDisplayTimer(int vBlankCount)
 {
 #ifdef IGRAPHICS_VSYNC
@@ -312,10 +334,8 @@ LRESULT CALLBACK IGraphicsWin::WndProc(HWND hWnd, UINT msg, WPARAM wParam, LPARA
 #ifdef IGRAPHICS_VSYNC // use VBLANK Thread
     assert((pGraphics->FPS() == 60) && "If you want to run at frame rates other than 60FPS remove IGRAPHICS_VSYNC");
     pGraphics->StartVBlankThread(hWnd);
-#else // use WM_TIMER -- its best to get below 16ms because the windows time quanta is slightly above 15ms.
-    int mSec = static_cast<int>(std::floorf(1000.0f / (pGraphics->FPS())));
-    if (mSec < 20) mSec = 15;
-    SetTimer(hWnd, IPLUG_TIMER_ID, mSec, NULL);
+#else
+    SetTimer(hWnd, IPLUG_TIMER_ID, TimerInterval(pGraphics->FPS()), NULL);
 #endif
 
     SetFocus(hWnd); // gets scroll wheel working straight away
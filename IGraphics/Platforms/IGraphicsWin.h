@@ -37,6 +37,7 @@ public:
   int GetPlatformWindowScale() const override { return GetScreenScale(); }
 
   void PlatformResize(bool parentHasResized) override;
+  void PlatformSetFrameRate(int fps) override;
 
 #ifdef IGRAPHICS_GL
   void DrawResize() override; // overriden here to deal with GL graphics context capture
@@ -105,6 +106,9 @@ private:
     * @param vBlankCount will allow redraws to get paced by the vblank message. Passing 0 is a WM_TIMER fallback. */
   void OnDisplayTimer(int vBlankCount = 0);
 
+  /** @return The WM_TIMER interval in milliseconds for a frame rate */
+  static UINT TimerInterval(int fps);
+
   enum EParamEditMsg
   {
     kNone,
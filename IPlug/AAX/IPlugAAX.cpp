@@ -337,6 +337,8 @@ void IPlugAAX::RenderAudio(AAX_SIPlugRenderInfo* pRenderInfo)
       ProcessMidiMsg(msg);
     }
     
+    ProcessDeferredMessages();
+    
     ENTER_PARAMS_MUTEX
     ProcessBuffers(0.0f, numSamples);
     LEAVE_PARAMS_MUTEX
@@ -430,7 +432,7 @@ AAX_Result IPlugAAX::GetChunkSize(AAX_CTypeID chunkID, uint32_t* pSize) const
     
     //IByteChunk::InitChunkWithIPlugVer(&IPlugChunk);
     
-    if (SerializeState(chunk))
+    if (SerializeEncodedState(chunk))
     {
       *pSize = chunk.Size();
     }
@@ -454,7 +456,7 @@ AAX_Result IPlugAAX::GetChunk(AAX_CTypeID chunkID, AAX_SPlugInChunk* pChunk) con
     
     //IByteChunk::InitChunkWithIPlugVer(&IPlugChunk); // TODO: IPlugVer should be in chunk!
     
-    if (SerializeState(chunk))
+    if (SerializeEncodedState(chunk))
     {
       pChunk->fSize = chunk.Size();
       memcpy(pChunk->fData, chunk.GetData(), chunk.Size());
@@ -476,7 +478,7 @@ AAX_Result IPlugAAX::SetChunk(AAX_CTypeID chunkID, const AAX_SPlugInChunk* pChun
     chunk.PutBytes(pChunk->fData, pChunk->fSize);
     int pos = 0;
     //IByteChunk::GetIPlugVerFromChunk(chunk, pos); // TODO: IPlugVer should be in chunk!
-    pos = UnserializeState(chunk, pos);
+    pos = UnserializeEncodedState(chunk, pos);
     
     for (int i = 0; i< NParams(); i++)
       SetParameterNormalizedValue(mParamIDs.Get(i)->Get(), GetParam(i)->GetNormalized());
@@ -141,6 +141,8 @@ void IPlugAPP::AppProcess(double** inputs, double** outputs, int nFrames)
       ProcessMidiMsg(msg);
     }
   }
+  
+  ProcessDeferredMessages();
 
   //Do not handle Sysex messages here - SendSysexMsgFromUI overridden
 
@@ -1418,7 +1418,7 @@ OSStatus IPlugAU::GetState(CFPropertyListRef* ppPropList)
   IByteChunk chunk;
   //InitChunkWithIPlugVer(&IPlugChunk); // TODO: IPlugVer should be in chunk!
 
-  if (SerializeState(chunk))
+  if (SerializeEncodedState(chunk))
   {
     PutDataInDict(pDict, kAUPresetDataKey, &chunk);
   }
@@ -1459,7 +1459,7 @@ OSStatus IPlugAU::SetState(CFPropertyListRef pPropList)
   //  int pos;
   //  IByteChunk::GetIPlugVerFromChunk(chunk, pos)
   
-  if (!UnserializeState(chunk, 0))
+  if (UnserializeEncodedState(chunk, 0) <= 0)
   {
     return kAudioUnitErr_InvalidPropertyValue;
   }
@@ -1693,6 +1693,8 @@ OSStatus IPlugAU::RenderProc(void* pPlug, AudioUnitRenderActionFlags* pFlags, co
       _this->SetChannelConnections(ERoute::kOutput, nConnected, totalNumChans - nConnected, false); // this will disconnect the channels that are on the unconnected buses
     }
 
+    _this->ProcessDeferredMessages();
+
     if (_this->GetBypassed())
     {
       _this->PassThroughBuffers((AudioSampleType) 0, nFrames);
@@ -731,7 +731,7 @@ static AUAudioUnitPreset* NewAUPreset(NSInteger number, NSString* pName)
 
   IByteChunk chunk;
 //  IByteChunk::InitChunkWithIPlugVer(chunk);
-  mPlug->SerializeState(chunk);
+  mPlug->SerializeEncodedState(chunk);
   NSMutableData* pData = [[NSMutableData alloc] init];
   [pData replaceBytesInRange:NSMakeRange (0, chunk.Size()) withBytes:chunk.GetData()];
   [pDict setValue:pData forKey:[NSString stringWithUTF8String: kAUPresetDataKey]];
@@ -749,7 +749,7 @@ static AUAudioUnitPreset* NewAUPreset(NSInteger number, NSString* pName)
   chunk.PutBytes([pData bytes], static_cast<int>([pData length]));
   int pos = 0;
 //  IByteChunk::GetIPlugVerFromChunk(chunk, pos);
-  mPlug->UnserializeState(chunk, pos);
+  mPlug->UnserializeEncodedState(chunk, pos);
 #endif
   
 //  [super setFullState: newFullState]; // this hangs auval
@@ -116,6 +116,8 @@ void IPlugAUv3::ProcessWithEvents(AudioTimeStamp const* pTimestamp, uint32_t fra
     ProcessMidiMsg(midiMsg);
   }
   
+  ProcessDeferredMessages();
+  
   mLastTimeStamp = *pTimestamp;
   AUEventSampleTime now = AUEventSampleTime(pTimestamp->mSampleTime);
   uint32_t framesRemaining = frameCount;
@@ -8,7 +8,17 @@
  ==============================================================================
  */
 
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <type_traits>
+#include <vector>
+
 #include "IPlugPlatform.h"
+#include "IPlugUtilities.h"
+#include "LaneVector.h"
 
 BEGIN_IPLUG_NAMESPACE
 
@@ -308,4 +318,610 @@ private:
   }
 };
 
+/** A bank of ADSR envelopes with the same curves as ADSREnvelope, for running many envelopes (e.g. several per voice for all voices) in lockstep.
+ * Every stage is evaluated as the recurrence env = a * env + b, followed by output = level * (env * mul + add), with coefficients that only change at stage boundaries,
+ * so the per-sample work is the same for every envelope and has no switch on the stage. The envelopes are stored as one array per variable and processed in groups of kLanes,
+ * with the state of a group in SSE2 or NEON registers (see LaneVector.h), or in scalar loops over the lanes on other targets. Groups where every envelope is idle are skipped.
+ * Start(), Release(), Retrigger() and Kill() take a sample offset within the next block, and the block is split at those offsets.
+ * Instead of calling functions on the audio thread, the ends of releases and the resets of retriggers are collected as events, to be read with GetEvents() after ProcessBlock().
+ * One difference to ADSREnvelope: a Release(), Retrigger() or Kill() at the same frame as a Start() releases from 0, where ADSREnvelope releases from its output before the Start().
+ * Apart from Resize(), nothing allocates under normal use, so everything else can be called on the audio thread. */
+template <typename T>
+class ADSREnvelopeBank
+{
+public:
+  using EStage = typename ADSREnvelope<T>::EStage;
+  using Env = ADSREnvelope<T>;
+
+  static constexpr int kLanes = 8;
+
+  /** Events that ADSREnvelope reports through callbacks */
+  enum EEventType
+  {
+    kEndRelease, // the envelope finished releasing and is idle, like ADSREnvelope::SetEndReleaseFunc()
+    kReset       // a retriggered envelope reached zero and restarts its attack, like ADSREnvelope::SetResetFunc()
+  };
+
+  struct Event
+  {
+    int idx;         // the envelope
+    int offset;      // the frame in the block
+    EEventType type;
+  };
+
+  /** @param nEnvelopes The number of envelopes
+   * @param sustainEnabled If \c false, the envelopes are AD envelopes
+   * @param maxCommands The number of Start(), Release(), Retrigger() or Kill() calls with a sample offset that can be queued per block */
+  ADSREnvelopeBank(int nEnvelopes = 0, bool sustainEnabled = true, int maxCommands = 256)
+  : mSustainEnabled(sustainEnabled)
+  {
+    mCommands.reserve(maxCommands);
+    Resize(nEnvelopes);
+  }
+
+  /** Sets the number of envelopes. New envelopes are idle, with the shortest stage times and a sustain level of 1. This allocates */
+  void Resize(int nEnvelopes)
+  {
+    mNEnvelopes = nEnvelopes;
+    const int nPadded = NGroups() * kLanes;
+
+    for (auto v : { &mEnv, &mA, &mB, &mMul, &mAdd, &mLevel, &mDir, &mThresh, &mScalar, &mReleaseLevel, &mNewStartLevel, &mPrevOutput })
+      v->resize(nPadded, T(0));
+
+    mSustain.resize(nPadded, T(1));
+    mAttackIncr.resize(nPadded, T(0));
+    mDecayIncr.resize(nPadded, T(0));
+    mReleaseIncr.resize(nPadded, T(0));
+    mStageTimes.resize(nPadded * 3, T(Env::MIN_ENV_TIME_MS));
+    mStage.resize(nPadded, Env::kIdle);
+    mGroupActive.resize(NGroups(), 0);
+    mEvents.reserve(std::max<size_t>(mEvents.capacity(), nPadded * 4));
+
+    for (auto i = 0; i < nPadded; i++)
+    {
+      mScalar[i] = T(1);
+      UpdateIncrs(i);
+      SetupStage(i, mStage[i]);
+    }
+  }
+
+  int NEnvelopes() const { return mNEnvelopes; }
+
+  /** Sets the sample rate, and recalculates the stage increments of all the envelopes */
+  void SetSampleRate(T sr)
+  {
+    mSampleRate = sr;
+    mEarlyReleaseIncr = CalcIncrFromTimeLinear(Env::EARLY_RELEASE_TIME, sr);
+    mRetriggerReleaseIncr = CalcIncrFromTimeLinear(Env::RETRIGGER_RELEASE_TIME, sr);
+
+    for (auto i = 0; i < mNEnvelopes; i++)
+    {
+      UpdateIncrs(i);
+      SetupStage(i, mStage[i]);
+    }
+  }
+
+  /** Sets the time of a stage of one envelope. If the envelope is in that stage, the new time applies from the next sample, as with ADSREnvelope
+   * @param idx The envelope
+   * @param stage kAttack, kDecay or kRelease
+   * @param timeMS The time in milliseconds */
+  void SetStageTime(int idx, int stage, T timeMS)
+  {
+    if (stage < Env::kAttack || stage > Env::kRelease || stage == Env::kSustain)
+      return;
+
+    mStageTimes[idx * 3 + (stage == Env::kRelease ? 2 : stage)] = Clip(timeMS, Env::MIN_ENV_TIME_MS, Env::MAX_ENV_TIME_MS);
+    UpdateIncrs(idx);
+
+    if (mStage[idx] == stage)
+      SetupStage(idx, stage);
+  }
+
+  /** Sets the time of a stage of all the envelopes */
+  void SetStageTime(int stage, T timeMS)
+  {
+    for (auto i = 0; i < mNEnvelopes; i++)
+      SetStageTime(i, stage, timeMS);
+  }
+
+  /** Sets the sustain level of an envelope, which applies from the next sample. To avoid discontinuities, change it in small steps, e.g. with a SmootherBank */
+  void SetSustainLevel(int idx, T sustainLevel)
+  {
+    mSustain[idx] = sustainLevel;
+
+    if (mStage[idx] == Env::kDecay || mStage[idx] == Env::kSustain)
+      SetupStage(idx, mStage[idx]);
+  }
+
+  /** Sets the sustain level of all the envelopes */
+  void SetSustainLevel(T sustainLevel)
+  {
+    for (auto i = 0; i < mNEnvelopes; i++)
+      SetSustainLevel(i, sustainLevel);
+  }
+
+  /** Triggers an envelope, see ADSREnvelope::Start()
+   * @param sampleOffset The frame within the next ProcessBlock() at which this happens. Offsets beyond that block carry over to later blocks */
+  void Start(int idx, T level, T timeScalar = 1., int sampleOffset = 0) { Command(idx, kCommandStart, level, timeScalar, sampleOffset); }
+
+  /** Releases an envelope, see ADSREnvelope::Release() */
+  void Release(int idx, int sampleOffset = 0) { Command(idx, kCommandRelease, T(0), T(1), sampleOffset); }
+
+  /** Retriggers an envelope, see ADSREnvelope::Retrigger(). A kReset event is reported when it restarts */
+  void Retrigger(int idx, T newStartLevel, T timeScalar = 1., int sampleOffset = 0) { Command(idx, kCommandRetrigger, newStartLevel, timeScalar, sampleOffset); }
+
+  /** Kills an envelope, see ADSREnvelope::Kill() */
+  void Kill(int idx, bool hard, int sampleOffset = 0) { Command(idx, hard ? kCommandHardKill : kCommandSoftKill, T(0), T(1), sampleOffset); }
+
+  /** @return /c true if the envelope is not idle */
+  bool GetBusy(int idx) const { return mStage[idx] != Env::kIdle; }
+
+  int GetStage(int idx) const { return mStage[idx]; }
+
+  /** @return The last output of an envelope */
+  T GetPrevOutput(int idx) const { return mPrevOutput[idx]; }
+
+  /** @return The events of the last ProcessBlock(), in order of their offset for each envelope */
+  const std::vector<Event>& GetEvents() const { return mEvents; }
+
+  /** Processes a block
+   * @param nFrames The number of frames
+   * @param outputs An array of NEnvelopes() buffers, each of nFrames */
+  void ProcessBlock(int nFrames, T** outputs)
+  {
+    mEvents.clear();
+
+    // insertion sort, stable so that several commands for an envelope at the same offset apply in order
+    for (size_t i = 1; i < mCommands.size(); i++)
+    {
+      for (size_t j = i; j > 0 && mCommands[j - 1].offset > mCommands[j].offset; j--)
+        std::swap(mCommands[j - 1], mCommands[j]);
+    }
+
+    size_t next = 0;
+    int pos = 0;
+
+    while (pos < nFrames)
+    {
+      while (next < mCommands.size() && mCommands[next].offset <= pos)
+      {
+        ApplyCommand(mCommands[next]);
+        next++;
+      }
+
+      const int end = next < mCommands.size() ? std::min(mCommands[next].offset, nFrames) : nFrames;
+
+      for (auto g = 0; g < NGroups(); g++)
+        ProcessGroup(g, pos, end - pos, outputs);
+
+      pos = end;
+    }
+
+    // commands beyond this block carry over
+    size_t kept = 0;
+
+    for (; next < mCommands.size(); next++)
+    {
+      mCommands[kept] = mCommands[next];
+      mCommands[kept++].offset -= nFrames;
+    }
+
+    mCommands.resize(kept);
+  }
+
+private:
+  enum ECommandType
+  {
+    kCommandStart,
+    kCommandRelease,
+    kCommandRetrigger,
+    kCommandHardKill,
+    kCommandSoftKill
+  };
+
+  struct CommandData
+  {
+    int idx;
+    int offset;
+    ECommandType type;
+    T level;
+    T timeScalar;
+  };
+
+  int NGroups() const { return (mNEnvelopes + kLanes - 1) / kLanes; }
+
+  void Command(int idx, ECommandType type, T level, T timeScalar, int sampleOffset)
+  {
+    const CommandData command { idx, sampleOffset, type, level, timeScalar };
+
+    if (sampleOffset <= 0 || mCommands.size() == mCommands.capacity())
+      ApplyCommand(command);
+    else
+      mCommands.push_back(command);
+  }
+
+  /** @return The envelope value before the level is applied, the equivalent of ADSREnvelope's mPrevResult */
+  T PrevResult(int idx) const { return mEnv[idx] * mMul[idx] + mAdd[idx]; }
+
+  void ApplyCommand(const CommandData& command)
+  {
+    const int i = command.idx;
+
+    switch (command.type)
+    {
+      case kCommandStart:
+        mEnv[i] = T(0);
+        mLevel[i] = command.level;
+        mScalar[i] = T(1) / command.timeScalar;
+        SetupStage(i, Env::kAttack);
+        break;
+      case kCommandRelease:
+        mReleaseLevel[i] = PrevResult(i);
+        mEnv[i] = T(1);
+        SetupStage(i, Env::kRelease);
+        break;
+      case kCommandRetrigger:
+        mReleaseLevel[i] = PrevResult(i);
+        mEnv[i] = T(1);
+        mNewStartLevel[i] = command.level;
+        mScalar[i] = T(1) / command.timeScalar;
+        SetupStage(i, Env::kReleasedToRetrigger);
+        break;
+      case kCommandHardKill:
+        if (mStage[i] != Env::kIdle)
+        {
+          mReleaseLevel[i] = T(0);
+          mEnv[i] = T(0);
+          SetupStage(i, Env::kIdle);
+        }
+        break;
+      case kCommandSoftKill:
+        if (mStage[i] != Env::kIdle)
+        {
+          mReleaseLevel[i] = PrevResult(i);
+          mEnv[i] = T(1);
+          SetupStage(i, Env::kReleasedToEndEarly);
+        }
+        break;
+    }
+
+    mGroupActive[i / kLanes] = 1;
+  }
+
+  void UpdateIncrs(int idx)
+  {
+    mAttackIncr[idx] = CalcIncrFromTimeLinear(mStageTimes[idx * 3], mSampleRate);
+    mDecayIncr[idx] = CalcIncrFromTimeExp(mStageTimes[idx * 3 + 1], mSampleRate);
+    mReleaseIncr[idx] = CalcIncrFromTimeExp(mStageTimes[idx * 3 + 2], mSampleRate);
+  }
+
+  /** Sets the recurrence, output mapping and end condition of a stage. A stage ends on the sample where dir * (env - thresh) > 0 */
+  void SetupStage(int i, int stage)
+  {
+    T a = T(1), b = T(0), mul = T(0), add = T(0), dir = T(0), thresh = T(0);
+
+    switch (stage)
+    {
+      case Env::kAttack:
+        b = mAttackIncr[i] * mScalar[i];
+        mul = T(1);
+        dir = T(1);
+        thresh = mAttackIncr[i] == T(0) ? T(-1) : Env::ENV_VALUE_HIGH; // a zero attack time ends straight away
+        break;
+      case Env::kDecay:
+        a = T(1) - mDecayIncr[i] * mScalar[i];
+        mul = T(1) - mSustain[i];
+        add = mSustain[i];
+        dir = T(-1);
+        thresh = Env::ENV_VALUE_LOW;
+        break;
+      case Env::kSustain:
+        add = mSustain[i];
+        break;
+      case Env::kRelease:
+        a = T(1) - mReleaseIncr[i] * mScalar[i];
+        mul = mReleaseLevel[i];
+        dir = T(-1);
+        thresh = mReleaseIncr[i] == T(0) ? T(2) : Env::ENV_VALUE_LOW; // a zero release time ends straight away
+        break;
+      case Env::kReleasedToRetrigger:
+        b = -mRetriggerReleaseIncr;
+        mul = mReleaseLevel[i];
+        dir = T(-1);
+        thresh = Env::ENV_VALUE_LOW;
+        break;
+      case Env::kReleasedToEndEarly:
+        b = -mEarlyReleaseIncr;
+        mul = mReleaseLevel[i];
+        dir = T(-1);
+        thresh = Env::ENV_VALUE_LOW;
+        break;
+      default: // idle
+        break;
+    }
+
+    mStage[i] = stage;
+    mA[i] = a;
+    mB[i] = b;
+    mMul[i] = mul;
+    mAdd[i] = add;
+    mDir[i] = dir;
+    mThresh[i] = thresh;
+  }
+
+  /** Moves an envelope whose stage just ended on to the next stage, as ADSREnvelope::Process() does */
+  void EndStage(int i, int offset)
+  {
+    switch (mStage[i])
+    {
+      case Env::kAttack:
+        mEnv[i] = T(1);
+        SetupStage(i, Env::kDecay);
+        break;
+      case Env::kDecay:
+        if (mSustainEnabled)
+        {
+          mEnv[i] = T(1);
+          SetupStage(i, Env::kSustain);
+        }
+        else
+        {
+          mReleaseLevel[i] = PrevResult(i);
+          mEnv[i] = T(1);
+          SetupStage(i, Env::kRelease);
+        }
+        break;
+      case Env::kReleasedToRetrigger:
+        mLevel[i] = mNewStartLevel[i];
+        mEnv[i] = T(0);
+        mReleaseLevel[i] = T(0);
+        SetupStage(i, Env::kAttack);
+        mEvents.push_back({ i, offset, kReset });
+        break;
+      case Env::kRelease:
+      case Env::kReleasedToEndEarly:
+        if (mStage[i] == Env::kReleasedToEndEarly)
+          mLevel[i] = T(0);
+
+        mEnv[i] = T(0);
+        mReleaseLevel[i] = T(0);
+        SetupStage(i, Env::kIdle);
+        mEvents.push_back({ i, offset, kEndRelease }); // mEvents is reserved for several events per envelope, so this only allocates in extreme cases
+        break;
+      default:
+        break;
+    }
+  }
+
+  void ProcessGroup(int group, int offset, int nFrames, T** outputs)
+  {
+    const int base = group * kLanes;
+    const int nLanes = std::min(kLanes, mNEnvelopes - base);
+
+    if (!mGroupActive[group])
+    {
+      for (auto l = 0; l < nLanes; l++)
+        std::fill(outputs[base + l] + offset, outputs[base + l] + offset + nFrames, T(0));
+
+      return;
+    }
+
+    ProcessLanes(std::integral_constant<bool, LaneVector<T>::kAvailable>(), base, nLanes, offset, nFrames, outputs);
+
+    bool busy = false;
+
+    for (auto l = 0; l < kLanes; l++)
+      busy |= mStage[base + l] != Env::kIdle;
+
+    mGroupActive[group] = busy;
+  }
+
+  /** Handles the envelopes of a group whose stage ended on this sample, mEnv holds the values of the sample */
+  void EndStages(int base, int nLanes, int offset)
+  {
+    for (auto l = 0; l < nLanes; l++)
+    {
+      const int i = base + l;
+
+      if (mDir[i] * (mEnv[i] - mThresh[i]) > T(0))
+        EndStage(i, offset);
+    }
+  }
+
+  /** The lanes of a group with scalar loops, for types without a LaneVector */
+  void ProcessLanes(std::false_type, int base, int nLanes, int offset, int nFrames, T** outputs)
+  {
+    T env[kLanes], a[kLanes], b[kLanes], mul[kLanes], add[kLanes], level[kLanes], dir[kLanes], thresh[kLanes], out[kLanes];
+
+    auto load = [&]() {
+      for (auto l = 0; l < kLanes; l++)
+      {
+        env[l] = mEnv[base + l];
+        a[l] = mA[base + l];
+        b[l] = mB[base + l];
+        mul[l] = mMul[base + l];
+        add[l] = mAdd[base + l];
+        level[l] = mLevel[base + l];
+        dir[l] = mDir[base + l];
+        thresh[l] = mThresh[base + l];
+      }
+    };
+
+    load();
+
+    for (auto l = 0; l < kLanes; l++)
+      out[l] = mPrevOutput[base + l];
+
+    for (auto s = 0; s < nFrames; s++)
+    {
+      int ended = 0;
+
+      for (auto l = 0; l < kLanes; l++)
+      {
+        env[l] = a[l] * env[l] + b[l];
+        ended |= dir[l] * (env[l] - thresh[l]) > T(0);
+      }
+
+      // stage ends are rare, so they are found for the group as a whole and then handled lane by lane
+      if (ended)
+      {
+        std::copy(env, env + kLanes, mEnv.begin() + base);
+        EndStages(base, nLanes, offset + s);
+        load();
+      }
+
+      for (auto l = 0; l < kLanes; l++)
+        out[l] = level[l] * (env[l] * mul[l] + add[l]);
+
+      for (auto l = 0; l < nLanes; l++)
+        outputs[base + l][offset + s] = out[l];
+    }
+
+    std::copy(env, env + kLanes, mEnv.begin() + base);
+    std::copy(out, out + kLanes, mPrevOutput.begin() + base);
+  }
+
+  /** The lanes of a group with the state in vector registers, with the same arithmetic as the scalar loops, so both give the same output */
+  void ProcessLanes(std::true_type, int base, int nLanes, int offset, int nFrames, T** outputs)
+  {
+    using Vec = LaneVector<T>;
+    using V = typename Vec::V;
+    static constexpr int kWidth = Vec::kWidth;
+    static constexpr int kNVectors = kLanes / kWidth;
+    static_assert(kLanes % kWidth == 0, "kLanes must be a multiple of the vector width");
+
+    V env[kNVectors], a[kNVectors], b[kNVectors], mul[kNVectors], add[kNVectors], level[kNVectors], dir[kNVectors], thresh[kNVectors], out[kNVectors];
+    const V zero = Vec::Splat(T(0));
+
+    auto load = [&]() {
+      for (auto v = 0; v < kNVectors; v++)
+      {
+        const int i = base + v * kWidth;
+        env[v] = Vec::Load(&mEnv[i]);
+        a[v] = Vec::Load(&mA[i]);
+        b[v] = Vec::Load(&mB[i]);
+        mul[v] = Vec::Load(&mMul[i]);
+        add[v] = Vec::Load(&mAdd[i]);
+        level[v] = Vec::Load(&mLevel[i]);
+        dir[v] = Vec::Load(&mDir[i]);
+        thresh[v] = Vec::Load(&mThresh[i]);
+      }
+    };
+
+    auto tick = [&](int s) {
+      V ended = zero;
+
+      for (auto v = 0; v < kNVectors; v++)
+      {
+        env[v] = Vec::Add(Vec::Mul(a[v], env[v]), b[v]);
+        ended = Vec::Max(ended, Vec::Mul(dir[v], Vec::Sub(env[v], thresh[v])));
+      }
+
+      // stage ends are rare, so they are found for the group as a whole and then handled lane by lane
+      if (Vec::AnyGreater(ended, zero))
+      {
+        for (auto v = 0; v < kNVectors; v++)
+          Vec::Store(&mEnv[base + v * kWidth], env[v]);
+
+        EndStages(base, nLanes, offset + s);
+        load();
+      }
+
+      for (auto v = 0; v < kNVectors; v++)
+        out[v] = Vec::Mul(level[v], Vec::Add(Vec::Mul(env[v], mul[v]), add[v]));
+    };
+
+    load();
+
+    for (auto v = 0; v < kNVectors; v++)
+      out[v] = Vec::Load(&mPrevOutput[base + v * kWidth]);
+
+    int s = 0;
+
+    // a full group stores kWidth frames at a time, transposed so that each envelope's buffer gets whole vectors
+    if (nLanes == kLanes)
+    {
+      for (; s + kWidth <= nFrames; s += kWidth)
+      {
+        V frames[kNVectors][kWidth];
+
+        for (auto f = 0; f < kWidth; f++)
+        {
+          tick(s + f);
+
+          for (auto v = 0; v < kNVectors; v++)
+            frames[v][f] = out[v];
+        }
+
+        for (auto v = 0; v < kNVectors; v++)
+        {
+          Vec::Transpose(frames[v]);
+
+          for (auto l = 0; l < kWidth; l++)
+            Vec::Store(outputs[base + v * kWidth + l] + offset + s, frames[v][l]);
+        }
+      }
+    }
+
+    for (; s < nFrames; s++)
+    {
+      tick(s);
+
+      T frame[kLanes];
+
+      for (auto v = 0; v < kNVectors; v++)
+        Vec::Store(frame + v * kWidth, out[v]);
+
+      for (auto l = 0; l < nLanes; l++)
+        outputs[base + l][offset + s] = frame[l];
+    }
+
+    for (auto v = 0; v < kNVectors; v++)
+    {
+      Vec::Store(&mEnv[base + v * kWidth], env[v]);
+      Vec::Store(&mPrevOutput[base + v * kWidth], out[v]);
+    }
+  }
+
+  static T CalcIncrFromTimeLinear(T timeMS, T sr)
+  {
+    if (timeMS <= 0.) return 0.;
+    else return (1./sr) / (timeMS/1000.);
+  }
+
+  static T CalcIncrFromTimeExp(T timeMS, T sr)
+  {
+    if (timeMS <= 0.0) return 0.;
+
+    T r = -std::expm1(1000.0 * std::log(0.001) / (sr * timeMS));
+    if (!(r < 1.0)) r = 1.0;
+
+    return r;
+  }
+
+  bool mSustainEnabled;
+  int mNEnvelopes = 0;
+  T mSampleRate = 44100.;
+  T mEarlyReleaseIncr = CalcIncrFromTimeLinear(Env::EARLY_RELEASE_TIME, 44100.);
+  T mRetriggerReleaseIncr = CalcIncrFromTimeLinear(Env::RETRIGGER_RELEASE_TIME, 44100.);
+
+  // one array per variable, padded to a multiple of kLanes
+  std::vector<T> mEnv;          // the normalized value, as ADSREnvelope's mEnvValue
+  std::vector<T> mA, mB;        // the recurrence of the current stage
+  std::vector<T> mMul, mAdd;    // maps mEnv to the result of the current stage
+  std::vector<T> mLevel;
+  std::vector<T> mDir, mThresh; // the end condition of the current stage
+  std::vector<T> mScalar;
+  std::vector<T> mReleaseLevel;
+  std::vector<T> mNewStartLevel;
+  std::vector<T> mSustain;
+  std::vector<T> mPrevOutput;
+  std::vector<T> mAttackIncr, mDecayIncr, mReleaseIncr;
+  std::vector<T> mStageTimes;   // attack, decay and release time of each envelope
+  std::vector<int> mStage;
+  std::vector<uint8_t> mGroupActive;
+  std::vector<CommandData> mCommands;
+  std::vector<Event> mEvents;
+};
+
 END_IPLUG_NAMESPACE
@@ -0,0 +1,567 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "IPlugEEL.h"
+#include "mutex.h"
+
+using namespace iplug;
+
+#ifndef IPLUG_EEL_NO_HOSTSTUBS
+// VMs without their own GRAM share the global gmem[], the compiler calls these when accessing it.
+// Define IPLUG_EEL_NO_HOSTSTUBS if your project already implements them
+static WDL_Mutex sEELMutex;
+void NSEEL_HOSTSTUB_EnterMutex() { sEELMutex.Enter(); }
+void NSEEL_HOSTSTUB_LeaveMutex() { sEELMutex.Leave(); }
+#endif
+
+// the block mode I/O buffer lives in the last 8 blocks of the default VM memory, out of the way of the script's own use of memory
+static constexpr int kIOBlocks = 8;
+static constexpr int kIOOffset = (NSEEL_RAM_BLOCKS_DEFAULTMAX - kIOBlocks) * NSEEL_RAM_ITEMSPERBLOCK;
+
+enum ESection { kHeader = 0, kInit, kSlider, kBlock, kSample, kProcess, kNumSections, kIgnoredSection = kNumSections };
+
+IPlugEEL::Program::~Program()
+{
+  for (auto code : { mProcess, mSample, mBlock, mSlider, mInit })
+  {
+    if (code)
+      NSEEL_code_free(code);
+  }
+
+  if (mVM)
+    NSEEL_VM_free(mVM);
+}
+
+IPlugEEL::IPlugEEL(const char* name, int maxNChans)
+: mMaxNChans(std::min(maxNChans, static_cast<int>(kMaxChannels)))
+, mSliderValues(new std::atomic<double>[kMaxSliders])
+{
+  mName.Set(name);
+
+  for (auto i = 0; i < kMaxSliders; i++)
+    mSliderValues[i].store(0.);
+}
+
+IPlugEEL::~IPlugEEL()
+{
+  delete mActive;
+  delete mPending.exchange(nullptr);
+  delete mRetired.exchange(nullptr);
+  delete mPendingSliders.exchange(nullptr);
+}
+
+bool IPlugEEL::ParseSlider(const char* line, int& sliderNum, Slider& slider)
+{
+  // sliderN:[var=]default<min,max[,step]>Label
+  if (strncmp(line, "slider", 6) != 0 || !isdigit(line[6]))
+    return false;
+
+  char* pEnd = nullptr;
+  sliderNum = static_cast<int>(strtol(line + 6, &pEnd, 10));
+
+  if (*pEnd != ':' || sliderNum < 1 || sliderNum > kMaxSliders)
+    return false;
+
+  const char* p = pEnd + 1;
+  const char* pEq = strchr(p, '=');
+  const char* pLT = strchr(p, '<');
+
+  if (pEq && (!pLT || pEq < pLT))
+  {
+    slider.mVar.Set(p, static_cast<int>(pEq - p));
+    p = pEq + 1;
+  }
+  else
+    slider.mVar.SetFormatted(32, "slider%i", sliderNum);
+
+  slider.mDefault = strtod(p, &pEnd);
+  p = pEnd;
+
+  if (*p == '<')
+  {
+    slider.mMin = strtod(p + 1, &pEnd);
+    p = pEnd;
+
+    if (*p == ',')
+    {
+      slider.mMax = strtod(p + 1, &pEnd);
+      p = pEnd;
+    }
+
+    if (*p == ',')
+    {
+      slider.mStep = strtod(p + 1, &pEnd);
+      p = pEnd;
+    }
+
+    p = strchr(p, '>');
+    p = p ? p + 1 : "";
+  }
+
+  while (*p == ' ' || *p == '\t')
+    p++;
+
+  slider.mLabel.Set(*p ? p : slider.mVar.Get());
+
+  int len = slider.mLabel.GetLength();
+  while (len > 0 && isspace(static_cast<unsigned char>(slider.mLabel.Get()[len - 1])))
+    slider.mLabel.SetLen(--len);
+
+  return slider.mVar.GetLength() > 0;
+}
+
+bool IPlugEEL::Compile(const char* script, WDL_String& error)
+{
+  std::vector<Slider> sliders;
+  WDL_String sections[kNumSections + 1];
+  int lineOffsets[kNumSections + 1] = {};
+  int section = kHeader;
+  int lineNum = 0;
+
+  // split the script into lines and sections
+  for (const char* pLine = script; pLine && *pLine; lineNum++)
+  {
+    const char* pEOL = strchr(pLine, '\n');
+    const int len = pEOL ? static_cast<int>(pEOL - pLine) : static_cast<int>(strlen(pLine));
+    WDL_String line;
+    line.Set(pLine, len);
+    pLine = pEOL ? pEOL + 1 : nullptr;
+
+    if (line.Get()[0] == '@')
+    {
+      const char* pName = line.Get() + 1;
+      auto is = [pName](const char* name) { const size_t n = strlen(name); return !strncmp(pName, name, n) && !isalnum(static_cast<unsigned char>(pName[n])); };
+
+      section = is("init") ? kInit : is("slider") ? kSlider : is("block") ? kBlock : is("sample") ? kSample : is("process") ? kProcess : kIgnoredSection;
+      lineOffsets[section] = lineNum + 1;
+      continue;
+    }
+
+    if (section == kHeader)
+    {
+      int sliderNum;
+      Slider slider;
+
+      if (ParseSlider(line.Get(), sliderNum, slider))
+      {
+        if (sliderNum > static_cast<int>(sliders.size()))
+          sliders.resize(sliderNum);
+
+        sliders[sliderNum - 1] = slider;
+      }
+    }
+    else
+    {
+      sections[section].Append(line.Get());
+      sections[section].Append("\n");
+    }
+  }
+
+  for (auto& slider : sliders)
+  {
+    if (!slider.mVar.GetLength()) // gaps in the slider numbers
+      slider.mVar.SetFormatted(32, "slider%i", static_cast<int>(&slider - sliders.data()) + 1);
+  }
+
+  std::unique_ptr<Program> pProgram(new Program());
+
+  if (!Build(*pProgram, sliders, sections, lineOffsets, error))
+    return false;
+
+  // values are kept for sliders that still exist, the IParams are updated by the main thread, see TakePendingSliders()
+  const int nOldSliders = mNCompiledSliders;
+  mNCompiledSliders = static_cast<int>(sliders.size());
+
+  for (auto i = 0; i < mNCompiledSliders; i++)
+  {
+    const Slider& slider = sliders[i];
+    const double value = mSliderValues[i].load();
+
+    if (i >= nOldSliders || value < slider.mMin || value > slider.mMax)
+      mSliderValues[i].store(slider.mDefault);
+  }
+
+  // run @init and @slider here rather than on the audio thread
+  *pProgram->mSrate = mSampleRate.load();
+  *pProgram->mNumCh = mMaxNChans;
+  PrepareIO(*pProgram);
+
+  if (pProgram->mInit)
+    NSEEL_code_execute(pProgram->mInit);
+
+  ApplySliders(*pProgram, ~0ull);
+
+  CollectGarbage();
+  delete mPending.exchange(pProgram.release());
+  delete mPendingSliders.exchange(new std::vector<Slider>(std::move(sliders)));
+
+  error.Set("");
+  return true;
+}
+
+bool IPlugEEL::CompileFile(const char* path, WDL_String& error)
+{
+  FILE* fp = fopen(path, "rb");
+
+  if (!fp)
+  {
+    error.SetFormatted(MAX_WIN32_PATH_LEN + 32, "IPlugEEL-%s:: could not open %s", mName.Get(), path);
+    return false;
+  }
+
+  fseek(fp, 0, SEEK_END);
+  const long size = ftell(fp);
+  fseek(fp, 0, SEEK_SET);
+
+  WDL_String script;
+  script.SetLen(static_cast<int>(size));
+  const size_t nRead = fread(script.Get(), 1, size, fp);
+  fclose(fp);
+  script.SetLen(static_cast<int>(nRead));
+
+  return Compile(script.Get(), error);
+}
+
+bool IPlugEEL::Build(Program& program, const std::vector<Slider>& sliders, const WDL_String* sections, const int* lineOffsets, WDL_String& error)
+{
+  program.mVM = NSEEL_VM_alloc();
+
+  if (!program.mVM)
+  {
+    error.Set("could not allocate an EEL VM");
+    return false;
+  }
+
+  // register the variables before compiling, so that the code references them directly
+  for (auto c = 0; c < kMaxChannels; c++)
+  {
+    char name[16];
+    snprintf(name, sizeof(name), "spl%i", c);
+    program.mSpl[c] = NSEEL_VM_regvar(program.mVM, name);
+  }
+
+  program.mNSliders = static_cast<int>(sliders.size());
+
+  for (auto i = 0; i < program.mNSliders; i++)
+    program.mSliderVars[i] = NSEEL_VM_regvar(program.mVM, sliders[i].mVar.Get());
+
+  program.mSrate = NSEEL_VM_regvar(program.mVM, "srate");
+  program.mNumCh = NSEEL_VM_regvar(program.mVM, "num_ch");
+  program.mSamplesBlock = NSEEL_VM_regvar(program.mVM, "samplesblock");
+  program.mNFrames = NSEEL_VM_regvar(program.mVM, "nframes");
+  program.mMaxFrames = NSEEL_VM_regvar(program.mVM, "maxframes");
+  program.mIO = NSEEL_VM_regvar(program.mVM, "io");
+
+  ReserveIO(program);
+
+  NSEEL_CODEHANDLE* codes[kNumSections] = { nullptr, &program.mInit, &program.mSlider, &program.mBlock, &program.mSample, &program.mProcess };
+  static const char* names[kNumSections] = { "", "@init", "@slider", "@block", "@sample", "@process" };
+
+  for (auto s = static_cast<int>(kInit); s < kNumSections; s++)
+  {
+    const char* pCode = sections[s].Get();
+
+    while (*pCode && isspace(static_cast<unsigned char>(*pCode)))
+      pCode++;
+
+    if (!*pCode)
+      continue;
+
+    // common functions, so that functions defined in @init can be called from the other sections
+    *codes[s] = NSEEL_code_compile_ex(program.mVM, sections[s].Get(), lineOffsets[s], NSEEL_CODE_COMPILE_FLAG_COMMONFUNCS);
+
+    if (!*codes[s])
+    {
+      const char* pErr = NSEEL_code_getcodeerror(program.mVM);
+      error.SetFormatted(1024, "%s: %s", names[s], pErr ? pErr : "compile error");
+      return false;
+    }
+  }
+
+  return true;
+}
+
+void IPlugEEL::ReserveIO(Program& program)
+{
+  // allocate the whole I/O buffer when the program is built, so that nothing is allocated on the audio thread when the block size changes
+  for (int offset = 0; offset < kIOBlocks * NSEEL_RAM_ITEMSPERBLOCK;)
+  {
+    int valid = 0;
+
+    if (!NSEEL_VM_getramptr(program.mVM, kIOOffset + offset, &valid) || valid <= 0)
+      break;
+
+    offset += valid;
+  }
+}
+
+int IPlugEEL::MaxIOFrames() const
+{
+  return std::max(1, std::min(mMaxBlockSize.load(), kIOBlocks * NSEEL_RAM_ITEMSPERBLOCK / mMaxNChans));
+}
+
+void IPlugEEL::PrepareIO(Program& program)
+{
+  // longer blocks are processed in several calls, see ProcessBlock()
+  const int maxFrames = MaxIOFrames();
+
+  *program.mIO = kIOOffset;
+  *program.mMaxFrames = maxFrames;
+}
+
+void IPlugEEL::ApplySliders(Program& program, uint64_t changes)
+{
+  bool changed = false;
+
+  for (auto i = 0; i < program.mNSliders; i++)
+  {
+    if (changes & (1ull << i))
+    {
+      *program.mSliderVars[i] = mSliderValues[i].load(std::memory_order_relaxed);
+      changed = true;
+    }
+  }
+
+  if (changed && program.mSlider)
+    NSEEL_code_execute(program.mSlider);
+}
+
+void IPlugEEL::CopyToRAM(Program& program, int offset, const sample* pSrc, int n)
+{
+  for (int done = 0; done < n;)
+  {
+    int valid = 0;
+    EEL_F* pRAM = NSEEL_VM_getramptr_noalloc(program.mVM, offset + done, &valid);
+
+    if (!pRAM || valid <= 0)
+      return;
+
+    const int count = std::min(valid, n - done);
+
+    for (auto i = 0; i < count; i++)
+      pRAM[i] = static_cast<EEL_F>(pSrc[done + i]);
+
+    done += count;
+  }
+}
+
+void IPlugEEL::CopyFromRAM(Program& program, int offset, sample* pDest, int n)
+{
+  for (int done = 0; done < n;)
+  {
+    int valid = 0;
+    EEL_F* pRAM = NSEEL_VM_getramptr_noalloc(program.mVM, offset + done, &valid);
+
+    if (!pRAM || valid <= 0)
+    {
+      memset(pDest + done, 0, (n - done) * sizeof(sample));
+      return;
+    }
+
+    const int count = std::min(valid, n - done);
+
+    for (auto i = 0; i < count; i++)
+      pDest[done + i] = static_cast<sample>(pRAM[i]);
+
+    done += count;
+  }
+}
+
+void IPlugEEL::CollectGarbage()
+{
+  delete mRetired.exchange(nullptr);
+}
+
+bool IPlugEEL::TakePendingSliders()
+{
+  std::unique_ptr<std::vector<Slider>> pSliders(mPendingSliders.exchange(nullptr));
+
+  if (!pSliders)
+    return false;
+
+  mParams.resize(pSliders->size());
+
+  for (auto i = 0; i < NParams(); i++)
+  {
+    const Slider& slider = (*pSliders)[i];
+
+    if (!mParams[i])
+      mParams[i] = std::make_unique<IParam>();
+
+    mParams[i]->InitDouble(slider.mLabel.Get(), slider.mDefault, slider.mMin, slider.mMax, slider.mStep > 0. ? slider.mStep : 0.001);
+    mParams[i]->Set(mSliderValues[i].load());
+  }
+
+  return true;
+}
+
+bool IPlugEEL::OnIdle()
+{
+  const bool changed = TakePendingSliders();
+
+  if (changed && mPlug && mIPlugParamStartIdx > -1)
+    CreateIPlugParameters(mPlug, mIPlugParamStartIdx, false);
+
+  CollectGarbage();
+  return changed;
+}
+
+void IPlugEEL::SetSampleRate(double sampleRate, int maxBlockSize)
+{
+  mSampleRate.store(sampleRate);
+  mMaxBlockSize.store(maxBlockSize);
+  mReinit.store(true);
+}
+
+int IPlugEEL::CreateIPlugParameters(IPlugAPIBase* pPlug, int startIdx, bool setToDefault)
+{
+  assert(pPlug != nullptr);
+
+  mPlug = pPlug;
+  mIPlugParamStartIdx = startIdx;
+  TakePendingSliders();
+
+  if (NParams() == 0)
+    return -1;
+
+  // the audio thread may be using the plug-in's parameters, and Init() replaces their shapes
+#ifdef PARAMS_MUTEX
+  WDL_MutexLock lock(&pPlug->mParams_mutex);
+#endif
+
+  for (auto p = 0; p < NParams(); p++)
+  {
+    assert(startIdx + p < pPlug->NParams()); // plugin needs to have enough params!
+
+    IParam* pParam = pPlug->GetParam(startIdx + p);
+    const double currentValueNormalised = pParam->GetNormalized();
+    pParam->Init(*mParams[p]);
+
+    if (setToDefault)
+      pParam->SetToDefault();
+    else
+      pParam->SetNormalized(currentValueNormalised);
+
+    SetParameterValue(p, pParam->Value());
+  }
+
+  return startIdx;
+}
+
+void IPlugEEL::SetParameterValue(int paramIdx, double value)
+{
+  if (paramIdx < 0 || paramIdx >= kMaxSliders)
+  {
+    DBGMSG("IPlugEEL-%s:: No parameter %i\n", mName.Get(), paramIdx);
+    return;
+  }
+
+  mSliderValues[paramIdx].store(value, std::memory_order_relaxed);
+  mSliderChanges.fetch_or(1ull << paramIdx, std::memory_order_release);
+}
+
+void IPlugEEL::ProcessBlock(sample** inputs, sample** outputs, int nFrames)
+{
+  // swap in a new program, unless the previous one has not been freed yet
+  if (mPending.load(std::memory_order_acquire) && !mRetired.load(std::memory_order_acquire))
+  {
+    Program* pNew = mPending.exchange(nullptr, std::memory_order_acq_rel);
+
+    if (pNew)
+    {
+      mRetired.store(mActive, std::memory_order_release);
+      mActive = pNew;
+
+      if (*mActive->mSrate != mSampleRate.load() || *mActive->mMaxFrames != MaxIOFrames())
+        mReinit.store(true);
+    }
+  }
+
+  Program* pProgram = mActive;
+  const int nChans = mMaxNChans;
+
+  if (!pProgram)
+  {
+    for (auto c = 0; c < nChans; c++)
+    {
+      if (outputs[c] != inputs[c])
+        memcpy(outputs[c], inputs[c], nFrames * sizeof(sample));
+    }
+
+    return;
+  }
+
+  uint64_t changes = mSliderChanges.exchange(0, std::memory_order_acquire);
+
+  if (mReinit.exchange(false))
+  {
+    *pProgram->mSrate = mSampleRate.load();
+    PrepareIO(*pProgram);
+
+    if (pProgram->mInit)
+      NSEEL_code_execute(pProgram->mInit);
+
+    changes = ~0ull;
+  }
+
+  ApplySliders(*pProgram, changes);
+
+  *pProgram->mNumCh = nChans;
+  *pProgram->mSamplesBlock = nFrames;
+
+  if (pProgram->mBlock)
+    NSEEL_code_execute(pProgram->mBlock);
+
+  if (pProgram->mProcess)
+  {
+    const int io = static_cast<int>(*pProgram->mIO);
+    const int maxFrames = static_cast<int>(*pProgram->mMaxFrames);
+
+    for (auto start = 0; start < nFrames; start += maxFrames)
+    {
+      const int n = std::min(nFrames - start, maxFrames);
+
+      for (auto c = 0; c < nChans; c++)
+        CopyToRAM(*pProgram, io + c * maxFrames, inputs[c] + start, n);
+
+      *pProgram->mNFrames = n;
+      NSEEL_code_execute(pProgram->mProcess);
+
+      for (auto c = 0; c < nChans; c++)
+        CopyFromRAM(*pProgram, io + c * maxFrames, outputs[c] + start, n);
+    }
+  }
+  else if (pProgram->mSample)
+  {
+    for (auto s = 0; s < nFrames; s++)
+    {
+      for (auto c = 0; c < nChans; c++)
+        *pProgram->mSpl[c] = inputs[c][s];
+
+      NSEEL_code_execute(pProgram->mSample);
+
+      for (auto c = 0; c < nChans; c++)
+        outputs[c][s] = static_cast<sample>(*pProgram->mSpl[c]);
+    }
+  }
+  else
+  {
+    for (auto c = 0; c < nChans; c++)
+    {
+      if (outputs[c] != inputs[c])
+        memcpy(outputs[c], inputs[c], nFrames * sizeof(sample));
+    }
+  }
+}
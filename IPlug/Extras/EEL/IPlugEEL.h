@@ -0,0 +1,186 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+#pragma once
+
+/**
+ * @file
+ * @copydoc IPlugEEL
+ */
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "wdlstring.h"
+#include "eel2/ns-eel.h"
+
+#include "IPlugAPIBase.h"
+
+BEGIN_IPLUG_NAMESPACE
+
+/** JIT compiled EEL2 DSP scripts, using the compiler in WDL/eel2. In addition to this file and IPlugEEL.cpp, your project needs to compile
+ * WDL/eel2/nseel-caltab.c, nseel-cfunc.c, nseel-compiler.c, nseel-eval.c, nseel-lextab.c, nseel-ram.c, nseel-yylex.c and on x86_64 Windows/macOS link asm-nseel-x64.obj/asm-nseel-x64-macho.o
+ *
+ * Scripts are written like JSFX, with slider declarations followed by sections:
+ * @code
+ * slider1:gain_db=0<-60,12,0.1>Gain (dB)
+ *
+ * @init
+ * gain = 1;
+ * @slider
+ * gain = 10^(gain_db/20);
+ * @sample
+ * spl0 *= gain;
+ * spl1 *= gain;
+ * @endcode
+ *
+ * - \@init runs after compiling and when the sample rate changes, \@slider runs after \@init and whenever a slider changes, \@block runs once per block.
+ * - \@sample runs once per frame with the channels in spl0...spl63. The variables srate, num_ch and samplesblock are also set.
+ * - \@process is the block mode alternative to \@sample, which avoids the per-sample call overhead: it runs once per block, with the audio of channel c
+ *   in memory at io[c * maxframes], for nframes frames, and is written back from the same place. Blocks longer than maxframes are processed
+ *   in several calls. If a script has \@process, \@sample is ignored.
+ *
+ * Slider variables default to sliderN if the name is omitted, e.g. `slider2:0.5<0,1,0.01>Mix`.
+ * Each slider is an IParam, which can be linked to the plug-in's parameters via CreateIPlugParameters().
+ *
+ * Compile() must be called on a thread other than the audio thread, the compiled code is swapped into ProcessBlock() without locking at the start of the next block.
+ * The previous program is freed by the next call to Compile() or CollectGarbage(). Slider values carry over by index as soon as the program is swapped in, but the
+ * IParams returned by GetParam(), and the plug-in's parameters if they are linked, belong to the main thread: they are re-initialised for the new sliders
+ * by the next call to OnIdle() or CreateIPlugParameters() on the main thread, so Compile() can run on a background thread. */
+class IPlugEEL
+{
+public:
+  static constexpr int kMaxChannels = 64;
+  static constexpr int kMaxSliders = 64;
+
+  IPlugEEL(const char* name = "IPlugEEL", int maxNChans = 2);
+  ~IPlugEEL();
+
+  IPlugEEL(const IPlugEEL&) = delete;
+  IPlugEEL& operator=(const IPlugEEL&) = delete;
+
+  /** Compiles a script, and if successful swaps it in at the next call to ProcessBlock(). Don't call this on the audio thread
+   * @param script The script text
+   * @param error Receives the compiler error, if any
+   * @return \c true on success */
+  bool Compile(const char* script, WDL_String& error);
+
+  /** Compiles a script from a file, see Compile() */
+  bool CompileFile(const char* path, WDL_String& error);
+
+  /** Frees the program that was replaced by the last compile, once the audio thread has swapped it out. Don't call this on the audio thread */
+  void CollectGarbage();
+
+  /** Call this periodically on the main thread, e.g. from the plug-in's OnIdle(). After a compile, it re-initialises the sliders' IParams and the linked plug-in
+   * parameters, then it frees the replaced program
+   * @return \c true if the sliders were re-initialised */
+  bool OnIdle();
+
+  /** Sets the sample rate and maximum block size. \@init is run again at the start of the next block */
+  void SetSampleRate(double sampleRate, int maxBlockSize);
+
+  /** @return The number of sliders of the last compiled script, once OnIdle() or CreateIPlugParameters() has picked it up. Main thread only */
+  int NParams() const { return static_cast<int>(mParams.size()); }
+
+  /** @return The IParam for a slider, see NParams(). Main thread only */
+  IParam* GetParam(int paramIdx) { return mParams[paramIdx].get(); }
+
+  /** Initialises the plug-in's parameters from the sliders of the last compiled script. If the plug-in is linked, OnIdle() does this again after each compile. Main thread only
+   * @param pPlug The plug-in
+   * @param startIdx The index of the first plug-in parameter to use
+   * @param setToDefault If \c false, the plug-in parameters keep their normalized value
+   * @return startIdx, or -1 if there are no sliders */
+  int CreateIPlugParameters(IPlugAPIBase* pPlug, int startIdx = 0, bool setToDefault = true);
+
+  /** Sets a slider value, this is lock-free and can be called from any thread. \@slider runs at the start of the next block
+   * @param paramIdx The slider index
+   * @param value The non-normalized value */
+  void SetParameterValue(int paramIdx, double value);
+
+  /** Processes a block with the current program, or passes the audio through if nothing has been compiled. Audio thread only */
+  void ProcessBlock(sample** inputs, sample** outputs, int nFrames);
+
+private:
+  /** A compiled script, owned by the audio thread while it is active */
+  struct Program
+  {
+    ~Program();
+
+    NSEEL_VMCTX mVM = nullptr;
+    NSEEL_CODEHANDLE mInit = nullptr;
+    NSEEL_CODEHANDLE mSlider = nullptr;
+    NSEEL_CODEHANDLE mBlock = nullptr;
+    NSEEL_CODEHANDLE mSample = nullptr;
+    NSEEL_CODEHANDLE mProcess = nullptr;
+    EEL_F* mSpl[kMaxChannels] = {};
+    EEL_F* mSliderVars[kMaxSliders] = {};
+    int mNSliders = 0;
+    EEL_F* mSrate = nullptr;
+    EEL_F* mNumCh = nullptr;
+    EEL_F* mSamplesBlock = nullptr;
+    EEL_F* mNFrames = nullptr;
+    EEL_F* mMaxFrames = nullptr;
+    EEL_F* mIO = nullptr;
+  };
+
+  struct Slider
+  {
+    Slider() = default;
+    Slider(const Slider&) = default;
+
+    // WDL_String only declares a copy constructor, so assign its contents
+    Slider& operator=(const Slider& other)
+    {
+      mVar.Set(&other.mVar);
+      mLabel.Set(&other.mLabel);
+      mDefault = other.mDefault;
+      mMin = other.mMin;
+      mMax = other.mMax;
+      mStep = other.mStep;
+      return *this;
+    }
+
+    WDL_String mVar;
+    WDL_String mLabel;
+    double mDefault = 0., mMin = 0., mMax = 1., mStep = 0.;
+  };
+
+  static bool ParseSlider(const char* line, int& sliderNum, Slider& slider);
+  bool TakePendingSliders();
+  bool Build(Program& program, const std::vector<Slider>& sliders, const WDL_String* sections, const int* lineOffsets, WDL_String& error);
+  void ReserveIO(Program& program);
+  int MaxIOFrames() const;
+  void PrepareIO(Program& program);
+  void ApplySliders(Program& program, uint64_t changes);
+  void CopyToRAM(Program& program, int offset, const sample* pSrc, int n);
+  void CopyFromRAM(Program& program, int offset, sample* pDest, int n);
+
+  WDL_String mName;
+  int mMaxNChans;
+  std::vector<std::unique_ptr<IParam>> mParams; // main thread only
+  std::atomic<std::vector<Slider>*> mPendingSliders {nullptr}; // compiled, waiting for the main thread
+  int mNCompiledSliders = 0; // the number of sliders of the last compiled script, compiling thread only
+  std::unique_ptr<std::atomic<double>[]> mSliderValues;
+  std::atomic<uint64_t> mSliderChanges {0}; // a bit per slider, set by SetParameterValue
+  std::atomic<double> mSampleRate {44100.};
+  std::atomic<int> mMaxBlockSize {1024};
+  std::atomic<bool> mReinit {false};
+
+  Program* mActive = nullptr; // only accessed on the audio thread, or before processing starts
+  std::atomic<Program*> mPending {nullptr}; // compiled, waiting for the audio thread
+  std::atomic<Program*> mRetired {nullptr}; // swapped out by the audio thread, waiting to be freed
+
+  IPlugAPIBase* mPlug = nullptr;
+  int mIPlugParamStartIdx = -1; // if this is negative, there is no linking
+};
+
+END_IPLUG_NAMESPACE
@@ -15,7 +15,9 @@
  * @copydoc IPlugFaust
  */
 
+#include <atomic>
 #include <memory>
+#include <vector>
 
 #include "faust/gui/UI.h"
 #include "faust/gui/MidiUI.h"
@@ -52,7 +54,10 @@ public:
 
   virtual ~IPlugFaust()
   {
-    mParams.Empty(true);
+    delete mPending.exchange(nullptr);
+    delete mPendingParams.exchange(nullptr);
+    delete mFade;
+    CollectGarbage();
   }
 
   IPlugFaust(const IPlugFaust&) = delete;
@@ -78,6 +83,23 @@ public:
   void FreeDSP()
   {
     mDSP = nullptr;
+    mDSPOwner = nullptr;
+  }
+
+  /** Deletes the DSP that was replaced by the last SwapDSP(), once the audio thread has finished crossfading from it. Don't call this on the audio thread */
+  void CollectGarbage()
+  {
+    delete mRetired.exchange(nullptr, std::memory_order_acq_rel);
+  }
+
+  /** Call this periodically on the main thread, e.g. from the plug-in's OnIdle(). After a recompile, it relinks the plug-in's parameters to the new DSP's parameters,
+   * and from then on parameter indices refer to the new DSP. Then it deletes the replaced DSP
+   * @return \c true if the parameters changed */
+  virtual bool OnIdle()
+  {
+    const bool changed = TakePendingParams();
+    CollectGarbage();
+    return changed;
   }
   
   void SetOverSamplingRate(int rate)
@@ -87,15 +109,11 @@ public:
   }
 
   // Unique methods
+
+  /** Sets the sample rate, the DSP is initialised with it on the audio thread at the start of the next block */
   void SetSampleRate(double sampleRate)
   {
-    int multiplier = 1;
-    
-    if(mOverSampler)
-      multiplier = mOverSampler->GetRate();
-    
-    if (mDSP)
-      mDSP->init(((int) sampleRate) * multiplier);
+    mSampleRate.store(sampleRate);
   }
 
   void ProcessMidiMsg(const IMidiMsg& msg)
@@ -105,60 +123,55 @@ public:
 
   virtual void ProcessBlock(sample** inputs, sample** outputs, int nFrames)
   {
+    TakePendingDSP();
+
     if (mDSP)
     {
-      assert(mDSP->getSampleRate() != 0); // did you forget to call SetSampleRate?
-      
+      ApplySampleRate();
+      ApplyParameterValues();
+
       if(mOverSampler)
         mOverSampler->ProcessBlock(inputs, outputs, nFrames, 2 /* TODO: flexible channel count */,
                                    [&](sample** inputs, sample** outputs, int nFrames) //TODO:: badness capture = allocated
                                    {
-                                     mDSP->compute(nFrames, inputs, outputs);
+                                     Compute(inputs, outputs, nFrames);
                                    });
       else
-        mDSP->compute(nFrames, inputs, outputs);
+        Compute(inputs, outputs, nFrames);
     }
 //    else silence?
   }
 
+  /** Sets a parameter value, this is lock-free and can be called from any thread. The value is applied at the start of the next block */
   void SetParameterValueNormalised(int paramIdx, double normalizedValue)
   {
-    if(paramIdx > kNoParameter && paramIdx >= NParams())
+    if(paramIdx < 0 || paramIdx >= NParams())
     {
       DBGMSG("IPlugFaust-%s:: No parameter %i\n", mName.Get(), paramIdx);
     }
     else
-    {
-      mParams.Get(paramIdx)->SetNormalized(normalizedValue);
-    
-      if(mZones.GetSize() == NParams())
-        *(mZones.Get(paramIdx)) = mParams.Get(paramIdx)->Value();
-      else
-        DBGMSG("IPlugFaust-%s:: Missing zone for parameter %s\n", mName.Get(), mParams.Get(paramIdx)->GetNameForHost());
-    }
+      StoreValue(paramIdx, normalizedValue, true);
   }
   
+  /** Sets a parameter value, this is lock-free and can be called from any thread. The value is applied at the start of the next block */
   void SetParameterValue(int paramIdx, double nonNormalizedValue)
   {
     if(NParams()) {
       
     assert(paramIdx < NParams()); // Seems like we don't have enough parameters!
-    
-    mParams.Get(paramIdx)->Set(nonNormalizedValue);
 
-    if(mZones.GetSize() == NParams())
-      *(mZones.Get(paramIdx)) = nonNormalizedValue;
-    else
-      DBGMSG("IPlugFaust-%s:: Missing zone for parameter %s\n", mName.Get(), mParams.Get(paramIdx)->GetNameForHost());
+    if(paramIdx >= 0 && paramIdx < NParams())
+      StoreValue(paramIdx, nonNormalizedValue, false);
     }
     else
       DBGMSG("SetParameterValue called with no FAUST params\n");
   }
 
+  /** Sets a parameter value by its FAUST label. Audio thread only, since the map belongs to the DSP that is running */
   void SetParameterValue(const char* labelToLookup, double nonNormalizedValue)
   {
     FAUSTFLOAT* dest = nullptr;
-    dest = mMap.Get(labelToLookup, nullptr);
+    dest = mLayout ? mLayout->mMap.Get(labelToLookup, nullptr) : nullptr;
 //    mParams.Get(paramIdx)->Set(nonNormalizedValue); // TODO: we are not updating the IPlug parameter
 
     if(dest)
@@ -167,10 +180,14 @@ public:
       DBGMSG("IPlugFaust-%s:: No parameter named %s\n", mName.Get(), labelToLookup);
   }
 
+  /** Initialises the plug-in's parameters from the FAUST parameters. Call this on the main thread after Init(). If the DSP is recompiled, OnIdle() does this again for the new parameters.
+   * The plug-in's parameter lock is held while they are re-initialised, when PARAMS_MUTEX is defined */
   int CreateIPlugParameters(IPlugAPIBase* pPlug, int startIdx = 0, int endIdx = -1, bool setToDefault = true)
   {
     assert(pPlug != nullptr);
-   
+
+    TakePendingParams();
+
     if(NParams() == 0)
       return -1;
     
@@ -180,6 +197,12 @@ public:
     
     if(endIdx == -1)
       endIdx = pPlug->NParams();
+
+    endIdx = std::min(endIdx, static_cast<int>(mParams.size()));
+
+#ifdef PARAMS_MUTEX
+    WDL_MutexLock lock(&pPlug->mParams_mutex);
+#endif
     
     for (auto p = 0; p < endIdx; p++)
     {
@@ -187,19 +210,22 @@ public:
 
       IParam* pParam = pPlug->GetParam(plugParamIdx + p);
       const double currentValueNormalised = pParam->GetNormalized();
-      pParam->Init(*mParams.Get(p));
+      pParam->Init(*mParams[p]);
       if(setToDefault)
         pParam->SetToDefault();
       else
         pParam->SetNormalized(currentValueNormalised);
+
+      SetParameterValue(p, pParam->Value());
     }
 
     return plugParamIdx;
   }
 
+  /** @return The number of parameters that parameter indices refer to, those of the DSP that Init() or the last OnIdle() picked up */
   int NParams()
   {
-    return mParams.GetSize();
+    return mNParams.load(std::memory_order_acquire);
   }
 
   // Meta
@@ -247,14 +273,268 @@ public:
   void addSoundfile(const char *label, const char *filename, Soundfile **sf_zone) override {}
 
 protected:
+  static constexpr int kMaxParams = 256;
+  static constexpr int kMaxCrossfadeChannels = 8;
+  static constexpr int kCrossfadeChunk = 64;
+  static constexpr double kCrossfadeTime = 0.01; // seconds
+
+  /** The parameters and zones of a DSP, which are only valid together with it. A recompiled DSP's layout is built on the compile thread, and handed
+   * to the audio thread with the DSP by SwapDSP() */
+  struct Layout
+  {
+    ~Layout() { mParams.Empty(true); }
+
+    WDL_PtrList<IParam> mParams;
+    WDL_PtrList<FAUSTFLOAT> mZones;
+    WDL_StringKeyedArray<FAUSTFLOAT*> mMap; // map is used for setting FAUST parameters by name
+    uint32_t mGeneration = 0; // tags the values set with this layout's parameter indices, see ParamValue
+  };
+
+  /** A DSP and its layout, handed to the audio thread by SwapDSP(), and back once the audio thread has finished with the DSP it replaced */
+  struct DSPSwap
+  {
+    std::shared_ptr<void> mOwner; // released after mDSP, see SwapDSP()
+    std::unique_ptr<::dsp> mDSP;
+    std::unique_ptr<Layout> mLayout;
+  };
+
+  /** Copies of a new layout's parameters, handed to the main thread by SwapDSP(), since the layout itself belongs to the audio thread */
+  struct ParamsUpdate
+  {
+    std::vector<std::unique_ptr<IParam>> mParams;
+    uint32_t mGeneration = 0;
+  };
+
+  /** A value set by SetParameterValue() or SetParameterValueNormalised(), which the audio thread writes to the zone. Until OnIdle() has picked up a recompiled DSP's
+   * parameters, indices still refer to the previous DSP's parameters, so each value is tagged with the generation of the layout its index refers to.
+   * A value set with the previous indices after the audio thread has picked up the new DSP is ignored, OnIdle() sends the linked plug-in parameters again */
+  struct ParamValue
+  {
+    std::atomic<double> mValue {0.};
+    std::atomic<bool> mNormalised {false};
+    std::atomic<uint32_t> mGeneration {0};
+  };
+
+  void StoreValue(int paramIdx, double value, bool normalised)
+  {
+    ParamValue& paramValue = mValues[paramIdx];
+    paramValue.mGeneration.store(mWriteGeneration.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    paramValue.mNormalised.store(normalised, std::memory_order_relaxed);
+    paramValue.mValue.store(value, std::memory_order_release);
+  }
+
+  /** Hands a new, initialised DSP instance and its layout to the audio thread, which crossfades to it at the start of the next block, and copies of its parameters
+   * to the main thread, which picks them up in OnIdle(). This is lock-free, but must not be called on the audio thread or concurrently with itself.
+   * If a previous DSP is still waiting to be picked up, it is replaced
+   * @param pDSP The new DSP, ownership is transferred
+   * @param pLayout The parameters and zones of the DSP, ownership is transferred
+   * @param owner Released after the DSP is deleted, e.g. the factory that created it */
+  void SwapDSP(::dsp* pDSP, Layout* pLayout, std::shared_ptr<void> owner = nullptr)
+  {
+    CollectGarbage();
+
+    DSPSwap* pSwap = nullptr;
+
+    if (pDSP)
+    {
+      pSwap = new DSPSwap;
+      pSwap->mOwner = std::move(owner);
+      pSwap->mDSP.reset(pDSP);
+      pSwap->mLayout.reset(pLayout);
+
+      ParamsUpdate* pUpdate = new ParamsUpdate;
+      CopyParams(*pLayout, pUpdate->mParams);
+      pUpdate->mGeneration = pLayout->mGeneration;
+      delete mPendingParams.exchange(pUpdate, std::memory_order_acq_rel);
+    }
+
+    delete mPending.exchange(pSwap, std::memory_order_acq_rel);
+  }
+
+  /** Picks up a DSP passed to SwapDSP(). Values set with the new DSP's parameter indices are kept, values set with the running DSP's indices move to the parameter
+   * with the same name, the others start at their default. If the channel counts allow it, the old DSP is kept running for a crossfade, otherwise it is retired straight away */
+  void TakePendingDSP()
+  {
+    if (mFade || !mPending.load(std::memory_order_acquire) || mRetired.load(std::memory_order_acquire))
+      return;
+
+    DSPSwap* pSwap = mPending.exchange(nullptr, std::memory_order_acq_rel);
+
+    if (!pSwap)
+      return;
+
+    const Layout& layout = *pSwap->mLayout;
+    const int nParams = std::min(layout.mParams.GetSize(), static_cast<int>(kMaxParams));
+    double values[kMaxParams];
+    bool normalised[kMaxParams];
+
+    for (auto p = 0; p < nParams; p++)
+    {
+      int src = p;
+      double value = mValues[p].mValue.load(std::memory_order_acquire);
+
+      if (mValues[p].mGeneration.load(std::memory_order_relaxed) != layout.mGeneration)
+      {
+        src = FindExistingParameterWithName(*mLayout, layout.mParams.Get(p)->GetNameForHost());
+
+        if (src >= kMaxParams)
+          src = -1;
+
+        if (src > -1)
+        {
+          value = mValues[src].mValue.load(std::memory_order_acquire);
+
+          if (mValues[src].mGeneration.load(std::memory_order_relaxed) != mLayout->mGeneration)
+            src = -1;
+        }
+      }
+
+      normalised[p] = src > -1 && mValues[src].mNormalised.load(std::memory_order_relaxed);
+      values[p] = src > -1 ? value : layout.mParams.Get(p)->GetDefault();
+    }
+
+    for (auto p = 0; p < nParams; p++)
+    {
+      mValues[p].mGeneration.store(layout.mGeneration, std::memory_order_relaxed);
+      mValues[p].mNormalised.store(normalised[p], std::memory_order_relaxed);
+      mValues[p].mValue.store(values[p], std::memory_order_relaxed);
+    }
+
+    // the swap object now carries the old DSP, its layout and owner
+    std::swap(mDSP, pSwap->mDSP);
+    std::swap(mLayout, pSwap->mLayout);
+    std::swap(mDSPOwner, pSwap->mOwner);
+
+    ::dsp* pOld = pSwap->mDSP.get();
+
+    if (pOld && std::max(pOld->getNumInputs(), mDSP->getNumInputs()) <= kMaxCrossfadeChannels
+             && std::max(pOld->getNumOutputs(), mDSP->getNumOutputs()) <= kMaxCrossfadeChannels)
+    {
+      mFade = pSwap;
+      mFadePos = 0;
+    }
+    else
+      mRetired.store(pSwap, std::memory_order_release);
+  }
+
+  /** Initialises the running DSPs when the sample rate has changed */
+  void ApplySampleRate()
+  {
+    const int multiplier = mOverSampler ? mOverSampler->GetRate() : 1;
+    const double sampleRate = mSampleRate.load();
+    const int rate = static_cast<int>(sampleRate) * multiplier;
+
+    mCrossfadeFrames = std::max(1, static_cast<int>(sampleRate * multiplier * kCrossfadeTime));
+
+    if (mDSP->getSampleRate() != rate)
+      mDSP->init(rate);
+
+    if (mFade && mFade->mDSP->getSampleRate() != rate)
+      mFade->mDSP->init(rate);
+  }
+
+  /** Writes the values set since the last block to the zones of the running DSP */
+  void ApplyParameterValues()
+  {
+    if (!mLayout)
+      return;
+
+    const int nParams = std::min(std::min(mLayout->mParams.GetSize(), mLayout->mZones.GetSize()), static_cast<int>(kMaxParams));
+
+    for (auto p = 0; p < nParams; p++)
+    {
+      const double value = mValues[p].mValue.load(std::memory_order_acquire);
+
+      // set with the previous DSP's indices, before OnIdle() picked up this one's parameters
+      if (mValues[p].mGeneration.load(std::memory_order_relaxed) != mLayout->mGeneration)
+        continue;
+
+      *(mLayout->mZones.Get(p)) = mValues[p].mNormalised.load(std::memory_order_relaxed) ? mLayout->mParams.Get(p)->FromNormalized(value) : value;
+    }
+  }
+
+  /** Runs the DSP, crossfading from the previous one after a swap */
+  void Compute(sample** inputs, sample** outputs, int nFrames)
+  {
+    int done = 0;
+
+    while (mFade && done < nFrames)
+    {
+      ::dsp* pFadeDSP = mFade->mDSP.get();
+      const int n = std::min(std::min(nFrames - done, static_cast<int>(kCrossfadeChunk)), mCrossfadeFrames - mFadePos);
+      const int nIn = std::max(pFadeDSP->getNumInputs(), mDSP->getNumInputs());
+      const int nNewOut = mDSP->getNumOutputs();
+      const int nOldOut = pFadeDSP->getNumOutputs();
+      sample* ins[kMaxCrossfadeChannels];
+      sample* outs[kMaxCrossfadeChannels];
+      sample* fadeOuts[kMaxCrossfadeChannels];
+
+      // inputs beyond the plug-in's channels are silent
+      for (auto c = 0; c < nIn; c++)
+        ins[c] = c < mNInputChans ? inputs[c] + done : mZeroBuffer;
+
+      for (auto c = 0; c < nNewOut; c++)
+        outs[c] = outputs[c] + done;
+
+      for (auto c = 0; c < nOldOut; c++)
+        fadeOuts[c] = mFadeBuffer[c];
+
+      // the old DSP runs first, since the outputs may be the same buffers as the inputs
+      pFadeDSP->compute(n, ins, fadeOuts);
+      mDSP->compute(n, ins, outs);
+
+      const sample step = sample(1) / mCrossfadeFrames;
+
+      for (auto c = 0; c < nNewOut; c++)
+      {
+        for (auto s = 0; s < n; s++)
+        {
+          const sample gain = (mFadePos + s) * step;
+          const sample old = c < nOldOut ? fadeOuts[c][s] : sample(0);
+          outs[c][s] = old + gain * (outs[c][s] - old);
+        }
+      }
+
+      done += n;
+      mFadePos += n;
+
+      if (mFadePos >= mCrossfadeFrames)
+      {
+        mRetired.store(mFade, std::memory_order_release);
+        mFade = nullptr;
+      }
+    }
+
+    if (done < nFrames)
+    {
+      if (done == 0)
+        mDSP->compute(nFrames, inputs, outputs);
+      else // the crossfade ended within this block, so the channel counts are within kMaxCrossfadeChannels
+      {
+        sample* ins[kMaxCrossfadeChannels];
+        sample* outs[kMaxCrossfadeChannels];
+
+        for (auto c = 0; c < mDSP->getNumInputs(); c++)
+          ins[c] = inputs[c] + done;
+
+        for (auto c = 0; c < mDSP->getNumOutputs(); c++)
+          outs[c] = outputs[c] + done;
+
+        mDSP->compute(nFrames - done, ins, outs);
+      }
+    }
+  }
+
+  /** Called by the UI callbacks while buildUserInterface() runs, adds a parameter to the layout being built */
   void AddOrUpdateParam(IParam::EParamType type, const char *label, FAUSTFLOAT *zone, FAUSTFLOAT init = 0., FAUSTFLOAT min = 0., FAUSTFLOAT max = 0., FAUSTFLOAT step = 1.)
   {
+    Layout& layout = mBuildLayout ? *mBuildLayout : *mLayout;
     IParam* pParam = nullptr;
     
-    const int idx = FindExistingParameterWithName(label);
+    const int idx = FindExistingParameterWithName(layout, label);
     
     if(idx > -1)
-      pParam = mParams.Get(idx);
+      pParam = layout.mParams.Get(idx);
     else
       pParam = new IParam();
     
@@ -278,34 +558,142 @@ protected:
     }
     
     if(idx == -1)
-      mParams.Add(pParam);
+      layout.mParams.Add(pParam);
     
-    mZones.Add(zone);
+    layout.mZones.Add(zone);
+  }
+
+  /** Builds the layout of a DSP that is not running yet, without touching the running DSP's layout
+   * @param pDSP The DSP
+   * @return The new layout, ownership is transferred */
+  Layout* BuildLayout(::dsp* pDSP)
+  {
+    Layout* pLayout = new Layout;
+    mBuildLayout = pLayout;
+    pDSP->buildUserInterface(this);
+    mBuildLayout = nullptr;
+    pLayout->mGeneration = ++mLayoutCounter;
+
+    for (auto p = 0; p < pLayout->mParams.GetSize(); p++)
+    {
+      pLayout->mMap.Insert(pLayout->mParams.Get(p)->GetNameForHost(), pLayout->mZones.Get(p)); // insert will overwrite keys with the same name
+    }
+
+    return pLayout;
+  }
+
+  static void CopyParams(const Layout& layout, std::vector<std::unique_ptr<IParam>>& params)
+  {
+    params.resize(std::min(layout.mParams.GetSize(), static_cast<int>(kMaxParams)));
+
+    for (auto p = 0; p < static_cast<int>(params.size()); p++)
+    {
+      params[p] = std::make_unique<IParam>();
+      params[p]->Init(*layout.mParams.Get(p));
+    }
+  }
+
+  /** Picks up the parameters of a DSP passed to SwapDSP(), on the main thread. From then on parameter indices refer to them, and the linked plug-in parameters are relinked
+   * @return \c true if there were new parameters */
+  bool TakePendingParams()
+  {
+    std::unique_ptr<ParamsUpdate> pUpdate(mPendingParams.exchange(nullptr, std::memory_order_acq_rel));
+
+    if (!pUpdate)
+      return false;
+
+    mNParams.store(static_cast<int>(pUpdate->mParams.size()), std::memory_order_release);
+    mWriteGeneration.store(pUpdate->mGeneration, std::memory_order_relaxed);
+    RelinkIPlugParameters(pUpdate->mParams);
+    mParams = std::move(pUpdate->mParams);
+    return true;
+  }
+
+  /** Re-initialises the linked plug-in parameters for new parameters, on the main thread. Parameters with the same name as one that they were linked to keep their value,
+   * the others are set to their default, and all the values are sent again with the new indices. The plug-in's parameter lock is held, when PARAMS_MUTEX is defined
+   * @param params The new parameters */
+  void RelinkIPlugParameters(const std::vector<std::unique_ptr<IParam>>& params)
+  {
+    if(mIPlugParamStartIdx < 0 || mPlug == nullptr)
+      return;
+
+    const int nPlugParams = std::min(mPlug->NParams() - mIPlugParamStartIdx, static_cast<int>(kMaxParams));
+    const int nPrev = std::min(static_cast<int>(mParams.size()), nPlugParams);
+    const int nParams = std::min(static_cast<int>(params.size()), nPlugParams);
+    double values[kMaxParams];
+
+    auto findPrev = [&](const char* name) {
+      for (auto p = 0; p < nPrev; p++)
+      {
+        if (strcmp(name, mParams[p]->GetNameForHost()) == 0)
+          return p;
+      }
+
+      return -1;
+    };
+
+#ifdef PARAMS_MUTEX
+    WDL_MutexLock lock(&mPlug->mParams_mutex);
+#endif
+
+    for (auto p = 0; p < nPrev; p++)
+      values[p] = mPlug->GetParam(mIPlugParamStartIdx + p)->Value();
+
+    for (auto p = 0; p < nParams; p++)
+    {
+      IParam* pParam = mPlug->GetParam(mIPlugParamStartIdx + p);
+      const int prev = findPrev(params[p]->GetNameForHost());
+      pParam->Init(*params[p]);
+
+      if (prev > -1)
+        pParam->Set(values[prev]);
+      else
+        pParam->SetToDefault();
+
+      SetParameterValue(p, pParam->Value());
+    }
   }
   
-  void BuildParameterMap()
+  /** Builds the map for the layout of mDSP, which was built before processing started, and sets the parameters to their defaults */
+  void BuildParameterMap(bool setToDefault = true)
   {
-    for(auto p = 0; p < NParams(); p++)
+    Layout& layout = *mLayout;
+    const int nParams = std::min(layout.mParams.GetSize(), static_cast<int>(kMaxParams));
+
+    for(auto p = 0; p < layout.mParams.GetSize(); p++)
     {
-      mMap.Insert(mParams.Get(p)->GetNameForHost(), mZones.Get(p)); // insert will overwrite keys with the same name
+      layout.mMap.Insert(layout.mParams.Get(p)->GetNameForHost(), layout.mZones.Get(p)); // insert will overwrite keys with the same name
     }
+
+    layout.mGeneration = ++mLayoutCounter;
+
+    for(auto p = 0; p < nParams; p++)
+    {
+      mValues[p].mGeneration.store(layout.mGeneration);
+      mValues[p].mNormalised.store(false);
+      mValues[p].mValue.store(layout.mParams.Get(p)->GetDefault());
+    }
+
+    CopyParams(layout, mParams);
+    mWriteGeneration.store(layout.mGeneration);
+    mNParams.store(nParams);
     
     if(mIPlugParamStartIdx > -1 && mPlug != nullptr) // if we've already linked parameters
     {
-      CreateIPlugParameters(mPlug, mIPlugParamStartIdx);
+      CreateIPlugParameters(mPlug, mIPlugParamStartIdx, -1, setToDefault);
     }
     
     for(auto p = 0; p < NParams(); p++)
     {
-      DBGMSG("%i %s\n", p, mParams.Get(p)->GetNameForHost());
+      DBGMSG("%i %s\n", p, layout.mParams.Get(p)->GetNameForHost());
     }
   }
 
-  int FindExistingParameterWithName(const char* name) // TODO: this needs to check meta data too - incase of grouping
+  static int FindExistingParameterWithName(const Layout& layout, const char* name) // TODO: this needs to check meta data too - incase of grouping
   {
-    for(auto p = 0; p < NParams(); p++)
+    for(auto p = 0; p < layout.mParams.GetSize(); p++)
     {
-      if(strcmp(name, mParams.Get(p)->GetNameForHost()) == 0)
+      if(strcmp(name, layout.mParams.Get(p)->GetNameForHost()) == 0)
       {
         return p;
       }
@@ -317,11 +705,26 @@ protected:
   std::unique_ptr<OverSampler<sample>> mOverSampler;
   WDL_String mName;
   int mNVoices;
-  std::unique_ptr<::dsp> mDSP;
+  int mNInputChans = 0; // the number of input buffers passed to ProcessBlock(), see SetMaxChannelCount()
+  std::shared_ptr<void> mDSPOwner; // released after mDSP, see SwapDSP(), audio thread only, once processing has started
+  std::unique_ptr<::dsp> mDSP; // audio thread only, once processing has started
+  std::unique_ptr<Layout> mLayout = std::make_unique<Layout>(); // the layout of mDSP, audio thread only, once processing has started
+  Layout* mBuildLayout = nullptr; // the layout that the UI callbacks add to, mLayout if this is null
+  uint32_t mLayoutCounter = 0; // the generation of the last layout built, only used by the thread that builds DSPs
+  std::vector<std::unique_ptr<IParam>> mParams; // copies of the parameters that parameter indices refer to, main thread only
+  std::atomic<uint32_t> mWriteGeneration {0}; // the generation of mParams' layout
+  std::atomic<ParamsUpdate*> mPendingParams {nullptr}; // passed to SwapDSP(), waiting for the main thread
+  std::atomic<DSPSwap*> mPending {nullptr}; // passed to SwapDSP(), waiting for the audio thread
+  std::atomic<DSPSwap*> mRetired {nullptr}; // swapped out by the audio thread, waiting to be deleted
+  DSPSwap* mFade = nullptr; // the previous DSP and layout, while crossfading, audio thread only
+  int mFadePos = 0;
+  int mCrossfadeFrames = static_cast<int>(DEFAULT_SAMPLE_RATE * kCrossfadeTime);
+  sample mFadeBuffer[kMaxCrossfadeChannels][kCrossfadeChunk];
+  sample mZeroBuffer[kCrossfadeChunk] = {};
+  std::atomic<double> mSampleRate {DEFAULT_SAMPLE_RATE};
   std::unique_ptr<MidiUI> mMidiUI;
-  WDL_PtrList<IParam> mParams;
-  WDL_PtrList<FAUSTFLOAT> mZones;
-  WDL_StringKeyedArray<FAUSTFLOAT*> mMap; // map is used for setting FAUST parameters by name, also used to reconnect existing parameters
+  std::unique_ptr<ParamValue[]> mValues = std::make_unique<ParamValue[]>(kMaxParams);
+  std::atomic<int> mNParams {0};
   int mIPlugParamStartIdx = -1; // if this is negative, it means there is no linking
   IPlugAPIBase* mPlug = nullptr;
   bool mInitialized = false;
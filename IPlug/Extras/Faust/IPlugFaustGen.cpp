@@ -12,6 +12,8 @@
 
 
 
+#include <algorithm>
+
 #include "IPlugFaustGen.h"
 #include "IPlugUtilities.h"
 
@@ -26,8 +28,41 @@ int FaustGen::sFaustGenCounter = 0;
 int FaustGen::Factory::sFactoryCounter = 0;
 bool FaustGen::sAutoRecompile = false;
 std::map<std::string, FaustGen::Factory *> FaustGen::Factory::sFactoryMap;
+std::map<std::string, FaustGen::Factory::LLVMFactoryPtr> FaustGen::Factory::sFactoryCache;
+std::mutex FaustGen::Factory::sFactoryCacheMutex;
 std::list<GUI*> GUI::fGuiList;
 Timer* FaustGen::sTimer = nullptr;
+std::thread FaustGen::sCompileThread;
+std::mutex FaustGen::sCompileMutex;
+std::condition_variable FaustGen::sCompileCV;
+std::deque<FaustGen::Factory*> FaustGen::sCompileQueue;
+bool FaustGen::sCompileThreadRunning = false;
+bool FaustGen::sCompiling = false;
+
+static uint64_t HashString(const std::string& str, uint64_t hash = 14695981039346656037ull)
+{
+  for (auto c : str)
+    hash = (hash ^ static_cast<uint8_t>(c)) * 1099511628211ull;
+
+  return hash;
+}
+
+static void GetFactoryCachePath(WDL_String& path)
+{
+#if defined FAUST_CACHE_PATH
+  path.Set(FAUST_CACHE_PATH);
+#elif defined OS_WIN
+  char tmp[MAX_PATH];
+  GetTempPathA(MAX_PATH, tmp);
+  path.Set(tmp);
+#else
+  const char* tmp = getenv("TMPDIR");
+  path.Set(tmp ? tmp : "/tmp/");
+#endif
+
+  if (path.GetLength() && path.Get()[path.GetLength() - 1] != '/' && path.Get()[path.GetLength() - 1] != '\\')
+    path.Append("/");
+}
 
 FaustGen::Factory::Factory(const char* name, const char* libraryPath, const char* drawPath, const char* inputDSP)
 {
@@ -55,18 +90,44 @@ void FaustGen::Factory::FreeDSPFactory()
 {
   WDL_MutexLock lock(&mDSPMutex);
 
-  for (auto inst : mInstances)
-  {
-    inst->FreeDSP();
-  }
+  // the instances may still be running DSPs created from the LLVM factory, which hold it until they are deleted
+  ReleaseCachedFactory(mLLVMFactory);
+  mLLVMFactory = nullptr;
+}
+
+//static
+FaustGen::Factory::LLVMFactoryPtr FaustGen::Factory::MakeLLVMFactoryPtr(llvm_dsp_factory* pFactory)
+{
+  if (!pFactory)
+    return nullptr;
+
+  return LLVMFactoryPtr(pFactory, [](llvm_dsp_factory* pToDelete) { deleteDSPFactory(pToDelete); });
+}
+
+//static
+void FaustGen::Factory::ReleaseCachedFactory(const LLVMFactoryPtr& pFactory)
+{
+  if (!pFactory)
+    return;
+
+  std::lock_guard<std::mutex> lock(sFactoryCacheMutex);
 
-  if(mLLVMFactory)
+  for (auto it = sFactoryCache.begin(); it != sFactoryCache.end();)
   {
-    deleteDSPFactory(mLLVMFactory); // this is commented in faustgen~
-    mLLVMFactory = nullptr;
+    if (it->second == pFactory)
+      it = sFactoryCache.erase(it);
+    else
+      ++it;
   }
 }
 
+//static
+void FaustGen::Factory::FreeFactoryCache()
+{
+  std::lock_guard<std::mutex> lock(sFactoryCacheMutex);
+  sFactoryCache.clear();
+}
+
 llvm_dsp_factory* FaustGen::Factory::CreateFactoryFromBitCode()
 {
   //return readDSPFactoryFromBitCodeStr(mBitCodeStr.Get(), getTarget(), mOptimizationLevel);
@@ -117,35 +178,135 @@ llvm_dsp_factory *FaustGen::Factory::CreateFactoryFromSourceCode()
 
   if(error.length())
     DBGMSG("%s\n", error.c_str());
-  
-  assert(pFactory != nullptr);
+
+  if (!pFactory)
+  {
+    //WHAT IS THIS?
+//    if (mInstances.begin() != mInstances.end())
+//    {
+//      (*mInstances.begin())->hilight_error(error);
+//    }
+    DBGMSG("FaustGen-%s: Invalid Faust code or compile options : %s\n", mName.Get(), error.c_str());
+  }
+
+  return pFactory;
+}
+
+FaustGen::Factory::LLVMFactoryPtr FaustGen::Factory::CreateFactoryCached()
+{
+  SetDefaultCompileOptions();
+
+  std::string keyStr = GetLLVMArchStr();
+  keyStr += "\n" + std::to_string(mOptimizationLevel) + "\n";
+
+  for (auto& o : mCompileOptions)
+  {
+    keyStr += o + "\n";
+  }
+
+  keyStr += mSourceCodeStr.Get();
+
+  char key[32];
+  snprintf(key, sizeof(key), "%016llx", static_cast<unsigned long long>(HashString(keyStr)));
+
+  std::lock_guard<std::mutex> lock(sFactoryCacheMutex);
+
+  auto it = sFactoryCache.find(key);
+
+  if (it != sFactoryCache.end())
+  {
+    DBGMSG("FaustGen-%s: Using cached factory %s\n", mName.Get(), key);
+    return it->second;
+  }
+
+  // machine code from a previous session, this skips the LLVM compile entirely
+  WDL_String cachePath;
+  GetFactoryCachePath(cachePath);
+  cachePath.AppendFormatted(MAX_WIN32_PATH_LEN, "FaustGen-%s.fmc", key);
+
+  std::string error;
+  LLVMFactoryPtr pFactory;
+
+  bool cached = false;
+
+  {
+    WDL_FileRead cacheFile(cachePath.Get());
+    cached = cacheFile.IsOpen();
+  }
+
+  if (cached)
+    pFactory = MakeLLVMFactoryPtr(readDSPFactoryFromMachineFile(cachePath.Get(), GetLLVMArchStr(), error));
 
   if (pFactory)
   {
-    // Update all instances
-    for (auto inst : mInstances)
-    {
-      inst->SetErrored(false);
-    }
-    
-    return pFactory;
+    DBGMSG("FaustGen-%s: Loaded factory from %s\n", mName.Get(), cachePath.Get());
   }
   else
   {
-    // Update all instances
-    for (auto inst : mInstances)
+    pFactory = MakeLLVMFactoryPtr(CreateFactoryFromSourceCode());
+
+    if (pFactory && !writeDSPFactoryToMachineFile(pFactory.get(), cachePath.Get(), GetLLVMArchStr()))
+      DBGMSG("FaustGen-%s: Could not write %s\n", mName.Get(), cachePath.Get());
+  }
+
+  if (pFactory)
+    sFactoryCache[key] = pFactory;
+
+  return pFactory;
+}
+
+void FaustGen::Factory::CompileAsync()
+{
+  StartCompileThread();
+
+  {
+    std::lock_guard<std::mutex> lock(sCompileMutex);
+
+    if (std::find(sCompileQueue.begin(), sCompileQueue.end(), this) == sCompileQueue.end())
+      sCompileQueue.push_back(this);
+
+    mCompilePending = true;
+  }
+
+  sCompileCV.notify_all();
+}
+
+void FaustGen::Factory::Recompile()
+{
+  WDL_MutexLock lock(&mDSPMutex);
+
+  LLVMFactoryPtr pLLVMFactory = CreateFactoryCached();
+
+  if (!pLLVMFactory)
+  {
+    DBGMSG("FaustGen-%s: JIT compile failed, the current DSP keeps running\n", mName.Get());
+    mCompilePending = false;
+    return;
+  }
+
+  // the replaced factory leaves the cache, the running DSPs created from it keep it until they are deleted
+  if (mLLVMFactory != pLLVMFactory)
+    ReleaseCachedFactory(mLLVMFactory);
+
+  mLLVMFactory = pLLVMFactory;
+
+  for (auto inst : mInstances)
+  {
+    ::dsp* pDSP = CreateDSPInstance();
+
+    if (inst->mMaxNInputs < pDSP->getNumInputs() || inst->mMaxNOutputs < pDSP->getNumOutputs())
     {
-      inst->SetErrored(true);
+      DBGMSG("FaustGen-%s: %i input(s), %i output(s) is more than this instance has buffers for\n", mName.Get(), pDSP->getNumInputs(), pDSP->getNumOutputs());
+      delete pDSP;
+      continue;
     }
 
-    //WHAT IS THIS?
-//    if (mInstances.begin() != mInstances.end())
-//    {
-//      (*mInstances.begin())->hilight_error(error);
-//    }
-    DBGMSG("FaustGen-%s: Invalid Faust code or compile options : %s\n", mName.Get(), error.c_str());
-    return 0;
+    mNInputs = pDSP->getNumInputs();
+    mNOutputs = pDSP->getNumOutputs();
+    inst->OnCompiled(pDSP, mLLVMFactory);
   }
+
+  mCompilePending = false;
 }
 
 ::dsp *FaustGen::Factory::CreateDSPInstance(int nVoices)
@@ -186,7 +347,7 @@ llvm_dsp_factory *FaustGen::Factory::CreateFactoryFromSourceCode()
   // Tries to create from bitcode
   if (mBitCodeStr.GetLength())
   {
-    mLLVMFactory = CreateFactoryFromBitCode();
+    mLLVMFactory = MakeLLVMFactoryPtr(CreateFactoryFromBitCode());
     if (mLLVMFactory)
     {
       pDSP = CreateDSPInstance();
@@ -199,7 +360,14 @@ llvm_dsp_factory *FaustGen::Factory::CreateFactoryFromSourceCode()
   // Otherwise tries to create from source code
   if (mSourceCodeStr.GetLength())
   {
-    mLLVMFactory = CreateFactoryFromSourceCode();
+    mLLVMFactory = CreateFactoryCached();
+
+    // Update all instances
+    for (auto inst : mInstances)
+    {
+      inst->SetErrored(mLLVMFactory == nullptr);
+    }
+
     if (mLLVMFactory)
     {
       pDSP = CreateDSPInstance();
@@ -211,7 +379,7 @@ llvm_dsp_factory *FaustGen::Factory::CreateFactoryFromSourceCode()
 
     // Otherwise creates default DSP keeping the same input/output number
   mSourceCodeStr.SetFormatted(256, maxInputs == 0 ? DEFAULT_SOURCE_CODE_FMT_STR_INSTRUMENT : DEFAULT_SOURCE_CODE_FMT_STR_FX, maxOutputs);
-  mLLVMFactory = createDSPFactoryFromString("default", mSourceCodeStr.Get(), 0, 0, GetLLVMArchStr(), error, 0);
+  mLLVMFactory = MakeLLVMFactoryPtr(createDSPFactoryFromString("default", mSourceCodeStr.Get(), 0, 0, GetLLVMArchStr(), error, 0));
 
   pDSP = CreateDSPInstance();
   DBGMSG("FaustGen-%s: Allocation of default DSP succeeded, %i input(s), %i output(s)\n", mName.Get(), pDSP->getNumInputs(), pDSP->getNumOutputs());
@@ -319,19 +487,16 @@ void FaustGen::Factory::UpdateSourceCode(const char* str)
     //      inst->hilight_off();
     //    }
 
-    // Delete the existing Faust module
-    FreeDSPFactory();
-
-    mSourceCodeStr.Set(str);
-
-    // Free the memory allocated for fBitCode
-    mBitCodeStr.Set("");
-
-    // Update all instances
-    for (auto inst : mInstances)
     {
-      inst->Init();
+      WDL_MutexLock lock(&mDSPMutex);
+      mSourceCodeStr.Set(str);
+
+      // Free the memory allocated for fBitCode
+      mBitCodeStr.Set("");
     }
+
+    // The instances keep running the existing DSP until the new one is compiled
+    CompileAsync();
   }
   else
   {
@@ -339,19 +504,15 @@ void FaustGen::Factory::UpdateSourceCode(const char* str)
   }
 }
 
-void FaustGen::Factory::RemoveInstance(FaustGen* pDSP)
+bool FaustGen::Factory::RemoveInstance(FaustGen* pDSP)
 {
+  // Recompile() holds the lock while it hands DSPs to the instances
+  WDL_MutexLock lock(&mDSPMutex);
   mInstances.erase(pDSP);
-
-  // Last instance : remove factory from global table and commit suicide...
-  if (mInstances.size() == 0)
-  {
-    sFactoryMap.erase(mName.Get());
-    delete this;
-  }
+  return mInstances.empty();
 }
 
-bool FaustGen::Factory::LoadFile(const char* file)
+bool FaustGen::Factory::LoadFile(const char* file, bool init)
 {
   // Delete the existing Faust module
   //FreeDSPFactory();
@@ -380,9 +541,12 @@ bool FaustGen::Factory::LoadFile(const char* file)
     mInputDSPFile.Set(file);
     
     // Update all instances
-    for (auto inst : mInstances)
+    if (init)
     {
-      inst->Init();
+      for (auto inst : mInstances)
+      {
+        inst->Init();
+      }
     }
     
     return true;
@@ -463,22 +627,150 @@ FaustGen::FaustGen(const char* name, const char* inputDSPFile, int nVoices, int
 
 FaustGen::~FaustGen()
 {
-  if (--sFaustGenCounter <= 0)
+  const bool last = --sFaustGenCounter <= 0;
+
+  if (last)
   {
     SetAutoRecompile(false);
   }
 
+  // first make sure that no compile can hand this instance a DSP
+  const bool lastOfFactory = mFactory && mFactory->RemoveInstance(this);
+
+  {
+    // if this was the factory's last instance, drop its queued compiles. Then wait for a compile that may be using the factory to finish
+    std::unique_lock<std::mutex> lock(sCompileMutex);
+
+    if (lastOfFactory)
+      sCompileQueue.erase(std::remove(sCompileQueue.begin(), sCompileQueue.end(), mFactory), sCompileQueue.end());
+
+    sCompileCV.wait(lock, [] { return !sCompiling; });
+  }
+
+  if (last)
+  {
+    StopCompileThread();
+  }
+
+  // free all DSPs created from the cached factories, before the cache is freed
   FreeDSP();
+  SwapDSP(nullptr, nullptr);
+  CollectGarbage();
+  delete mFade;
+  mFade = nullptr;
+
+  if (lastOfFactory)
+  {
+    Factory::sFactoryMap.erase(mFactory->GetName());
+    delete mFactory;
+  }
+
+  if (last)
+  {
+    Factory::FreeFactoryCache();
+  }
+}
+
+void FaustGen::OnCompiled(::dsp* pDSP, const Factory::LLVMFactoryPtr& pFactory)
+{
+  int multiplier = 1;
+
+  if (mOverSampler)
+    multiplier = mOverSampler->GetRate();
+
+  pDSP->init(static_cast<int>(mSampleRate.load()) * multiplier);
+
+  int nInputs, nOutputs;
+
+  {
+    WDL_MutexLock lock(&mMutex);
+
+    // the running DSP's parameters and zones are left alone, the new ones are published with the DSP. The plug-in's parameters are relinked by OnIdle()
+    nInputs = pDSP->getNumInputs();
+    nOutputs = pDSP->getNumOutputs();
+
+    Layout* pLayout = BuildLayout(pDSP);
+    SwapDSP(pDSP, pLayout, pFactory);
+  }
+
+  mErrored = false;
+  mInitialized = true;
+
+  DBGMSG("FaustGen-%s: JIT compile succeeded, %i input(s), %i output(s)\n", mName.Get(), nInputs, nOutputs);
+}
+
+bool FaustGen::OnIdle()
+{
+  const bool changed = IPlugFaust::OnIdle();
+
+  if(changed && mOnCompileFunc)
+    mOnCompileFunc();
+
+  return changed;
+}
+
+//static
+void FaustGen::StartCompileThread()
+{
+  std::lock_guard<std::mutex> lock(sCompileMutex);
+
+  if (sCompileThreadRunning)
+    return;
 
-  if(mFactory)
-    mFactory->RemoveInstance(this);
+  startMTDSPFactories();
+  sCompileThreadRunning = true;
+  sCompileThread = std::thread(CompileThreadProc);
+}
+
+//static
+void FaustGen::StopCompileThread()
+{
+  {
+    std::lock_guard<std::mutex> lock(sCompileMutex);
+
+    if (!sCompileThreadRunning)
+      return;
+
+    sCompileThreadRunning = false;
+    sCompileQueue.clear();
+  }
+
+  sCompileCV.notify_all();
+  sCompileThread.join();
+  stopMTDSPFactories();
+}
+
+//static
+void FaustGen::CompileThreadProc()
+{
+  std::unique_lock<std::mutex> lock(sCompileMutex);
+
+  while (true)
+  {
+    sCompileCV.wait(lock, [] { return !sCompileThreadRunning || !sCompileQueue.empty(); });
+
+    if (!sCompileThreadRunning)
+      break;
+
+    Factory* pFactory = sCompileQueue.front();
+    sCompileQueue.pop_front();
+    sCompiling = true;
+    lock.unlock();
+
+    pFactory->Recompile();
+
+    lock.lock();
+    sCompiling = false;
+    sCompileCV.notify_all();
+  }
 }
 
 void FaustGen::Init()
 {
-  mZones.Empty(); // remove existing pointers to zones
+  mLayout = std::make_unique<Layout>(); // remove existing pointers to zones
   
   mDSP = std::unique_ptr<::dsp>(mFactory->GetDSP(mMaxNInputs, mMaxNOutputs));
+  mDSPOwner = mFactory->mLLVMFactory; // after the previous DSP is deleted
   assert(mDSP);
 
 //    AddMidiHandler();
@@ -588,6 +880,10 @@ void FaustGen::OnTimer(Timer& timer)
 
   for (auto f : Factory::sFactoryMap)
   {
+    // check again once the compile has started, so as not to block on the factory while it compiles
+    if (f.second->mCompilePending)
+      continue;
+
     pInputFile = &f.second->mInputDSPFile;
     StatType buf;
     GetStat(pInputFile->Get(), &buf);
@@ -596,14 +892,17 @@ void FaustGen::OnTimer(Timer& timer)
 
     if(!Equal(newTime, oldTime))
     {
-      WDL_MutexLock lock(&mMutex);
-
       recompile = true;
-      f.second->FreeDSPFactory();
       DBGMSG("FaustGen-%s: File change detected ----------------------------------\n", mName.Get());
-      DBGMSG("FaustGen-%s: JIT compiling %s\n", mName.Get(), pInputFile->Get());
-      f.second->LoadFile(pInputFile->Get());
-      Init();
+      DBGMSG("FaustGen-%s: JIT compiling %s in the background\n", mName.Get(), pInputFile->Get());
+
+      {
+        WDL_MutexLock lock(&f.second->mDSPMutex);
+        f.second->LoadFile(pInputFile->Get(), false);
+      }
+
+      // the audio keeps running with the current DSP and crossfades to the new one once it is compiled
+      f.second->CompileAsync();
     }
       
     f.second->mPreviousTime = newTime;
@@ -650,7 +949,7 @@ void FaustGen::SetAutoRecompile(bool enable)
 
 void FaustGen::ProcessBlock(sample** inputs, sample** outputs, int nFrames)
 {
-  WDL_MutexLock lock(&mMutex);
+  // no lock here, recompiled DSPs are handed over via SwapDSP()
   if(!mErrored)
     IPlugFaust::ProcessBlock(inputs, outputs, nFrames);
   else
@@ -26,6 +26,11 @@ using FaustGen = iplug::IPlugFaust; // not used, except for CompileCPP();
 #include <set>
 #include <vector>
 #include <map>
+#include <atomic>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
 
 #include "IPlugPlatform.h"
 #include "IPlugConstants.h"
@@ -85,6 +90,9 @@ static inline StatTime TimeZero() { return (StatTime) 0; }
 #define FAUST_CLASS_PREFIX "F"
 #define FAUST_RECOMPILE_INTERVAL 5000 //ms
 
+// Compiled factories are cached on disk as machine code, in this folder. If not defined, the system temporary folder is used
+//#define FAUST_CACHE_PATH "/path/to/cache/"
+
 #ifndef FAUST_EXE
   #if defined OS_MAC || defined OS_LINUX
     #define FAUST_EXE "/usr/local/bin/faust"
@@ -138,8 +146,28 @@ class FaustGen : public IPlugFaust
     Factory(const Factory&) = delete;
     Factory& operator=(const Factory&) = delete;
       
+    using LLVMFactoryPtr = std::shared_ptr<llvm_dsp_factory>;
+
+    /** @return A pointer that deletes the factory once neither a Factory nor a DSP created from it holds it, or null if pFactory is null */
+    static LLVMFactoryPtr MakeLLVMFactoryPtr(llvm_dsp_factory* pFactory);
+
     llvm_dsp_factory* CreateFactoryFromBitCode();
     llvm_dsp_factory* CreateFactoryFromSourceCode();
+
+    /** Gets a factory for the current source code and compile options from the memory cache, the disk cache, or by compiling it */
+    LLVMFactoryPtr CreateFactoryCached();
+
+    /** Removes a factory that has been replaced from the memory cache, it is deleted once the DSPs created from it are */
+    static void ReleaseCachedFactory(const LLVMFactoryPtr& pFactory);
+
+    /** Queues this factory to be recompiled on the compile thread. The instances keep running the current DSP until the new one is ready */
+    void CompileAsync();
+
+    /** Called on the compile thread, compiles and hands new DSP instances to all instances of this factory */
+    void Recompile();
+
+    /** Releases all cached factories, when no DSP instances are left */
+    static void FreeFactoryCache();
     
     /** If DSP already exists will return it, otherwise create it
      * @return pointer to the DSP instance */
@@ -156,10 +184,14 @@ class FaustGen : public IPlugFaust
     void UpdateSourceCode(const char* str);
 
     ::dsp* CreateDSPInstance(int nVoices = 0);
-    void AddInstance(FaustGen* pDSP) { mInstances.insert(pDSP); }
-    void RemoveInstance(FaustGen* pDSP);
+    void AddInstance(FaustGen* pDSP) { WDL_MutexLock lock(&mDSPMutex); mInstances.insert(pDSP); }
+
+    /** Once this returns, Recompile() can no longer hand pDSP a DSP
+     * @return \c true if that was the last instance, the caller then deletes the factory */
+    bool RemoveInstance(FaustGen* pDSP);
 
-    bool LoadFile(const char* file);
+    /** @param init If \c true, the instances are reinitialised synchronously, otherwise the caller should call CompileAsync() */
+    bool LoadFile(const char* file, bool init = true);
     bool WriteToFile(const char* file);
     void SetCompileOptions(std::initializer_list<const char*> options);
 
@@ -190,10 +222,11 @@ class FaustGen : public IPlugFaust
 
   private:
     int mInstanceIdx;
-    WDL_Mutex mDSPMutex;
+    WDL_Mutex mDSPMutex; // held while compiling, and while the instances are modified
     std::set<FaustGen*> mInstances;
+    std::atomic<bool> mCompilePending {false}; // queued for the compile thread
 
-    llvm_dsp_factory* mLLVMFactory = nullptr;
+    LLVMFactoryPtr mLLVMFactory;
     //  midi_handler mMidiHandler;
     WDL_FastString mSourceCodeStr;
     WDL_FastString mBitCodeStr;
@@ -209,6 +242,8 @@ class FaustGen : public IPlugFaust
     int mOptimizationLevel = LLVM_OPTIMIZATION;
     static int sFactoryCounter;
     static std::map<std::string, Factory*> sFactoryMap;
+    static std::map<std::string, LLVMFactoryPtr> sFactoryCache; // keyed by a hash of the source code, compile options and target
+    static std::mutex sFactoryCacheMutex;
     WDL_String mInputDSPFile;
     StatTime mPreviousTime;
   };
@@ -225,7 +260,7 @@ public:
   /** Call this method after constructing the class to inform FaustGen what the maximum I/O count is
    * @param maxNInputs Specify a number here to tell FaustGen the maximum number of inputs the hosting code can accommodate
    * @param maxNOutputs Specify a number here to tell FaustGen the maximum number of outputs the hosting code can accommodate */
-  void SetMaxChannelCount(int maxNInputs, int maxNOutputs) override { mMaxNInputs = maxNInputs; mMaxNOutputs = maxNOutputs; }
+  void SetMaxChannelCount(int maxNInputs, int maxNOutputs) override { mMaxNInputs = mNInputChans = maxNInputs; mMaxNOutputs = maxNOutputs; }
   
   /** Call this method after constructing the class to JIT compile */
   void Init() override;
@@ -245,7 +280,12 @@ public:
 
   void SetAutoRecompile(bool enable);
   
+  /** @param func Called on the main thread after the DSP is (re)compiled, by Init() or, after a compile in the background, by OnIdle() */
   void SetCompileFunc(std::function<void()> func) { mOnCompileFunc = func; }
+
+  /** Call this periodically on the main thread, e.g. from the plug-in's OnIdle(). After a compile in the background, this relinks the plug-in's parameters
+   * and calls the compile function, see SetCompileFunc() */
+  bool OnIdle() override;
   
   void OnTimer(Timer& timer);
   
@@ -254,13 +294,27 @@ public:
   void SetErrored(bool errored) { mErrored = errored; }
   
 private:
+  /** Called on the compile thread with a new DSP instance, which is handed to the audio thread with its own parameters and zones, and its parameters to the main thread
+   * @param pFactory The factory that created the DSP, which is kept until the DSP is deleted */
+  void OnCompiled(::dsp* pDSP, const Factory::LLVMFactoryPtr& pFactory);
+
+  static void StartCompileThread();
+  static void StopCompileThread();
+  static void CompileThreadProc();
+
   Factory* mFactory = nullptr;
+  static std::thread sCompileThread;
+  static std::mutex sCompileMutex;
+  static std::condition_variable sCompileCV;
+  static std::deque<Factory*> sCompileQueue;
+  static bool sCompileThreadRunning;
+  static bool sCompiling;
   static Timer* sTimer;
   static int sFaustGenCounter;
   static bool sAutoRecompile;
   int mMaxNInputs = -1;
   int mMaxNOutputs = -1;
-  bool mErrored = false;
+  std::atomic<bool> mErrored {false};
   std::function<void()> mOnCompileFunc = nullptr;
   
   WDL_Mutex mMutex;
@@ -0,0 +1,171 @@
+/*
+ ==============================================================================
+ 
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers. 
+ 
+ See LICENSE.txt for  more info.
+ 
+ ==============================================================================
+*/
+
+#pragma once
+
+/**
+ * @file
+ * @brief 128 bit vector operations for the banks in IPlug/Extras that process many smoothers or envelopes in lanes.
+ * SSE2 and NEON are part of every x86_64 and arm64 CPU, so unlike the AVX2 kernels in IGraphicsLicePreMul.h, these need no runtime check
+ */
+
+#include "IPlugPlatform.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+  #define IPLUG_LANES_SSE2 1
+  #include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__) || defined(_M_ARM64)
+  #define IPLUG_LANES_NEON 1
+  #include <arm_neon.h>
+#endif
+
+BEGIN_IPLUG_NAMESPACE
+
+/** The vector operations of the lane kernels of SmootherBank and ADSREnvelopeBank, for the sample types the target has 128 bit registers for.
+ * Types without them have kAvailable == false, and the banks use scalar loops */
+template<typename T>
+struct LaneVector
+{
+  static constexpr bool kAvailable = false;
+};
+
+#if defined(IPLUG_LANES_SSE2)
+template<>
+struct LaneVector<float>
+{
+  static constexpr bool kAvailable = true;
+  static constexpr int kWidth = 4;
+  using V = __m128;
+
+  static inline V Load(const float* p) { return _mm_loadu_ps(p); }
+  static inline void Store(float* p, V v) { _mm_storeu_ps(p, v); }
+  static inline V Splat(float x) { return _mm_set1_ps(x); }
+  static inline V Add(V a, V b) { return _mm_add_ps(a, b); }
+  static inline V Sub(V a, V b) { return _mm_sub_ps(a, b); }
+  static inline V Mul(V a, V b) { return _mm_mul_ps(a, b); }
+  static inline V Max(V a, V b) { return _mm_max_ps(a, b); }
+
+  /** @return ifGreater in the lanes where a > b, otherwise in the others */
+  static inline V SelectGreater(V a, V b, V ifGreater, V otherwise)
+  {
+    const V mask = _mm_cmpgt_ps(a, b);
+    return _mm_or_ps(_mm_and_ps(mask, ifGreater), _mm_andnot_ps(mask, otherwise));
+  }
+
+  /** @return \c true if a > b in any lane */
+  static inline bool AnyGreater(V a, V b) { return _mm_movemask_ps(_mm_cmpgt_ps(a, b)) != 0; }
+
+  /** Turns kWidth frames of kWidth lanes into kWidth lanes of kWidth frames */
+  static inline void Transpose(V (&v)[kWidth]) { _MM_TRANSPOSE4_PS(v[0], v[1], v[2], v[3]); }
+};
+
+template<>
+struct LaneVector<double>
+{
+  static constexpr bool kAvailable = true;
+  static constexpr int kWidth = 2;
+  using V = __m128d;
+
+  static inline V Load(const double* p) { return _mm_loadu_pd(p); }
+  static inline void Store(double* p, V v) { _mm_storeu_pd(p, v); }
+  static inline V Splat(double x) { return _mm_set1_pd(x); }
+  static inline V Add(V a, V b) { return _mm_add_pd(a, b); }
+  static inline V Sub(V a, V b) { return _mm_sub_pd(a, b); }
+  static inline V Mul(V a, V b) { return _mm_mul_pd(a, b); }
+  static inline V Max(V a, V b) { return _mm_max_pd(a, b); }
+
+  static inline V SelectGreater(V a, V b, V ifGreater, V otherwise)
+  {
+    const V mask = _mm_cmpgt_pd(a, b);
+    return _mm_or_pd(_mm_and_pd(mask, ifGreater), _mm_andnot_pd(mask, otherwise));
+  }
+
+  static inline bool AnyGreater(V a, V b) { return _mm_movemask_pd(_mm_cmpgt_pd(a, b)) != 0; }
+
+  static inline void Transpose(V (&v)[kWidth])
+  {
+    const V lo = _mm_unpacklo_pd(v[0], v[1]);
+    v[1] = _mm_unpackhi_pd(v[0], v[1]);
+    v[0] = lo;
+  }
+};
+#elif defined(IPLUG_LANES_NEON)
+template<>
+struct LaneVector<float>
+{
+  static constexpr bool kAvailable = true;
+  static constexpr int kWidth = 4;
+  using V = float32x4_t;
+
+  static inline V Load(const float* p) { return vld1q_f32(p); }
+  static inline void Store(float* p, V v) { vst1q_f32(p, v); }
+  static inline V Splat(float x) { return vdupq_n_f32(x); }
+  static inline V Add(V a, V b) { return vaddq_f32(a, b); }
+  static inline V Sub(V a, V b) { return vsubq_f32(a, b); }
+  static inline V Mul(V a, V b) { return vmulq_f32(a, b); }
+  static inline V Max(V a, V b) { return vmaxq_f32(a, b); }
+
+  /** @return ifGreater in the lanes where a > b, otherwise in the others */
+  static inline V SelectGreater(V a, V b, V ifGreater, V otherwise) { return vbslq_f32(vcgtq_f32(a, b), ifGreater, otherwise); }
+
+  /** @return \c true if a > b in any lane */
+  static inline bool AnyGreater(V a, V b)
+  {
+    const uint32x4_t mask = vcgtq_f32(a, b);
+    const uint32x2_t halves = vorr_u32(vget_low_u32(mask), vget_high_u32(mask));
+    return (vget_lane_u32(halves, 0) | vget_lane_u32(halves, 1)) != 0;
+  }
+
+  /** Turns kWidth frames of kWidth lanes into kWidth lanes of kWidth frames */
+  static inline void Transpose(V (&v)[kWidth])
+  {
+    const float32x4x2_t ab = vtrnq_f32(v[0], v[1]);
+    const float32x4x2_t cd = vtrnq_f32(v[2], v[3]);
+    v[0] = vcombine_f32(vget_low_f32(ab.val[0]), vget_low_f32(cd.val[0]));
+    v[1] = vcombine_f32(vget_low_f32(ab.val[1]), vget_low_f32(cd.val[1]));
+    v[2] = vcombine_f32(vget_high_f32(ab.val[0]), vget_high_f32(cd.val[0]));
+    v[3] = vcombine_f32(vget_high_f32(ab.val[1]), vget_high_f32(cd.val[1]));
+  }
+};
+
+#if defined(__aarch64__) || defined(_M_ARM64)
+template<>
+struct LaneVector<double>
+{
+  static constexpr bool kAvailable = true;
+  static constexpr int kWidth = 2;
+  using V = float64x2_t;
+
+  static inline V Load(const double* p) { return vld1q_f64(p); }
+  static inline void Store(double* p, V v) { vst1q_f64(p, v); }
+  static inline V Splat(double x) { return vdupq_n_f64(x); }
+  static inline V Add(V a, V b) { return vaddq_f64(a, b); }
+  static inline V Sub(V a, V b) { return vsubq_f64(a, b); }
+  static inline V Mul(V a, V b) { return vmulq_f64(a, b); }
+  static inline V Max(V a, V b) { return vmaxq_f64(a, b); }
+  static inline V SelectGreater(V a, V b, V ifGreater, V otherwise) { return vbslq_f64(vcgtq_f64(a, b), ifGreater, otherwise); }
+
+  static inline bool AnyGreater(V a, V b)
+  {
+    const uint64x2_t mask = vcgtq_f64(a, b);
+    return (vgetq_lane_u64(mask, 0) | vgetq_lane_u64(mask, 1)) != 0;
+  }
+
+  static inline void Transpose(V (&v)[kWidth])
+  {
+    const V lo = vzip1q_f64(v[0], v[1]);
+    v[1] = vzip2q_f64(v[0], v[1]);
+    v[0] = lo;
+  }
+};
+#endif
+#endif
+
+END_IPLUG_NAMESPACE
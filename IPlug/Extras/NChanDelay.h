@@ -1,71 +1,256 @@
 /*
  ==============================================================================
- 
- This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers. 
- 
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
  See LICENSE.txt for  more info.
- 
+
  ==============================================================================
 */
 
 #pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <cmath>
+
+#include "heapbuf.h"
+
 #include "IPlugPlatform.h"
+#include "IPlugUtilities.h"
 
 BEGIN_IPLUG_NAMESPACE
 
-// A static delayline used to delay bypassed signals to match mLatency in AAX/VST3/AU
+/** Interpolation used for fractional delay reads */
+enum class EDelayInterp
+{
+  None,       // integer delay, the fractional part is truncated
+  Linear,     // 2 point linear interpolation
+  Lagrange3,  // 4 point, 3rd order Lagrange interpolation, minimum delay of 1 sample
+  Allpass     // 1st order Thiran allpass interpolation, flat magnitude response but needs a DelayTap state per read, minimum delay of 0.5 samples
+};
+
+/** A multichannel delay line, used to delay bypassed signals to match mLatency in AAX/VST3/AU, and as the basis of modulated delay effects.
+ * Each channel has its own contiguous power-of-two ring buffer, indexed with a mask. Constant delays are processed with block copies.
+ * Fractional and per-sample modulated reads from any number of taps are available via Write() and ReadTap(), for chorus, flanger or diffusion networks.
+ * Changing the delay time within the maximum set with SetMaxDelayTime() does not allocate. */
 template<typename T>
 class NChanDelayLine
 {
 public:
+  /** State of a modulated read position. Only the allpass interpolation uses it, but one should be kept per tap and channel regardless of the interpolation */
+  struct DelayTap
+  {
+    T z1 = 0; // previous output of the allpass interpolator
+  };
+
   NChanDelayLine(int nInputChans = 2, int nOutputChans = 2)
   : mNInChans(nInputChans)
   , mNOutChans(nOutputChans)
   {}
 
-  void SetDelayTime(int delayTimeSamples)
+  /** Allocates the buffers, this is the only method that allocates (apart from SetDelayTime() beyond the current maximum)
+   * @param maxDelaySamples The longest delay that will be set or read
+   * @param maxBlockSize The largest number of frames passed to Write() between calls to ReadTap() */
+  void SetMaxDelayTime(int maxDelaySamples, int maxBlockSize = 0)
   {
-    mDTSamples = delayTimeSamples;
-    mBuffer.Resize(mNInChans * delayTimeSamples);
+    mMaxDelay = std::max(maxDelaySamples, 0);
+    mMaxBlockSize = std::max(maxBlockSize, 0);
+
+    uint32_t capacity = 64;
+
+    while (capacity < static_cast<uint32_t>(mMaxDelay + mMaxBlockSize + kInterpGuard + 1))
+      capacity *= 2;
+
+    if (capacity != mCapacity)
+    {
+      mCapacity = capacity;
+      mMask = capacity - 1;
+      mBuffer.Resize(mNInChans * mCapacity);
+    }
+
+    mDTSamples = std::min(mDTSamples, static_cast<uint32_t>(mMaxDelay));
     mWriteAddress = 0;
     ClearBuffer();
   }
 
+  /** Set the constant delay used by ProcessBlock(). If the delay fits within the maximum delay time, the history is kept and nothing is allocated
+   * @param delayTimeSamples The delay in samples */
+  void SetDelayTime(int delayTimeSamples)
+  {
+    delayTimeSamples = std::max(delayTimeSamples, 0);
+
+    if (!mCapacity || delayTimeSamples > mMaxDelay)
+      SetMaxDelayTime(delayTimeSamples, mMaxBlockSize);
+
+    mDTSamples = delayTimeSamples;
+  }
+
+  /** @return The constant delay in samples, used by ProcessBlock() */
+  int GetDelayTime() const { return static_cast<int>(mDTSamples); }
+
   void ClearBuffer()
   {
-    memset(mBuffer.Get(), 0, mNInChans * mDTSamples * sizeof(T));
+    if (mCapacity)
+      memset(mBuffer.Get(), 0, mNInChans * mCapacity * sizeof(T));
   }
 
+  /** Delays the inputs by the constant delay time. Inputs and outputs may be the same buffers */
   void ProcessBlock(T** inputs, T** outputs, int nFrames)
   {
-    T* buffer = mBuffer.Get();
+    if (!mCapacity)
+      SetMaxDelayTime(mDTSamples);
+
+    const int nChans = static_cast<int>(std::min(mNInChans, mNOutChans));
+    int done = 0;
 
-    for (auto s = 0 ; s < nFrames; ++s)
+    while (done < nFrames)
     {
-      int32_t readAddress = mWriteAddress - mDTSamples;
-      readAddress %= mDTSamples;
+      // the input is written before the output is read, so a chunk must not overwrite samples that it still has to read
+      const int n = std::min(nFrames - done, static_cast<int>(mCapacity - mDTSamples));
 
-      for (auto c = 0; c < mNInChans; c++)
+      for (auto c = 0; c < nChans; c++)
       {
-        if (c < mNOutChans)
-        {
-          T input = inputs[c][s];
-          const int offset = c * mDTSamples;
-          outputs[c][s] = buffer[offset + readAddress];
-          buffer[offset + mWriteAddress] = input;
-        }
+        T* buffer = GetChannel(c);
+        CopyIn(buffer, mWriteAddress, inputs[c] + done, n);
+        CopyOut(buffer, mWriteAddress - mDTSamples, outputs[c] + done, n);
       }
 
-      mWriteAddress++;
-      mWriteAddress %= mDTSamples;
+      mWriteAddress = (mWriteAddress + n) & mMask;
+      done += n;
     }
   }
 
+  /** Writes a block of input to the delay line, without reading. Follow with ReadTap() calls for each tap and channel
+   * @param nFrames Must not be more than the maxBlockSize passed to SetMaxDelayTime() */
+  void Write(T** inputs, int nFrames)
+  {
+    assert(nFrames <= mMaxBlockSize);
+
+    mBlockStart = mWriteAddress;
+
+    for (auto c = 0; c < static_cast<int>(mNInChans); c++)
+      CopyIn(GetChannel(c), mWriteAddress, inputs[c], nFrames);
+
+    mWriteAddress = (mWriteAddress + nFrames) & mMask;
+  }
+
+  /** Reads a tap with a per-sample delay, relative to each sample of the block last passed to Write(). Delays are clamped to the range supported by the interpolation
+   * @param chan The channel to read
+   * @param delays The delay of each output sample, in samples
+   * @param output Receives nFrames samples
+   * @param nFrames The number of frames, no more than were passed to Write()
+   * @param tap The state of this tap, used by EDelayInterp::Allpass */
+  template <EDelayInterp INTERP = EDelayInterp::Linear>
+  void ReadTap(int chan, const T* delays, T* output, int nFrames, DelayTap& tap)
+  {
+    const T* buffer = GetChannel(chan);
+
+    for (auto s = 0; s < nFrames; s++)
+      output[s] = ReadSample<INTERP>(buffer, mBlockStart + s, delays[s], tap);
+  }
+
+  /** Reads a tap with a constant fractional delay, relative to each sample of the block last passed to Write() */
+  template <EDelayInterp INTERP = EDelayInterp::Linear>
+  void ReadTap(int chan, T delay, T* output, int nFrames, DelayTap& tap)
+  {
+    const T* buffer = GetChannel(chan);
+
+    if (INTERP == EDelayInterp::None || (INTERP != EDelayInterp::Allpass && delay == std::floor(delay) && delay >= MinDelay<INTERP>()))
+    {
+      CopyOut(buffer, mBlockStart - static_cast<uint32_t>(Clip(delay, T(0), static_cast<T>(mMaxDelay))), output, nFrames);
+      return;
+    }
+
+    for (auto s = 0; s < nFrames; s++)
+      output[s] = ReadSample<INTERP>(buffer, mBlockStart + s, delay, tap);
+  }
+
 private:
+  static constexpr int kInterpGuard = 4; // extra samples read by the interpolators
+
+  template <EDelayInterp INTERP>
+  static constexpr T MinDelay()
+  {
+    return INTERP == EDelayInterp::Lagrange3 ? T(1) : INTERP == EDelayInterp::Allpass ? T(0.5) : T(0);
+  }
+
+  T* GetChannel(int chan) { return mBuffer.Get() + chan * mCapacity; }
+
+  /** @param pos The position of the current sample in the ring
+   * @param delay The delay relative to pos, in samples */
+  template <EDelayInterp INTERP>
+  inline T ReadSample(const T* buffer, uint32_t pos, T delay, DelayTap& tap) const
+  {
+    delay = Clip(delay, MinDelay<INTERP>(), static_cast<T>(mMaxDelay));
+
+    auto at = [&](int i) { return buffer[(pos - static_cast<uint32_t>(i)) & mMask]; };
+
+    switch (INTERP)
+    {
+      case EDelayInterp::None:
+        return at(static_cast<int>(delay));
+      case EDelayInterp::Linear:
+      {
+        const int i = static_cast<int>(delay);
+        const T f = delay - i;
+        const T x0 = at(i);
+        return x0 + f * (at(i + 1) - x0);
+      }
+      case EDelayInterp::Lagrange3:
+      {
+        const int i = static_cast<int>(delay);
+        const T f = delay - i;
+        const T xm1 = at(i - 1), x0 = at(i), x1 = at(i + 1), x2 = at(i + 2);
+        const T fm1 = f - T(1), fm2 = f - T(2), fp1 = f + T(1);
+        return -f * fm1 * fm2 * (T(1) / T(6)) * xm1
+             + fp1 * fm1 * fm2 * T(0.5) * x0
+             - fp1 * f * fm2 * T(0.5) * x1
+             + fp1 * f * fm1 * (T(1) / T(6)) * x2;
+      }
+      case EDelayInterp::Allpass:
+      {
+        // keep the fractional part in [0.5, 1.5), where the 1st order allpass has a near constant phase delay
+        const int i = static_cast<int>(delay - T(0.5));
+        const T d = delay - i;
+        const T a = (T(1) - d) / (T(1) + d);
+        const T y = a * at(i) + at(i + 1) - a * tap.z1;
+        tap.z1 = y;
+        return y;
+      }
+    }
+
+    return T(0);
+  }
+
+  /** Copies n samples into the ring at pos, in at most two parts */
+  void CopyIn(T* buffer, uint32_t pos, const T* src, int n) const
+  {
+    pos &= mMask;
+    const int first = std::min(n, static_cast<int>(mCapacity - pos));
+    memcpy(buffer + pos, src, first * sizeof(T));
+    memcpy(buffer, src + first, (n - first) * sizeof(T));
+  }
+
+  /** Copies n samples out of the ring from pos, in at most two parts */
+  void CopyOut(const T* buffer, uint32_t pos, T* dest, int n) const
+  {
+    pos &= mMask;
+    const int first = std::min(n, static_cast<int>(mCapacity - pos));
+    memcpy(dest, buffer + pos, first * sizeof(T));
+    memcpy(dest + first, buffer, (n - first) * sizeof(T));
+  }
+
   WDL_TypedBuf<T> mBuffer;
   uint32_t mNInChans, mNOutChans;
+  uint32_t mCapacity = 0;
+  uint32_t mMask = 0;
   uint32_t mWriteAddress = 0;
+  uint32_t mBlockStart = 0;
   uint32_t mDTSamples = 0;
+  int mMaxDelay = 0;
+  int mMaxBlockSize = 0;
 } WDL_FIXALIGN;
 
 END_IPLUG_NAMESPACE
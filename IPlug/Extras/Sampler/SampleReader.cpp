@@ -0,0 +1,708 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+#include <algorithm>
+#include <cstring>
+
+#if defined _MSC_VER
+#include <intrin.h>
+#endif
+
+#include "SampleReader.h"
+
+using namespace iplug;
+
+static inline uint32_t ReadLE16(const uint8_t* p) { return p[0] | (p[1] << 8); }
+static inline uint32_t ReadLE32(const uint8_t* p) { return p[0] | (p[1] << 8) | (p[2] << 16) | (static_cast<uint32_t>(p[3]) << 24); }
+
+std::unique_ptr<ISampleReader> ISampleReader::Open(const char* path, unsigned int mmapMaxSize)
+{
+  std::unique_ptr<WDL_FileRead> pFile(new WDL_FileRead(path, 0, 65536, 4, 0, mmapMaxSize));
+  uint8_t header[12];
+
+  if (!pFile->IsOpen() || pFile->Read(header, 12) != 12 || pFile->SetPosition(0))
+    return nullptr;
+
+  if (!memcmp(header, "RIFF", 4) && !memcmp(header + 8, "WAVE", 4))
+  {
+    std::unique_ptr<WAVReader> pReader(new WAVReader(std::move(pFile)));
+
+    if (pReader->IsValid())
+      return pReader;
+  }
+  else if (!memcmp(header, "fLaC", 4))
+  {
+    std::unique_ptr<FLACReader> pReader(new FLACReader(std::move(pFile)));
+
+    if (pReader->IsValid())
+      return pReader;
+  }
+
+  return nullptr;
+}
+
+#pragma mark - WAV
+
+WAVReader::WAVReader(std::unique_ptr<WDL_FileRead> pFile)
+: mFile(std::move(pFile))
+{
+  const int64_t fileSize = mFile->GetSize();
+  int64_t pos = 12;
+  int format = 0;
+  bool haveFormat = false;
+  uint8_t chunk[8];
+
+  while (!mFile->SetPosition(pos) && mFile->Read(chunk, 8) == 8)
+  {
+    const uint32_t size = ReadLE32(chunk + 4);
+
+    if (!memcmp(chunk, "fmt ", 4) && size >= 16)
+    {
+      uint8_t fmt[40] = {};
+
+      if (mFile->Read(fmt, static_cast<int>(std::min(size, 40u))) < 16)
+        return;
+
+      format = ReadLE16(fmt);
+      mNChans = ReadLE16(fmt + 2);
+      mSampleRate = ReadLE32(fmt + 4);
+      mBlockAlign = ReadLE16(fmt + 12);
+      mBitsPerSample = ReadLE16(fmt + 14);
+
+      if (format == 0xFFFE && size >= 26) // WAVE_FORMAT_EXTENSIBLE, the format is the first two bytes of the sub format GUID
+        format = ReadLE16(fmt + 24);
+
+      haveFormat = true;
+    }
+    else if (!memcmp(chunk, "data", 4) && haveFormat)
+    {
+      const bool intFormat = format == 1 && (mBitsPerSample == 8 || mBitsPerSample == 16 || mBitsPerSample == 24 || mBitsPerSample == 32);
+      const bool floatFormat = format == 3 && (mBitsPerSample == 32 || mBitsPerSample == 64);
+
+      if ((!intFormat && !floatFormat) || mNChans <= 0 || mBlockAlign != mNChans * mBitsPerSample / 8)
+        return;
+
+      // The size is 0xFFFFFFFF or too large in some files that were written while recording
+      mNFrames = std::min<int64_t>(size, fileSize - (pos + 8)) / mBlockAlign;
+      mFloat = floatFormat;
+      mDataOffset = pos + 8;
+      return;
+    }
+
+    pos += 8 + static_cast<int64_t>(size) + (size & 1);
+  }
+}
+
+int WAVReader::Read(int64_t startFrame, float** ppDest, int nFrames)
+{
+  if (startFrame < 0 || startFrame >= mNFrames || nFrames <= 0)
+    return 0;
+
+  nFrames = static_cast<int>(std::min<int64_t>(nFrames, mNFrames - startFrame));
+  mBuffer.resize(static_cast<size_t>(nFrames) * mBlockAlign);
+
+  if (mFile->SetPosition(mDataOffset + startFrame * mBlockAlign))
+    return 0;
+
+  nFrames = mFile->Read(mBuffer.data(), nFrames * mBlockAlign) / mBlockAlign;
+
+  const int bytesPerSample = mBitsPerSample / 8;
+
+  for (int c = 0; c < mNChans; c++)
+  {
+    const uint8_t* pIn = mBuffer.data() + c * bytesPerSample;
+    float* pOut = ppDest[c];
+
+    for (int i = 0; i < nFrames; i++, pIn += mBlockAlign)
+    {
+      if (mFloat)
+      {
+        if (mBitsPerSample == 32)
+        {
+          float f;
+          memcpy(&f, pIn, 4);
+          pOut[i] = f;
+        }
+        else
+        {
+          double d;
+          memcpy(&d, pIn, 8);
+          pOut[i] = static_cast<float>(d);
+        }
+      }
+      else
+      {
+        switch (mBitsPerSample)
+        {
+          case 8:  pOut[i] = (pIn[0] - 128) * (1.f / 128.f); break;
+          case 16: pOut[i] = static_cast<int16_t>(ReadLE16(pIn)) * (1.f / 32768.f); break;
+          case 24: pOut[i] = (static_cast<int32_t>((pIn[0] << 8) | (pIn[1] << 16) | (static_cast<uint32_t>(pIn[2]) << 24)) >> 8) * (1.f / 8388608.f); break;
+          case 32: pOut[i] = static_cast<int32_t>(ReadLE32(pIn)) * (1.f / 2147483648.f); break;
+        }
+      }
+    }
+  }
+
+  return nFrames;
+}
+
+#pragma mark - FLAC
+
+/** Reads the big endian bit stream of a FLAC frame. The data must be followed by 8 bytes of padding, since it reads 64 bits at a time */
+class iplug::FLACBitReader
+{
+public:
+  FLACBitReader(const uint8_t* pData, int size)
+  : mData(pData), mNBits(static_cast<int64_t>(size) * 8)
+  {}
+
+  /** @param n The number of bits, up to 32 */
+  uint32_t ReadBits(int n)
+  {
+    if (!n)
+      return 0;
+
+    const uint64_t word = Load(mBitPos >> 3) << (mBitPos & 7);
+    mBitPos += n;
+    return static_cast<uint32_t>(word >> (64 - n));
+  }
+
+  /** @param n The number of bits, up to 32 */
+  int32_t ReadSigned(int n)
+  {
+    if (!n)
+      return 0;
+
+    return static_cast<int32_t>(ReadBits(n) << (32 - n)) >> (32 - n);
+  }
+
+  /** @return The number of 0 bits before the next 1 bit, which is skipped */
+  uint32_t ReadUnary()
+  {
+    uint32_t count = 0;
+
+    while (mBitPos < mNBits)
+    {
+      const int shift = static_cast<int>(mBitPos & 7);
+      const uint64_t word = Load(mBitPos >> 3) << shift;
+
+      if (word)
+      {
+        const int zeros = CountLeadingZeros(word);
+
+        if (zeros < 64 - shift)
+        {
+          mBitPos += zeros + 1;
+          return count + zeros;
+        }
+      }
+
+      count += 64 - shift;
+      mBitPos += 64 - shift;
+    }
+
+    return count;
+  }
+
+  void Skip(int n) { mBitPos += n; }
+
+  /** @return \c true if more bits were read than there are */
+  bool Overrun() const { return mBitPos > mNBits; }
+
+private:
+  static inline int CountLeadingZeros(uint64_t x)
+  {
+#if defined _MSC_VER
+    unsigned long idx;
+    _BitScanReverse64(&idx, x);
+    return 63 - static_cast<int>(idx);
+#else
+    return __builtin_clzll(x);
+#endif
+  }
+
+  uint64_t Load(int64_t byte) const
+  {
+    const uint8_t* p = mData + std::min(byte, mNBits >> 3);
+    uint64_t word = 0;
+
+    for (int i = 0; i < 8; i++)
+      word = (word << 8) | p[i];
+
+    return word;
+  }
+
+  const uint8_t* mData;
+  int64_t mNBits;
+  int64_t mBitPos = 0;
+};
+
+static constexpr int kFLACMaxHeaderSize = 16;
+static constexpr int kFLACScanChunkSize = 65536;
+
+struct FLACCRC8Table
+{
+  uint8_t mTable[256];
+
+  FLACCRC8Table()
+  {
+    for (int i = 0; i < 256; i++)
+    {
+      uint8_t crc = static_cast<uint8_t>(i);
+
+      for (int b = 0; b < 8; b++)
+        crc = (crc & 0x80) ? static_cast<uint8_t>((crc << 1) ^ 0x07) : static_cast<uint8_t>(crc << 1);
+
+      mTable[i] = crc;
+    }
+  }
+};
+
+static uint8_t FLACCRC8(const uint8_t* pData, int size)
+{
+  static const FLACCRC8Table sTable; // thread safe initialisation, readers may be opened on several threads
+  uint8_t crc = 0;
+
+  for (int i = 0; i < size; i++)
+    crc = sTable.mTable[crc ^ pData[i]];
+
+  return crc;
+}
+
+FLACReader::FLACReader(std::unique_ptr<WDL_FileRead> pFile)
+: mFile(std::move(pFile))
+{
+  mFileSize = mFile->GetSize();
+  int64_t pos = 4;
+  bool haveStreamInfo = false;
+  uint8_t header[4];
+
+  while (ReadAt(pos, header, 4))
+  {
+    const int type = header[0] & 0x7F;
+    const int size = (header[1] << 16) | (header[2] << 8) | header[3];
+
+    if (type == 0 && size >= 34)
+    {
+      uint8_t info[34];
+
+      if (!ReadAt(pos + 4, info, 34))
+        return;
+
+      const int maxBlockSize = (info[2] << 8) | info[3];
+      mMinFrameSize = (info[4] << 16) | (info[5] << 8) | info[6];
+      mSampleRate = (info[10] << 12) | (info[11] << 4) | (info[12] >> 4);
+      mNChans = ((info[12] >> 1) & 7) + 1;
+      mBitsPerSample = (((info[12] & 1) << 4) | (info[13] >> 4)) + 1;
+      mNFrames = (static_cast<int64_t>(info[13] & 0xF) << 32) | (static_cast<int64_t>(info[14]) << 24) | (info[15] << 16) | (info[16] << 8) | info[17];
+      mMaxBlockSize = maxBlockSize;
+      haveStreamInfo = true;
+    }
+
+    pos += 4 + size;
+
+    if (header[0] & 0x80)
+      break;
+  }
+
+  // The total length is needed to stream, and is only unknown in files written by live encoders
+  if (!haveStreamInfo || mBitsPerSample > 24 || mBitsPerSample < 4 || mSampleRate <= 0. || mNFrames <= 0 || mMaxBlockSize < 16)
+    return;
+
+  mFirstFrameOffset = pos;
+  mScanOffset = pos;
+}
+
+bool FLACReader::ReadAt(int64_t offset, uint8_t* pDest, int size)
+{
+  return !mFile->SetPosition(offset) && mFile->Read(pDest, size) == size;
+}
+
+bool FLACReader::ParseFrameHeader(const uint8_t* p, int size, FrameHeader& header) const
+{
+  if (size < 6 || p[0] != 0xFF || (p[1] & 0xFE) != 0xF8)
+    return false;
+
+  const bool variableBlockSize = p[1] & 1;
+  const int blockSizeCode = p[2] >> 4;
+  const int sampleRateCode = p[2] & 0xF;
+  const int channelCode = p[3] >> 4;
+  const int sampleSizeCode = (p[3] >> 1) & 7;
+
+  if (!blockSizeCode || sampleRateCode == 15 || channelCode > 10 || sampleSizeCode == 3 || (p[3] & 1))
+    return false;
+
+  if ((channelCode < 8 ? channelCode + 1 : 2) != mNChans)
+    return false;
+
+  // The frame or sample number, coded like UTF-8
+  int pos = 4;
+  uint64_t number = p[pos++];
+  int extra = 0;
+
+  if (number < 0x80)        extra = 0;
+  else if (number >= 0xFE)  { number = 0; extra = 6; if (p[pos - 1] != 0xFE) return false; }
+  else if (number >= 0xFC)  { number &= 0x01; extra = 5; }
+  else if (number >= 0xF8)  { number &= 0x03; extra = 4; }
+  else if (number >= 0xF0)  { number &= 0x07; extra = 3; }
+  else if (number >= 0xE0)  { number &= 0x0F; extra = 2; }
+  else if (number >= 0xC0)  { number &= 0x1F; extra = 1; }
+  else return false;
+
+  if (pos + extra + 5 > size)
+    return false;
+
+  for (int i = 0; i < extra; i++, pos++)
+  {
+    if ((p[pos] & 0xC0) != 0x80)
+      return false;
+
+    number = (number << 6) | (p[pos] & 0x3F);
+  }
+
+  int blockSize;
+
+  if (blockSizeCode == 1)       blockSize = 192;
+  else if (blockSizeCode <= 5)  blockSize = 576 << (blockSizeCode - 2);
+  else if (blockSizeCode == 6)  blockSize = p[pos++] + 1;
+  else if (blockSizeCode == 7)  { blockSize = ((p[pos] << 8) | p[pos + 1]) + 1; pos += 2; }
+  else                          blockSize = 256 << (blockSizeCode - 8);
+
+  if (sampleRateCode == 12)
+    pos += 1;
+  else if (sampleRateCode == 13 || sampleRateCode == 14)
+    pos += 2;
+
+  if (FLACCRC8(p, pos) != p[pos])
+    return false;
+
+  static const int sBitsPerSample[] = { 0, 8, 12, 0, 16, 20, 24, 32 };
+  header.mBitsPerSample = sampleSizeCode ? sBitsPerSample[sampleSizeCode] : mBitsPerSample;
+
+  if (header.mBitsPerSample != mBitsPerSample || blockSize > mMaxBlockSize)
+    return false;
+
+  header.mFirstSample = variableBlockSize ? static_cast<int64_t>(number) : static_cast<int64_t>(number) * mMaxBlockSize;
+  header.mBlockSize = blockSize;
+  header.mChannelAssignment = channelCode;
+  header.mSize = pos + 1;
+  return true;
+}
+
+bool FLACReader::IndexUpTo(int64_t sample)
+{
+  // Index until there is a frame after the one containing the sample, since that is where the frame ends
+  while (!mScanDone && (mFrames.empty() || mFrames.back().mFirstSample <= sample))
+  {
+    const int64_t expected = mFrames.empty() ? 0 : mFrames.back().mFirstSample + mFrames.back().mBlockSize;
+
+    if (expected >= mNFrames || mScanOffset >= mFileSize)
+    {
+      mScanDone = true;
+      break;
+    }
+
+    const bool bufferAtEnd = mScanBufferOffset >= 0 && mScanBufferOffset + static_cast<int64_t>(mScanBuffer.size()) >= mFileSize;
+
+    if (mScanBufferOffset < 0 || mScanOffset < mScanBufferOffset ||
+        (mScanOffset + kFLACMaxHeaderSize > mScanBufferOffset + static_cast<int64_t>(mScanBuffer.size()) && !bufferAtEnd))
+    {
+      const int size = static_cast<int>(std::min<int64_t>(kFLACScanChunkSize, mFileSize - mScanOffset));
+      mScanBuffer.resize(size);
+
+      if (!ReadAt(mScanOffset, mScanBuffer.data(), size))
+      {
+        mScanDone = true;
+        break;
+      }
+
+      mScanBufferOffset = mScanOffset;
+    }
+
+    const bool atEnd = mScanBufferOffset + static_cast<int64_t>(mScanBuffer.size()) >= mFileSize;
+    const uint8_t* p = mScanBuffer.data() + (mScanOffset - mScanBufferOffset);
+    const int avail = static_cast<int>(mScanBufferOffset + static_cast<int64_t>(mScanBuffer.size()) - mScanOffset);
+    FrameHeader header;
+    bool found = false;
+    int i = 0;
+
+    for (; i + 1 < avail; i++)
+    {
+      if (p[i] != 0xFF || (p[i + 1] & 0xFE) != 0xF8)
+        continue;
+
+      if (avail - i < kFLACMaxHeaderSize && !atEnd)
+        break; // refill the buffer from here
+
+      // The expected sample number rules out almost all false syncs in the frame data that pass the CRC
+      if (ParseFrameHeader(p + i, avail - i, header) && header.mFirstSample == expected)
+      {
+        found = true;
+        break;
+      }
+    }
+
+    mScanOffset += i;
+
+    if (found)
+    {
+      mFrames.push_back({ mScanOffset, header.mFirstSample, header.mBlockSize });
+      mScanOffset += std::max(header.mSize, mMinFrameSize);
+    }
+    else if (atEnd && i + 1 >= avail)
+    {
+      mScanDone = true;
+    }
+  }
+
+  return !mFrames.empty();
+}
+
+int FLACReader::FindFrame(int64_t sample)
+{
+  if (!IndexUpTo(sample))
+    return -1;
+
+  auto it = std::upper_bound(mFrames.begin(), mFrames.end(), sample, [](int64_t s, const FrameEntry& frame) { return s < frame.mFirstSample; });
+
+  if (it == mFrames.begin())
+    return -1;
+
+  --it;
+
+  if (sample >= it->mFirstSample + it->mBlockSize)
+    return -1;
+
+  return static_cast<int>(it - mFrames.begin());
+}
+
+bool FLACReader::DecodeSubframe(FLACBitReader& reader, int bps, int blockSize, int32_t* pDest)
+{
+  if (reader.ReadBits(1))
+    return false;
+
+  const int type = static_cast<int>(reader.ReadBits(6));
+  int wasted = 0;
+
+  if (reader.ReadBits(1))
+    wasted = static_cast<int>(reader.ReadUnary()) + 1;
+
+  bps -= wasted;
+
+  if (bps <= 0 || bps > 32)
+    return false;
+
+  int order = 0;
+  int32_t coefs[32];
+  int precision = 0, shift = 0;
+
+  if (type == 0)
+  {
+    const int32_t value = reader.ReadSigned(bps);
+    std::fill(pDest, pDest + blockSize, value);
+  }
+  else if (type == 1)
+  {
+    for (int i = 0; i < blockSize; i++)
+      pDest[i] = reader.ReadSigned(bps);
+  }
+  else if ((type >= 8 && type <= 12) || type >= 32)
+  {
+    const bool lpc = type >= 32;
+    order = lpc ? type - 31 : type - 8;
+
+    if (order > blockSize)
+      return false;
+
+    for (int i = 0; i < order; i++)
+      pDest[i] = reader.ReadSigned(bps);
+
+    if (lpc)
+    {
+      precision = static_cast<int>(reader.ReadBits(4)) + 1;
+      shift = reader.ReadSigned(5);
+
+      if (precision == 16 || shift < 0)
+        return false;
+
+      for (int i = 0; i < order; i++)
+        coefs[i] = reader.ReadSigned(precision);
+    }
+
+    // Residual, in 2^partitionOrder partitions, each with its own Rice parameter or an escape code followed by raw samples
+    const int method = static_cast<int>(reader.ReadBits(2));
+
+    if (method > 1)
+      return false;
+
+    const int paramBits = method ? 5 : 4;
+    const uint32_t escape = method ? 31 : 15;
+    const int partitionOrder = static_cast<int>(reader.ReadBits(4));
+    const int partitionSize = blockSize >> partitionOrder;
+
+    if ((partitionSize << partitionOrder) != blockSize || partitionSize < order)
+      return false;
+
+    int32_t* pResidual = pDest + order;
+
+    for (int p = 0; p < (1 << partitionOrder); p++)
+    {
+      const int n = partitionSize - (p ? 0 : order);
+      const uint32_t param = reader.ReadBits(paramBits);
+
+      if (param == escape)
+      {
+        const int bits = static_cast<int>(reader.ReadBits(5));
+
+        for (int i = 0; i < n; i++)
+          *pResidual++ = reader.ReadSigned(bits);
+      }
+      else
+      {
+        for (int i = 0; i < n; i++)
+        {
+          const uint32_t u = (reader.ReadUnary() << param) | reader.ReadBits(param);
+          *pResidual++ = static_cast<int32_t>(u >> 1) ^ -static_cast<int32_t>(u & 1);
+        }
+      }
+
+      if (reader.Overrun())
+        return false;
+    }
+
+    // Prediction, the residual is replaced with the samples
+    if (lpc)
+    {
+      for (int i = order; i < blockSize; i++)
+      {
+        int64_t sum = 0;
+
+        for (int j = 0; j < order; j++)
+          sum += static_cast<int64_t>(coefs[j]) * pDest[i - j - 1];
+
+        pDest[i] += static_cast<int32_t>(sum >> shift);
+      }
+    }
+    else
+    {
+      switch (order)
+      {
+        case 1: for (int i = 1; i < blockSize; i++) pDest[i] += pDest[i - 1]; break;
+        case 2: for (int i = 2; i < blockSize; i++) pDest[i] += 2 * pDest[i - 1] - pDest[i - 2]; break;
+        case 3: for (int i = 3; i < blockSize; i++) pDest[i] += 3 * pDest[i - 1] - 3 * pDest[i - 2] + pDest[i - 3]; break;
+        case 4: for (int i = 4; i < blockSize; i++) pDest[i] += 4 * pDest[i - 1] - 6 * pDest[i - 2] + 4 * pDest[i - 3] - pDest[i - 4]; break;
+      }
+    }
+  }
+  else
+    return false;
+
+  if (wasted)
+  {
+    for (int i = 0; i < blockSize; i++)
+      pDest[i] = static_cast<int32_t>(static_cast<uint32_t>(pDest[i]) << wasted);
+  }
+
+  return !reader.Overrun();
+}
+
+bool FLACReader::DecodeFrame(int frameIdx)
+{
+  mDecodedFrame = -1;
+
+  const FrameEntry& frame = mFrames[frameIdx];
+  const int64_t end = frameIdx + 1 < static_cast<int>(mFrames.size()) ? mFrames[frameIdx + 1].mOffset : mFileSize;
+  const int size = static_cast<int>(end - frame.mOffset);
+
+  mFrameBytes.assign(size + 8, 0);
+
+  if (!ReadAt(frame.mOffset, mFrameBytes.data(), size))
+    return false;
+
+  FrameHeader header;
+
+  if (!ParseFrameHeader(mFrameBytes.data(), size, header))
+    return false;
+
+  FLACBitReader reader(mFrameBytes.data(), size);
+  reader.Skip(header.mSize * 8);
+
+  const int assignment = header.mChannelAssignment;
+
+  for (int c = 0; c < mNChans; c++)
+  {
+    // The side channel of the stereo modes has an extra bit
+    const bool side = (assignment == 8 && c == 1) || (assignment == 9 && c == 0) || (assignment == 10 && c == 1);
+    mDecoded[c].resize(header.mBlockSize);
+
+    if (!DecodeSubframe(reader, header.mBitsPerSample + (side ? 1 : 0), header.mBlockSize, mDecoded[c].data()))
+      return false;
+  }
+
+  if (assignment >= 8)
+  {
+    int32_t* pA = mDecoded[0].data();
+    int32_t* pB = mDecoded[1].data();
+
+    for (int i = 0; i < header.mBlockSize; i++)
+    {
+      if (assignment == 8)      // left, side
+        pB[i] = pA[i] - pB[i];
+      else if (assignment == 9) // side, right
+        pA[i] += pB[i];
+      else                      // mid, side
+      {
+        const int32_t mid = static_cast<int32_t>((static_cast<uint32_t>(pA[i]) << 1) | (pB[i] & 1));
+        pA[i] = (mid + pB[i]) >> 1;
+        pB[i] = (mid - pB[i]) >> 1;
+      }
+    }
+  }
+
+  mDecodedFrame = frameIdx;
+  mDecodedBitsPerSample = header.mBitsPerSample;
+  return true;
+}
+
+int FLACReader::Read(int64_t startFrame, float** ppDest, int nFrames)
+{
+  int done = 0;
+
+  while (done < nFrames && startFrame + done < mNFrames && startFrame >= 0)
+  {
+    const int64_t pos = startFrame + done;
+
+    if (mDecodedFrame < 0 || pos < mFrames[mDecodedFrame].mFirstSample || pos >= mFrames[mDecodedFrame].mFirstSample + mFrames[mDecodedFrame].mBlockSize)
+    {
+      const int frameIdx = FindFrame(pos);
+
+      if (frameIdx < 0 || !DecodeFrame(frameIdx))
+        break;
+    }
+
+    const FrameEntry& frame = mFrames[mDecodedFrame];
+    const int offset = static_cast<int>(pos - frame.mFirstSample);
+    const int n = std::min(frame.mBlockSize - offset, nFrames - done);
+    const float scale = 1.f / static_cast<float>(1 << (mDecodedBitsPerSample - 1));
+
+    for (int c = 0; c < mNChans; c++)
+    {
+      const int32_t* pIn = mDecoded[c].data() + offset;
+      float* pOut = ppDest[c] + done;
+
+      for (int i = 0; i < n; i++)
+        pOut[i] = pIn[i] * scale;
+    }
+
+    done += n;
+  }
+
+  return done;
+}
@@ -0,0 +1,141 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+#pragma once
+
+/**
+ * @file
+ * @brief Random access readers for WAV and FLAC files, used by SampleStreamer
+ */
+
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+#include "IPlugPlatform.h"
+
+#ifndef OS_WIN
+  #include <unistd.h> // fileread.h uses pread() and close() without including it
+#endif
+#include "fileread.h"
+
+BEGIN_IPLUG_NAMESPACE
+
+class FLACBitReader;
+
+/** Reads frames of an audio file from any position, as planar floats. Readers are not thread safe, each one should only be used by one thread at a time */
+class ISampleReader
+{
+public:
+  virtual ~ISampleReader() {}
+
+  /** Opens a WAV or FLAC file, detected from its header
+   * @param path The file path
+   * @param mmapMaxSize Files smaller than this are memory mapped, larger ones are read with read-ahead buffering
+   * @return The reader, or nullptr if the file couldn't be opened or its format isn't supported */
+  static std::unique_ptr<ISampleReader> Open(const char* path, unsigned int mmapMaxSize = 64 * 1024 * 1024);
+
+  /** Reads frames, converted to floats in the range -1 to 1
+   * @param startFrame The first frame to read
+   * @param ppDest An array of NChans() channel buffers, of at least nFrames each
+   * @param nFrames The number of frames to read
+   * @return The number of frames read, which is less than nFrames at the end of the file or on an error */
+  virtual int Read(int64_t startFrame, float** ppDest, int nFrames) = 0;
+
+  int NChans() const { return mNChans; }
+  int64_t NFrames() const { return mNFrames; }
+  double GetSampleRate() const { return mSampleRate; }
+  int GetBitsPerSample() const { return mBitsPerSample; }
+
+protected:
+  int mNChans = 0;
+  int64_t mNFrames = 0;
+  double mSampleRate = 0.;
+  int mBitsPerSample = 0;
+};
+
+/** Reads 8, 16, 24 and 32 bit integer and 32 and 64 bit float PCM WAV files, including WAVE_FORMAT_EXTENSIBLE ones */
+class WAVReader final : public ISampleReader
+{
+public:
+  /** @param pFile An open file, which the reader takes ownership of */
+  WAVReader(std::unique_ptr<WDL_FileRead> pFile);
+
+  /** @return \c true if the header was valid and the format is supported */
+  bool IsValid() const { return mDataOffset > 0; }
+
+  int Read(int64_t startFrame, float** ppDest, int nFrames) override;
+
+private:
+  std::unique_ptr<WDL_FileRead> mFile;
+  int64_t mDataOffset = 0;
+  int mBlockAlign = 0;
+  bool mFloat = false;
+  std::vector<uint8_t> mBuffer;
+};
+
+/** Reads FLAC files of up to 24 bits. FLAC has no random access, so the reader indexes frame positions as it goes,
+ * scanning for frame headers from the last indexed frame up to the one that is needed. Reading a file from the start, as streaming does,
+ * costs one pass over it, and the last decoded frame is kept, so consecutive reads that share a frame only decode it once */
+class FLACReader final : public ISampleReader
+{
+public:
+  /** @param pFile An open file, which the reader takes ownership of */
+  FLACReader(std::unique_ptr<WDL_FileRead> pFile);
+
+  /** @return \c true if the stream info was valid and the format is supported */
+  bool IsValid() const { return mFirstFrameOffset > 0; }
+
+  int Read(int64_t startFrame, float** ppDest, int nFrames) override;
+
+private:
+  struct FrameHeader
+  {
+    int64_t mFirstSample = 0;
+    int mBlockSize = 0;
+    int mChannelAssignment = 0;
+    int mBitsPerSample = 0;
+    int mSize = 0; // the size of the header in bytes
+  };
+
+  struct FrameEntry
+  {
+    int64_t mOffset;
+    int64_t mFirstSample;
+    int mBlockSize;
+  };
+
+  bool ParseFrameHeader(const uint8_t* pData, int size, FrameHeader& header) const;
+  bool IndexUpTo(int64_t sample);
+  int FindFrame(int64_t sample);
+  bool DecodeFrame(int frameIdx);
+  bool DecodeSubframe(FLACBitReader& reader, int bps, int blockSize, int32_t* pDest);
+  bool ReadAt(int64_t offset, uint8_t* pDest, int size);
+
+  std::unique_ptr<WDL_FileRead> mFile;
+  int64_t mFileSize = 0;
+  int64_t mFirstFrameOffset = 0;
+  int mMinFrameSize = 0;
+  int mMaxBlockSize = 0;
+
+  std::vector<FrameEntry> mFrames;
+  int64_t mScanOffset = 0; // where to continue scanning for frame headers
+  bool mScanDone = false;
+  std::vector<uint8_t> mScanBuffer;
+  int64_t mScanBufferOffset = -1;
+
+  int mDecodedFrame = -1;
+  int mDecodedBitsPerSample = 0;
+  std::vector<int32_t> mDecoded[8];
+  std::vector<uint8_t> mFrameBytes;
+};
+
+END_IPLUG_NAMESPACE
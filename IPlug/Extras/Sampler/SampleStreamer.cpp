@@ -0,0 +1,273 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+#include <chrono>
+
+#include "SampleStreamer.h"
+
+using namespace iplug;
+
+constexpr int SampleStreamer::kFadeInFrames;
+constexpr int SampleStreamer::kFadeOutFrames;
+constexpr int SampleStreamer::kMaxChans;
+
+#pragma mark - SampleStream
+
+int64_t SampleStream::ChunkStart(int64_t chunk) const
+{
+  return mChunkBase + chunk * mStreamer->mChunkFrames;
+}
+
+void SampleStream::AdvanceTo(int64_t position)
+{
+  const int64_t chunk = (position - mChunkBase) / mStreamer->mChunkFrames;
+
+  if (chunk == mCurrentChunk)
+    return;
+
+  // Every slot holds the first chunk at or after the current one that maps to it, so the slots of chunks that have been passed move on to the next lap of the ring
+  const int64_t nSlots = static_cast<int64_t>(mSlots.size());
+  mCurrentChunk = chunk;
+
+  for (int64_t s = 0; s < nSlots; s++)
+  {
+    Slot& slot = mSlots[s];
+    const int64_t target = chunk + ((s - chunk) % nSlots + nSlots) % nSlots;
+
+    if (slot.mChunk != target)
+    {
+      slot.mChunk = target;
+      slot.mReady = false;
+    }
+  }
+
+  mStreamer->RequestChunks(*this);
+}
+
+#pragma mark - SampleStreamer
+
+SampleStreamer::SampleStreamer(int maxStreams, int chunkFrames, int nChunks, int maxChans)
+: mNStreams(maxStreams)
+, mChunkFrames(chunkFrames)
+, mNChunks(std::max(2, nChunks))
+, mMaxChans(std::min(std::max(1, maxChans), kMaxChans))
+, mChunkData(static_cast<size_t>(maxStreams) * mNChunks * mMaxChans * chunkFrames)
+, mStreams(new SampleStream[maxStreams])
+, mRequests(maxStreams * mNChunks)
+, mCompletions(maxStreams * mNChunks)
+, mReadPtrs(kMaxChans)
+{
+  // Each slot has at most one request in flight, so neither queue can hold more than maxStreams * nChunks items
+  mFreeStreams.reserve(maxStreams);
+
+  for (int i = maxStreams - 1; i >= 0; i--)
+  {
+    SampleStream& stream = mStreams[i];
+    stream.mStreamer = this;
+    stream.mSlots.resize(mNChunks);
+    stream.mLastOutput.resize(mMaxChans);
+
+    for (int s = 0; s < mNChunks; s++)
+      stream.mSlots[s].mData = mChunkData.data() + (static_cast<size_t>(i) * mNChunks + s) * mMaxChans * mChunkFrames;
+
+    mFreeStreams.push_back(&stream);
+  }
+}
+
+SampleStreamer::~SampleStreamer()
+{
+  Stop();
+}
+
+const SampleZone* SampleStreamer::AddZone(const char* path, int preloadFrames)
+{
+  std::unique_ptr<ISampleReader> pReader = ISampleReader::Open(path);
+
+  if (!pReader || pReader->NChans() < 1 || pReader->NChans() > mMaxChans)
+    return nullptr;
+
+  std::unique_ptr<SampleZone> pZone(new SampleZone);
+  pZone->mPath.Set(path);
+  pZone->mNChans = pReader->NChans();
+  pZone->mNFrames = pReader->NFrames();
+  pZone->mSampleRate = pReader->GetSampleRate();
+  pZone->mNPreloadFrames = static_cast<int>(std::min<int64_t>(std::max(0, preloadFrames), pReader->NFrames()));
+  pZone->mPreload.resize(static_cast<size_t>(pZone->mNChans) * pZone->mNPreloadFrames);
+
+  float* ptrs[kMaxChans];
+
+  for (int c = 0; c < pZone->mNChans; c++)
+    ptrs[c] = pZone->mPreload.data() + static_cast<size_t>(c) * pZone->mNPreloadFrames;
+
+  if (pReader->Read(0, ptrs, pZone->mNPreloadFrames) != pZone->mNPreloadFrames)
+    return nullptr;
+
+  pZone->mReader = std::move(pReader);
+  mZones.push_back(std::move(pZone));
+  return mZones.back().get();
+}
+
+void SampleStreamer::ClearZones()
+{
+  mZones.clear();
+}
+
+void SampleStreamer::Start()
+{
+#if !defined OS_WEB
+  if (mRunning.exchange(true))
+    return;
+
+  mThread = std::thread([this]() { ThreadProc(); });
+#endif
+}
+
+void SampleStreamer::Stop()
+{
+#if !defined OS_WEB
+  if (!mRunning.exchange(false))
+    return;
+
+  mThread.join();
+#endif
+}
+
+void SampleStreamer::ProcessCompletions()
+{
+#if defined OS_WEB
+  ServiceRequests(); // no threads, so the reads happen here
+#endif
+
+  Completion completion;
+
+  while (mCompletions.Pop(completion))
+  {
+    SampleStream& stream = *completion.mStream;
+    SampleStream::Slot& slot = stream.mSlots[completion.mSlot];
+    slot.mInFlight = false;
+
+    if (!stream.mZone)
+      continue;
+
+    // A completion for a stream that has been restarted, or a slot that has moved on to another chunk, frees the slot to be requested again
+    if (completion.mGeneration == stream.mGeneration.load(std::memory_order_relaxed) && completion.mChunk == slot.mChunk)
+      slot.mReady = true;
+    else
+      RequestChunks(stream);
+  }
+}
+
+SampleStream* SampleStreamer::StartStream(const SampleZone* pZone, int64_t startFrame)
+{
+  if (!pZone || mFreeStreams.empty())
+    return nullptr;
+
+  SampleStream& stream = *mFreeStreams.back();
+  mFreeStreams.pop_back();
+
+  stream.mZone = pZone;
+  stream.mGeneration.store(stream.mGeneration.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+  stream.mPosition = std::min(std::max<int64_t>(startFrame, 0), pZone->NFrames());
+  stream.mEnd = pZone->NFrames();
+  stream.mChunkBase = std::max<int64_t>(stream.mPosition, pZone->NPreloadFrames());
+  stream.mCurrentChunk = 0;
+  stream.mNUnderruns = 0;
+  stream.mNUnderrunFrames = 0;
+  stream.mFadeIn = 0;
+  stream.mFadeOut = 0;
+
+  // Slots that are still in flight for the previous zone are requested again once their completions arrive
+  for (int s = 0; s < mNChunks; s++)
+  {
+    stream.mSlots[s].mChunk = s;
+    stream.mSlots[s].mReady = false;
+  }
+
+  RequestChunks(stream);
+  return &stream;
+}
+
+void SampleStreamer::StopStream(SampleStream* pStream)
+{
+  if (!pStream || !pStream->mZone)
+    return;
+
+  pStream->mZone = nullptr;
+  pStream->mGeneration.store(pStream->mGeneration.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+  pStream->mPosition = pStream->mEnd = 0;
+  mFreeStreams.push_back(pStream);
+}
+
+void SampleStreamer::RequestChunks(SampleStream& stream)
+{
+  const uint32_t generation = stream.mGeneration.load(std::memory_order_relaxed);
+
+  // Request the chunks in play order, starting from the current one
+  for (int i = 0; i < mNChunks; i++)
+  {
+    const int s = static_cast<int>((stream.mCurrentChunk + i) % mNChunks);
+    SampleStream::Slot& slot = stream.mSlots[s];
+
+    if (slot.mReady || slot.mInFlight)
+      continue;
+
+    const int64_t startFrame = stream.ChunkStart(slot.mChunk);
+
+    if (startFrame >= stream.mEnd)
+      continue;
+
+    const int nFrames = static_cast<int>(std::min<int64_t>(mChunkFrames, stream.mEnd - startFrame));
+
+    if (mRequests.Push({&stream, stream.mZone, slot.mData, generation, s, slot.mChunk, startFrame, nFrames}))
+      slot.mInFlight = true;
+  }
+}
+
+int SampleStreamer::ServiceRequests()
+{
+  Request request;
+  int nServiced = 0;
+
+  while (mRequests.Pop(request))
+  {
+    // Skip the read if the stream has been stopped or restarted since the request, the completion still has to be sent to free the slot
+    if (request.mStream->mGeneration.load(std::memory_order_relaxed) == request.mGeneration)
+    {
+      const int nChans = request.mZone->NChans();
+
+      for (int c = 0; c < nChans; c++)
+        mReadPtrs[c] = request.mData + static_cast<size_t>(c) * mChunkFrames;
+
+      const int nRead = std::max(0, request.mZone->mReader->Read(request.mStartFrame, mReadPtrs.data(), request.mNFrames));
+
+      // A file that can't be read plays as silence, rather than as an underrun that never ends
+      for (int c = 0; c < nChans; c++)
+        std::fill(mReadPtrs[c] + nRead, mReadPtrs[c] + request.mNFrames, 0.f);
+
+      mNFramesRead.fetch_add(nRead, std::memory_order_relaxed);
+    }
+
+    mCompletions.Push(request);
+    nServiced++;
+  }
+
+  return nServiced;
+}
+
+void SampleStreamer::ThreadProc()
+{
+#if !defined OS_WEB
+  while (mRunning.load(std::memory_order_acquire))
+  {
+    if (!ServiceRequests())
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+#endif
+}
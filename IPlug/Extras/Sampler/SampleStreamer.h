@@ -0,0 +1,350 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+#pragma once
+
+/**
+ * @file
+ * @brief Streaming of samples from disk for instruments with large multi-sample libraries
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "IPlugPlatform.h"
+#include "IPlugQueue.h"
+#include "wdlstring.h"
+
+#include "SampleReader.h"
+
+BEGIN_IPLUG_NAMESPACE
+
+class SampleStreamer;
+
+/** A sample file that can be streamed. The first frames are preloaded into memory, so that a stream can start playing straight away
+ * while the rest of the file is read in the background. Zones are created with SampleStreamer::AddZone(), and are immutable after that */
+class SampleZone final
+{
+public:
+  const char* GetPath() const { return mPath.Get(); }
+  int NChans() const { return mNChans; }
+  int64_t NFrames() const { return mNFrames; }
+  double GetSampleRate() const { return mSampleRate; }
+
+  /** @return The number of frames held in memory */
+  int NPreloadFrames() const { return mNPreloadFrames; }
+
+  /** @return The preloaded frames of a channel */
+  const float* GetPreload(int chan) const { return mPreload.data() + static_cast<size_t>(chan) * mNPreloadFrames; }
+
+private:
+  friend class SampleStreamer;
+
+  WDL_String mPath;
+  std::unique_ptr<ISampleReader> mReader; // only used by the I/O thread after the zone is created
+  int mNChans = 0;
+  int64_t mNFrames = 0;
+  double mSampleRate = 0.;
+  int mNPreloadFrames = 0;
+  std::vector<float> mPreload;
+};
+
+/** The playback of a zone by one voice. Streams are owned by the SampleStreamer, and are started, read and stopped on the audio thread.
+ * A stream plays the preloaded frames, then a ring of chunks that the I/O thread fills ahead of the play position.
+ * If a chunk isn't ready in time, the stream fades out to silence for it and keeps its position, so it stays in time, and fades back in when the data arrives */
+class SampleStream final
+{
+public:
+  /** @return \c true until the end of the zone has been reached */
+  bool IsPlaying() const { return mPosition < mEnd; }
+
+  /** @return The zone being played */
+  const SampleZone* GetZone() const { return mZone; }
+
+  /** @return The next frame to be read */
+  int64_t GetPosition() const { return mPosition; }
+
+  /** @return The number of times this stream has had to output silence because a chunk wasn't ready */
+  int NUnderruns() const { return mNUnderruns; }
+
+  /** @return The number of frames of silence this stream has output because chunks weren't ready */
+  int64_t NUnderrunFrames() const { return mNUnderrunFrames; }
+
+  /** Reads the next frames, which replace the contents of the buffers. A mono zone is copied to every channel, and channels beyond those of the zone are
+   * copied from its last channel. Frames after the end of the zone are cleared
+   * @param ppDest An array of nChans channel buffers, of at least nFrames each
+   * @param nChans The number of channels to write
+   * @param nFrames The number of frames to read
+   * @return The number of frames read before the end of the zone */
+  template <typename T>
+  int Read(T** ppDest, int nChans, int nFrames);
+
+private:
+  friend class SampleStreamer;
+
+  struct Slot
+  {
+    float* mData = nullptr; // planar, maxChans * chunkFrames
+    int64_t mChunk = -1; // the chunk this slot should hold
+    bool mReady = false;
+    bool mInFlight = false;
+  };
+
+  int64_t ChunkStart(int64_t chunk) const;
+  void AdvanceTo(int64_t position);
+
+  SampleStreamer* mStreamer = nullptr;
+  const SampleZone* mZone = nullptr;
+  std::atomic<uint32_t> mGeneration {0}; // changed on every start and stop, so that the I/O thread can skip work that is no longer needed
+  int64_t mPosition = 0;
+  int64_t mEnd = 0;
+  int64_t mChunkBase = 0; // the first frame of chunk 0, which is after the preload
+  int64_t mCurrentChunk = 0;
+  int mNUnderruns = 0;
+  int64_t mNUnderrunFrames = 0;
+  int mFadeIn = 0; // frames of the fade after an underrun that are still to be applied
+  int mFadeOut = 0; // frames of the fade from the last output frame that are still to be applied if a chunk isn't ready
+  std::vector<float> mLastOutput; // the last frame output, per channel of the zone
+  std::vector<Slot> mSlots;
+};
+
+/** Streams samples from disk for many voices at once. Zones keep their attack in memory, and a background I/O thread reads the rest of each file
+ * a few chunks ahead of every playing stream, with memory mapped or read-ahead file access, see ISampleReader.
+ * Voices and the I/O thread communicate through two lock-free SPSC rings, one for chunk requests and one for completions, which are sized so that they can never fill.
+ * All memory is allocated up front, so starting, reading and stopping streams never allocates, blocks or touches the disk.
+ *
+ * Typical use: add the zones when the instrument is loaded, call Start(), then on the audio thread call ProcessCompletions() at the start of each block,
+ * StartStream() on note on, SampleStream::Read() in the voice, and StopStream() when the voice is released or the stream has finished.
+ *
+ * How far ahead the I/O thread reads is chunkFrames * (nChunks - 1) frames, and the preload should cover at least the time it takes to read the first chunk,
+ * which depends on the disk and how many streams start together. A stream that starts after the preloaded frames can't play until its first chunk has been read */
+class SampleStreamer final
+{
+public:
+  static constexpr int kFadeInFrames = 64;
+  static constexpr int kFadeOutFrames = 64;
+  static constexpr int kMaxChans = 8;
+
+  /** @param maxStreams The number of streams that can play at once
+   * @param chunkFrames The number of frames read by each request
+   * @param nChunks The number of chunks buffered per stream, at least 2
+   * @param maxChans The maximum number of channels of a zone, up to kMaxChans */
+  SampleStreamer(int maxStreams = 256, int chunkFrames = 4096, int nChunks = 4, int maxChans = 2);
+
+  /** Stops the I/O thread. Streams must not be read after this */
+  ~SampleStreamer();
+
+  SampleStreamer(const SampleStreamer&) = delete;
+  SampleStreamer& operator=(const SampleStreamer&) = delete;
+
+  /** Opens a sample file and preloads its first frames. Call this on the main or a loading thread, not the audio thread.
+   * Zones are kept until the streamer is destroyed, or ClearZones() is called
+   * @param path The path of a WAV or FLAC file
+   * @param preloadFrames The number of frames to hold in memory, the whole file is preloaded if it is shorter
+   * @return The zone, or nullptr if the file couldn't be opened or has more than maxChans channels */
+  const SampleZone* AddZone(const char* path, int preloadFrames);
+
+  /** Removes all the zones. The I/O thread must be stopped and no streams may be playing */
+  void ClearZones();
+
+  /** Starts the I/O thread, if it isn't running */
+  void Start();
+
+  /** Stops the I/O thread, waiting for the request it is reading to finish */
+  void Stop();
+
+  /** Audio thread: handles the chunks the I/O thread has read since the last call, call this at the start of each block */
+  void ProcessCompletions();
+
+  /** Audio thread: starts playing a zone
+   * @param pZone The zone
+   * @param startFrame The frame to start from, which plays straight away if it is within the preloaded frames
+   * @return The stream, or nullptr if maxStreams are playing */
+  SampleStream* StartStream(const SampleZone* pZone, int64_t startFrame = 0);
+
+  /** Audio thread: stops a stream, which can then be reused by StartStream() */
+  void StopStream(SampleStream* pStream);
+
+  /** @return The number of streams started and not yet stopped */
+  int NActiveStreams() const { return mNStreams - static_cast<int>(mFreeStreams.size()); }
+
+  /** @return The number of times any stream has had to output silence because a chunk wasn't ready. Can be called on any thread */
+  int NUnderruns() const { return mNUnderruns.load(std::memory_order_relaxed); }
+
+  /** @return The number of frames the I/O thread has read. Can be called on any thread */
+  int64_t NFramesRead() const { return mNFramesRead.load(std::memory_order_relaxed); }
+
+  int GetChunkFrames() const { return mChunkFrames; }
+  int NChunks() const { return mNChunks; }
+
+private:
+  friend class SampleStream;
+
+  /** A chunk for the I/O thread to read, which it sends back as the completion once it has been read. Everything the I/O thread needs is copied
+   * into the request, so that it never reads the state of a stream, which the audio thread may be changing */
+  struct Request
+  {
+    SampleStream* mStream;
+    const SampleZone* mZone;
+    float* mData;
+    uint32_t mGeneration;
+    int mSlot;
+    int64_t mChunk;
+    int64_t mStartFrame;
+    int mNFrames;
+  };
+
+  using Completion = Request;
+
+  void RequestChunks(SampleStream& stream);
+  int ServiceRequests();
+  void ThreadProc();
+
+  int mNStreams;
+  int mChunkFrames;
+  int mNChunks;
+  int mMaxChans;
+
+  std::vector<std::unique_ptr<SampleZone>> mZones;
+  std::vector<float> mChunkData;
+  std::unique_ptr<SampleStream[]> mStreams;
+  std::vector<SampleStream*> mFreeStreams; // audio thread only, never grows beyond its reserved size
+
+  IPlugQueue<Request> mRequests;
+  IPlugQueue<Completion> mCompletions;
+  std::vector<float*> mReadPtrs; // I/O thread only
+
+  std::atomic<int> mNUnderruns {0};
+  std::atomic<int64_t> mNFramesRead {0};
+
+#if !defined OS_WEB
+  std::atomic<bool> mRunning {false};
+  std::thread mThread;
+#endif
+};
+
+#pragma mark - SampleStream
+
+template <typename T>
+int SampleStream::Read(T** ppDest, int nChans, int nFrames)
+{
+  const SampleZone& zone = *mZone;
+  const int lastChan = zone.NChans() - 1;
+  int done = 0;
+
+  while (done < nFrames && mPosition < mEnd)
+  {
+    const float* pSrc[SampleStreamer::kMaxChans] = {};
+    int64_t srcFrames;
+    bool underrun = false;
+
+    if (mPosition < zone.NPreloadFrames())
+    {
+      for (int c = 0; c <= lastChan; c++)
+        pSrc[c] = zone.GetPreload(c) + mPosition;
+
+      srcFrames = zone.NPreloadFrames() - mPosition;
+    }
+    else
+    {
+      const int64_t chunk = (mPosition - mChunkBase) / mStreamer->mChunkFrames;
+      const int64_t offset = mPosition - ChunkStart(chunk);
+      const Slot& slot = mSlots[chunk % mSlots.size()];
+
+      AdvanceTo(mPosition);
+      srcFrames = std::min<int64_t>(mStreamer->mChunkFrames - offset, mEnd - mPosition);
+
+      if (slot.mChunk == chunk && slot.mReady)
+      {
+        for (int c = 0; c <= lastChan; c++)
+          pSrc[c] = slot.mData + static_cast<size_t>(c) * mStreamer->mChunkFrames + offset;
+      }
+      else
+        underrun = true;
+    }
+
+    const int n = static_cast<int>(std::min<int64_t>(srcFrames, nFrames - done));
+
+    if (underrun)
+    {
+      if (!mFadeIn)
+      {
+        mNUnderruns++;
+        mStreamer->mNUnderruns.fetch_add(1, std::memory_order_relaxed);
+      }
+
+      mFadeIn = SampleStreamer::kFadeInFrames;
+      mNUnderrunFrames += n;
+
+      // The frames that should follow aren't there, so ramp the last frame output down to silence rather than stepping to it
+      const int nFade = std::min(mFadeOut, n);
+      const int fadeStart = SampleStreamer::kFadeOutFrames - mFadeOut;
+
+      for (int c = 0; c < nChans; c++)
+      {
+        const T last = static_cast<T>(mLastOutput[std::min(c, lastChan)]);
+
+        for (int i = 0; i < nFade; i++)
+          ppDest[c][done + i] = last * static_cast<T>(SampleStreamer::kFadeOutFrames - (fadeStart + i + 1)) / static_cast<T>(SampleStreamer::kFadeOutFrames);
+
+        std::fill(ppDest[c] + done + nFade, ppDest[c] + done + n, T(0));
+      }
+
+      mFadeOut -= nFade;
+    }
+    else
+    {
+      for (int c = 0; c < nChans; c++)
+      {
+        const float* pIn = pSrc[std::min(c, lastChan)];
+        T* pOut = ppDest[c] + done;
+
+        for (int i = 0; i < n; i++)
+          pOut[i] = static_cast<T>(pIn[i]);
+      }
+
+      if (mFadeIn)
+      {
+        const int nFade = std::min(mFadeIn, n);
+        const int fadeStart = SampleStreamer::kFadeInFrames - mFadeIn;
+
+        for (int c = 0; c < nChans; c++)
+        {
+          for (int i = 0; i < nFade; i++)
+            ppDest[c][done + i] *= static_cast<T>(fadeStart + i) / static_cast<T>(SampleStreamer::kFadeInFrames);
+        }
+
+        mFadeIn -= nFade;
+      }
+
+      for (int c = 0; c < std::min(nChans, lastChan + 1); c++)
+        mLastOutput[c] = static_cast<float>(ppDest[c][done + n - 1]);
+
+      mFadeOut = SampleStreamer::kFadeOutFrames;
+    }
+
+    mPosition += n;
+    done += n;
+  }
+
+  if (mPosition >= zone.NPreloadFrames())
+    AdvanceTo(mPosition);
+
+  for (int c = 0; c < nChans; c++)
+    std::fill(ppDest[c] + done, ppDest[c] + nFrames, T(0));
+
+  return done;
+}
+
+END_IPLUG_NAMESPACE
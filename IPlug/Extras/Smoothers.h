@@ -8,8 +8,17 @@
  ==============================================================================
 */
 
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
 #include "denormal.h"
 #include "IPlugConstants.h"
+#include "IPlugUtilities.h"
+#include "Synth/ControlRamp.h"
+#include "LaneVector.h"
 
 BEGIN_IPLUG_NAMESPACE
 
@@ -86,4 +95,534 @@ public:
 
 } WDL_FIXALIGN;
 
+/** Curves available in a SmootherBank */
+enum class ESmootherMode
+{
+  Exponential, // one or more cascaded one-pole lowpass filters, with one pole this is the same curve as LogParamSmooth
+  Linear       // a linear ramp to each new target, which lasts the smoothing time
+};
+
+/** The per-segment loops of a SmootherBank group of NLANES smoothers, with the state held in vector registers. This is the fallback for types
+ * without a LaneVector, the functions return \c false and the bank runs its scalar loops */
+template<typename T, int NLANES, bool SIMD = LaneVector<T>::kAvailable>
+struct SmootherLanes
+{
+  template <int NPOLES, bool WRITE>
+  static bool Exponential(T (&y)[NPOLES][NLANES], const T* target, const T* coeff, int nLanes, int nFrames, T** outputs, int offset) { return false; }
+
+  template <bool WRITE>
+  static bool Linear(T* y, T* remaining, const T* target, const T* step, int nLanes, int nFrames, T** outputs, int offset) { return false; }
+};
+
+template<typename T, int NLANES>
+struct SmootherLanes<T, NLANES, true>
+{
+  using Vec = LaneVector<T>;
+  using V = typename Vec::V;
+  static constexpr int kWidth = Vec::kWidth;
+  static constexpr int kNVectors = NLANES / kWidth;
+  static_assert(NLANES % kWidth == 0, "NLANES must be a multiple of the vector width");
+
+  /** The same arithmetic as the scalar loop in SmootherBank, so both give the same output
+   * @param outputs The output buffers of the group's smoothers, only used when WRITE is true
+   * @return \c true */
+  template <int NPOLES, bool WRITE>
+  static bool Exponential(T (&y)[NPOLES][NLANES], const T* target, const T* coeff, int nLanes, int nFrames, T** outputs, int offset)
+  {
+    V vy[NPOLES][kNVectors], vTarget[kNVectors], vCoeff[kNVectors];
+
+    for (auto v = 0; v < kNVectors; v++)
+    {
+      vTarget[v] = Vec::Load(target + v * kWidth);
+      vCoeff[v] = Vec::Load(coeff + v * kWidth);
+
+      for (auto p = 0; p < NPOLES; p++)
+        vy[p][v] = Vec::Load(y[p] + v * kWidth);
+    }
+
+    auto tick = [&]() {
+      for (auto v = 0; v < kNVectors; v++)
+      {
+        vy[0][v] = Vec::Add(vy[0][v], Vec::Mul(vCoeff[v], Vec::Sub(vTarget[v], vy[0][v])));
+
+        for (auto p = 1; p < NPOLES; p++)
+          vy[p][v] = Vec::Add(vy[p][v], Vec::Mul(vCoeff[v], Vec::Sub(vy[p - 1][v], vy[p][v])));
+      }
+    };
+
+    Run<WRITE>(tick, vy[NPOLES - 1], nLanes, nFrames, outputs, offset);
+
+    for (auto v = 0; v < kNVectors; v++)
+    {
+      for (auto p = 0; p < NPOLES; p++)
+        Vec::Store(y[p] + v * kWidth, vy[p][v]);
+    }
+
+    return true;
+  }
+
+  /** @return \c true */
+  template <bool WRITE>
+  static bool Linear(T* y, T* remaining, const T* target, const T* step, int nLanes, int nFrames, T** outputs, int offset)
+  {
+    V vy[kNVectors], vRemaining[kNVectors], vTarget[kNVectors], vStep[kNVectors];
+    const V one = Vec::Splat(T(1));
+    const V zero = Vec::Splat(T(0));
+
+    for (auto v = 0; v < kNVectors; v++)
+    {
+      vy[v] = Vec::Load(y + v * kWidth);
+      vRemaining[v] = Vec::Load(remaining + v * kWidth);
+      vTarget[v] = Vec::Load(target + v * kWidth);
+      vStep[v] = Vec::Load(step + v * kWidth);
+    }
+
+    auto tick = [&]() {
+      for (auto v = 0; v < kNVectors; v++)
+      {
+        vy[v] = Vec::SelectGreater(vRemaining[v], one, Vec::Add(vy[v], vStep[v]), vTarget[v]);
+        vRemaining[v] = Vec::Max(Vec::Sub(vRemaining[v], one), zero);
+      }
+    };
+
+    Run<WRITE>(tick, vy, nLanes, nFrames, outputs, offset);
+
+    for (auto v = 0; v < kNVectors; v++)
+    {
+      Vec::Store(y + v * kWidth, vy[v]);
+      Vec::Store(remaining + v * kWidth, vRemaining[v]);
+    }
+
+    return true;
+  }
+
+private:
+  /** Calls tick() for every frame. When the group is full, kWidth frames are transposed and stored together, so each smoother's buffer gets whole vectors */
+  template <bool WRITE, typename F>
+  static inline void Run(F& tick, const V (&out)[kNVectors], int nLanes, int nFrames, T** outputs, int offset)
+  {
+    int s = 0;
+
+    if (WRITE && nLanes == NLANES)
+    {
+      for (; s + kWidth <= nFrames; s += kWidth)
+      {
+        V frames[kNVectors][kWidth];
+
+        for (auto f = 0; f < kWidth; f++)
+        {
+          tick();
+
+          for (auto v = 0; v < kNVectors; v++)
+            frames[v][f] = out[v];
+        }
+
+        for (auto v = 0; v < kNVectors; v++)
+        {
+          Vec::Transpose(frames[v]);
+
+          for (auto l = 0; l < kWidth; l++)
+            Vec::Store(outputs[v * kWidth + l] + offset + s, frames[v][l]);
+        }
+      }
+    }
+
+    for (; s < nFrames; s++)
+    {
+      tick();
+
+      if (WRITE)
+      {
+        T frame[NLANES];
+
+        for (auto v = 0; v < kNVectors; v++)
+          Vec::Store(frame + v * kWidth, out[v]);
+
+        for (auto l = 0; l < nLanes; l++)
+          outputs[l][offset + s] = frame[l];
+      }
+    }
+  }
+};
+
+/** A bank of parameter smoothers, for smoothing many parameters (e.g. all the parameters of a voice) in one pass.
+ * The state is stored as one array per variable rather than one struct per smoother, and the smoothers are processed in groups of kLanes,
+ * with the state of a group in SSE2 or NEON registers (see SmootherLanes), or in scalar loops over the lanes on other targets. Groups where every smoother has settled on its target are skipped.
+ * Targets can be set at any sample offset within the next block with SetTarget(), and the block is split at those offsets.
+ * Apart from Resize(), nothing allocates, so everything else can be called on the audio thread. */
+template<typename T>
+class SmootherBank
+{
+public:
+  static constexpr int kLanes = 8;
+  static constexpr int kMaxPoles = 4;
+
+  /** @param nSmoothers The number of smoothers
+   * @param mode The curve used by all the smoothers
+   * @param nPoles The number of cascaded poles for ESmootherMode::Exponential, 1 to kMaxPoles
+   * @param maxTargets The number of SetTarget() calls with a sample offset that can be queued per block */
+  SmootherBank(int nSmoothers = 0, ESmootherMode mode = ESmootherMode::Exponential, int nPoles = 1, int maxTargets = 256)
+  : mMode(mode)
+  , mNPoles(mode == ESmootherMode::Linear ? 1 : Clip(nPoles, 1, kMaxPoles))
+  {
+    mTargets.reserve(maxTargets);
+    Resize(nSmoothers);
+  }
+
+  /** Sets the number of smoothers. New smoothers start at 0 with a smoothing time of 5 ms, targets queued for removed smoothers are dropped. This allocates */
+  void Resize(int nSmoothers)
+  {
+    mNSmoothers = nSmoothers;
+
+    // targets queued for smoothers that no longer exist are dropped
+    mTargets.erase(std::remove_if(mTargets.begin(), mTargets.end(), [nSmoothers](const Target& t) { return t.idx >= nSmoothers; }), mTargets.end());
+    const int nPadded = NGroups() * kLanes;
+
+    mTarget.resize(nPadded, T(0));
+    mCoeff.resize(nPadded, T(1));
+    mStep.resize(nPadded, T(0));
+    mRemaining.resize(nPadded, T(0));
+    mRampSamples.resize(nPadded, T(1));
+    mStartValues.resize(nPadded, T(0));
+    mTimeMs.resize(nPadded, 5.);
+    mGroupActive.resize(NGroups(), 0);
+
+    for (auto p = 0; p < kMaxPoles; p++)
+      mStage[p].resize(nPadded, T(0));
+
+    // after shrinking, the padding of the last group may hold removed smoothers, which start again from 0 if the bank grows
+    for (auto i = nSmoothers; i < nPadded; i++)
+    {
+      SetValue(i, T(0));
+      mStep[i] = T(0);
+      mTimeMs[i] = 5.;
+    }
+
+    for (auto i = 0; i < nPadded; i++)
+      UpdateCoeff(i);
+  }
+
+  int NSmoothers() const { return mNSmoothers; }
+
+  /** Recalculates the coefficients of all the smoothers for a new sample rate */
+  void SetSampleRate(double sampleRate)
+  {
+    mSampleRate = sampleRate;
+
+    for (auto i = 0; i < mNSmoothers; i++)
+      UpdateCoeff(i);
+  }
+
+  /** @param idx The smoother
+   * @param timeMs The smoothing time. For ESmootherMode::Exponential, this is the time constant of each pole divided by the number of poles */
+  void SetSmoothTime(int idx, double timeMs)
+  {
+    mTimeMs[idx] = timeMs;
+    UpdateCoeff(idx);
+  }
+
+  /** Sets the smoothing time of all the smoothers */
+  void SetSmoothTime(double timeMs)
+  {
+    for (auto i = 0; i < mNSmoothers; i++)
+      SetSmoothTime(i, timeMs);
+  }
+
+  /** Sets the value below which the difference between a smoother's output and its target is considered settled, at which point it jumps to the target and stops processing */
+  void SetSettleThreshold(T threshold) { mSettleThreshold = threshold; }
+
+  /** Sets a new target
+   * @param idx The smoother
+   * @param value The target value
+   * @param sampleOffset The frame within the next ProcessBlock() at which the smoother starts moving towards the target. Offsets beyond that block carry over to later blocks */
+  void SetTarget(int idx, T value, int sampleOffset = 0)
+  {
+    if (sampleOffset <= 0 || mTargets.size() == mTargets.capacity())
+    {
+      // a target carried over from an earlier block that is due now would otherwise be applied after this one
+      mTargets.erase(std::remove_if(mTargets.begin(), mTargets.end(), [idx](const Target& t) { return t.idx == idx && t.offset <= 0; }), mTargets.end());
+      ApplyTarget(idx, value);
+    }
+    else
+      mTargets.push_back({ idx, sampleOffset, value });
+  }
+
+  /** Jumps to a value, without smoothing */
+  void SetValue(int idx, T value)
+  {
+    for (auto p = 0; p < kMaxPoles; p++)
+      mStage[p][idx] = value;
+
+    mTarget[idx] = value;
+    mRemaining[idx] = T(0);
+  }
+
+  /** @return The current output of a smoother */
+  T GetValue(int idx) const { return mStage[mNPoles - 1][idx]; }
+
+  T GetTarget(int idx) const { return mTarget[idx]; }
+
+  /** @return \c true if the group that contains this smoother is still moving */
+  bool IsActive(int idx) const { return mGroupActive[idx / kLanes] != 0; }
+
+  /** Processes a block, writing the output of every smoother for every frame
+   * @param nFrames The number of frames
+   * @param outputs An array of NSmoothers() buffers, each of nFrames */
+  void ProcessBlock(int nFrames, T** outputs)
+  {
+    ProcessSegments<true>(nFrames, outputs);
+  }
+
+  /** Processes a block without writing per-frame output, and optionally describes each smoother's movement over the block as a ControlRamp.
+   * The ramp goes from the value at the start of the block to the value at its end, which is exact for ESmootherMode::Linear when the ramp spans the whole block
+   * @param nFrames The number of frames
+   * @param pRamps nullptr, or an array of NSmoothers() ramps */
+  void ProcessBlock(int nFrames, ControlRamp* pRamps = nullptr)
+  {
+    if (pRamps)
+      std::copy(mStage[mNPoles - 1].begin(), mStage[mNPoles - 1].begin() + mNSmoothers, mStartValues.begin());
+
+    ProcessSegments<false>(nFrames, nullptr);
+
+    if (pRamps)
+    {
+      for (auto i = 0; i < mNSmoothers; i++)
+      {
+        ControlRamp& ramp = pRamps[i];
+        ramp.startValue = mStartValues[i];
+        ramp.endValue = GetValue(i);
+        ramp.transitionStart = 0;
+        ramp.transitionEnd = nFrames;
+      }
+    }
+  }
+
+private:
+  struct Target
+  {
+    int idx;
+    int offset;
+    T value;
+  };
+
+  using Lanes = SmootherLanes<T, kLanes>;
+
+  int NGroups() const { return (mNSmoothers + kLanes - 1) / kLanes; }
+
+  void UpdateCoeff(int idx)
+  {
+    static constexpr double TWO_PI = 6.283185307179586476925286766559;
+
+    const double samples = std::max(mTimeMs[idx] * 0.001 * mSampleRate, 1.);
+    const double timePerPole = samples / mNPoles;
+    mCoeff[idx] = static_cast<T>(1. - std::exp(-TWO_PI / timePerPole));
+    mRampSamples[idx] = static_cast<T>(std::ceil(samples));
+  }
+
+  void ApplyTarget(int idx, T value)
+  {
+    mTarget[idx] = value;
+
+    if (mMode == ESmootherMode::Linear)
+    {
+      mStep[idx] = (value - mStage[0][idx]) / mRampSamples[idx];
+      mRemaining[idx] = mRampSamples[idx];
+    }
+
+    mGroupActive[idx / kLanes] = 1;
+  }
+
+  /** Splits the block at the offsets of queued targets */
+  template <bool WRITE>
+  void ProcessSegments(int nFrames, T** outputs)
+  {
+    // insertion sort, stable so that several targets for a smoother at the same offset apply in order
+    for (size_t i = 1; i < mTargets.size(); i++)
+    {
+      for (size_t j = i; j > 0 && mTargets[j - 1].offset > mTargets[j].offset; j--)
+        std::swap(mTargets[j - 1], mTargets[j]);
+    }
+
+    size_t next = 0;
+    int pos = 0;
+
+    while (pos < nFrames)
+    {
+      while (next < mTargets.size() && mTargets[next].offset <= pos)
+      {
+        ApplyTarget(mTargets[next].idx, mTargets[next].value);
+        next++;
+      }
+
+      const int end = next < mTargets.size() ? std::min(mTargets[next].offset, nFrames) : nFrames;
+      ProcessGroups<WRITE>(pos, end - pos, outputs);
+      pos = end;
+    }
+
+    // targets beyond this block carry over
+    size_t kept = 0;
+
+    for (; next < mTargets.size(); next++)
+    {
+      mTargets[kept] = mTargets[next];
+      mTargets[kept++].offset -= nFrames;
+    }
+
+    mTargets.resize(kept);
+  }
+
+  template <bool WRITE>
+  void ProcessGroups(int offset, int nFrames, T** outputs)
+  {
+    for (auto g = 0; g < NGroups(); g++)
+    {
+      const int nLanes = std::min(kLanes, mNSmoothers - g * kLanes);
+
+      if (!mGroupActive[g])
+      {
+        if (WRITE)
+        {
+          for (auto l = 0; l < nLanes; l++)
+            std::fill(outputs[g * kLanes + l] + offset, outputs[g * kLanes + l] + offset + nFrames, GetValue(g * kLanes + l));
+        }
+
+        continue;
+      }
+
+      if (mMode == ESmootherMode::Linear)
+        mGroupActive[g] = ProcessLinear<WRITE>(g, nLanes, offset, nFrames, outputs);
+      else
+      {
+        switch (mNPoles)
+        {
+          case 1: mGroupActive[g] = ProcessExponential<1, WRITE>(g, nLanes, offset, nFrames, outputs); break;
+          case 2: mGroupActive[g] = ProcessExponential<2, WRITE>(g, nLanes, offset, nFrames, outputs); break;
+          case 3: mGroupActive[g] = ProcessExponential<3, WRITE>(g, nLanes, offset, nFrames, outputs); break;
+          default: mGroupActive[g] = ProcessExponential<4, WRITE>(g, nLanes, offset, nFrames, outputs); break;
+        }
+      }
+    }
+  }
+
+  /** @return \c true if the group is still moving */
+  template <int NPOLES, bool WRITE>
+  bool ProcessExponential(int group, int nLanes, int offset, int nFrames, T** outputs)
+  {
+    const int base = group * kLanes;
+    T y[NPOLES][kLanes];
+    T target[kLanes], coeff[kLanes];
+
+    for (auto l = 0; l < kLanes; l++)
+    {
+      target[l] = mTarget[base + l];
+      coeff[l] = mCoeff[base + l];
+
+      for (auto p = 0; p < NPOLES; p++)
+        y[p][l] = mStage[p][base + l];
+    }
+
+    if (!Lanes::template Exponential<NPOLES, WRITE>(y, target, coeff, nLanes, nFrames, WRITE ? outputs + base : nullptr, offset))
+    {
+      for (auto s = 0; s < nFrames; s++)
+      {
+        for (auto l = 0; l < kLanes; l++)
+        {
+          y[0][l] += coeff[l] * (target[l] - y[0][l]);
+
+          for (auto p = 1; p < NPOLES; p++)
+            y[p][l] += coeff[l] * (y[p - 1][l] - y[p][l]);
+        }
+
+        if (WRITE)
+        {
+          for (auto l = 0; l < nLanes; l++)
+            outputs[base + l][offset + s] = y[NPOLES - 1][l];
+        }
+      }
+    }
+
+    bool moving = false;
+
+    // a pole that did not change over the segment has stalled, because the steps got smaller than the precision of T
+    for (auto l = 0; l < kLanes; l++)
+    {
+      for (auto p = 0; p < NPOLES; p++)
+        moving |= std::abs(target[l] - y[p][l]) > mSettleThreshold && y[p][l] != mStage[p][base + l];
+    }
+
+    // once settled, jump to the targets, which also stops the states from decaying into denormals
+    for (auto l = 0; l < kLanes; l++)
+    {
+      for (auto p = 0; p < NPOLES; p++)
+        mStage[p][base + l] = moving ? y[p][l] : target[l];
+    }
+
+    return moving;
+  }
+
+  /** @return \c true if the group is still moving */
+  template <bool WRITE>
+  bool ProcessLinear(int group, int nLanes, int offset, int nFrames, T** outputs)
+  {
+    const int base = group * kLanes;
+    T y[kLanes], target[kLanes], step[kLanes], remaining[kLanes];
+
+    for (auto l = 0; l < kLanes; l++)
+    {
+      y[l] = mStage[0][base + l];
+      target[l] = mTarget[base + l];
+      step[l] = mStep[base + l];
+      remaining[l] = mRemaining[base + l];
+    }
+
+    if (!Lanes::template Linear<WRITE>(y, remaining, target, step, nLanes, nFrames, WRITE ? outputs + base : nullptr, offset))
+    {
+      for (auto s = 0; s < nFrames; s++)
+      {
+        for (auto l = 0; l < kLanes; l++)
+        {
+          // the last step lands exactly on the target
+          y[l] = remaining[l] > T(1) ? y[l] + step[l] : target[l];
+          remaining[l] = std::max(remaining[l] - T(1), T(0));
+        }
+
+        if (WRITE)
+        {
+          for (auto l = 0; l < nLanes; l++)
+            outputs[base + l][offset + s] = y[l];
+        }
+      }
+    }
+
+    bool moving = false;
+
+    for (auto l = 0; l < kLanes; l++)
+    {
+      mStage[0][base + l] = y[l];
+      mRemaining[base + l] = remaining[l];
+      moving |= remaining[l] > T(0);
+    }
+
+    return moving;
+  }
+
+  ESmootherMode mMode;
+  int mNPoles;
+  int mNSmoothers = 0;
+  double mSampleRate = DEFAULT_SAMPLE_RATE;
+  T mSettleThreshold = T(1e-5);
+
+  // one array per variable, padded to a multiple of kLanes
+  std::vector<T> mStage[kMaxPoles]; // the state of each pole, mStage[mNPoles - 1] is the output
+  std::vector<T> mTarget;
+  std::vector<T> mCoeff;
+  std::vector<T> mStep;        // linear mode, the change per sample
+  std::vector<T> mRemaining;   // linear mode, the samples left in the ramp
+  std::vector<T> mRampSamples; // linear mode, the length of a ramp
+  std::vector<T> mStartValues; // scratch, the outputs at the start of the block, for the ramps
+  std::vector<double> mTimeMs;
+  std::vector<uint8_t> mGroupActive;
+  std::vector<Target> mTargets;
+};
+
 END_IPLUG_NAMESPACE
@@ -400,22 +400,15 @@ bool MidiSynth::ProcessBlock(sample** inputs, sample** outputs, int nInputs, int
 
   if (mVoicesAreActive | !mMidiQueue.Empty())
   {
-    int blockSize = mBlockSize;
-    int samplesRemaining = nFrames;
     int startIndex = 0;
 
-    while(samplesRemaining > 0)
+    while(startIndex < nFrames)
     {
-      if(samplesRemaining < blockSize)
-        blockSize = samplesRemaining;
-
-      while (!mMidiQueue.Empty())
+      // the block is split at the offset of each message, so messages always apply at the start of a sub-block
+      while (mMidiQueue.NextOffset() <= startIndex)
       {
         IMidiMsg msg = mMidiQueue.Peek();
 
-        // we assume the messages are in chronological order. If we find one later than the current block we are done.
-        if (msg.mOffset > startIndex + blockSize) break;
-
         if(IsRPNMessage(msg))
         {
           HandleRPN(msg);
@@ -423,17 +416,21 @@ bool MidiSynth::ProcessBlock(sample** inputs, sample** outputs, int nInputs, int
         else
         {
           // send performance messages to the voice allocator
-          // message offset is relative to the start of this processSamples() block
-          msg.mOffset -= startIndex;
+          msg.mOffset = 0;
           mVoiceAllocator.AddEvent(MidiMessageToEvent(msg));
         }
         mMidiQueue.Remove();
       }
 
+      int blockSize = std::min(mBlockSize, nFrames - startIndex);
+      const int nextOffset = mMidiQueue.NextOffset();
+
+      if (nextOffset < startIndex + blockSize)
+        blockSize = nextOffset - startIndex;
+
       mVoiceAllocator.ProcessEvents(blockSize, mSampleTime);
       mVoiceAllocator.ProcessVoices(inputs, outputs, nInputs, nOutputs, startIndex, blockSize);
 
-      samplesRemaining -= blockSize;
       startIndex += blockSize;
       mSampleTime += blockSize;
     }
@@ -474,7 +471,7 @@ void MidiSynth::SetSampleRateAndBlockSize(double sampleRate, int blockSize)
   Reset();
 
   mSampleRate = sampleRate;
-  mMidiQueue.Resize(blockSize);
+  mMidiQueue.Resize(blockSize, kMidiQueueCapacity);
   mVoiceAllocator.SetSampleRateAndBlockSize(sampleRate, blockSize);
 
   for(int v = 0; v < NVoices(); v++)
@@ -37,8 +37,11 @@ BEGIN_IPLUG_NAMESPACE
 class MidiSynth
 {
 public:
-  /** This defines the size in samples of a single block of processing that will be done by the synth. */
+  /** This defines the maximum size in samples of a single block of processing that will be done by the synth, which sets the rate at which the voice inputs are updated.
+   * Blocks are also split exactly at the offsets of MIDI messages */
   static constexpr int kDefaultBlockSize = 32;
+  /** The number of MIDI messages that can be queued, see IMidiScheduler */
+  static constexpr int kMidiQueueCapacity = 4096;
   static constexpr int kDefaultPitchBendRange = 12;
 
 #pragma mark - MidiSynth class
@@ -195,7 +198,7 @@ private:
   // basic MIDI data
   VoiceAllocator mVoiceAllocator;
   uint16_t mUnisonVoices{1};
-  IMidiQueue mMidiQueue;
+  IMidiScheduler mMidiQueue;
   float mVelocityLUT[128];
   float mAfterTouchLUT[128];
   ChannelState mChannelStates[16]{};
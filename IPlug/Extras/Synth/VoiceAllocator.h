@@ -18,8 +18,10 @@
 #include <array>
 #include <vector>
 #include <stdint.h>
+#include <climits>
 #include <functional>
 #include <bitset>
+#include <memory>
 //#include <iostream>
 
 #include "IPlugLogger.h"
@@ -26,26 +26,33 @@ bool IWebsocketEditorDelegate::OnWebsocketText(int connIdx, const char* pStr, si
 //this method gets called on server connection thread
 bool IWebsocketEditorDelegate::OnWebsocketData(int connIdx, void* pData, size_t dataSize)
 {
-  uint8_t* pByteData = (uint8_t*) pData;
+  IByteStream stream(pData, static_cast<int>(dataSize));
   int pos = 6;
 
+  if (dataSize < 6)
+    return false;
+
   // Send Parameter Value from UI
   if (memcmp(pData, "SPVFUI" , 6) == 0)
   {
-    int paramIdx = * ((int*)(pByteData + pos)); pos+= 4;
-    double value = * ((double*)(pByteData + pos)); pos += 8;
+    int paramIdx = 0;
+    double value = 0.;
+    pos = stream.Get(&paramIdx, pos);
+    pos = stream.Get(&value, pos);
     
-    mParamChangeFromClients.Push(ParamTupleCX { paramIdx, value, connIdx } );
+    if (pos > 0)
+      mParamChangeFromClients.Push(ParamTupleCX { paramIdx, value, connIdx } );
   }
   // Send MIDI Message from UI
   else if (memcmp(pData, "SMMFUI" , 6) == 0)
   {
     IMidiMsg msg;
-    msg.mStatus = * ((uint8_t*)(pByteData + pos)); pos++;
-    msg.mData1 = * ((uint8_t*)(pByteData + pos)); pos++;
-    msg.mData2 = * ((uint8_t*)(pByteData + pos)); pos++;
+    pos = stream.Get(&msg.mStatus, pos);
+    pos = stream.Get(&msg.mData1, pos);
+    pos = stream.Get(&msg.mData2, pos);
 
-    mMIDIFromClients.Push(msg);
+    if (pos > 0)
+      mMIDIFromClients.Push(msg);
   }
   // Send Sysex Message from UI
   else if (memcmp(pData, "SSMFUI" , 6) == 0)
@@ -190,6 +190,8 @@ void IPlugAPIBase::OnTimer(Timer& t)
   #endif
   }
   
+  mMessagesFromEditor.Collect();
+  
   OnIdle();
 }
 
@@ -207,7 +209,28 @@ void IPlugAPIBase::SendSysexMsgFromUI(const ISysEx& msg)
 
 void IPlugAPIBase::SendArbitraryMsgFromUI(int msgTag, int ctrlTag, int dataSize, const void* pData)
 {
+  if (OnPresetMsgFromUI(msgTag, ctrlTag, dataSize, pData))
+    return;
+
   OnMessage(msgTag, ctrlTag, dataSize, pData); // IPlugAPIBase implementation handles non distributed plug-ins - just call OnMessage() directly
   
   EDITOR_DELEGATE_CLASS::SendArbitraryMsgFromUI(msgTag, ctrlTag, dataSize, pData);
 }
+
+bool IPlugAPIBase::DeferArbitraryMsgFromUI(int msgTag, int ctrlTag, int dataSize, const void* pData)
+{
+#if defined VST3C_API || defined VST3P_API || defined WEB_API || defined WAM_API
+  return false; // the editor and processor may not share memory, on the web the processor runs in an audio worklet
+#else
+  return mMessagesFromEditor.Send(msgTag, ctrlTag, dataSize, pData);
+#endif
+}
+
+void IPlugAPIBase::ProcessDeferredMessages()
+{
+  while (IPlugMessage* pMsg = mMessagesFromEditor.Receive())
+  {
+    if (!OnDeferredMessage(*pMsg))
+      mMessagesFromEditor.Return(pMsg);
+  }
+}
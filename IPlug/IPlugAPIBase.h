@@ -24,6 +24,7 @@
 #include "IPlugUtilities.h"
 #include "IPlugParameter.h"
 #include "IPlugQueue.h"
+#include "IPlugMessageChannel.h"
 #include "IPlugTimer.h"
 
 /**
@@ -79,6 +80,20 @@ public:
    * @return return \c true if your plug-in supports these dimensions */
   virtual bool OnHostRequestingSupportedViewConfiguration(int width, int height) { return true; }
   
+  /** Called on the realtime audio thread at the start of a block, for each message queued with DeferArbitraryMsgFromUI(). The default implementation calls OnMessage() with the payload.
+   * Override this to keep the payload after the call, for instance to swap in a wavetable, and hand it back later with ReturnDeferredMessage(), from the audio thread
+   * @param msg The message, whose payload stays valid until it is handed back
+   * @return \c true if the message is kept, \c false to hand it back straight away */
+  virtual bool OnDeferredMessage(IPlugMessage& msg)
+  {
+    OnMessage(msg.mMsgTag, msg.mCtrlTag, msg.mDataSize, msg.GetData());
+    return false;
+  }
+  
+  /** Hands a message kept by OnDeferredMessage() back to the editor side, which frees or reuses its buffer. Call this on the realtime audio thread, it doesn't block
+   * @param pMsg The message */
+  void ReturnDeferredMessage(IPlugMessage* pMsg) { mMessagesFromEditor.Return(pMsg); }
+  
   /** Called by some AUv3 plug-in hosts when a particular UI size is selected
    * @param width The selected width
    * @param height The selected height */
@@ -163,6 +178,8 @@ public:
   
   void SendArbitraryMsgFromUI(int msgTag, int ctrlTag = kNoTag, int dataSize = 0, const void* pData = nullptr) override;
   
+  bool DeferArbitraryMsgFromUI(int msgTag, int ctrlTag = kNoTag, int dataSize = 0, const void* pData = nullptr) override;
+  
   void DeferMidiMsg(const IMidiMsg& msg) override { mMidiMsgsFromEditor.Push(msg); }
   
   void DeferSysexMsg(const ISysEx& msg) override
@@ -202,6 +219,10 @@ private:
   void OnTimer(Timer& t);
 
 protected:
+  /** Called by the API classes on the realtime audio thread at the start of a block, passes the messages queued with DeferArbitraryMsgFromUI() to OnDeferredMessage() */
+  void ProcessDeferredMessages();
+  
+
   WDL_String mParamDisplayStr;
   std::unique_ptr<Timer> mTimer;
   
@@ -211,6 +232,7 @@ protected:
   IPlugQueue<SysExData> mSysExDataFromEditor {SYSEX_TRANSFER_SIZE}; // a queue of SYSEX data to send to the processor
   IPlugQueue<SysExData> mSysExDataFromProcessor {SYSEX_TRANSFER_SIZE}; // a queue of SYSEX data to send to the editor
   SysExData mSysexBuf;
+  IPlugMessageChannel mMessagesFromEditor {MESSAGE_TRANSFER_SIZE}; // variable size messages to the processor, with buffers that the processor hands back
 };
 
 END_IPLUG_NAMESPACE
@@ -118,6 +118,7 @@ static const int MAX_PARAM_DISPLAY_PRECISION = 6;
 #define PARAM_TRANSFER_SIZE 512
 #define MIDI_TRANSFER_SIZE 32
 #define SYSEX_TRANSFER_SIZE 4
+#define MESSAGE_TRANSFER_SIZE 64
 
 // All version ints are stored as 0xVVVVRRMM: V = version, R = revision, M = minor revision.
 #define IPLUG_VERSION 0x010000
@@ -129,6 +130,16 @@ static const int kNoParameter = -1;
 static const int kNoValIdx = -1;
 static const int kNoTag = -1;
 
+/** Message tags reserved for browsing the plug-in's presets from the UI through the editor delegate, see IPluginBase::OnPresetMsgFromUI() */
+enum EPresetMsgTag
+{
+  kMsgTagRequestPresets = -100, // UI to delegate, no data
+  kMsgTagRestorePreset, // UI to delegate, an int: the index of a preset, or NPresets() plus the index of a user preset
+  kMsgTagAddUserPresetFile, // UI to delegate, the path of a preset container, as an IByteChunk string
+  kMsgTagPresetList, // delegate to the control that sent the request, see IPluginBase::OnPresetMsgFromUI()
+  kMsgTagPresetRestored // delegate to the control that sent the request, when the preset list hasn't changed since it was last sent
+};
+
 #define MAX_BUS_CHANS 64 // wild cards in channel i/o strings will result in this many channels
 
 //#if defined VST3_API || defined VST3C_API || defined VST3P_API
@@ -277,6 +277,17 @@ public:
   * @param pData Ptr to the opaque data payload for the message */
   virtual void SendArbitraryMsgFromUI(int msgTag, int ctrlTag = kNoTag, int dataSize = 0, const void* pData = nullptr) {};
   
+  /** DeferArbitraryMsgFromUI (Abbreviation: DAMFUI)
+   * Like SendArbitraryMsgFromUI(), but the payload is copied into a pooled buffer and queued to the realtime audio thread, without locking,
+   * where it is handled by IPlugAPIBase::OnDeferredMessage() at the start of the next block. Use this for large payloads that the DSP needs, such as sample data or impulse responses.
+   * Not available with distributed plug-in APIs, VST3 with separate controller and processor, WAM and the web editor, where it returns \c false
+   * @param msgTag A unique tag to identify the message
+   * @param ctrlTag A unique tag to identify the control that sent the message, if desired
+   * @param dataSize The size in bytes of the data payload pointed to by pData. Note: if this is nonzero, pData must be valid.
+   * @param pData Ptr to the opaque data payload for the message
+   * @return \c true if the message was queued */
+  virtual bool DeferArbitraryMsgFromUI(int msgTag, int ctrlTag = kNoTag, int dataSize = 0, const void* pData = nullptr) { return false; }
+  
 #pragma mark -
   /** This method is needed, for remote editors to avoid a feedback loop */
   virtual void DeferMidiMsg(const IMidiMsg& msg) {};
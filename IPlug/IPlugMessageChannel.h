@@ -0,0 +1,274 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+#pragma once
+
+/**
+ * @file
+ * @copydoc IPlugMessageChannel
+ */
+
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <vector>
+
+#include "IPlugPlatform.h"
+#include "IPlugConstants.h"
+#include "IPlugQueue.h"
+
+BEGIN_IPLUG_NAMESPACE
+
+/** A message sent through an IPlugMessageChannel: the tags of SendArbitraryMsgFromUI() followed by a payload buffer.
+ * The header and payload are allocated together, and the payload is aligned for any type. */
+struct alignas(16) IPlugMessage
+{
+  int mMsgTag = kNoTag;
+  int mCtrlTag = kNoTag;
+  int mDataSize = 0;
+
+  /** @return The size of the payload buffer in bytes, which is at least mDataSize */
+  int GetCapacity() const { return mCapacity; }
+
+  void* GetData() { return reinterpret_cast<uint8_t*>(this) + sizeof(IPlugMessage); }
+  const void* GetData() const { return reinterpret_cast<const uint8_t*>(this) + sizeof(IPlugMessage); }
+
+private:
+  friend class IPlugMessageChannel;
+
+  int mCapacity = 0;
+  int mSizeClass = 0;
+  IPlugMessage* mPrevAllocated = nullptr; // links of all the messages of a channel, only touched by the editor side
+  IPlugMessage* mNextAllocated = nullptr;
+};
+
+/** A lock-free channel for variable size messages from the editor to the processor, with pooled payload buffers.
+ * The editor side fills a buffer and queues it, the processor side receives it, and hands it back when it is finished with it,
+ * which may be straight away or blocks later if it keeps using the payload (e.g. a wavetable). Only the editor side ever allocates or frees.
+ * Buffers are rounded up to a power of two and reused from a free list per size, so after Reserve() or the first few messages of a size
+ * sending doesn't allocate either.
+ * The processor side never blocks or allocates, Receive() and Return() are O(1), and at most maxMessages are ever outstanding,
+ * which bounds both the work per block and how long a message can wait. The editor side is single threaded, as is the processor side. */
+class IPlugMessageChannel final
+{
+public:
+  static constexpr int kMinCapacity = 64;
+  static constexpr int kNumSizeClasses = 24; // up to 512 MB
+
+  /** @param maxMessages The maximum number of messages outstanding, i.e. queued, held by the processor or waiting to be collected
+   * @param maxPoolBytes The maximum size of the payloads kept for reuse, buffers that are collected beyond this are freed */
+  IPlugMessageChannel(int maxMessages = MESSAGE_TRANSFER_SIZE, size_t maxPoolBytes = 4 * 1024 * 1024)
+  : mToProcessor(maxMessages)
+  , mFromProcessor(maxMessages)
+  , mMaxMessages(maxMessages)
+  , mMaxPoolBytes(maxPoolBytes)
+  {}
+
+  /** Frees every buffer, including those the processor still holds, so the processor must not be running */
+  ~IPlugMessageChannel()
+  {
+    while (mAllocated)
+      Free(mAllocated);
+  }
+
+  IPlugMessageChannel(const IPlugMessageChannel&) = delete;
+  IPlugMessageChannel& operator=(const IPlugMessageChannel&) = delete;
+
+#pragma mark - Editor side
+
+  /** Editor side: preallocates buffers, e.g. for the largest payload that will be sent, so that the first send of that size doesn't allocate.
+   * Reserved buffers count towards the pool size
+   * @param dataSize The payload size in bytes
+   * @param count The number of buffers */
+  void Reserve(int dataSize, int count)
+  {
+    const int sizeClass = SizeClass(dataSize);
+
+    for (int i = 0; i < count; i++)
+    {
+      if (IPlugMessage* pMsg = Allocate(sizeClass))
+      {
+        mPoolBytes += pMsg->mCapacity;
+        mFree[sizeClass].push_back(pMsg);
+      }
+    }
+  }
+
+  /** Editor side: gets a buffer to fill in place, to avoid a copy of the payload. Send it with Send(), or give it back with Release()
+   * @param dataSize The payload size in bytes
+   * @return The message, with mDataSize set, or nullptr if maxMessages are outstanding or the size is too large */
+  IPlugMessage* Acquire(int dataSize)
+  {
+    if (mNOutstanding >= mMaxMessages)
+      Collect();
+
+    if (mNOutstanding >= mMaxMessages || dataSize < 0 || dataSize > (kMinCapacity << (kNumSizeClasses - 1)))
+      return nullptr;
+
+    const int sizeClass = SizeClass(dataSize);
+    IPlugMessage* pMsg = nullptr;
+
+    if (!mFree[sizeClass].empty())
+    {
+      pMsg = mFree[sizeClass].back();
+      mFree[sizeClass].pop_back();
+      mPoolBytes -= pMsg->mCapacity;
+    }
+    else if (!(pMsg = Allocate(sizeClass)))
+      return nullptr;
+
+    pMsg->mMsgTag = kNoTag;
+    pMsg->mCtrlTag = kNoTag;
+    pMsg->mDataSize = dataSize;
+    mNOutstanding++;
+    return pMsg;
+  }
+
+  /** Editor side: queues a message from Acquire() to the processor. Never fails, since no more than maxMessages can be acquired */
+  void Send(IPlugMessage* pMsg)
+  {
+    mToProcessor.Push(pMsg);
+  }
+
+  /** Editor side: copies a payload into a buffer and queues it
+   * @return \c true if the message was queued, \c false if it couldn't be acquired */
+  bool Send(int msgTag, int ctrlTag, int dataSize, const void* pData)
+  {
+    IPlugMessage* pMsg = Acquire(dataSize);
+
+    if (!pMsg)
+    {
+      mNDropped++;
+      return false;
+    }
+
+    pMsg->mMsgTag = msgTag;
+    pMsg->mCtrlTag = ctrlTag;
+
+    if (dataSize > 0)
+      memcpy(pMsg->GetData(), pData, dataSize);
+
+    Send(pMsg);
+    return true;
+  }
+
+  /** Editor side: gives back a message from Acquire() that wasn't sent */
+  void Release(IPlugMessage* pMsg)
+  {
+    mNOutstanding--;
+    Recycle(pMsg);
+  }
+
+  /** Editor side: takes back the buffers the processor has returned, keeping them for reuse up to maxPoolBytes. Call this regularly, e.g. on the timer */
+  void Collect()
+  {
+    IPlugMessage* pMsg;
+
+    while (mFromProcessor.Pop(pMsg))
+    {
+      mNOutstanding--;
+      Recycle(pMsg);
+    }
+  }
+
+  /** @return The number of messages that Send() couldn't queue */
+  int NDropped() const { return mNDropped; }
+
+  /** @return The size of the buffers kept for reuse, in bytes */
+  size_t GetPoolBytes() const { return mPoolBytes; }
+
+#pragma mark - Processor side
+
+  /** Processor side: takes the next message, which the processor then owns until it hands it back with Return(). Wait-free
+   * @return The message, or nullptr if there are none */
+  IPlugMessage* Receive()
+  {
+    IPlugMessage* pMsg = nullptr;
+    return mToProcessor.Pop(pMsg) ? pMsg : nullptr;
+  }
+
+  /** Processor side: hands a received message back to the editor side, which frees or reuses it. Wait-free, and never fails,
+   * since the return queue has room for every outstanding message */
+  void Return(IPlugMessage* pMsg)
+  {
+    mFromProcessor.Push(pMsg);
+  }
+
+private:
+  static int SizeClass(int dataSize)
+  {
+    int sizeClass = 0;
+
+    while ((kMinCapacity << sizeClass) < dataSize && sizeClass < kNumSizeClasses - 1)
+      sizeClass++;
+
+    return sizeClass;
+  }
+
+  IPlugMessage* Allocate(int sizeClass)
+  {
+    const size_t capacity = static_cast<size_t>(kMinCapacity) << sizeClass;
+    void* pMem = ::operator new(sizeof(IPlugMessage) + capacity, std::nothrow);
+
+    if (!pMem)
+      return nullptr;
+
+    IPlugMessage* pMsg = new (pMem) IPlugMessage();
+    pMsg->mCapacity = static_cast<int>(capacity);
+    pMsg->mSizeClass = sizeClass;
+    pMsg->mNextAllocated = mAllocated;
+
+    if (mAllocated)
+      mAllocated->mPrevAllocated = pMsg;
+
+    mAllocated = pMsg;
+    return pMsg;
+  }
+
+  void Free(IPlugMessage* pMsg)
+  {
+    if (pMsg->mPrevAllocated)
+      pMsg->mPrevAllocated->mNextAllocated = pMsg->mNextAllocated;
+    else
+      mAllocated = pMsg->mNextAllocated;
+
+    if (pMsg->mNextAllocated)
+      pMsg->mNextAllocated->mPrevAllocated = pMsg->mPrevAllocated;
+
+    pMsg->~IPlugMessage();
+    ::operator delete(pMsg);
+  }
+
+  void Recycle(IPlugMessage* pMsg)
+  {
+    if (mPoolBytes + pMsg->mCapacity > mMaxPoolBytes)
+    {
+      Free(pMsg);
+      return;
+    }
+
+    mPoolBytes += pMsg->mCapacity;
+    mFree[pMsg->mSizeClass].push_back(pMsg);
+  }
+
+  IPlugQueue<IPlugMessage*> mToProcessor;
+  IPlugQueue<IPlugMessage*> mFromProcessor;
+  int mMaxMessages;
+  size_t mMaxPoolBytes;
+
+  // Editor side only
+  std::vector<IPlugMessage*> mFree[kNumSizeClasses];
+  IPlugMessage* mAllocated = nullptr;
+  size_t mPoolBytes = 0;
+  int mNOutstanding = 0;
+  int mNDropped = 0;
+};
+
+END_IPLUG_NAMESPACE
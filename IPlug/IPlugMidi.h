@@ -20,6 +20,12 @@
 #include <cstdint>
 #include <cstdio>
 #include <algorithm>
+#include <limits>
+#include <vector>
+
+#if defined _MSC_VER
+#include <intrin.h>
+#endif
 
 #include "IPlugLogger.h"
 
@@ -787,4 +793,239 @@ protected:
   int mFront, mBack;
 };
 
+/** A scheduler for timestamped MIDI messages, which can be used in place of IMidiQueue on the audio thread.
+ * Messages are kept in a preallocated pool and linked into one bucket per sample offset of the block, so adding a message is O(1) however many are queued,
+ * and nothing is moved or allocated after Resize(). A bitmap of the occupied buckets finds the next offset with a message, so that processing can be split exactly at message offsets.
+ * Messages for the same offset come out in the order they were added. Messages beyond the block wait in an overflow list until Flush() brings them within range.
+ * If the pool is full, Add() drops the message rather than allocating
+ * @ingroup IPlugUtilities */
+class IMidiScheduler
+{
+public:
+  static constexpr int kNoMessage = std::numeric_limits<int>::max();
+
+  /** @param maxBlockSize The largest block, which is the number of buckets
+   * @param capacity The number of messages that can be queued */
+  IMidiScheduler(int maxBlockSize = DEFAULT_BLOCK_SIZE, int capacity = 4096)
+  {
+    Resize(maxBlockSize, capacity);
+  }
+
+  /** Sets the number of buckets and the size of the pool, and clears the scheduler. This allocates, so don't call it on the audio thread */
+  void Resize(int maxBlockSize, int capacity)
+  {
+    mNBuckets = std::max(maxBlockSize, 1);
+    mHeads.resize(mNBuckets);
+    mTails.resize(mNBuckets);
+    mOccupied.assign((mNBuckets + 63) / 64, 0);
+    mNodes.resize(std::max(capacity, 1));
+    Clear();
+  }
+
+  /** Clears all messages */
+  void Clear()
+  {
+    for (auto b = 0; b < mNBuckets; b++)
+      mHeads[b] = mTails[b] = kEnd;
+
+    std::fill(mOccupied.begin(), mOccupied.end(), 0);
+
+    for (auto i = 0; i < static_cast<int>(mNodes.size()); i++)
+      mNodes[i].mNext = i + 1 < static_cast<int>(mNodes.size()) ? i + 1 : kEnd;
+
+    mFree = 0;
+    mOverflowHead = mOverflowTail = kEnd;
+    mCount = 0;
+    mFirstWord = 0;
+  }
+
+  /** Adds a message in O(1). Negative offsets are treated as 0
+   * @return \c false if the pool is full and the message was dropped */
+  bool Add(const IMidiMsg& msg)
+  {
+    if (mFree == kEnd)
+    {
+      mNDropped++;
+      return false;
+    }
+
+    const int node = mFree;
+    mFree = mNodes[node].mNext;
+    mNodes[node].mMsg = msg;
+    mNodes[node].mMsg.mOffset = std::max(msg.mOffset, 0);
+    mNodes[node].mNext = kEnd;
+    mCount++;
+
+    if (mNodes[node].mMsg.mOffset < mNBuckets)
+      Link(node, mNodes[node].mMsg.mOffset);
+    else
+      Append(mOverflowHead, mOverflowTail, node);
+
+    return true;
+  }
+
+  /** @return \c true if no messages are queued, including those beyond the block */
+  bool Empty() const { return mCount == 0; }
+
+  /** @return The number of queued messages, including those beyond the block */
+  int ToDo() const { return mCount; }
+
+  /** @return The number of messages dropped because the pool was full, since construction */
+  int NDropped() const { return mNDropped; }
+
+  /** @return The offset of the earliest message within the block, or kNoMessage */
+  int NextOffset()
+  {
+    const int nWords = static_cast<int>(mOccupied.size());
+
+    while (mFirstWord < nWords && !mOccupied[mFirstWord])
+      mFirstWord++;
+
+    if (mFirstWord == nWords)
+      return kNoMessage;
+
+    return mFirstWord * 64 + CountTrailingZeros(mOccupied[mFirstWord]);
+  }
+
+  /** @return The earliest message within the block. Only valid if NextOffset() is not kNoMessage */
+  const IMidiMsg& Peek()
+  {
+    return mNodes[mHeads[NextOffset()]].mMsg;
+  }
+
+  /** Removes the earliest message within the block */
+  void Remove()
+  {
+    const int bucket = NextOffset();
+
+    if (bucket == kNoMessage)
+      return;
+
+    const int node = mHeads[bucket];
+    mHeads[bucket] = mNodes[node].mNext;
+
+    if (mHeads[bucket] == kEnd)
+    {
+      mTails[bucket] = kEnd;
+      mOccupied[bucket / 64] &= ~(uint64_t(1) << (bucket % 64));
+    }
+
+    mNodes[node].mNext = mFree;
+    mFree = node;
+    mCount--;
+  }
+
+  /** Call at the end of each block. Messages that were not removed move nFrames earlier, late ones to offset 0, and messages beyond the block that are now within range move into their buckets */
+  void Flush(int nFrames)
+  {
+    // in ascending order, so each destination bucket has already been moved on and messages keep their order
+    for (auto w = mFirstWord; w < static_cast<int>(mOccupied.size()); w++)
+    {
+      uint64_t bits = mOccupied[w];
+      mOccupied[w] = 0;
+
+      while (bits)
+      {
+        const int bucket = w * 64 + CountTrailingZeros(bits);
+        bits &= bits - 1;
+        const int dest = std::max(bucket - nFrames, 0);
+
+        if (bucket != dest)
+        {
+          const int head = mHeads[bucket], tail = mTails[bucket];
+          mHeads[bucket] = mTails[bucket] = kEnd;
+
+          for (int n = head; n != kEnd; n = mNodes[n].mNext)
+            mNodes[n].mMsg.mOffset = dest;
+
+          if (mHeads[dest] == kEnd)
+            mHeads[dest] = head;
+          else
+            mNodes[mTails[dest]].mNext = head;
+
+          mTails[dest] = tail;
+        }
+
+        mOccupied[dest / 64] |= uint64_t(1) << (dest % 64);
+      }
+    }
+
+    mFirstWord = 0;
+
+    // bring messages beyond the block within range
+    int node = mOverflowHead;
+    mOverflowHead = mOverflowTail = kEnd;
+
+    while (node != kEnd)
+    {
+      const int next = mNodes[node].mNext;
+      mNodes[node].mNext = kEnd;
+      mNodes[node].mMsg.mOffset -= nFrames;
+
+      if (mNodes[node].mMsg.mOffset < mNBuckets)
+        Link(node, std::max(mNodes[node].mMsg.mOffset, 0));
+      else
+        Append(mOverflowHead, mOverflowTail, node);
+
+      node = next;
+    }
+  }
+
+private:
+  static constexpr int kEnd = -1;
+
+  struct Node
+  {
+    IMidiMsg mMsg;
+    int mNext;
+  };
+
+  /** @param x A non-zero value */
+  static inline int CountTrailingZeros(uint64_t x)
+  {
+#if defined _MSC_VER && (defined _M_X64 || defined _M_ARM64)
+    unsigned long idx;
+    _BitScanForward64(&idx, x);
+    return static_cast<int>(idx);
+#elif defined _MSC_VER // _BitScanForward64 is only available on 64 bit targets
+    unsigned long idx;
+
+    if (_BitScanForward(&idx, static_cast<unsigned long>(x)))
+      return static_cast<int>(idx);
+
+    _BitScanForward(&idx, static_cast<unsigned long>(x >> 32));
+    return static_cast<int>(idx) + 32;
+#else
+    return __builtin_ctzll(x);
+#endif
+  }
+
+  void Append(int& head, int& tail, int node)
+  {
+    if (head == kEnd)
+      head = node;
+    else
+      mNodes[tail].mNext = node;
+
+    tail = node;
+  }
+
+  void Link(int node, int bucket)
+  {
+    Append(mHeads[bucket], mTails[bucket], node);
+    mOccupied[bucket / 64] |= uint64_t(1) << (bucket % 64);
+    mFirstWord = std::min(mFirstWord, bucket / 64);
+  }
+
+  std::vector<Node> mNodes;
+  std::vector<int> mHeads, mTails; // one linked list per sample offset
+  std::vector<uint64_t> mOccupied; // a bit per non-empty bucket
+  int mNBuckets = 0;
+  int mFree = kEnd;
+  int mOverflowHead = kEnd, mOverflowTail = kEnd;
+  int mCount = 0;
+  int mNDropped = 0;
+  int mFirstWord = 0; // no bucket before this word is occupied
+};
+
 END_IPLUG_NAMESPACE
@@ -33,6 +33,15 @@ double IParam::ShapeLinear::ValueToNormalized(double value, const IParam& param)
   return (value - param.mMin) / (param.mMax - param.mMin);
 }
 
+void IParam::ShapeLinear::NormalizedToValues(const double* pNormalized, double* pValues, int nValues, const IParam& param) const
+{
+  const double min = param.mMin;
+  const double range = param.mMax - param.mMin;
+
+  for (auto i = 0; i < nValues; i++)
+    pValues[i] = min + pNormalized[i] * range;
+}
+
 IParam::ShapePowCurve::ShapePowCurve(double shape)
 : mShape(shape)
 {
@@ -58,6 +67,32 @@ double IParam::ShapePowCurve::ValueToNormalized(double value, const IParam& para
   return std::pow((value - param.GetMin()) / (param.GetMax() - param.GetMin()), 1.0 / mShape);
 }
 
+void IParam::ShapePowCurve::NormalizedToValues(const double* pNormalized, double* pValues, int nValues, const IParam& param) const
+{
+  const double min = param.GetMin();
+  const double range = param.GetMax() - param.GetMin();
+
+  // the common curves, as chosen by GetDisplayType(), are computed without pow(), x * x * x can differ from pow() in the last bit
+  auto process = [&](auto curve) {
+    for (auto i = 0; i < nValues; i++)
+      pValues[i] = min + curve(pNormalized[i]) * range;
+  };
+
+  if (mShape == 1.0)
+    process([](double x) { return x; });
+  else if (mShape == 2.0)
+    process([](double x) { return x * x; });
+  else if (mShape == 3.0)
+    process([](double x) { return x * x * x; });
+  else if (mShape == 0.5)
+    process([](double x) { return std::sqrt(x); });
+  else
+  {
+    const double shape = mShape;
+    process([shape](double x) { return std::pow(x, shape); });
+  }
+}
+
 void IParam::ShapeExp::Init(const IParam& param)
 {
   double min = param.GetMin();
@@ -79,6 +114,15 @@ double IParam::ShapeExp::ValueToNormalized(double value, const IParam& param) co
   return (std::log(value) - mAdd) / mMul;
 }
 
+void IParam::ShapeExp::NormalizedToValues(const double* pNormalized, double* pValues, int nValues, const IParam& param) const
+{
+  const double add = mAdd;
+  const double mul = mMul;
+
+  for (auto i = 0; i < nValues; i++)
+    pValues[i] = std::exp(add + pNormalized[i] * mul);
+}
+
 #pragma mark -
 
 IParam::IParam()
@@ -168,6 +212,9 @@ void IParam::InitDouble(const char* name, double defaultVal, double minVal, doub
     
   mShape = std::unique_ptr<Shape>(shape.Clone());
   mShape->Init(*this);
+  
+  mTable.Resize(0);
+  mTableError = 0.;
 }
 
 void IParam::InitFrequency(const char *name, double defaultVal, double minVal, double maxVal, double step, int flags, const char *group)
@@ -245,6 +292,76 @@ void IParam::Init(const IParam& p, const char* searchStr, const char* replaceStr
   }
 }
 
+void IParam::FromNormalized(const double* pNormalized, double* pValues, int nValues) const
+{
+  mShape->NormalizedToValues(pNormalized, pValues, nValues, *this);
+
+  if (mFlags & kFlagStepped)
+  {
+    for (auto i = 0; i < nValues; i++)
+      pValues[i] = Constrain(pValues[i]);
+  }
+  else
+  {
+    for (auto i = 0; i < nValues; i++)
+      pValues[i] = Clip(pValues[i], mMin, mMax);
+  }
+}
+
+void IParam::FromNormalizedApprox(const double* pNormalized, double* pValues, int nValues) const
+{
+  if (mTable.GetSize() < 2)
+  {
+    FromNormalized(pNormalized, pValues, nValues);
+    return;
+  }
+
+  const double* pTable = mTable.Get();
+  const int size = mTable.GetSize() - 1;
+
+  for (auto i = 0; i < nValues; i++)
+  {
+    const double x = Clip(pNormalized[i], 0., 1.) * size;
+    const int idx = std::min(static_cast<int>(x), size - 1);
+    const double frac = x - idx;
+    pValues[i] = pTable[idx] + frac * (pTable[idx + 1] - pTable[idx]);
+  }
+
+  if (mFlags & kFlagStepped)
+  {
+    for (auto i = 0; i < nValues; i++)
+      pValues[i] = Constrain(pValues[i]);
+  }
+  else
+  {
+    for (auto i = 0; i < nValues; i++)
+      pValues[i] = Clip(pValues[i], mMin, mMax);
+  }
+}
+
+void IParam::InitNormalizationTable(int size)
+{
+  size = std::max(size, 1);
+  mTable.Resize(size + 1);
+  double* pTable = mTable.Get();
+
+  for (auto i = 0; i <= size; i++)
+    pTable[i] = mShape->NormalizedToValue(static_cast<double>(i) / size, *this);
+
+  // measure the interpolation error at a few points within each interval
+  mTableError = 0.;
+
+  for (auto i = 0; i < size; i++)
+  {
+    for (double frac : {0.25, 0.5, 0.75})
+    {
+      const double exact = mShape->NormalizedToValue((i + frac) / size, *this);
+      const double approx = pTable[i] + frac * (pTable[i + 1] - pTable[i]);
+      mTableError = std::max(mTableError, std::fabs(exact - approx));
+    }
+  }
+}
+
 void IParam::SetDisplayText(double value, const char* str)
 {
   int n = mDisplayTexts.GetSize();
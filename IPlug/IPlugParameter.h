@@ -83,6 +83,17 @@ public:
      * @param param /todo
      * @return double /todo */
     virtual double ValueToNormalized(double value, const IParam& param) const = 0;
+
+    /** Converts an array of normalized values to real values, without a virtual call per value. Shapes override this with loops that the compiler can vectorize
+     * @param pNormalized The normalized input values in the range 0. to 1.
+     * @param pValues Receives the real values, may be the same array as pNormalized
+     * @param nValues The number of values
+     * @param param The parameter this shape belongs to */
+    virtual void NormalizedToValues(const double* pNormalized, double* pValues, int nValues, const IParam& param) const
+    {
+      for (auto i = 0; i < nValues; i++)
+        pValues[i] = NormalizedToValue(pNormalized[i], param);
+    }
   };
 
   /** Linear parameter shaping */
@@ -92,6 +103,7 @@ public:
     IParam::EDisplayType GetDisplayType() const override { return kDisplayLinear; }
     double NormalizedToValue(double value, const IParam& param) const override;
     double ValueToNormalized(double value, const IParam& param) const override;
+    void NormalizedToValues(const double* pNormalized, double* pValues, int nValues, const IParam& param) const override;
   
     double mShape;
   };
@@ -104,6 +116,7 @@ public:
     IParam::EDisplayType GetDisplayType() const override;
     double NormalizedToValue(double value, const IParam& param) const override;
     double ValueToNormalized(double value, const IParam& param) const override;
+    void NormalizedToValues(const double* pNormalized, double* pValues, int nValues, const IParam& param) const override;
     
     double mShape;
   };
@@ -116,6 +129,7 @@ public:
     IParam::EDisplayType GetDisplayType() const override { return kDisplayLog; }
     double NormalizedToValue(double value, const IParam& param) const override;
     double ValueToNormalized(double value, const IParam& param) const override;
+    void NormalizedToValues(const double* pNormalized, double* pValues, int nValues, const IParam& param) const override;
     
     double mMul = 1.0;
     double mAdd = 1.0;
@@ -281,6 +295,29 @@ public:
     return Constrain(mShape->NormalizedToValue(normalizedValue, *this));
   }
 
+  /** Convert an array of normalized values to real values for this parameter, e.g. a modulation buffer. The result matches calling FromNormalized() for each value within rounding,
+   * since common shapes such as ShapePowCurve(3.) are computed without pow()
+   * @param pNormalized The normalized input values in the range 0. to 1.
+   * @param pValues Receives the real values, may be the same array as pNormalized
+   * @param nValues The number of values */
+  void FromNormalized(const double* pNormalized, double* pValues, int nValues) const;
+
+  /** Convert an array of normalized values to real values by linear interpolation of a table of the shape, built with InitNormalizationTable().
+   * This avoids the pow(), exp() etc. of the shape for audio rate modulation. The error is bounded by GetNormalizationTableError().
+   * Falls back to the exact conversion if there is no table. Stepped parameters are still stepped and all values are clamped to the parameter's range
+   * @param pNormalized The normalized input values in the range 0. to 1.
+   * @param pValues Receives the real values, may be the same array as pNormalized
+   * @param nValues The number of values */
+  void FromNormalizedApprox(const double* pNormalized, double* pValues, int nValues) const;
+
+  /** Tabulates the parameter's shape for FromNormalizedApprox(). This allocates, so call it after the parameter has been initialized, rather than on the audio thread.
+   * Re-initializing the parameter discards the table.
+   * @param size The number of intervals in the table. For a ShapeExp over 3 decades, 1024 gives a relative error below 6e-6 */
+  void InitNormalizationTable(int size = 1024);
+
+  /** @return The largest absolute error of FromNormalizedApprox() relative to the exact conversion, measured when the table was built (in the parameter's units), or 0. if there is no table */
+  double GetNormalizationTableError() const { return mTableError; }
+
   /** Sets the parameter value
    * @param value Value to be set. Will be stepped and clamped between \c mMin and \c mMax */
   void Set(double value) { mValue.store(Constrain(value)); }
@@ -486,6 +523,8 @@ private:
   DisplayFunc mDisplayFunction = nullptr;
 
   WDL_TypedBuf<DisplayText> mDisplayTexts;
+  WDL_TypedBuf<double> mTable; // the shape at mTable.GetSize() - 1 equal intervals, see InitNormalizationTable()
+  double mTableError = 0.;
 } WDL_FIXALIGN;
 
 END_IPLUG_NAMESPACE
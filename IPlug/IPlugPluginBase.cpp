@@ -14,6 +14,7 @@
  */
 
 #include "IPlugPluginBase.h"
+#include "IPlugPresetLibrary.h"
 #include "wdlendian.h"
 #include "wdl_base64.h"
 
@@ -33,6 +34,7 @@ IPluginBase::~IPluginBase()
 #ifndef NO_PRESETS
   mPresets.Empty(true);
 #endif
+  mStateCodecReferences.Empty(true);
 }
 
 int IPluginBase::GetPluginVersion(bool decimal) const
@@ -107,16 +109,26 @@ void IPluginBase::GetBuildInfoStr(WDL_String& str) const
 bool IPluginBase::SerializeParams(IByteChunk& chunk) const
 {
   TRACE
-  bool savedOK = true;
   int i, n = mParams.GetSize();
-  for (i = 0; i < n && savedOK; ++i)
+  const int startPos = chunk.Size();
+  const int size = n * static_cast<int>(sizeof(double));
+
+  // one resize for all parameters, values are written in place
+  chunk.Resize(startPos + size);
+
+  if (chunk.Size() != startPos + size)
+    return false;
+
+  uint8_t* pDest = chunk.GetData() + startPos;
+
+  for (i = 0; i < n; ++i)
   {
     IParam* pParam = mParams.Get(i);
     Trace(TRACELOC, "%d %s %f", i, pParam->GetNameForHost(), pParam->Value());
     double v = pParam->Value();
-    savedOK &= (chunk.Put(&v) > 0);
+    memcpy(pDest + i * sizeof(double), &v, sizeof(double));
   }
-  return savedOK;
+  return true;
 }
 
 int IPluginBase::UnserializeParams(const IByteChunk& chunk, int startPos)
@@ -139,6 +151,76 @@ int IPluginBase::UnserializeParams(const IByteChunk& chunk, int startPos)
   return pos;
 }
 
+void IPluginBase::SetStateCodec(int flags)
+{
+  if ((flags & kStateCodecDeflate) && !IStateCodec::kCanDeflate)
+    DBGMSG("SetStateCodec: kStateCodecDeflate needs IPLUG_STATE_USE_ZLIB and the WDL/zlib sources, see IPlugStateCodec.h. The state will be saved uncompressed\n");
+
+  mStateCodecFlags = flags;
+
+  if (mStateCodecReferences.GetSize())
+    mStateCodecReferences.Delete(0, true);
+
+  IByteChunk* pReference = new IByteChunk;
+
+  if (flags & kStateCodecDelta)
+    SerializeState(*pReference);
+
+  mStateCodecReferences.Insert(0, pReference);
+}
+
+void IPluginBase::AddStateCodecReference(const IByteChunk& reference)
+{
+  IByteChunk* pReference = new IByteChunk;
+  pReference->PutChunk(&reference);
+
+  // The first entry is always the current reference
+  if (!mStateCodecReferences.GetSize())
+    mStateCodecReferences.Add(new IByteChunk);
+
+  mStateCodecReferences.Add(pReference);
+}
+
+bool IPluginBase::SerializeEncodedState(IByteChunk& chunk) const
+{
+  // Unless the plug-in opted in to compression with SetStateCodec() and IPLUG_STATE_USE_ZLIB, the state is saved as SerializeState() writes it
+  if (mStateCodecFlags == kStateCodecNone)
+    return SerializeState(chunk);
+
+  IByteChunk raw;
+
+  if (!SerializeState(raw))
+    return false;
+
+  return IStateCodec::Encode(raw, mStateCodecFlags, mStateCodecReferences.Get(0), chunk);
+}
+
+int IPluginBase::UnserializeEncodedState(const IByteChunk& chunk, int startPos)
+{
+  if (!IStateCodec::IsEncoded(chunk, startPos))
+    return UnserializeState(chunk, startPos);
+
+  const IByteChunk* pReference = nullptr;
+  uint32_t hash;
+
+  if (IStateCodec::GetReferenceHash(chunk, startPos, hash))
+  {
+    for (int i = 0; i < mStateCodecReferences.GetSize() && !pReference; i++)
+    {
+      if (IStateCodec::Hash(*mStateCodecReferences.Get(i)) == hash)
+        pReference = mStateCodecReferences.Get(i);
+    }
+  }
+
+  IByteChunk raw;
+  const int endPos = IStateCodec::Decode(chunk, startPos, pReference, raw);
+
+  if (endPos < 0 || UnserializeState(raw, 0) < 0)
+    return -1;
+
+  return endPos;
+}
+
 void IPluginBase::InitParamRange(int startIdx, int endIdx, int countStart, const char* nameFmtStr, double defaultVal, double minVal, double maxVal, double step, const char *label, int flags, const char *group, const IParam::Shape& shape, IParam::EParamUnit unit, IParam::DisplayFunc displayFunc)
 {
   WDL_String nameStr;
@@ -259,6 +341,84 @@ void IPluginBase::PrintParamValues()
   });
 }
 
+bool IPluginBase::OnPresetMsgFromUI(int msgTag, int ctrlTag, int dataSize, const void* pData)
+{
+#ifdef NO_PRESETS
+  return false;
+#else
+  int restoredIdx = -1;
+
+  switch (msgTag)
+  {
+    case kMsgTagRequestPresets:
+      break;
+    case kMsgTagRestorePreset:
+    {
+      int idx = -1;
+
+      if (dataSize == sizeof(int))
+        memcpy(&idx, pData, sizeof(int));
+
+      const int nPresets = NPresets();
+
+      if (idx >= 0 && idx < nPresets && RestorePreset(idx))
+      {
+        InformHostOfProgramChange();
+        DirtyParametersFromUI();
+        restoredIdx = idx;
+      }
+      else if (idx >= nPresets && RestoreUserPreset(idx - nPresets))
+      {
+        DirtyParametersFromUI();
+        restoredIdx = idx;
+      }
+      break;
+    }
+    case kMsgTagAddUserPresetFile:
+    {
+      WDL_String path;
+
+      if (IByteStream(pData, dataSize).GetStr(path, 0) > 0)
+        AddUserPresetFile(path.Get());
+      break;
+    }
+    default:
+      return false;
+  }
+
+  const int generation = mPresetLibrary ? mPresetLibrary->GetGeneration() : 0;
+
+  // The names are only sent again when they are asked for or have changed
+  if (msgTag != kMsgTagRequestPresets && generation == mSentPresetListGeneration)
+  {
+    IByteChunk indices;
+    indices.Put(&mCurrentPresetIdx);
+    indices.Put(&restoredIdx);
+    SendControlMsgFromDelegate(ctrlTag, kMsgTagPresetRestored, indices.Size(), indices.GetData());
+    return true;
+  }
+
+  mSentPresetListGeneration = generation;
+
+  const int nPresets = NPresets();
+  const int nUserPresets = NUserPresets();
+  IByteChunk list;
+  list.Put(&nPresets);
+  list.Put(&nUserPresets);
+  list.Put(&mCurrentPresetIdx);
+  list.Put(&restoredIdx);
+
+  for (int i = 0; i < nPresets; i++)
+    list.PutStr(GetPresetName(i));
+
+  for (int i = 0; i < nUserPresets; i++)
+    list.PutStr(GetUserPresetName(i));
+
+  SendControlMsgFromDelegate(ctrlTag, kMsgTagPresetList, list.Size(), list.GetData());
+  return true;
+#endif
+}
+
 #ifndef NO_PRESETS
 static IPreset* GetNextUninitializedPreset(WDL_PtrList<IPreset>* pPresets)
 {
@@ -412,11 +572,31 @@ void IPluginBase::PruneUninitializedPresets()
   }
 }
 
+int IPluginBase::NPresets() const
+{
+  return mPresets.GetSize() + (mPresetLibrary ? mPresetLibrary->NFactoryPresets() : 0);
+}
+
 bool IPluginBase::RestorePreset(int idx)
 {
   TRACE
   bool restoredOK = false;
-  if (idx >= 0 && idx < mPresets.GetSize())
+  if (mPresetLibrary && idx >= mPresets.GetSize() && idx < NPresets())
+  {
+    // library presets are only loaded when they are restored
+    IByteChunk chunk;
+    
+    if (mPresetLibrary->GetPresetChunk(idx - mPresets.GetSize(), chunk))
+      restoredOK = (UnserializeState(chunk, 0) > 0);
+    
+    if (restoredOK)
+    {
+      mCurrentPresetIdx = idx;
+      OnPresetsModified();
+      OnRestoreState();
+    }
+  }
+  else if (idx >= 0 && idx < mPresets.GetSize())
   {
     IPreset* pPreset = mPresets.Get(idx);
     
@@ -454,6 +634,17 @@ bool IPluginBase::RestorePreset(const char* name)
         return RestorePreset(i);
       }
     }
+    
+    if (mPresetLibrary)
+    {
+      const int libraryIdx = mPresetLibrary->Find(name);
+      const int nFactory = mPresetLibrary->NFactoryPresets();
+      
+      if (libraryIdx > -1 && libraryIdx < nFactory)
+        return RestorePreset(n + libraryIdx);
+      else if (libraryIdx >= nFactory)
+        return RestoreUserPreset(libraryIdx - nFactory);
+    }
   }
   return false;
 }
@@ -464,9 +655,80 @@ const char* IPluginBase::GetPresetName(int idx) const
   {
     return mPresets.Get(idx)->mName;
   }
+  else if (mPresetLibrary && idx >= mPresets.GetSize() && idx < NPresets())
+  {
+    return mPresetLibrary->GetName(idx - mPresets.GetSize());
+  }
   return "";
 }
 
+int IPluginBase::NUserPresets() const
+{
+  return mPresetLibrary ? mPresetLibrary->NUserPresets() : 0;
+}
+
+const char* IPluginBase::GetUserPresetName(int idx) const
+{
+  if (mPresetLibrary && idx >= 0)
+    return mPresetLibrary->GetName(mPresetLibrary->NFactoryPresets() + idx);
+  
+  return "";
+}
+
+bool IPluginBase::RestoreUserPreset(int idx)
+{
+  TRACE
+  IByteChunk chunk;
+  
+  if (!mPresetLibrary || idx < 0 || !mPresetLibrary->GetPresetChunk(mPresetLibrary->NFactoryPresets() + idx, chunk))
+    return false;
+  
+  if (UnserializeState(chunk, 0) < 0)
+    return false;
+  
+  OnRestoreState();
+  return true;
+}
+
+bool IPluginBase::AddUserPresetFile(const char* path)
+{
+  if (!mPresetLibrary)
+    mPresetLibrary = std::make_unique<IPresetLibrary>();
+  
+  return mPresetLibrary->AddUserFile(path);
+}
+
+bool IPluginBase::LoadPresetLibrary(const char* path)
+{
+  if (!mPresetLibrary)
+    mPresetLibrary = std::make_unique<IPresetLibrary>();
+  
+  return mPresetLibrary->Open(path);
+}
+
+void IPluginBase::IndexUserPresets(const char* path, const char* extension)
+{
+  if (!mPresetLibrary)
+    mPresetLibrary = std::make_unique<IPresetLibrary>();
+  
+  mPresetLibrary->IndexFolder(path, extension);
+}
+
+bool IPluginBase::SavePresetLibrary(const char* path) const
+{
+  std::vector<IPresetLibrary::Item> items;
+  
+  for (int i = 0; i < mPresets.GetSize(); ++i)
+  {
+    IPreset* pPreset = mPresets.Get(i);
+    
+    if (pPreset->mInitialized)
+      items.push_back({pPreset->mName, "", &pPreset->mChunk});
+  }
+  
+  return IPresetLibrary::Write(path, items);
+}
+
 void IPluginBase::ModifyCurrentPreset(const char* name)
 {
   if (mCurrentPresetIdx >= 0 && mCurrentPresetIdx < mPresets.GetSize())
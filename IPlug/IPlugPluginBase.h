@@ -18,10 +18,13 @@
 #include "IPlugDelegate_select.h"
 #include "IPlugParameter.h"
 #include "IPlugStructs.h"
+#include "IPlugStateCodec.h"
 #include "IPlugLogger.h"
 
 BEGIN_IPLUG_NAMESPACE
 
+class IPresetLibrary;
+
 /** Base class that contains plug-in info and state manipulation methods */
 class IPluginBase : public EDITOR_DELEGATE_CLASS
 {
@@ -150,6 +153,34 @@ public:
    * @param chunk chunk The incoming chunk containing the state data.
    * @return The new chunk position (endPos) */
   virtual int UnserializeVST3CtrlrState(const IByteChunk& chunk, int startPos) { return startPos; }
+
+  /** Sets how the state is encoded when the host saves it, see EStateCodec. If kStateCodecDelta is used, the current state is captured as the reference,
+   * so call this at the end of your plug-in's constructor, when parameters and custom data are at their defaults.
+   * A delta encoded state can only be decoded with the reference it was saved against. If a new version changes the default state, keep the reference of each
+   * earlier version (e.g. a chunk written by SerializeState() at its defaults, stored as a resource) and pass it to AddStateCodecReference(), so that old sessions keep loading.
+   * States saved without encoding are always loaded.
+   * Compression is opt-in: kStateCodecDeflate, and with it kStateCodecDelta, only take effect in builds that define IPLUG_STATE_USE_ZLIB and compile the WDL/zlib sources,
+   * see IPlugStateCodec.h. Other builds save the state uncompressed.
+   * @param flags A combination of EStateCodec flags */
+  void SetStateCodec(int flags);
+
+  /** Adds the delta reference of an earlier version of the plug-in, see SetStateCodec(). References are matched to saved states by their hash
+   * @param reference The state that an earlier version captured as its reference */
+  void AddStateCodecReference(const IByteChunk& reference);
+
+  /** @return The EStateCodec flags set with SetStateCodec() */
+  int GetStateCodec() const { return mStateCodecFlags; }
+
+  /** Called by the API classes to serialize the state via SerializeState(), encoded as set with SetStateCodec()
+   * @param chunk The output chunk, data is appended
+   * @return \c true if serialization was successful */
+  bool SerializeEncodedState(IByteChunk& chunk) const;
+
+  /** Called by the API classes to unserialize a state via UnserializeState(), whether it was encoded or not
+   * @param chunk The incoming chunk containing the state data
+   * @param startPos The position in the chunk where the data starts
+   * @return The new chunk position (endPos), or -1 on failure */
+  int UnserializeEncodedState(const IByteChunk& chunk, int startPos);
   
   /** Get the index of the current, active preset
    * @return The index of the current preset */
@@ -179,8 +210,9 @@ public:
   void ModifyCurrentPreset(const char* name = 0);
 
   /** Gets the number of factory presets. NOTE: some hosts don't like 0 presets, so even if you don't support factory presets, this method should return 1
+   * This includes the factory presets of the preset library, if one is loaded, which follow the baked in presets, but not the user presets
    * @return The number of factory presets */
-  int NPresets() const { return mPresets.GetSize(); }
+  int NPresets() const;
 
   /** Restore a preset by index. This should also update mCurrentPresetIdx
    * @param idx The index of the preset to restore
@@ -239,6 +271,44 @@ public:
    * @param blob The binary string
    * @param sizeOfChunk The binary string size */
   void MakePresetFromBlob(const char* name, const char* blob, int sizeOfChunk);
+
+  /** Memory maps an on-disk preset library (see IPresetLibrary), whose presets are added after the baked in presets. Names are read from the mapping and
+   * a preset's state is only loaded when it is restored, so large factory libraries don't use memory per instance and are not stored in the state chunk.
+   * Call this in the plug-in constructor, since some hosts only query the number of presets once
+   * @param path The preset container
+   * @return \c true if the library was loaded */
+  bool LoadPresetLibrary(const char* path);
+
+  /** Indexes a folder of user preset containers on a background thread. User presets are not included in NPresets(), since hosts such as VST3 ones
+   * read the program list once, and the number of user presets changes when indexing completes. Use NUserPresets(), GetUserPresetName() and RestoreUserPreset()
+   * @param path The folder to index
+   * @param extension The file extension of the preset containers */
+  void IndexUserPresets(const char* path, const char* extension = ".ipresets");
+
+  /** Adds the presets of a user preset container to the user presets straight away, e.g. one chosen by the user
+   * @param path The preset container
+   * @return \c true if the file was a valid container */
+  bool AddUserPresetFile(const char* path);
+
+  /** @return The number of user presets indexed so far */
+  int NUserPresets() const;
+
+  /** @param idx The index of the user preset, from 0 to NUserPresets() - 1
+   * @return The name of the user preset, or an empty string for an invalid index */
+  const char* GetUserPresetName(int idx) const;
+
+  /** Restores a user preset. User presets are not programs, so this doesn't change the current preset index
+   * @param idx The index of the user preset, from 0 to NUserPresets() - 1
+   * @return \c true on success */
+  bool RestoreUserPreset(int idx);
+
+  /** Writes the baked in presets to a preset container, e.g. to build a factory library that can be loaded with LoadPresetLibrary()
+   * @param path The file to write
+   * @return \c true on success */
+  bool SavePresetLibrary(const char* path) const;
+
+  /** @return The preset library, or nullptr if none has been loaded */
+  IPresetLibrary* GetPresetLibrary() { return mPresetLibrary.get(); }
   
   /** /todo */
   void PruneUninitializedPresets();
@@ -442,6 +512,17 @@ public:
   void PrintParamValues();
 
 protected:
+  /** Handles the preset messages of EPresetMsgTag, which preset browsers such as IVPresetManagerControl send with SendArbitraryMsgFromUI().
+   * Called by the API classes on the editor side (the controller, in distributed plug-ins) before OnMessage(), since restoring a preset there
+   * and informing the host of the parameter changes reaches the processor, as the host's own program changes do.
+   * kMsgTagRequestPresets, and any request made after the presets have changed (a library was loaded or user presets were indexed), is answered
+   * by a kMsgTagPresetList message to the control with ctrlTag, which contains, as IByteChunk data:
+   * int NPresets(), int NUserPresets(), int GetCurrentPresetIdx(), int the index that was restored or -1, then the preset names followed by the user preset names as strings.
+   * Other requests, such as restoring a preset, are answered by a kMsgTagPresetRestored message with only int GetCurrentPresetIdx() and int the index that was restored or -1,
+   * so that stepping through a large library doesn't send all of its names on every step. A UI with several preset browsers should request the list when it opens one.
+   * @return \c true if the message was a preset message */
+  bool OnPresetMsgFromUI(int msgTag, int ctrlTag, int dataSize, const void* pData);
+
   int mCurrentPresetIdx = 0;
   /** \c true if the plug-in does opaque state chunks. If false the host will provide a default interface */
   bool mStateChunks = false;
@@ -478,12 +559,21 @@ protected:
   /** A list of unique cstrings found specified as "parameter groups" when defining IParams. These are used in various APIs to group parameters together in automation dialogues. */
   WDL_PtrList<const char> mParamGroups;
   
+  /** EStateCodec flags for the state saved by the host */
+  int mStateCodecFlags = kStateCodecNone;
+  /** The reference states for delta encoding, the first is the one states are saved against */
+  WDL_PtrList<IByteChunk> mStateCodecReferences;
+
 #ifndef NO_PRESETS
   WDL_PtrList<IPreset> mPresets;
+  std::unique_ptr<IPresetLibrary> mPresetLibrary;
+  int mSentPresetListGeneration = -1; // the IPresetLibrary::GetGeneration() of the preset list last sent by OnPresetMsgFromUI()
 #endif
 
 #ifdef PARAMS_MUTEX
   friend class IPlugVST3ProcessorBase;
+  friend class IPlugEEL;
+  friend class IPlugFaust;
 protected:
   /** Lock when accessing mParams (including via GetParam) from the audio thread */
   WDL_Mutex mParams_mutex;
@@ -0,0 +1,673 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+#pragma once
+
+/**
+ * @file
+ * @copydoc IPresetLibrary
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#if !defined OS_WEB
+#include <thread>
+#endif
+
+#if !defined OS_WIN && !defined OS_WEB
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "dirscan.h"
+#include "mutex.h"
+
+#include "IPlugPlatform.h"
+#include "IPlugStructs.h"
+#include "IPlugPaths.h"
+
+BEGIN_IPLUG_NAMESPACE
+
+/** A read-only view of a whole file. The file is memory mapped, so only the pages that are accessed are read from disk.
+ * On the web, where there is no mmap, the file is read into memory */
+class IPlugMappedFile
+{
+public:
+  IPlugMappedFile() = default;
+  ~IPlugMappedFile() { Close(); }
+
+  IPlugMappedFile(const IPlugMappedFile&) = delete;
+  IPlugMappedFile& operator=(const IPlugMappedFile&) = delete;
+
+  /** @return \c true if the file was opened and mapped */
+  bool Open(const char* path)
+  {
+    Close();
+
+#if defined OS_WIN
+    wchar_t pathW[MAX_PATH];
+    UTF8ToUTF16(pathW, path, MAX_PATH);
+    mFile = CreateFileW(pathW, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+
+    if (mFile == INVALID_HANDLE_VALUE)
+      return false;
+
+    LARGE_INTEGER size;
+
+    if (GetFileSizeEx(mFile, &size) && size.QuadPart > 0)
+    {
+      mMapping = CreateFileMappingW(mFile, NULL, PAGE_READONLY, 0, 0, NULL);
+
+      if (mMapping)
+      {
+        mData = static_cast<const uint8_t*>(MapViewOfFile(mMapping, FILE_MAP_READ, 0, 0, 0));
+        mSize = mData ? static_cast<size_t>(size.QuadPart) : 0;
+      }
+    }
+#elif defined OS_WEB
+    FILE* fp = fopen(path, "rb");
+
+    if (!fp)
+      return false;
+
+    fseek(fp, 0, SEEK_END);
+    const long size = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+
+    if (size > 0)
+    {
+      mBuffer.resize(size);
+
+      if (fread(mBuffer.data(), 1, size, fp) == static_cast<size_t>(size))
+      {
+        mData = mBuffer.data();
+        mSize = mBuffer.size();
+      }
+    }
+
+    fclose(fp);
+#else
+    const int fd = open(path, O_RDONLY);
+
+    if (fd < 0)
+      return false;
+
+    struct stat st;
+
+    if (fstat(fd, &st) == 0 && st.st_size > 0)
+    {
+      void* pData = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+      if (pData != MAP_FAILED)
+      {
+        mData = static_cast<const uint8_t*>(pData);
+        mSize = st.st_size;
+      }
+    }
+
+    close(fd); // the mapping keeps a reference to the file
+#endif
+
+    if (!mData)
+      Close();
+
+    return mData != nullptr;
+  }
+
+  void Close()
+  {
+#if defined OS_WIN
+    if (mData) UnmapViewOfFile(mData);
+    if (mMapping) CloseHandle(mMapping);
+    if (mFile != INVALID_HANDLE_VALUE) CloseHandle(mFile);
+    mMapping = NULL;
+    mFile = INVALID_HANDLE_VALUE;
+#elif defined OS_WEB
+    mBuffer.clear();
+#else
+    if (mData) munmap(const_cast<uint8_t*>(mData), mSize);
+#endif
+    mData = nullptr;
+    mSize = 0;
+  }
+
+  const uint8_t* Data() const { return mData; }
+  size_t Size() const { return mSize; }
+
+private:
+  const uint8_t* mData = nullptr;
+  size_t mSize = 0;
+#if defined OS_WIN
+  HANDLE mFile = INVALID_HANDLE_VALUE;
+  HANDLE mMapping = NULL;
+#elif defined OS_WEB
+  std::vector<uint8_t> mBuffer;
+#endif
+};
+
+/** IPresetLibrary gives access to large preset collections without keeping them in memory.
+ * Presets are stored in a compact container: a header, a fixed size index entry per preset, an array of entries sorted by name, a string table of names and tags,
+ * and the payloads, which are the state chunks written by IPluginBase::SerializeState(). Numbers are in the byte order of the machine that wrote the container,
+ * as the state chunks are, so that the index can be used straight from the mapping. A container written with the other byte order fails the magic number check and is refused.
+ * A factory library is memory mapped with Open(), so that names and tags are read directly from the mapping, names are found with a binary search,
+ * and a payload is only read from disk when it is recalled with GetPresetChunk().
+ * Folders of user preset containers are indexed on a background thread with IndexFolder(), only reading the headers and names of each file.
+ * Indices 0 to NFactoryPresets() - 1 are the factory presets, followed by the user presets. See IPluginBase::LoadPresetLibrary() */
+class IPresetLibrary
+{
+public:
+  static constexpr uint32_t kMagic = 0x4C505049; // "IPPL"
+  static constexpr uint32_t kVersion = 1;
+
+  /** A preset to be written with Write() */
+  struct Item
+  {
+    const char* name;
+    const char* tags; // e.g. comma separated categories, may be empty
+    const IByteChunk* pChunk;
+  };
+
+  IPresetLibrary() = default;
+
+  /** Cancels indexing, so that destruction doesn't wait for a folder scan to finish */
+  ~IPresetLibrary()
+  {
+    StopIndexing();
+  }
+
+  IPresetLibrary(const IPresetLibrary&) = delete;
+  IPresetLibrary& operator=(const IPresetLibrary&) = delete;
+
+  /** Writes a preset container
+   * @param path The file to write
+   * @param items The presets, in the order of their indices
+   * @return \c true on success */
+  static bool Write(const char* path, const std::vector<Item>& items)
+  {
+    const uint32_t nPresets = static_cast<uint32_t>(items.size());
+    std::vector<FileEntry> entries(nPresets);
+    std::vector<uint32_t> sorted(nPresets);
+    std::vector<char> strings;
+
+    auto addString = [&strings](const char* str) {
+      const uint32_t offset = static_cast<uint32_t>(strings.size());
+      str = str ? str : "";
+      strings.insert(strings.end(), str, str + strlen(str) + 1);
+      return offset;
+    };
+
+    FileHeader header = {};
+    header.magic = kMagic;
+    header.version = kVersion;
+    header.nPresets = nPresets;
+    header.indexOffset = sizeof(FileHeader);
+    header.sortedOffset = header.indexOffset + nPresets * sizeof(FileEntry);
+    header.stringsOffset = header.sortedOffset + nPresets * sizeof(uint32_t);
+
+    for (uint32_t i = 0; i < nPresets; i++)
+    {
+      entries[i].nameOffset = addString(items[i].name);
+      entries[i].tagsOffset = addString(items[i].tags);
+      sorted[i] = i;
+    }
+
+    header.stringsSize = strings.size();
+
+    uint64_t payloadOffset = header.stringsOffset + header.stringsSize;
+
+    for (uint32_t i = 0; i < nPresets; i++)
+    {
+      entries[i].payloadOffset = payloadOffset;
+      entries[i].payloadSize = items[i].pChunk ? items[i].pChunk->Size() : 0;
+      payloadOffset += entries[i].payloadSize;
+    }
+
+    std::sort(sorted.begin(), sorted.end(), [&](uint32_t a, uint32_t b) {
+      return strcmp(strings.data() + entries[a].nameOffset, strings.data() + entries[b].nameOffset) < 0;
+    });
+
+    FILE* fp = fopen(path, "wb");
+
+    if (!fp)
+      return false;
+
+    bool ok = fwrite(&header, sizeof(FileHeader), 1, fp) == 1;
+    ok &= !nPresets || fwrite(entries.data(), sizeof(FileEntry), nPresets, fp) == nPresets;
+    ok &= !nPresets || fwrite(sorted.data(), sizeof(uint32_t), nPresets, fp) == nPresets;
+    ok &= strings.empty() || fwrite(strings.data(), 1, strings.size(), fp) == strings.size();
+
+    for (uint32_t i = 0; i < nPresets && ok; i++)
+    {
+      if (entries[i].payloadSize)
+        ok &= fwrite(items[i].pChunk->GetData(), 1, entries[i].payloadSize, fp) == entries[i].payloadSize;
+    }
+
+    fclose(fp);
+    return ok;
+  }
+
+  /** Memory maps a factory preset container, replacing the previously opened one. Call this on the main thread, when no presets are being recalled
+   * @param path The container file
+   * @return \c true if the file is a valid container */
+  bool Open(const char* path)
+  {
+    mFactoryFile.Close();
+    mFactory = {};
+    mGeneration++;
+
+    if (!mFactoryFile.Open(path))
+      return false;
+
+    if (!ParseContainer(mFactoryFile.Data(), mFactoryFile.Size(), mFactory))
+    {
+      mFactoryFile.Close();
+      mFactory = {};
+      return false;
+    }
+
+    return true;
+  }
+
+  /** Starts indexing a folder (and its sub folders) of user preset containers on a background thread. Presets found replace the previously indexed user presets when indexing is complete.
+   * The strings returned by GetName() and GetTags() for previously indexed user presets remain valid until the next call of IndexFolder().
+   * @param path The folder to scan
+   * @param extension The file extension of the preset containers */
+  void IndexFolder(const char* path, const char* extension = ".ipresets")
+  {
+    StopIndexing();
+
+    {
+      WDL_MutexLock lock(&mUserMutex);
+      mRetiredIndices.clear();
+    }
+
+    mIndexing = true;
+    mStopIndexing = false;
+
+    std::string folder(path);
+    std::string ext(extension);
+
+    auto indexFunc = [this, folder, ext]() {
+      auto pIndex = std::make_shared<UserIndex>();
+
+      if (ScanFolder(folder.c_str(), ext.c_str(), *pIndex, mStopIndexing))
+        Publish(pIndex);
+
+      mIndexing = false;
+    };
+
+#if defined OS_WEB
+    indexFunc();
+#else
+    mIndexThread = std::thread(indexFunc);
+#endif
+  }
+
+  /** Cancels indexing, if a folder is being indexed, and waits for the indexing thread to finish. The previously indexed user presets are kept */
+  void StopIndexing()
+  {
+    mStopIndexing = true;
+
+#if !defined OS_WEB
+    if (mIndexThread.joinable())
+      mIndexThread.join();
+#endif
+  }
+
+  /** Adds the presets of a user preset container to the indexed user presets, straight away. Call this on the main thread
+   * @param path The container file
+   * @return \c true if the file is a valid container */
+  bool AddUserFile(const char* path)
+  {
+    auto pIndex = std::make_shared<UserIndex>();
+
+    {
+      WDL_MutexLock lock(&mUserMutex);
+
+      if (mUserIndex)
+        pIndex->entries = mUserIndex->entries;
+    }
+
+    const size_t nExisting = pIndex->entries.size();
+
+    if (!IndexFile(path, *pIndex) || pIndex->entries.size() == nExisting)
+      return false;
+
+    Publish(pIndex);
+    return true;
+  }
+
+  /** @return \c true while a folder is being indexed */
+  bool IsIndexing() const { return mIndexing; }
+
+  /** @return A number that changes whenever the presets change, when a factory container is opened or user presets are added or indexed */
+  int GetGeneration() const { return mGeneration; }
+
+  /** @return The number of presets in the factory container */
+  int NFactoryPresets() const { return static_cast<int>(mFactory.nPresets); }
+
+  /** @return The number of indexed user presets, which follow the factory presets */
+  int NUserPresets() const
+  {
+    WDL_MutexLock lock(&mUserMutex);
+    return mUserIndex ? static_cast<int>(mUserIndex->entries.size()) : 0;
+  }
+
+  /** @return The total number of factory and indexed user presets */
+  int NPresets() const
+  {
+    WDL_MutexLock lock(&mUserMutex);
+    return NFactoryPresets() + (mUserIndex ? static_cast<int>(mUserIndex->entries.size()) : 0);
+  }
+
+  /** @return The name of a preset, or an empty string for an invalid index */
+  const char* GetName(int idx) const
+  {
+    if (idx >= 0 && idx < NFactoryPresets())
+      return mFactory.strings + mFactory.entries[idx].nameOffset;
+
+    WDL_MutexLock lock(&mUserMutex);
+    const UserEntry* pEntry = GetUserEntry(idx);
+    return pEntry ? pEntry->name.c_str() : "";
+  }
+
+  /** @return The tags of a preset, or an empty string for an invalid index */
+  const char* GetTags(int idx) const
+  {
+    if (idx >= 0 && idx < NFactoryPresets())
+      return mFactory.strings + mFactory.entries[idx].tagsOffset;
+
+    WDL_MutexLock lock(&mUserMutex);
+    const UserEntry* pEntry = GetUserEntry(idx);
+    return pEntry ? pEntry->tags.c_str() : "";
+  }
+
+  /** Find a preset by name, factory presets are searched first
+   * @return The index of the preset, or -1 if it was not found */
+  int Find(const char* name) const
+  {
+    int lo = 0, hi = NFactoryPresets() - 1;
+
+    while (lo <= hi)
+    {
+      const int mid = (lo + hi) / 2;
+      const uint32_t idx = mFactory.sorted[mid];
+      const int cmp = strcmp(name, mFactory.strings + mFactory.entries[idx].nameOffset);
+
+      if (cmp == 0)
+        return static_cast<int>(idx);
+      else if (cmp < 0)
+        hi = mid - 1;
+      else
+        lo = mid + 1;
+    }
+
+    WDL_MutexLock lock(&mUserMutex);
+
+    if (mUserIndex)
+    {
+      auto it = mUserIndex->byName.find(name);
+
+      if (it != mUserIndex->byName.end())
+        return NFactoryPresets() + it->second;
+    }
+
+    return -1;
+  }
+
+  /** Reads the payload of a preset. Factory payloads are copied from the mapping, user payloads are read from their file
+   * @param idx The index of the preset
+   * @param chunk Receives the state chunk
+   * @return \c true on success */
+  bool GetPresetChunk(int idx, IByteChunk& chunk) const
+  {
+    chunk.Clear();
+
+    if (idx >= 0 && idx < NFactoryPresets())
+    {
+      const FileEntry& entry = mFactory.entries[idx];
+      return chunk.PutBytes(mFactory.pData + entry.payloadOffset, static_cast<int>(entry.payloadSize)) > 0;
+    }
+
+    std::string path;
+    uint64_t offset = 0;
+    uint32_t size = 0;
+
+    {
+      WDL_MutexLock lock(&mUserMutex);
+      const UserEntry* pEntry = GetUserEntry(idx);
+
+      if (!pEntry)
+        return false;
+
+      path = pEntry->path;
+      offset = pEntry->payloadOffset;
+      size = pEntry->payloadSize;
+    }
+
+    FILE* fp = fopen(path.c_str(), "rb");
+
+    if (!fp)
+      return false;
+
+    bool ok = size > 0 && fseek(fp, static_cast<long>(offset), SEEK_SET) == 0;
+
+    if (ok)
+    {
+      chunk.Resize(static_cast<int>(size));
+      ok = fread(chunk.GetData(), 1, size, fp) == size;
+    }
+
+    fclose(fp);
+    return ok;
+  }
+
+private:
+  struct FileHeader
+  {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t nPresets;
+    uint32_t reserved;
+    uint64_t indexOffset;
+    uint64_t sortedOffset;
+    uint64_t stringsOffset;
+    uint64_t stringsSize;
+  };
+
+  struct FileEntry
+  {
+    uint32_t nameOffset;
+    uint32_t tagsOffset;
+    uint64_t payloadOffset;
+    uint32_t payloadSize;
+    uint32_t reserved;
+  };
+
+  /** Pointers into a validated container */
+  struct Container
+  {
+    const uint8_t* pData = nullptr;
+    uint32_t nPresets = 0;
+    const FileEntry* entries = nullptr;
+    const uint32_t* sorted = nullptr;
+    const char* strings = nullptr;
+  };
+
+  struct UserEntry
+  {
+    std::string name;
+    std::string tags;
+    std::string path;
+    uint64_t payloadOffset;
+    uint32_t payloadSize;
+  };
+
+  struct UserIndex
+  {
+    std::vector<UserEntry> entries;
+    std::unordered_map<std::string, int> byName;
+  };
+
+  /** Checks that all the offsets in a container are within the data, and that the strings are terminated */
+  static bool ParseContainer(const uint8_t* pData, size_t size, Container& container)
+  {
+    if (size < sizeof(FileHeader))
+      return false;
+
+    FileHeader header;
+    memcpy(&header, pData, sizeof(FileHeader));
+
+    if (header.magic != kMagic || header.version > kVersion)
+      return false;
+
+    const uint64_t n = header.nPresets;
+
+    if (header.indexOffset + n * sizeof(FileEntry) > size || header.sortedOffset + n * sizeof(uint32_t) > size
+     || header.stringsOffset + header.stringsSize > size || header.indexOffset % alignof(FileEntry) || header.sortedOffset % alignof(uint32_t))
+      return false;
+
+    const FileEntry* entries = reinterpret_cast<const FileEntry*>(pData + header.indexOffset);
+    const uint32_t* sorted = reinterpret_cast<const uint32_t*>(pData + header.sortedOffset);
+    const char* strings = reinterpret_cast<const char*>(pData + header.stringsOffset);
+
+    if (n && (!header.stringsSize || strings[header.stringsSize - 1] != '\0'))
+      return false;
+
+    for (uint64_t i = 0; i < n; i++)
+    {
+      const FileEntry& e = entries[i];
+
+      if (e.nameOffset >= header.stringsSize || e.tagsOffset >= header.stringsSize || e.payloadOffset + e.payloadSize > size || sorted[i] >= n)
+        return false;
+    }
+
+    container.pData = pData;
+    container.nPresets = header.nPresets;
+    container.entries = entries;
+    container.sorted = sorted;
+    container.strings = strings;
+    return true;
+  }
+
+  /** Builds the name lookup of an index and makes it the current user index, keeping the previous one alive */
+  void Publish(const std::shared_ptr<UserIndex>& pIndex)
+  {
+    for (auto i = 0; i < static_cast<int>(pIndex->entries.size()); i++)
+      pIndex->byName.emplace(pIndex->entries[i].name, i); // first preset of a name wins
+
+    WDL_MutexLock lock(&mUserMutex);
+
+    if (mUserIndex)
+      mRetiredIndices.push_back(mUserIndex);
+
+    mUserIndex = pIndex;
+    mGeneration++;
+  }
+
+  /** Maps a container to add its index, but not its payloads, to a user index
+   * @return \c true if the file is a valid container */
+  static bool IndexFile(const char* path, UserIndex& index)
+  {
+    IPlugMappedFile file;
+    Container container;
+
+    if (!file.Open(path) || !ParseContainer(file.Data(), file.Size(), container))
+      return false;
+
+    for (uint32_t i = 0; i < container.nPresets; i++)
+    {
+      const FileEntry& e = container.entries[i];
+      index.entries.push_back({container.strings + e.nameOffset, container.strings + e.tagsOffset, path, e.payloadOffset, e.payloadSize});
+    }
+
+    return true;
+  }
+
+  /** Called on the indexing thread, maps each container to read its index, but not its payloads
+   * @return \c false if the scan was cancelled with StopIndexing() */
+  static bool ScanFolder(const char* path, const char* extension, UserIndex& index, const std::atomic<bool>& stop)
+  {
+    WDL_DirScan d;
+
+    if (d.First(path))
+      return !stop;
+
+    const size_t extLen = strlen(extension);
+
+    do
+    {
+      if (stop)
+        return false;
+
+      const char* f = d.GetCurrentFN();
+
+      if (!f || f[0] == '.')
+        continue;
+
+      WDL_String fullPath;
+      d.GetCurrentFullFN(&fullPath);
+
+      if (d.GetCurrentIsDirectory())
+      {
+        if (!ScanFolder(fullPath.Get(), extension, index, stop))
+          return false;
+
+        continue;
+      }
+
+      const size_t len = strlen(f);
+
+      if (len <= extLen || strcmp(f + len - extLen, extension))
+        continue;
+
+      IndexFile(fullPath.Get(), index);
+    }
+    while (!d.Next());
+
+    return !stop;
+  }
+
+  /** Must be called with mUserMutex locked */
+  const UserEntry* GetUserEntry(int idx) const
+  {
+    idx -= NFactoryPresets();
+
+    if (!mUserIndex || idx < 0 || idx >= static_cast<int>(mUserIndex->entries.size()))
+      return nullptr;
+
+    return &mUserIndex->entries[idx];
+  }
+
+  IPlugMappedFile mFactoryFile;
+  Container mFactory;
+
+  mutable WDL_Mutex mUserMutex;
+  std::shared_ptr<UserIndex> mUserIndex;
+  std::vector<std::shared_ptr<UserIndex>> mRetiredIndices; // kept alive so that strings handed out remain valid
+  std::atomic<bool> mIndexing {false};
+  std::atomic<bool> mStopIndexing {false};
+  std::atomic<int> mGeneration {0};
+#if !defined OS_WEB
+  std::thread mIndexThread;
+#endif
+};
+
+END_IPLUG_NAMESPACE
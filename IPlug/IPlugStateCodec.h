@@ -0,0 +1,229 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+#pragma once
+
+/**
+ * @file
+ * @copydoc IStateCodec
+ */
+
+#include <cstdint>
+#include <cstring>
+
+#include "IPlugPlatform.h"
+#include "IPlugStructs.h"
+
+/* Compression of saved state is opt-in, since it needs zlib, which iPlug2 projects don't build by default. To use kStateCodecDeflate:
+ * - add IPLUG_STATE_USE_ZLIB=1 to the preprocessor definitions of every target of the plug-in
+ * - add adler32.c, compress.c, crc32.c, deflate.c, inffast.c, inflate.c, inftrees.c, trees.c, uncompr.c and zutil.c from WDL/zlib to the project
+ * - call SetStateCodec(kStateCodecDeflate) or SetStateCodec(kStateCodecDelta | kStateCodecDeflate) at the end of the plug-in's constructor
+ * Without IPLUG_STATE_USE_ZLIB, states are saved uncompressed, and compressed states saved by a build with it fail to load.
+ * Tests/CommandLineTests/StateCodecTest.cpp shows the setup, and measures the sizes and times */
+#ifdef IPLUG_STATE_USE_ZLIB
+#include "zlib/zlib.h"
+#endif
+
+BEGIN_IPLUG_NAMESPACE
+
+/** Flags for the encoding of state chunks, see IPluginBase::SetStateCodec() */
+enum EStateCodec
+{
+  kStateCodecNone = 0,
+  kStateCodecDelta = 1 << 0,  // XOR the state against a reference state (typically the default state), so unchanged bytes become zeros. Only used together with kStateCodecDeflate, since the zeros only save space once compressed
+  kStateCodecDeflate = 1 << 1 // compress the state with zlib, ignored unless IPLUG_STATE_USE_ZLIB is defined and the WDL/zlib sources are compiled in, see above
+};
+
+/** Encodes and decodes plug-in state chunks, so that large states take less space in host sessions and undo histories.
+ * An encoded state is a block that starts with a magic number and a version, followed by the flags, the raw size, the hash of the delta reference and the payload size.
+ * State that was saved before encoding was enabled does not start with the magic number and is passed through unchanged, so old sessions keep loading. */
+class IStateCodec
+{
+public:
+  static constexpr int kMagic = 'IPsc';
+  static constexpr int kVersion = 1;
+  static constexpr int kHeaderSize = 6 * sizeof(int32_t);
+
+#ifdef IPLUG_STATE_USE_ZLIB
+  static constexpr bool kCanDeflate = true;
+#else
+  static constexpr bool kCanDeflate = false; // kStateCodecDeflate is ignored, see IPLUG_STATE_USE_ZLIB
+#endif
+
+  /** Appends an encoded block to a chunk
+   * @param raw The state to encode
+   * @param flags A combination of EStateCodec flags
+   * @param pReference The reference state for kStateCodecDelta, or nullptr
+   * @param chunk The chunk to append to
+   * @return \c true on success */
+  static bool Encode(const IByteChunk& raw, int flags, const IByteChunk* pReference, IByteChunk& chunk)
+  {
+#ifndef IPLUG_STATE_USE_ZLIB
+    flags &= ~kStateCodecDeflate;
+#endif
+
+    if (!(flags & kStateCodecDeflate) || !pReference || !pReference->Size())
+      flags &= ~kStateCodecDelta;
+
+    const int rawSize = raw.Size();
+    WDL_TypedBuf<uint8_t> delta;
+    const uint8_t* pData = raw.GetData();
+
+    if (flags & kStateCodecDelta)
+    {
+      delta.Resize(rawSize, false);
+      memcpy(delta.Get(), raw.GetData(), rawSize);
+      XOR(delta.Get(), rawSize, pReference->GetData(), pReference->Size());
+      pData = delta.Get();
+    }
+
+    const int headerPos = chunk.Size();
+    const int32_t header[6] = { kMagic, kVersion, flags, rawSize, static_cast<int32_t>(flags & kStateCodecDelta ? Hash(*pReference) : 0u), 0 };
+    chunk.PutBytes(header, kHeaderSize);
+
+    int payloadSize = rawSize;
+
+#ifdef IPLUG_STATE_USE_ZLIB
+    if (flags & kStateCodecDeflate)
+    {
+      uLongf destSize = compressBound(static_cast<uLong>(rawSize));
+      chunk.Resize(headerPos + kHeaderSize + static_cast<int>(destSize));
+
+      if (compress2(chunk.GetData() + headerPos + kHeaderSize, &destSize, pData, static_cast<uLong>(rawSize), Z_BEST_SPEED) != Z_OK)
+      {
+        chunk.Resize(headerPos);
+        return false;
+      }
+
+      payloadSize = static_cast<int>(destSize);
+      chunk.Resize(headerPos + kHeaderSize + payloadSize);
+    }
+    else
+#endif
+      chunk.PutBytes(pData, rawSize);
+
+    memcpy(chunk.GetData() + headerPos + 5 * sizeof(int32_t), &payloadSize, sizeof(int32_t));
+    return true;
+  }
+
+  /** @param chunk The chunk to check
+   * @param startPos The position where the state starts
+   * @return \c true if an encoded block starts at startPos */
+  static bool IsEncoded(const IByteChunk& chunk, int startPos)
+  {
+    int32_t magic = 0;
+    return chunk.Get(&magic, startPos) > 0 && magic == kMagic;
+  }
+
+  /** @param chunk The chunk containing the encoded block
+   * @param startPos The position of the block
+   * @param hash Receives the hash of the reference state the block was delta encoded against
+   * @return \c true if the block is delta encoded */
+  static bool GetReferenceHash(const IByteChunk& chunk, int startPos, uint32_t& hash)
+  {
+    int32_t header[6];
+
+    if (chunk.GetBytes(header, kHeaderSize, startPos) < 0 || header[0] != kMagic || !(header[2] & kStateCodecDelta))
+      return false;
+
+    hash = static_cast<uint32_t>(header[4]);
+    return true;
+  }
+
+  /** Decodes the block starting at startPos
+   * @param chunk The chunk containing the encoded block
+   * @param startPos The position of the block
+   * @param pReference The reference state, if the block was delta encoded, see GetReferenceHash()
+   * @param raw Receives the decoded state
+   * @return The position after the encoded block, or -1 if it could not be decoded */
+  static int Decode(const IByteChunk& chunk, int startPos, const IByteChunk* pReference, IByteChunk& raw)
+  {
+    int32_t header[6];
+
+    if (chunk.GetBytes(header, kHeaderSize, startPos) < 0 || header[0] != kMagic)
+      return -1;
+
+    const int flags = header[2], rawSize = header[3], payloadSize = header[5];
+    const int payloadPos = startPos + kHeaderSize;
+
+    if (header[1] > kVersion || rawSize < 0 || payloadSize < 0 || payloadSize > chunk.Size() - payloadPos)
+    {
+      DBGMSG("IStateCodec: invalid or newer state block\n");
+      return -1;
+    }
+
+    if ((flags & kStateCodecDelta) && (!pReference || static_cast<int32_t>(Hash(*pReference)) != header[4]))
+    {
+      DBGMSG("IStateCodec: the delta reference state does not match the one used to save this state\n");
+      return -1;
+    }
+
+    raw.Resize(rawSize);
+    const uint8_t* pPayload = chunk.GetData() + payloadPos;
+
+    if (flags & kStateCodecDeflate)
+    {
+#ifdef IPLUG_STATE_USE_ZLIB
+      uLongf destSize = static_cast<uLongf>(rawSize);
+
+      if (uncompress(raw.GetData(), &destSize, pPayload, static_cast<uLong>(payloadSize)) != Z_OK || destSize != static_cast<uLongf>(rawSize))
+        return -1;
+#else
+      DBGMSG("IStateCodec: the state is compressed, but IPLUG_STATE_USE_ZLIB is not defined\n");
+      return -1;
+#endif
+    }
+    else
+    {
+      if (payloadSize != rawSize)
+        return -1;
+
+      memcpy(raw.GetData(), pPayload, rawSize);
+    }
+
+    if (flags & kStateCodecDelta)
+      XOR(raw.GetData(), rawSize, pReference->GetData(), pReference->Size());
+
+    return payloadPos + payloadSize;
+  }
+
+  /** FNV-1a hash of a chunk, used to identify the delta reference */
+  static uint32_t Hash(const IByteChunk& chunk)
+  {
+    uint32_t hash = 2166136261u;
+    const uint8_t* pData = chunk.GetData();
+
+    for (int i = 0; i < chunk.Size(); i++)
+      hash = (hash ^ pData[i]) * 16777619u;
+
+    return hash;
+  }
+
+private:
+  static void XOR(uint8_t* pData, int size, const uint8_t* pReference, int referenceSize)
+  {
+    const int n = std::min(size, referenceSize);
+    int i = 0;
+
+    for (; i + 8 <= n; i += 8)
+    {
+      uint64_t a, b;
+      memcpy(&a, pData + i, 8);
+      memcpy(&b, pReference + i, 8);
+      a ^= b;
+      memcpy(pData + i, &a, 8);
+    }
+
+    for (; i < n; i++)
+      pData[i] ^= pReference[i];
+  }
+};
+
+END_IPLUG_NAMESPACE
@@ -18,6 +18,7 @@
  */
 
 #include <algorithm>
+#include <type_traits>
 #include "wdlstring.h"
 #include "ptrlist.h"
 
@@ -80,6 +81,20 @@ struct IByteGetter
     }
     return -1;
   }
+
+  /** Gets a pointer to a range of the data, without copying it
+   * @param pData The data
+   * @param dataSize The size of the data in bytes
+   * @param size The size of the range in bytes
+   * @param startPos The start of the range
+   * @return A pointer to the range, or nullptr if it is not within the data */
+  static inline const uint8_t* GetView(const uint8_t* pData, int dataSize, int size, int startPos)
+  {
+    if (startPos >= 0 && size >= 0 && size <= dataSize - startPos)
+      return pData + startPos;
+
+    return nullptr;
+  }
   
   /** /todo 
    * @param pData /todo
@@ -107,7 +122,9 @@ struct IByteGetter
   }
 };
   
-/** Manages a block of memory, for plug-in settings store/recall */
+/** Manages a block of memory, for plug-in settings store/recall
+ * Values are stored in the native byte order, which is little endian on all supported platforms, and read/written via memcpy so positions don't need to be aligned.
+ * The memory grows geometrically and is kept when the chunk is cleared, so a chunk that is reused does not reallocate */
 class IByteChunk : private IByteGetter
 {
 public:
@@ -146,10 +163,55 @@ public:
   inline int PutBytes(const void* pBuf, int size)
   {
     int n = mBytes.GetSize();
-    mBytes.Resize(n + size);
+    mBytes.Resize(n + size, false);
     memcpy(mBytes.Get() + n, pBuf, size);
     return mBytes.GetSize();
   }
+
+  /** Allocates memory for at least capacity bytes, so that writes up to that size do not reallocate
+   * @param capacity The total size in bytes */
+  inline void Reserve(int capacity)
+  {
+    int n = mBytes.GetSize();
+
+    if (capacity > n)
+    {
+      mBytes.Resize(capacity, false);
+      mBytes.Resize(n, false);
+    }
+  }
+
+  /** Copies an array of values into the chunk, with a single copy
+   * @param pVals The values
+   * @param n The number of values
+   * @return The new size of the chunk */
+  template <class T>
+  inline int PutArray(const T* pVals, int n)
+  {
+    static_assert(std::is_trivially_copyable<T>::value, "IByteChunk::PutArray requires trivially copyable values");
+    return PutBytes(pVals, n * static_cast<int>(sizeof(T)));
+  }
+
+  /** Copies an array of values out of the chunk
+   * @param pVals Receives the values
+   * @param n The number of values
+   * @param startPos The position to read from
+   * @return The position after the array, or -1 if the chunk is too small */
+  template <class T>
+  inline int GetArray(T* pVals, int n, int startPos) const
+  {
+    static_assert(std::is_trivially_copyable<T>::value, "IByteChunk::GetArray requires trivially copyable values");
+    return GetBytes(pVals, n * static_cast<int>(sizeof(T)), startPos);
+  }
+
+  /** Gets a pointer to a range of the chunk, without copying it. The pointer is invalidated by any write to the chunk
+   * @param size The size of the range in bytes
+   * @param startPos The start of the range
+   * @return A pointer to the range, or nullptr if it is not within the chunk */
+  inline const uint8_t* GetView(int size, int startPos) const
+  {
+    return IByteGetter::GetView(mBytes.Get(), Size(), size, startPos);
+  }
   
   /** /todo  
    * @param pBuf /todo
@@ -209,10 +271,10 @@ public:
     return PutBytes(pRHS->GetData(), pRHS->Size());
   }
   
-  /** Clears the chunk */
+  /** Clears the chunk, keeping the allocated memory */
   inline void Clear()
   {
-    mBytes.Resize(0);
+    mBytes.Resize(0, false);
   }
   
   /** Returns the current size of the chunk
@@ -268,6 +330,8 @@ class IByteStream : private IByteGetter
 {
 public:
   IByteStream(const void *pData, int dataSize) : mBytes(reinterpret_cast<const uint8_t *>(pData)), mSize(dataSize) {}
+  /** Creates a view of a chunk, which must outlive the stream and not be written to while it is in use */
+  explicit IByteStream(const IByteChunk& chunk) : mBytes(chunk.GetData()), mSize(chunk.Size()) {}
   ~IByteStream() {}
   
   /** /todo 
@@ -299,6 +363,37 @@ public:
   {
     return IByteGetter::GetStr(mBytes, Size(), str, startPos);
   }
+
+  /** Copies an array of values out of the stream
+   * @param pVals Receives the values
+   * @param n The number of values
+   * @param startPos The position to read from
+   * @return The position after the array, or -1 if the stream is too small */
+  template <class T>
+  inline int GetArray(T* pVals, int n, int startPos) const
+  {
+    static_assert(std::is_trivially_copyable<T>::value, "IByteStream::GetArray requires trivially copyable values");
+    return GetBytes(pVals, n * static_cast<int>(sizeof(T)), startPos);
+  }
+
+  /** Gets a pointer to a range of the stream, without copying it
+   * @param size The size of the range in bytes
+   * @param startPos The start of the range
+   * @return A pointer to the range, or nullptr if it is not within the stream */
+  inline const uint8_t* GetView(int size, int startPos) const
+  {
+    return IByteGetter::GetView(mBytes, Size(), size, startPos);
+  }
+
+  /** Gets a stream for a range of this stream, without copying it, e.g. for the payload of a message
+   * @param size The size of the range in bytes
+   * @param startPos The start of the range
+   * @return The sub-stream, which is empty if the range is not within this stream */
+  inline IByteStream GetSubStream(int size, int startPos) const
+  {
+    const uint8_t* pView = GetView(size, startPos);
+    return pView ? IByteStream(pView, size) : IByteStream(nullptr, 0);
+  }
   
   /** Returns the  size of the chunk
    * @return  size (in bytes) */
@@ -318,7 +413,7 @@ public:
   
   /** /todo  
    * @return const uint8_t* /todo */
-  inline const uint8_t* GetData()
+  inline const uint8_t* GetData() const
   {
     return mBytes;
   }
@@ -0,0 +1,112 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+#pragma once
+
+/**
+ * @file
+ * @copydoc IPlugTripleBuffer
+ */
+
+#include <atomic>
+#include <cstdint>
+
+#include "IPlugPlatform.h"
+
+BEGIN_IPLUG_NAMESPACE
+
+/** A wait-free single producer, single consumer "latest value" channel.
+ * Unlike IPlugQueue, intermediate values are overwritten rather than queued, so the consumer only ever sees the most recent
+ * complete value. Neither side ever blocks or fails, which makes it suitable for streaming visualization data from the realtime audio thread.
+ * Three slots are used: the producer owns one, the consumer owns one, and the third is swapped atomically between them. */
+template<typename T>
+class IPlugTripleBuffer final
+{
+public:
+  IPlugTripleBuffer() = default;
+
+  /** Constructs the triple buffer with all three slots initialized to a value
+   * @param init The initial value of every slot */
+  IPlugTripleBuffer(const T& init)
+  {
+    for (auto& slot : mSlots)
+      slot = init;
+  }
+
+  IPlugTripleBuffer(const IPlugTripleBuffer&) = delete;
+  IPlugTripleBuffer& operator=(const IPlugTripleBuffer&) = delete;
+
+  /** Producer side: get a reference to the slot owned by the producer, so that it can be filled in place without an extra copy.
+   * The contents are undefined (they hold an older value), call Publish() when the slot is complete */
+  T& GetWriteBuffer()
+  {
+    return mSlots[mBackIdx];
+  }
+
+  /** Producer side: make the slot returned by GetWriteBuffer() available to the consumer. Wait-free. */
+  void Publish()
+  {
+    mBackIdx = mMiddle.exchange(mBackIdx | kDirtyBit, std::memory_order_acq_rel) & kIndexMask;
+  }
+
+  /** Producer side: copy a value into the write slot and publish it. Wait-free.
+   * @param item The value to publish */
+  void Write(const T& item)
+  {
+    GetWriteBuffer() = item;
+    Publish();
+  }
+
+  /** Consumer side: acquire the most recently published value, if there is one that has not already been consumed.
+   * @return \c true if the read slot was updated with new data */
+  bool Update()
+  {
+    if (!HasNewData())
+      return false;
+
+    mFrontIdx = mMiddle.exchange(mFrontIdx, std::memory_order_acq_rel) & kIndexMask;
+    return true;
+  }
+
+  /** Consumer side: get the slot currently owned by the consumer. This is the value acquired by the last successful call to Update() */
+  const T& GetReadBuffer() const
+  {
+    return mSlots[mFrontIdx];
+  }
+
+  /** Consumer side: copy out the latest value, if there is a new one
+   * @param item Receives the value if new data was available
+   * @return \c true if new data was available */
+  bool Read(T& item)
+  {
+    if (!Update())
+      return false;
+
+    item = GetReadBuffer();
+    return true;
+  }
+
+  /** @return \c true if the producer has published since the consumer last called Update() */
+  bool HasNewData() const
+  {
+    return (mMiddle.load(std::memory_order_relaxed) & kDirtyBit) != 0;
+  }
+
+private:
+  static constexpr uint8_t kIndexMask = 0x3;
+  static constexpr uint8_t kDirtyBit = 0x4;
+
+  T mSlots[3] {};
+  uint8_t mBackIdx = 0; // owned by the producer
+  uint8_t mFrontIdx = 1; // owned by the consumer
+  std::atomic<uint8_t> mMiddle {2}; // shared, index in the low bits + dirty flag
+};
+
+END_IPLUG_NAMESPACE
@@ -502,7 +502,7 @@ VstIntPtr VSTCALLBACK IPlugVST2::VSTDispatcher(AEffect *pEffect, VstInt32 opCode
         }
         else
         {
-          savedOK = _this->SerializeState(chunk);
+          savedOK = _this->SerializeEncodedState(chunk);
         }
 
         if (savedOK && chunk.Size())
@@ -531,7 +531,7 @@ VstIntPtr VSTCALLBACK IPlugVST2::VSTDispatcher(AEffect *pEffect, VstInt32 opCode
         }
         else
         {
-          pos = _this->UnserializeState(chunk, pos);
+          pos = _this->UnserializeEncodedState(chunk, pos);
           _this->ModifyCurrentPreset();
         }
 
@@ -960,6 +960,8 @@ void IPlugVST2::VSTPreProcess(SAMPLETYPE** inputs, SAMPLETYPE** outputs, VstInt3
   {
     ProcessMidiMsg(msg);
   }
+  
+  ProcessDeferredMessages();
 }
 
 // Deprecated.
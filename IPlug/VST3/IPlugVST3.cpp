@@ -98,6 +98,7 @@ tresult PLUGIN_API IPlugVST3::process(ProcessData& data)
 {
   TRACE
 
+  ProcessDeferredMessages();
   Process(data, processSetup, audioInputs, audioOutputs, mMidiMsgsFromEditor, mMidiMsgsFromProcessor, mSysExDataFromEditor, mSysexBuf);
   return kResultOk;
 }
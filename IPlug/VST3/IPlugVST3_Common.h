@@ -29,7 +29,7 @@ struct IPlugVST3State
     // TODO: IPlugVer should be in chunk!
     //  IByteChunk::GetIPlugVerFromChunk(chunk)
     
-    if (pPlug->SerializeState(chunk))
+    if (pPlug->SerializeEncodedState(chunk))
     {
       /*
        int chunkSize = chunk.Size();
@@ -66,7 +66,7 @@ struct IPlugVST3State
       
       chunk.PutBytes(buffer, bytesRead);
     }
-    int pos = pPlug->UnserializeState(chunk,0);
+    int pos = pPlug->UnserializeEncodedState(chunk,0);
     
     Steinberg::int32 savedBypass = 0;
     
@@ -250,6 +250,9 @@ void IPlugVST3Controller::SendSysexMsgFromUI(const ISysEx& msg)
 
 void IPlugVST3Controller::SendArbitraryMsgFromUI(int msgTag, int ctrlTag, int dataSize, const void* pData)
 {
+  if (OnPresetMsgFromUI(msgTag, ctrlTag, dataSize, pData))
+    return; // presets are restored on the controller, which informs the host of the parameter changes
+
   OPtr<IMessage> message = allocateMessage();
   
   if (!message)
@@ -65,6 +65,8 @@ void IPlugWAM::onProcess(WAM::AudioBus* pAudio, void* pData)
   AttachBuffers(ERoute::kInput, 0, NChannelsConnected(ERoute::kInput), pAudio->inputs, blockSize);
   AttachBuffers(ERoute::kOutput, 0, NChannelsConnected(ERoute::kOutput), pAudio->outputs, blockSize);
   
+  ProcessDeferredMessages();
+  
   ENTER_PARAMS_MUTEX
   ProcessBuffers((float) 0.0f, blockSize);
   LEAVE_PARAMS_MUTEX
@@ -129,7 +131,10 @@ void IPlugWAM::onMessage(char* verb, char* res, void* pData, uint32_t size)
     pos = stream.Get(&ctrlTag, pos);
     pos = stream.Get(&dataSize, pos);
     
-    OnMessage(msgTag, ctrlTag, dataSize, stream.GetData() + (sizeof(int) * 3));
+    const uint8_t* pMsgData = stream.GetView(dataSize, pos);
+
+    if (pMsgData)
+      OnMessage(msgTag, ctrlTag, dataSize, pMsgData);
   }
   else if(strcmp(verb, "SSMFUI") == 0)
   {
@@ -104,6 +104,9 @@ void IPlugWeb::SendSysexMsgFromUI(const ISysEx& msg)
 
 void IPlugWeb::SendArbitraryMsgFromUI(int msgTag, int ctrlTag, int dataSize, const void* pData)
 {
+  if (OnPresetMsgFromUI(msgTag, ctrlTag, dataSize, pData))
+    return;
+
   mSAMFUIBuf.Resize(kNumSAMFUIBytes + dataSize);
   int pos = kNumMsgHeaderBytes;
 
@@ -0,0 +1,246 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+// Checks ADSREnvelopeBank against one ADSREnvelope per envelope, for float and double, with and without sustain, with a partly used last group:
+// random stage times, sustain levels and time scalars, and starts, releases, retriggers and kills at random offsets within and beyond the block.
+// The outputs must agree to rounding, and the end of release and reset events must match the callbacks of ADSREnvelope.
+// Then times the bank against ADSREnvelope::Process()
+
+#include <algorithm>
+#include <random>
+#include <tuple>
+#include <vector>
+
+#include "ADSREnvelope.h"
+
+#include "CommandLineTest.h"
+
+using namespace iplug;
+
+static constexpr int kNEnvelopes = 259; // 32 full groups and one of 3
+static constexpr int kMaxBlockSize = 512;
+static constexpr double kSampleRate = 48000.;
+static constexpr int kNBenchEnvelopes = 256;
+static constexpr int kNRuns = 500;
+
+using EventKey = std::tuple<int, int64_t, int>; // envelope, frame, type
+
+/** Runs a bank and the envelopes it replaces through random blocks and commands
+ * @param maxError The largest difference between the outputs
+ * @param events The bank's events and the envelope callbacks, in the same order */
+template <typename T>
+static void CompareBank(bool sustainEnabled, double& maxError, std::vector<EventKey>& bankEvents, std::vector<EventKey>& refEvents)
+{
+  using Env = ADSREnvelope<T>;
+  using Bank = ADSREnvelopeBank<T>;
+
+  struct Queued
+  {
+    int64_t frame;
+    int idx;
+    int type;
+    T level;
+    T timeScalar;
+  };
+
+  std::mt19937 rng(sustainEnabled ? 1 : 2);
+  std::uniform_real_distribution<double> timeDist(0., 200.);
+  std::uniform_real_distribution<double> unitDist(0., 1.);
+
+  Bank bank(kNEnvelopes, sustainEnabled, 4096);
+  bank.SetSampleRate(static_cast<T>(kSampleRate));
+  std::vector<Env> refs(kNEnvelopes, Env("", nullptr, sustainEnabled));
+  std::vector<T> sustain(kNEnvelopes);
+  int64_t frame = 0;
+
+  for (auto i = 0; i < kNEnvelopes; i++)
+  {
+    refs[i].SetSampleRate(static_cast<T>(kSampleRate));
+    refs[i].SetResetFunc([&refEvents, &frame, i]() { refEvents.emplace_back(i, frame, Bank::kReset); });
+    refs[i].SetEndReleaseFunc([&refEvents, &frame, i]() { refEvents.emplace_back(i, frame, Bank::kEndRelease); });
+
+    for (auto stage : { Env::kAttack, Env::kDecay, Env::kRelease })
+    {
+      const T time = static_cast<T>(i % 13 == 0 ? 0. : timeDist(rng)); // some stages take the shortest time
+      bank.SetStageTime(i, stage, time);
+      refs[i].SetStageTime(stage, time);
+    }
+
+    sustain[i] = static_cast<T>(unitDist(rng));
+    bank.SetSustainLevel(i, sustain[i]);
+  }
+
+  std::vector<std::vector<T>> buffers(kNEnvelopes, std::vector<T>(kMaxBlockSize));
+  std::vector<T*> outputs(kNEnvelopes);
+  std::vector<Queued> queued;
+
+  for (auto i = 0; i < kNEnvelopes; i++)
+    outputs[i] = buffers[i].data();
+
+  maxError = 0.;
+
+  for (auto b = 0; b < 200; b++)
+  {
+    const int nFrames = 1 + rng() % kMaxBlockSize;
+
+    for (auto c = 0; c < 60; c++)
+    {
+      const int idx = rng() % kNEnvelopes;
+      const int offset = rng() % 2 ? 0 : static_cast<int>(rng() % (2 * nFrames));
+
+      // the documented difference, a second command at the same frame sees the state the first one set, rather than the output before it
+      if (std::any_of(queued.begin(), queued.end(), [&](const Queued& q) { return q.idx == idx && q.frame == frame + offset; }))
+        continue;
+
+      int type = rng() % 6; // starts and releases are the most common, 5 is a soft kill and 6 a hard one
+      const T level = static_cast<T>(0.2 + 0.8 * unitDist(rng));
+      const T timeScalar = static_cast<T>(0.5 + unitDist(rng));
+
+      switch (type)
+      {
+        case 0: case 1: bank.Start(idx, level, timeScalar, offset); break;
+        case 2: case 3: bank.Release(idx, offset); break;
+        case 4: bank.Retrigger(idx, level, timeScalar, offset); break;
+        default:
+          type += rng() % 4 == 0;
+          bank.Kill(idx, type == 6, offset);
+          break;
+      }
+
+      queued.push_back({ frame + offset, idx, type, level, timeScalar });
+    }
+
+    bank.ProcessBlock(nFrames, outputs.data());
+
+    for (const auto& e : bank.GetEvents())
+      bankEvents.emplace_back(e.idx, frame + e.offset, e.type);
+
+    for (auto s = 0; s < nFrames; s++, frame++)
+    {
+      for (const auto& q : queued)
+      {
+        if (q.frame != frame)
+          continue;
+
+        switch (q.type)
+        {
+          case 0: case 1: refs[q.idx].Start(q.level, q.timeScalar); break;
+          case 2: case 3: refs[q.idx].Release(); break;
+          case 4: refs[q.idx].Retrigger(q.level, q.timeScalar); break;
+          default: refs[q.idx].Kill(q.type == 6); break;
+        }
+      }
+
+      for (auto i = 0; i < kNEnvelopes; i++)
+        maxError = std::max(maxError, std::fabs(static_cast<double>(outputs[i][s] - refs[i].Process(sustain[i]))));
+    }
+
+    queued.erase(std::remove_if(queued.begin(), queued.end(), [frame](const Queued& q) { return q.frame < frame; }), queued.end());
+  }
+}
+
+template <typename T>
+static void TestAgainstEnvelopes(const char* typeName, double tolerance)
+{
+  for (auto sustainEnabled : { true, false })
+  {
+    double maxError;
+    std::vector<EventKey> bankEvents, refEvents;
+    CompareBank<T>(sustainEnabled, maxError, bankEvents, refEvents);
+
+    std::sort(bankEvents.begin(), bankEvents.end());
+    std::sort(refEvents.begin(), refEvents.end());
+
+    printf("  %-6s %-4s largest difference %.2e, %zu events, %s\n", typeName, sustainEnabled ? "ADSR" : "AD", maxError, bankEvents.size(),
+           bankEvents == refEvents ? "same as the callbacks" : "NOT the same as the callbacks");
+
+    CHECK(maxError <= tolerance);
+    CHECK(!bankEvents.empty());
+    CHECK(bankEvents == refEvents);
+  }
+}
+
+/** Times kNBenchEnvelopes envelopes that are always busy, with a new note every few blocks */
+template <typename T>
+static void Benchmark(const char* typeName)
+{
+  using Env = ADSREnvelope<T>;
+
+  std::vector<std::vector<T>> buffers(kNBenchEnvelopes, std::vector<T>(kMaxBlockSize));
+  std::vector<T*> outputs(kNBenchEnvelopes);
+  std::vector<Env> envs(kNBenchEnvelopes);
+  ADSREnvelopeBank<T> bank(kNBenchEnvelopes);
+  int block = 0;
+
+  for (auto i = 0; i < kNBenchEnvelopes; i++)
+  {
+    outputs[i] = buffers[i].data();
+
+    for (auto stage : { Env::kAttack, Env::kDecay, Env::kRelease })
+    {
+      envs[i].SetStageTime(stage, T(20));
+      bank.SetStageTime(i, stage, T(20));
+    }
+
+    bank.SetSustainLevel(i, T(0.5));
+  }
+
+  const double envTime = TimeMicroseconds(kNRuns, [&]() {
+    for (auto i = 0; i < kNBenchEnvelopes; i++)
+    {
+      if ((block + i) % 8 == 0)
+        envs[i].Start(T(1));
+      else if ((block + i) % 8 == 4)
+        envs[i].Release();
+
+      T* output = outputs[i];
+
+      for (auto s = 0; s < kMaxBlockSize; s++)
+        output[s] = envs[i].Process(T(0.5));
+    }
+
+    block++;
+  });
+
+  const double bankTime = TimeMicroseconds(kNRuns, [&]() {
+    for (auto i = 0; i < kNBenchEnvelopes; i++)
+    {
+      if ((block + i) % 8 == 0)
+        bank.Start(i, T(1));
+      else if ((block + i) % 8 == 4)
+        bank.Release(i);
+    }
+
+    bank.ProcessBlock(kMaxBlockSize, outputs.data());
+    block++;
+  });
+
+  printf("  %-6s ADSREnvelope %6.2f, bank %6.2f\n", typeName, 1000. * envTime / (kNBenchEnvelopes * kMaxBlockSize), 1000. * bankTime / (kNBenchEnvelopes * kMaxBlockSize));
+}
+
+int main()
+{
+  printf("Against ADSREnvelope\n");
+  TestAgainstEnvelopes<float>("float", 1e-4);
+  TestAgainstEnvelopes<double>("double", 1e-6); // rounding can end a decay or release a sample apart, where the envelope is within 1e-6 of 0
+
+#if defined(IPLUG_LANES_SSE2)
+  printf("%i envelopes x %i frames, SSE2, ns per envelope per frame\n", kNBenchEnvelopes, kMaxBlockSize);
+#elif defined(IPLUG_LANES_NEON)
+  printf("%i envelopes x %i frames, NEON, ns per envelope per frame\n", kNBenchEnvelopes, kMaxBlockSize);
+#else
+  printf("%i envelopes x %i frames, scalar, ns per envelope per frame\n", kNBenchEnvelopes, kMaxBlockSize);
+#endif
+
+  Benchmark<float>("float");
+  Benchmark<double>("double");
+
+  return TestResult("ADSREnvelopeBankTest");
+}
@@ -0,0 +1,540 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+#pragma once
+
+/**
+ * @file
+ * @brief WAV and FLAC writers for the command line tests, so that the sample readers can be checked against known PCM without test files in the repo.
+ * The FLAC writer is not a useful encoder, it picks subframe types, predictors and residual codings in turn rather than for size,
+ * so that a short file exercises every path of a decoder
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <vector>
+
+using AudioChannels = std::vector<std::vector<int32_t>>;
+
+#pragma mark - WAV
+
+/** Writes a WAV file, with an odd sized chunk before the data, as some editors write
+ * @param formatTag 1 for integer PCM, 3 for float
+ * @param extensible Write the format as WAVE_FORMAT_EXTENSIBLE
+ * @param data The interleaved sample bytes */
+inline bool WriteWAVFile(const char* path, int nChans, int bitsPerSample, int sampleRate, int formatTag, bool extensible, const std::vector<uint8_t>& data)
+{
+  FILE* pFile = fopen(path, "wb");
+
+  if (!pFile)
+    return false;
+
+  auto write32 = [&](uint32_t v) { fwrite(&v, 4, 1, pFile); };
+  auto write16 = [&](uint16_t v) { fwrite(&v, 2, 1, pFile); };
+  const uint32_t fmtSize = extensible ? 40 : 16;
+  const uint32_t blockAlign = nChans * bitsPerSample / 8;
+  const char info[] = { 'o', 'd', 'd' };
+
+  fwrite("RIFF", 1, 4, pFile);
+  write32(static_cast<uint32_t>(4 + 8 + fmtSize + 8 + sizeof(info) + 1 + 8 + data.size()));
+  fwrite("WAVEfmt ", 1, 8, pFile);
+  write32(fmtSize);
+  write16(extensible ? 0xFFFE : formatTag);
+  write16(nChans);
+  write32(sampleRate);
+  write32(sampleRate * blockAlign);
+  write16(blockAlign);
+  write16(bitsPerSample);
+
+  if (extensible)
+  {
+    const uint8_t guidTail[14] = { 0x00, 0x00, 0x00, 0x00, 0x10, 0x00, 0x80, 0x00, 0x00, 0xAA, 0x00, 0x38, 0x9B, 0x71 };
+    write16(22);
+    write16(bitsPerSample);
+    write32(0); // channel mask
+    write16(formatTag);
+    fwrite(guidTail, 1, sizeof(guidTail), pFile);
+  }
+
+  // a chunk of odd size, which is followed by a pad byte
+  fwrite("INFO", 1, 4, pFile);
+  write32(sizeof(info));
+  fwrite(info, 1, sizeof(info), pFile);
+  fputc(0, pFile);
+
+  fwrite("data", 1, 4, pFile);
+  write32(static_cast<uint32_t>(data.size()));
+
+  const bool ok = fwrite(data.data(), 1, data.size(), pFile) == data.size();
+  fclose(pFile);
+  return ok;
+}
+
+/** Writes integer samples as an 8, 16, 24 or 32 bit PCM WAV file */
+inline bool WriteWAV(const char* path, const AudioChannels& chans, int bitsPerSample, int sampleRate, bool extensible = false)
+{
+  const int bytesPerSample = bitsPerSample / 8;
+  const size_t nFrames = chans[0].size();
+  std::vector<uint8_t> data(nFrames * chans.size() * bytesPerSample);
+  uint8_t* pOut = data.data();
+
+  for (size_t i = 0; i < nFrames; i++)
+  {
+    for (const auto& chan : chans)
+    {
+      // 8 bit WAV samples are unsigned
+      const uint32_t value = static_cast<uint32_t>(chan[i]) + (bitsPerSample == 8 ? 128 : 0);
+
+      for (auto b = 0; b < bytesPerSample; b++)
+        *pOut++ = static_cast<uint8_t>(value >> (8 * b));
+    }
+  }
+
+  return WriteWAVFile(path, static_cast<int>(chans.size()), bitsPerSample, sampleRate, 1, extensible, data);
+}
+
+/** Writes samples as a 32 or 64 bit float WAV file */
+inline bool WriteFloatWAV(const char* path, const std::vector<std::vector<double>>& chans, int bitsPerSample, int sampleRate, bool extensible = false)
+{
+  const int bytesPerSample = bitsPerSample / 8;
+  const size_t nFrames = chans[0].size();
+  std::vector<uint8_t> data(nFrames * chans.size() * bytesPerSample);
+  uint8_t* pOut = data.data();
+
+  for (size_t i = 0; i < nFrames; i++)
+  {
+    for (const auto& chan : chans)
+    {
+      if (bitsPerSample == 32)
+      {
+        const float f = static_cast<float>(chan[i]);
+        memcpy(pOut, &f, 4);
+      }
+      else
+        memcpy(pOut, &chan[i], 8);
+
+      pOut += bytesPerSample;
+    }
+  }
+
+  return WriteWAVFile(path, static_cast<int>(chans.size()), bitsPerSample, sampleRate, 3, extensible, data);
+}
+
+#pragma mark - FLAC
+
+/** Writes bits most significant first */
+class FLACBitWriter
+{
+public:
+  void Write(uint64_t value, int nBits)
+  {
+    for (auto i = nBits - 1; i >= 0; i--)
+      PutBit((value >> i) & 1);
+  }
+
+  void WriteSigned(int64_t value, int nBits) { Write(static_cast<uint64_t>(value) & ((1ull << nBits) - 1), nBits); }
+
+  void WriteUnary(uint64_t quotient)
+  {
+    for (uint64_t i = 0; i < quotient; i++)
+      PutBit(0);
+
+    PutBit(1);
+  }
+
+  /** Pads with zero bits to the next byte */
+  void Align()
+  {
+    while (mNBits)
+      PutBit(0);
+  }
+
+  std::vector<uint8_t> mBytes;
+
+private:
+  void PutBit(int bit)
+  {
+    mCurrent = static_cast<uint8_t>((mCurrent << 1) | bit);
+
+    if (++mNBits == 8)
+    {
+      mBytes.push_back(mCurrent);
+      mCurrent = 0;
+      mNBits = 0;
+    }
+  }
+
+  uint8_t mCurrent = 0;
+  int mNBits = 0;
+};
+
+inline uint8_t TestFLACCRC8(const uint8_t* p, size_t size)
+{
+  uint8_t crc = 0;
+
+  for (size_t i = 0; i < size; i++)
+  {
+    crc ^= p[i];
+
+    for (auto b = 0; b < 8; b++)
+      crc = static_cast<uint8_t>(crc & 0x80 ? (crc << 1) ^ 0x07 : crc << 1);
+  }
+
+  return crc;
+}
+
+inline uint16_t TestFLACCRC16(const uint8_t* p, size_t size)
+{
+  uint16_t crc = 0;
+
+  for (size_t i = 0; i < size; i++)
+  {
+    crc ^= p[i] << 8;
+
+    for (auto b = 0; b < 8; b++)
+      crc = static_cast<uint16_t>(crc & 0x8000 ? (crc << 1) ^ 0x8005 : crc << 1);
+  }
+
+  return crc;
+}
+
+/** Appends a frame or sample number, coded like UTF-8 */
+inline void WriteFLACNumber(std::vector<uint8_t>& out, uint64_t n)
+{
+  if (n < 0x80)
+  {
+    out.push_back(static_cast<uint8_t>(n));
+    return;
+  }
+
+  int extra = 1;
+
+  while (extra < 6 && n >= (1ull << (6 * extra + 6 - extra)))
+    extra++;
+
+  out.push_back(static_cast<uint8_t>((0xFF00 >> (extra + 1)) | (n >> (6 * extra))));
+
+  for (auto i = extra - 1; i >= 0; i--)
+    out.push_back(static_cast<uint8_t>(0x80 | ((n >> (6 * i)) & 0x3F)));
+}
+
+/** Options for WriteFLAC() */
+struct FLACWriterOptions
+{
+  int mBlockSize = 4096; // the fixed block size, or the largest one if mVariableBlockSize
+  bool mVariableBlockSize = false; // random block sizes, numbered by sample rather than by frame
+  uint32_t mSeed = 1; // for the random choices of block size, residual coding and LPC precision
+};
+
+/** Writes the residual of a predictor, in a random number of partitions with either Rice coding method, escaping some partitions to raw samples */
+inline void WriteFLACResidual(FLACBitWriter& writer, const std::vector<int64_t>& residual, int order, int blockSize, std::mt19937& rng)
+{
+  const int method = rng() % 2;
+  const int paramBits = method ? 5 : 4;
+  const int escape = method ? 31 : 15;
+  int maxPartitionOrder = 0;
+
+  while (maxPartitionOrder < 8 && ((blockSize >> (maxPartitionOrder + 1)) << (maxPartitionOrder + 1)) == blockSize && (blockSize >> (maxPartitionOrder + 1)) >= order)
+    maxPartitionOrder++;
+
+  const int partitionOrder = rng() % (maxPartitionOrder + 1);
+  writer.Write(method, 2);
+  writer.Write(partitionOrder, 4);
+
+  size_t idx = 0;
+
+  for (auto p = 0; p < (1 << partitionOrder); p++)
+  {
+    const int n = (blockSize >> partitionOrder) - (p ? 0 : order);
+    int64_t maxAbs = 0;
+    double mean = 0.;
+
+    for (auto i = 0; i < n; i++)
+    {
+      maxAbs = std::max(maxAbs, std::abs(residual[idx + i]));
+      mean += std::abs(residual[idx + i]);
+    }
+
+    mean /= std::max(n, 1);
+
+    if (rng() % 10 == 0)
+    {
+      int bits = 1;
+
+      while ((1ll << (bits - 1)) <= maxAbs)
+        bits++;
+
+      writer.Write(escape, paramBits);
+      writer.Write(bits, 5);
+
+      for (auto i = 0; i < n; i++)
+        writer.WriteSigned(residual[idx + i], bits);
+    }
+    else
+    {
+      const int param = std::min(escape - 1, static_cast<int>(std::log2(mean + 1.)));
+      writer.Write(param, paramBits);
+
+      for (auto i = 0; i < n; i++)
+      {
+        const int64_t v = residual[idx + i];
+        const uint64_t u = v >= 0 ? static_cast<uint64_t>(v) << 1 : (static_cast<uint64_t>(-v) << 1) - 1;
+        writer.WriteUnary(u >> param);
+        writer.Write(u & ((1ull << param) - 1), param);
+      }
+    }
+
+    idx += n;
+  }
+}
+
+/** Writes one subframe. Constant blocks are written as constant subframes, others cycle through verbatim, the fixed predictors and LPC orders
+ * @param kind The index of the predictor to use, which is wrapped */
+inline void WriteFLACSubframe(FLACBitWriter& writer, const std::vector<int64_t>& x, int bitsPerSample, int kind, std::mt19937& rng)
+{
+  static const int kKinds[] = { -1, 0, 1, 2, 3, 4, 101, 102, 103, 108, 112, 132 }; // -1 verbatim, 0-4 fixed, 100 + order LPC
+  const int blockSize = static_cast<int>(x.size());
+  const bool constant = std::all_of(x.begin(), x.end(), [&](int64_t v) { return v == x[0]; });
+  const bool anyNonZero = std::any_of(x.begin(), x.end(), [](int64_t v) { return v != 0; });
+  const int wasted = !constant && anyNonZero && std::all_of(x.begin(), x.end(), [](int64_t v) { return v % 4 == 0; }) ? 2 : 0;
+  const int bps = bitsPerSample - wasted;
+  int predictor = kKinds[kind % (sizeof(kKinds) / sizeof(kKinds[0]))];
+  const int order = predictor >= 100 ? predictor - 100 : std::max(predictor, 0);
+
+  if (order >= blockSize)
+    predictor = -1;
+
+  std::vector<int64_t> y(blockSize);
+
+  for (auto i = 0; i < blockSize; i++)
+    y[i] = x[i] >> wasted;
+
+  auto writeHeader = [&](int type) {
+    writer.Write(0, 1);
+    writer.Write(type, 6);
+    writer.Write(wasted ? 1 : 0, 1);
+
+    if (wasted)
+      writer.WriteUnary(wasted - 1);
+  };
+
+  if (constant)
+  {
+    writeHeader(0);
+    writer.WriteSigned(y[0], bps);
+    return;
+  }
+
+  if (predictor < 0)
+  {
+    writeHeader(1);
+
+    for (auto v : y)
+      writer.WriteSigned(v, bps);
+
+    return;
+  }
+
+  std::vector<int64_t> residual;
+
+  if (predictor < 100)
+  {
+    writeHeader(8 + order);
+
+    for (auto i = 0; i < order; i++)
+      writer.WriteSigned(y[i], bps);
+
+    for (auto i = order; i < blockSize; i++)
+    {
+      static const int64_t kFixed[5][4] = { {0, 0, 0, 0}, {1, 0, 0, 0}, {2, -1, 0, 0}, {3, -3, 1, 0}, {4, -6, 4, -1} };
+      int64_t prediction = 0;
+
+      for (auto j = 0; j < order; j++)
+        prediction += kFixed[order][j] * y[i - j - 1];
+
+      residual.push_back(y[i] - prediction);
+    }
+  }
+  else
+  {
+    static const double kBase[] = { 1.8, -0.85, 0.05, -0.02, 0.01 };
+    const int precision = 8 + rng() % 8;
+    const int shift = std::min(15, precision - 4 + static_cast<int>(rng() % 7));
+    const int64_t limit = (1 << (precision - 1)) - 1;
+    std::vector<int64_t> coefs(order);
+
+    writeHeader(32 + order - 1);
+
+    for (auto i = 0; i < order; i++)
+      writer.WriteSigned(y[i], bps);
+
+    writer.Write(precision - 1, 4);
+    writer.WriteSigned(shift, 5);
+
+    for (auto j = 0; j < order; j++)
+    {
+      const double base = j < 5 ? kBase[j] : 0.;
+      coefs[j] = std::max(-limit - 1, std::min(limit, static_cast<int64_t>(std::lround(base * (1 << shift)))));
+      writer.WriteSigned(coefs[j], precision);
+    }
+
+    for (auto i = order; i < blockSize; i++)
+    {
+      int64_t sum = 0;
+
+      for (auto j = 0; j < order; j++)
+        sum += coefs[j] * y[i - j - 1];
+
+      residual.push_back(y[i] - (sum >> shift));
+    }
+  }
+
+  WriteFLACResidual(writer, residual, order, blockSize, rng);
+}
+
+/** Writes integer samples of 4 to 24 bits as a FLAC file. Stereo frames cycle through the four channel assignments */
+inline bool WriteFLAC(const char* path, const AudioChannels& chans, int bitsPerSample, int sampleRate, const FLACWriterOptions& options = FLACWriterOptions())
+{
+  std::mt19937 rng(options.mSeed);
+  const int nChans = static_cast<int>(chans.size());
+  const int64_t nFrames = static_cast<int64_t>(chans[0].size());
+  std::vector<uint8_t> frames;
+  int minFrameSize = 0x7FFFFFFF, maxFrameSize = 0;
+  int64_t pos = 0;
+
+  for (int64_t frameNumber = 0; pos < nFrames; frameNumber++)
+  {
+    int blockSize = options.mBlockSize;
+
+    if (options.mVariableBlockSize)
+      blockSize = 16 + rng() % (options.mBlockSize - 15);
+
+    blockSize = static_cast<int>(std::min<int64_t>(blockSize, nFrames - pos));
+
+    int blockSizeCode;
+
+    if (blockSize == 192)
+      blockSizeCode = 1;
+    else if (blockSize == 576 || blockSize == 1152 || blockSize == 2304 || blockSize == 4608)
+      blockSizeCode = 2 + static_cast<int>(std::log2(blockSize / 576));
+    else if (blockSize >= 256 && blockSize <= 32768 && !(blockSize & (blockSize - 1)))
+      blockSizeCode = 8 + static_cast<int>(std::log2(blockSize / 256));
+    else
+      blockSizeCode = blockSize <= 256 ? 6 : 7;
+
+    const int sampleSizeCode = bitsPerSample == 8 ? 1 : bitsPerSample == 12 ? 2 : bitsPerSample == 16 ? 4 : bitsPerSample == 20 ? 5 : bitsPerSample == 24 ? 6 : 0;
+    const int assignment = nChans == 2 ? (frameNumber % 4 ? 7 + frameNumber % 4 : 1) : nChans - 1;
+
+    FLACBitWriter header;
+    header.Write(0x3FFE, 14);
+    header.Write(0, 1);
+    header.Write(options.mVariableBlockSize ? 1 : 0, 1);
+    header.Write(blockSizeCode, 4);
+    header.Write(0, 4); // the sample rate of the stream info
+    header.Write(assignment, 4);
+    header.Write(sampleSizeCode, 3);
+    header.Write(0, 1);
+
+    std::vector<uint8_t> frame = header.mBytes;
+    WriteFLACNumber(frame, options.mVariableBlockSize ? pos : frameNumber);
+
+    if (blockSizeCode == 6)
+      frame.push_back(static_cast<uint8_t>(blockSize - 1));
+    else if (blockSizeCode == 7)
+    {
+      frame.push_back(static_cast<uint8_t>((blockSize - 1) >> 8));
+      frame.push_back(static_cast<uint8_t>(blockSize - 1));
+    }
+
+    frame.push_back(TestFLACCRC8(frame.data(), frame.size()));
+
+    // The subframes, with the side channels of the stereo assignments, which have an extra bit
+    std::vector<std::vector<int64_t>> blocks(nChans, std::vector<int64_t>(blockSize));
+    std::vector<int> bps(nChans, bitsPerSample);
+
+    for (auto c = 0; c < nChans; c++)
+    {
+      for (auto i = 0; i < blockSize; i++)
+        blocks[c][i] = chans[c][pos + i];
+    }
+
+    if (assignment >= 8)
+    {
+      for (auto i = 0; i < blockSize; i++)
+      {
+        const int64_t l = chans[0][pos + i], r = chans[1][pos + i];
+
+        if (assignment == 8)
+          blocks[1][i] = l - r;
+        else if (assignment == 9)
+          blocks[0][i] = l - r;
+        else
+        {
+          blocks[0][i] = (l + r) >> 1;
+          blocks[1][i] = l - r;
+        }
+      }
+
+      bps[assignment == 9 ? 0 : 1]++;
+    }
+
+    FLACBitWriter subframes;
+
+    for (auto c = 0; c < nChans; c++)
+      WriteFLACSubframe(subframes, blocks[c], bps[c], static_cast<int>(frameNumber * 3 + c), rng);
+
+    subframes.Align();
+    frame.insert(frame.end(), subframes.mBytes.begin(), subframes.mBytes.end());
+
+    const uint16_t crc = TestFLACCRC16(frame.data(), frame.size());
+    frame.push_back(static_cast<uint8_t>(crc >> 8));
+    frame.push_back(static_cast<uint8_t>(crc));
+
+    minFrameSize = std::min(minFrameSize, static_cast<int>(frame.size()));
+    maxFrameSize = std::max(maxFrameSize, static_cast<int>(frame.size()));
+    frames.insert(frames.end(), frame.begin(), frame.end());
+    pos += blockSize;
+  }
+
+  FLACBitWriter info;
+  info.Write(options.mVariableBlockSize ? 16 : options.mBlockSize, 16);
+  info.Write(options.mBlockSize, 16);
+  info.Write(minFrameSize, 24);
+  info.Write(maxFrameSize, 24);
+  info.Write(sampleRate, 20);
+  info.Write(nChans - 1, 3);
+  info.Write(bitsPerSample - 1, 5);
+  info.Write(static_cast<uint64_t>(nFrames), 36);
+  info.Write(0, 64); // no MD5
+  info.Write(0, 64);
+
+  FILE* pFile = fopen(path, "wb");
+
+  if (!pFile)
+    return false;
+
+  const uint8_t streamInfoHeader[] = { 0x00, 0, 0, 34 };
+  const uint8_t paddingHeader[] = { 0x81, 0, 0, 10 }; // the last metadata block
+  const uint8_t padding[10] = {};
+
+  fwrite("fLaC", 1, 4, pFile);
+  fwrite(streamInfoHeader, 1, 4, pFile);
+  fwrite(info.mBytes.data(), 1, info.mBytes.size(), pFile);
+  fwrite(paddingHeader, 1, 4, pFile);
+  fwrite(padding, 1, 10, pFile);
+
+  const bool ok = fwrite(frames.data(), 1, frames.size(), pFile) == frames.size();
+  fclose(pFile);
+  return ok;
+}
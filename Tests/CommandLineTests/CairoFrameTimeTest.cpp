@@ -0,0 +1,183 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+// Draws frames of a 1000x800 editor with 100 vector knobs into an IGraphicsCairo offscreen surface, without a window, and prints the frame times:
+// full redraws, a single knob changing, and knobs drawn through layers, which reuse pooled surfaces. Also checks that layer surfaces still referenced
+// elsewhere are not pooled. Built only when pkg-config finds cairo
+
+#include <algorithm>
+#include <vector>
+
+#include "IGraphicsCairo.h"
+#include "HeadlessGraphics.h"
+
+#include "CommandLineTest.h"
+
+static constexpr int kNKnobs = 100;
+static constexpr int kNFrames = 200;
+
+/** A knob drawn with the shapes vector controls use, round rect, arcs, circle and line, optionally through a layer */
+class KnobControl : public IControl
+{
+public:
+  KnobControl(const IRECT& bounds, bool useLayer)
+  : IControl(bounds)
+  , mUseLayer(useLayer)
+  {}
+
+  void Draw(IGraphics& g) override
+  {
+    if (!mUseLayer)
+      return DrawKnob(g);
+
+    g.StartLayer(this, mRECT);
+    DrawKnob(g);
+    mLayer = g.EndLayer();
+    g.DrawLayer(mLayer);
+  }
+
+private:
+  void DrawKnob(IGraphics& g)
+  {
+    const float cx = mRECT.MW(), cy = mRECT.MH(), r = mRECT.W() * 0.35f;
+    const float angle = -135.f + static_cast<float>(GetValue()) * 270.f;
+
+    g.FillRoundRect(COLOR_LIGHT_GRAY, mRECT, 6.f);
+    g.DrawArc(COLOR_MID_GRAY, cx, cy, r + 4.f, -135.f, 135.f, nullptr, 3.f);
+    g.FillArc(COLOR_ORANGE, cx, cy, r + 4.f, -135.f, angle);
+    g.FillCircle(COLOR_DARK_GRAY, cx, cy, r);
+    g.DrawRadialLine(COLOR_WHITE, cx, cy, angle, 0.2f * r, r, nullptr, 2.f);
+  }
+
+  bool mUseLayer;
+  ILayerPtr mLayer;
+};
+
+/** Draws kNFrames frames, calling prepare before each one
+ * @return The frame times in milliseconds, sorted */
+template <typename F>
+static std::vector<double> TimeFrames(HeadlessGraphics<IGraphicsCairo>& graphics, F&& prepare)
+{
+  std::vector<double> times;
+
+  for (auto f = 0; f < kNFrames; f++)
+  {
+    prepare(f);
+
+    // Timed directly rather than with TimeMicroseconds(), whose warm up run would draw the frame before it is timed
+    const auto start = std::chrono::high_resolution_clock::now();
+    graphics.Tick();
+    times.push_back(std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count());
+  }
+
+  std::sort(times.begin(), times.end());
+  return times;
+}
+
+static void PrintTimes(const char* name, const std::vector<double>& times)
+{
+  double total = 0.;
+
+  for (auto t : times)
+    total += t;
+
+  printf("  %-28s mean %7.3f ms, median %7.3f ms, 99th percentile %7.3f ms\n", name, total / times.size(), times[times.size() / 2], times[times.size() * 99 / 100]);
+}
+
+/** @return \c true if the pixel is not the white the surface is cleared to */
+static bool IsDrawn(cairo_surface_t* pSurface, int x, int y)
+{
+  cairo_surface_flush(pSurface);
+  const unsigned char* pData = cairo_image_surface_get_data(pSurface);
+  const uint32_t pixel = *reinterpret_cast<const uint32_t*>(pData + y * cairo_image_surface_get_stride(pSurface) + x * 4);
+  return pixel != 0xFFFFFFFF;
+}
+
+static void Run(int scale, bool useLayers)
+{
+  HeadlessDelegate delegate;
+  HeadlessGraphics<IGraphicsCairo> graphics(delegate, 1000, 800);
+  const float size = 80.f;
+
+  graphics.SetScreenScale(scale);
+  graphics.SetOffscreen(true);
+  graphics.AttachPanelBackground(COLOR_WHITE);
+
+  for (auto i = 0; i < kNKnobs; i++)
+    graphics.AttachControl(new KnobControl(IRECT(size * (i % 10), size * (i / 10), size * (i % 10 + 1), size * (i / 10 + 1)).GetPadded(-4.f), useLayers));
+
+  CHECK(graphics.GetOffscreenSurface() != nullptr);
+
+  if (!graphics.GetOffscreenSurface())
+    return;
+
+  printf("%ix, %s\n", scale, useLayers ? "knobs drawn through layers" : "knobs drawn directly");
+
+  PrintTimes("full redraw", TimeFrames(graphics, [&](int f) {
+    graphics.SetAllControlsDirty();
+  }));
+
+  PrintTimes("one knob changing", TimeFrames(graphics, [&](int f) {
+    graphics.GetControl(1 + f % kNKnobs)->SetValue((f % 20) / 20.);
+    graphics.GetControl(1 + f % kNKnobs)->SetDirty(false);
+  }));
+
+  // the centre of the first knob has been drawn, and the gap between the knobs is the background
+  CHECK(IsDrawn(graphics.GetOffscreenSurface(), 40 * scale, 40 * scale));
+  CHECK(!IsDrawn(graphics.GetOffscreenSurface(), 1 * scale, 1 * scale));
+}
+
+/** A layer surface that something else still references must not be recycled, or clearing it for the next layer would wipe the other owner's copy */
+static void TestSharedLayerSurface()
+{
+  HeadlessDelegate delegate;
+  HeadlessGraphics<IGraphicsCairo> graphics(delegate, 200, 200);
+  IControl* pControl = new KnobControl(IRECT(0, 0, 100, 100), false);
+
+  graphics.SetOffscreen(true);
+  graphics.AttachControl(pControl);
+
+  auto makeLayer = [&]() {
+    graphics.StartLayer(pControl, IRECT(0, 0, 100, 100));
+    graphics.FillRect(COLOR_RED, IRECT(0, 0, 100, 100), nullptr);
+    return graphics.EndLayer();
+  };
+
+  ILayerPtr layer = makeLayer();
+  cairo_surface_t* pShared = cairo_surface_reference(layer->GetAPIBitmap()->GetBitmap());
+  layer = nullptr;
+
+  ILayerPtr next = makeLayer();
+  CHECK(next->GetAPIBitmap()->GetBitmap() != pShared);
+  cairo_surface_flush(pShared);
+  CHECK(*reinterpret_cast<const uint32_t*>(cairo_image_surface_get_data(pShared) + 50 * cairo_image_surface_get_stride(pShared) + 50 * 4) == 0xFFFF0000); // still red, not cleared
+  CHECK(cairo_surface_get_reference_count(pShared) == 1);
+  cairo_surface_destroy(pShared);
+
+  // An unshared surface is reused by the next layer of the same size
+  cairo_surface_t* pUnshared = next->GetAPIBitmap()->GetBitmap();
+  next = nullptr;
+  CHECK(makeLayer()->GetAPIBitmap()->GetBitmap() == pUnshared);
+}
+
+int main()
+{
+  TestSharedLayerSurface();
+
+  printf("%i knobs, %i frames per run\n", kNKnobs, kNFrames);
+
+  for (auto scale : {1, 2})
+  {
+    Run(scale, false);
+    Run(scale, true);
+  }
+
+  return TestResult("CairoFrameTimeTest");
+}
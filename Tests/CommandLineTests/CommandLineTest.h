@@ -0,0 +1,49 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+#pragma once
+
+/**
+ * @file
+ * @brief Minimal helpers shared by the command line tests. Each test is a program that prints its results and returns non-zero if a check failed
+ */
+
+#include <chrono>
+#include <cstdio>
+
+static int sNFailedChecks = 0;
+
+#define CHECK(condition) \
+  do { if (!(condition)) { printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); sNFailedChecks++; } } while (0)
+
+/** Runs a function repeatedly and returns the mean time of one run
+ * @param nRuns The number of runs to time, after one untimed warm up run
+ * @param func The function to time
+ * @return The mean time in microseconds */
+template <typename F>
+double TimeMicroseconds(int nRuns, F&& func)
+{
+  func();
+
+  const auto start = std::chrono::high_resolution_clock::now();
+
+  for (int i = 0; i < nRuns; i++)
+    func();
+
+  return std::chrono::duration<double, std::micro>(std::chrono::high_resolution_clock::now() - start).count() / nRuns;
+}
+
+/** Prints the result of a test, call this at the end of main()
+ * @return The value for main() to return */
+static int TestResult(const char* name)
+{
+  printf("%s: %s\n", name, sNFailedChecks ? "FAILED" : "passed");
+  return sNFailedChecks ? 1 : 0;
+}
@@ -0,0 +1,268 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+// Checks IDisplayList with a headless IGraphics that logs the calls it receives: a replayed list makes the same calls, with the same arguments,
+// as drawing directly, and a replay clipped to a region skips exactly the commands outside it, still clearing the paths of skipped strokes and fills.
+// Then checks the draw loop: a control that uses a display list is recorded once, replayed culled to the dirty regions of other controls,
+// and recorded again only when it is dirty itself. Also times recording and replaying a list of many shapes
+
+#include <string>
+#include <vector>
+
+#include "HeadlessGraphics.h"
+
+#include "CommandLineTest.h"
+
+static constexpr int kNBenchShapes = 1000;
+
+/** A NullDrawing that logs the calls IDisplayList replays, with their arguments */
+class LoggingDrawing : public NullDrawing
+{
+public:
+  LoggingDrawing(IGEditorDelegate& dlg, int w, int h, int fps, float scale)
+  : NullDrawing(dlg, w, h, fps, scale)
+  {}
+
+  void FillRect(const IColor& color, const IRECT& bounds, const IBlend* pBlend) override { Log("FillRect", color, bounds, pBlend); }
+  void FillCircle(const IColor& color, float cx, float cy, float r, const IBlend* pBlend) override { Log("FillCircle", color, IRECT(cx, cy, r, r), pBlend); }
+  void DrawLine(const IColor& color, float x1, float y1, float x2, float y2, const IBlend* pBlend, float thickness) override { Log("DrawLine", color, IRECT(x1, y1, x2, y2), pBlend, thickness); }
+  void DrawRoundRect(const IColor& color, const IRECT& bounds, float cornerRadius, const IBlend* pBlend, float thickness) override { Log("DrawRoundRect", color, bounds, pBlend, thickness, cornerRadius); }
+
+  void DrawConvexPolygon(const IColor& color, float* x, float* y, int nPoints, const IBlend* pBlend, float thickness) override
+  {
+    Log("DrawConvexPolygon", color, IRECT(x[0], y[0], x[nPoints - 1], y[nPoints - 1]), pBlend, thickness, static_cast<float>(nPoints));
+  }
+
+  void PathClear() override { mLog.push_back("PathClear"); }
+  void PathMoveTo(float x, float y) override { Log("PathMoveTo", COLOR_TRANSPARENT, IRECT(x, y, x, y)); }
+  void PathLineTo(float x, float y) override { Log("PathLineTo", COLOR_TRANSPARENT, IRECT(x, y, x, y)); }
+  void PathRect(const IRECT& bounds) override { Log("PathRect", COLOR_TRANSPARENT, bounds); }
+  void PathStroke(const IPattern& pattern, float thickness, const IStrokeOptions& options, const IBlend* pBlend) override { Log("PathStroke", pattern.GetStop(0).mColor, IRECT(), pBlend, thickness); }
+  void PathFill(const IPattern& pattern, const IFillOptions& options, const IBlend* pBlend) override { Log("PathFill", pattern.GetStop(0).mColor, IRECT(), pBlend); }
+  void PathTransformSave() override { mLog.push_back("PathTransformSave"); }
+  void PathTransformRestore() override { mLog.push_back("PathTransformRestore"); }
+  void PathTransformTranslate(float x, float y) override { Log("PathTransformTranslate", COLOR_TRANSPARENT, IRECT(x, y, x, y)); }
+
+  /** @return The calls logged since the last call */
+  std::vector<std::string> TakeLog() { std::vector<std::string> log; log.swap(mLog); return log; }
+
+  /** @return The number of logged calls that start with name */
+  int Count(const std::vector<std::string>& log, const char* name) const
+  {
+    int n = 0;
+
+    for (const auto& entry : log)
+      n += entry.compare(0, strlen(name), name) == 0;
+
+    return n;
+  }
+
+protected:
+  void DoDrawText(const IText& text, const char* str, const IRECT& bounds, const IBlend* pBlend) override { Log((std::string("DrawText ") + str).c_str(), text.mFGColor, bounds, pBlend, text.mSize); }
+
+private:
+  void Log(const char* name, const IColor& color, const IRECT& bounds, const IBlend* pBlend = nullptr, float a = 0.f, float b = 0.f)
+  {
+    char entry[256];
+    snprintf(entry, sizeof(entry), "%s %i,%i,%i,%i %g,%g,%g,%g blend %g %g %g", name, color.A, color.R, color.G, color.B, bounds.L, bounds.T, bounds.R, bounds.B,
+             pBlend ? pBlend->mWeight : -1.f, a, b);
+    mLog.push_back(entry);
+  }
+
+  std::vector<std::string> mLog;
+};
+
+using TestGraphics = HeadlessGraphics<LoggingDrawing>;
+
+/** The same drawing code for IGraphics and IDisplayList, with shapes in the top left, where the clipped replay draws, and in the bottom right */
+template <class G>
+static void DrawScene(G& g)
+{
+  const IBlend blend(EBlend::Default, 0.5f);
+  float x[] = { 20.f, 50.f, 35.f }, y[] = { 30.f, 30.f, 55.f };
+
+  g.FillRect(COLOR_RED, IRECT(0, 0, 50, 50));
+  g.DrawLine(COLOR_BLUE, 10, 10, 90, 20, &blend, 2.f);
+  g.FillCircle(COLOR_GREEN, 150, 150, 20);
+  g.DrawRoundRect(COLOR_BLACK, IRECT(100, 0, 190, 40), 4.f, nullptr, 3.f);
+  g.DrawConvexPolygon(COLOR_WHITE, x, y, 3, &blend, 1.f);
+  g.DrawText(IText(14.f, COLOR_BLUE), "Label", IRECT(120, 180, 190, 200));
+  g.PathMoveTo(0, 100);
+  g.PathLineTo(40, 140);
+  g.PathStroke(IPattern(COLOR_ORANGE), 2.f);
+  g.PathRect(IRECT(150, 20, 190, 60));
+  g.PathFill(IPattern(COLOR_GRAY));
+  g.PathRect(IRECT(10, 10, 20, 20));
+  g.PathFill(IPattern(COLOR_YELLOW));
+
+  // Under a transform the bounds aren't known, so this is never culled
+  g.PathTransformSave();
+  g.PathTransformTranslate(180, 180);
+  g.FillRect(COLOR_RED, IRECT(0, 0, 10, 10));
+  g.PathTransformRestore();
+}
+
+static void TestReplay()
+{
+  HeadlessDelegate delegate;
+  TestGraphics graphics(delegate, 200, 200);
+
+  DrawScene<IGraphics>(graphics); // through the base class, where the default arguments are
+  const std::vector<std::string> direct = graphics.TakeLog();
+
+  IDisplayList list;
+  list.Clear(IRECT(0, 0, 200, 200));
+  DrawScene(list);
+
+  CHECK(list.IsValid());
+  CHECK(list.NCommands() == 17);
+  CHECK(list.Replay(graphics) == 0);
+  CHECK(graphics.TakeLog() == direct);
+
+  // Only the shapes that reach the top left are drawn. The skipped stroke and fill still clear their paths, so the next fill doesn't pick them up
+  const int nCulled = list.Replay(graphics, IRECT(0, 0, 60, 60));
+  const std::vector<std::string> clipped = graphics.TakeLog();
+
+  CHECK(nCulled == 4);
+  CHECK(graphics.Count(clipped, "FillRect") == 2);
+  CHECK(graphics.Count(clipped, "DrawLine") == 1);
+  CHECK(graphics.Count(clipped, "DrawConvexPolygon") == 1);
+  CHECK(graphics.Count(clipped, "FillCircle") == 0);
+  CHECK(graphics.Count(clipped, "DrawRoundRect") == 0);
+  CHECK(graphics.Count(clipped, "DrawText") == 1);
+  CHECK(graphics.Count(clipped, "PathStroke") == 0);
+  CHECK(graphics.Count(clipped, "PathFill") == 1);
+  CHECK(graphics.Count(clipped, "PathClear") == 2);
+  CHECK(clipped.size() == direct.size() - nCulled + 2);
+
+  // Clearing keeps nothing of the previous recording
+  list.Clear();
+  CHECK(list.NCommands() == 0);
+  CHECK(list.Replay(graphics) == 0);
+  CHECK(graphics.TakeLog().empty());
+
+  list.Invalidate();
+  CHECK(!list.IsValid());
+}
+
+/** A control that draws two halves in different colours, either directly or via its display list, and counts how often each is called */
+class HalvesControl : public IControl
+{
+public:
+  HalvesControl(const IRECT& bounds)
+  : IControl(bounds)
+  {
+    SetUseDisplayList(true);
+  }
+
+  void Draw(IGraphics& g) override
+  {
+    mNDraws++;
+    DrawHalves(g);
+  }
+
+  void RecordDisplayList(IGraphics& g, IDisplayList& list) override
+  {
+    mNRecords++;
+    DrawHalves(list);
+  }
+
+  int mNDraws = 0;
+  int mNRecords = 0;
+
+private:
+  template <class G>
+  void DrawHalves(G& g)
+  {
+    g.FillRect(COLOR_RED, mRECT.GetGridCell(0, 1, 2));
+    g.FillRect(GetValue() > 0.5 ? COLOR_YELLOW : COLOR_GREEN, mRECT.GetGridCell(1, 1, 2));
+  }
+};
+
+static void TestDrawLoop()
+{
+  HeadlessDelegate delegate;
+  TestGraphics graphics(delegate, 200, 200);
+  HalvesControl* pListed = new HalvesControl(IRECT(0, 0, 100, 50));
+  IControl* pOverlapping = new IPanelControl(IRECT(75, 0, 150, 50), COLOR_BLUE);
+
+  graphics.AttachControl(pListed);
+  graphics.AttachControl(pOverlapping);
+
+  graphics.Tick();
+  std::vector<std::string> log = graphics.TakeLog();
+  CHECK(pListed->mNRecords == 1);
+  CHECK(pListed->mNDraws == 0);
+  CHECK(graphics.Count(log, "FillRect 255,255,0,0") == 1 && graphics.Count(log, "FillRect 255,0,255,0") == 1);
+
+  // A dirty control over the right half replays the list, which is not recorded again, and only the right half reaches the dirty region
+  for (auto i = 0; i < 3; i++)
+  {
+    pOverlapping->SetDirty(false);
+    graphics.Tick();
+    log = graphics.TakeLog();
+  }
+
+  CHECK(pListed->mNRecords == 1);
+  CHECK(graphics.Count(log, "FillRect 255,255,0,0") == 0);
+  CHECK(graphics.Count(log, "FillRect 255,0,255,0") == 1);
+
+  // Nothing is dirty, nothing is drawn
+  CHECK(!graphics.Tick());
+
+  // Changing the control's value makes it dirty, which records it again, with the new colour
+  pListed->SetValue(1.);
+  pListed->SetDirty(false);
+  graphics.Tick();
+  log = graphics.TakeLog();
+  CHECK(pListed->mNRecords == 2);
+  CHECK(graphics.Count(log, "FillRect 255,255,0,0") == 1 && graphics.Count(log, "FillRect 255,255,255,0") == 1);
+
+  // Without the list the control draws directly again
+  pListed->SetUseDisplayList(false);
+  pListed->SetDirty(false);
+  graphics.Tick();
+  CHECK(pListed->mNRecords == 2);
+  CHECK(pListed->mNDraws == 1);
+}
+
+static void BenchmarkReplay()
+{
+  HeadlessDelegate delegate;
+  HeadlessGraphics<NullDrawing> graphics(delegate, 1000, 1000);
+  IDisplayList list;
+
+  auto record = [&]() {
+    list.Clear(IRECT(0, 0, 1000, 1000));
+
+    for (auto i = 0; i < kNBenchShapes; i++)
+    {
+      const IRECT cell = IRECT(0, 0, 1000, 1000).GetGridCell(i, 32, 32);
+      list.FillRoundRect(COLOR_LIGHT_GRAY, cell, 3.f);
+      list.FillCircle(COLOR_DARK_GRAY, cell.MW(), cell.MH(), cell.W() * 0.3f);
+    }
+  };
+
+  const double recordTime = TimeMicroseconds(200, record);
+  const double replayTime = TimeMicroseconds(200, [&]() { list.Replay(graphics); });
+  const double clippedTime = TimeMicroseconds(200, [&]() { list.Replay(graphics, IRECT(0, 0, 100, 100)); });
+
+  printf("%i commands, %zu bytes: record %.1f us, replay %.1f us, replay clipped to 1%% of the area %.1f us\n",
+         list.NCommands(), list.GetSize(), recordTime, replayTime, clippedTime);
+}
+
+int main()
+{
+  TestReplay();
+  TestDrawLoop();
+  BenchmarkReplay();
+
+  return TestResult("DisplayListTest");
+}
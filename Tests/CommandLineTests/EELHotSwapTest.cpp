@@ -0,0 +1,245 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+// Checks IPlugEEL, built with the WDL/eel2 compiler: scripts are swapped in at the start of a block, slider values carry over by index,
+// the IParams only change when the main thread calls OnIdle(), \@process handles blocks longer than the maximum block size, and a script that fails to compile
+// leaves the running one alone. Then recompiles on a background thread while another thread processes, where every block must come from one whole program.
+// Then times \@sample against \@process
+
+#include <atomic>
+#include <cmath>
+#include <thread>
+#include <vector>
+
+#include "IPlugEEL.h"
+
+#include "CommandLineTest.h"
+
+using namespace iplug;
+
+static constexpr int kNChans = 2;
+static constexpr int kBlockSize = 256;
+static constexpr int kNSwaps = 200;
+static constexpr int kNRuns = 200;
+
+static const char* kGainScript = R"(
+slider1:gain_db=0<-60,12,0.1>Gain (dB)
+
+@slider
+gain = 10^(gain_db/20);
+@sample
+spl0 *= gain;
+spl1 *= gain;
+)";
+
+static const char* kGainMixScript = R"(
+slider1:gain_db=0<-60,12,0.1>Gain (dB)
+slider2:mix=0.5<0,1,0.01>Mix
+
+@slider
+gain = 10^(gain_db/20);
+@sample
+spl0 = spl0 * gain * mix;
+spl1 = spl1 * gain * (1 - mix);
+)";
+
+static const char* kBlockScript = R"(
+slider1:offset=0.25<0,1,0.01>Offset
+
+@process
+i = 0;
+loop(num_ch * maxframes,
+  io[i] += offset;
+  i += 1;
+);
+)";
+
+/** Audio buffers of kNChans channels, with the inputs set to a constant */
+struct Buffers
+{
+  Buffers(int nFrames, sample input = sample(1))
+  : mIn(kNChans, std::vector<sample>(nFrames, input))
+  , mOut(kNChans, std::vector<sample>(nFrames))
+  {
+    for (auto c = 0; c < kNChans; c++)
+    {
+      mInputs[c] = mIn[c].data();
+      mOutputs[c] = mOut[c].data();
+    }
+  }
+
+  /** @return \c true if every frame of a channel equals value */
+  bool All(int chan, sample value, double tolerance = 1e-9) const
+  {
+    for (auto s : mOut[chan])
+    {
+      if (std::fabs(s - value) > tolerance)
+        return false;
+    }
+
+    return true;
+  }
+
+  std::vector<std::vector<sample>> mIn, mOut;
+  sample* mInputs[kNChans];
+  sample* mOutputs[kNChans];
+};
+
+static void TestSwap()
+{
+  IPlugEEL eel("EELHotSwapTest", kNChans);
+  eel.SetSampleRate(48000., kBlockSize);
+  Buffers buffers(kBlockSize);
+  WDL_String error;
+
+  // nothing compiled, the audio passes through
+  eel.ProcessBlock(buffers.mInputs, buffers.mOutputs, kBlockSize);
+  CHECK(buffers.All(0, 1.) && buffers.All(1, 1.));
+
+  CHECK(eel.Compile(kGainScript, error));
+  CHECK(eel.NParams() == 0); // until the main thread picks up the sliders
+  CHECK(eel.OnIdle());
+  CHECK(eel.NParams() == 1 && !strcmp(eel.GetParam(0)->GetNameForHost(), "Gain (dB)"));
+  CHECK(!eel.OnIdle());
+
+  eel.SetParameterValue(0, -6.);
+  eel.ProcessBlock(buffers.mInputs, buffers.mOutputs, kBlockSize);
+  const double gain = std::pow(10., -6. / 20.);
+  CHECK(buffers.All(0, gain) && buffers.All(1, gain));
+
+  // the gain carries over to the new script, the new slider starts at its default
+  CHECK(eel.Compile(kGainMixScript, error));
+  CHECK(eel.NParams() == 1);
+  eel.ProcessBlock(buffers.mInputs, buffers.mOutputs, kBlockSize);
+  CHECK(buffers.All(0, gain * 0.5) && buffers.All(1, gain * 0.5));
+
+  CHECK(eel.OnIdle());
+  CHECK(eel.NParams() == 2 && !strcmp(eel.GetParam(1)->GetNameForHost(), "Mix"));
+  CHECK(std::fabs(eel.GetParam(0)->Value() + 6.) < 1e-9 && eel.GetParam(1)->Value() == 0.5);
+
+  eel.SetParameterValue(1, 0.25);
+  eel.ProcessBlock(buffers.mInputs, buffers.mOutputs, kBlockSize);
+  CHECK(buffers.All(0, gain * 0.25) && buffers.All(1, gain * 0.75));
+
+  // a failed compile keeps the running script and its sliders
+  CHECK(!eel.Compile("slider1:x=0<0,1>X\n@sample\nspl0 = (;\n", error));
+  CHECK(error.GetLength() > 0);
+  CHECK(!eel.OnIdle());
+  eel.ProcessBlock(buffers.mInputs, buffers.mOutputs, kBlockSize);
+  CHECK(buffers.All(0, gain * 0.25) && buffers.All(1, gain * 0.75));
+
+  // @process runs several times for a block longer than the maximum block size, and once for a shorter one, every frame is written once
+  const int longBlock = 16 * kBlockSize + 100;
+  Buffers longBuffers(longBlock, sample(0.5));
+  CHECK(eel.Compile(kBlockScript, error));
+  CHECK(eel.OnIdle());
+  eel.ProcessBlock(longBuffers.mInputs, longBuffers.mOutputs, longBlock);
+  CHECK(longBuffers.All(0, 0.75) && longBuffers.All(1, 0.75));
+
+  longBuffers.mOut[0][99] = 0.;
+  eel.ProcessBlock(longBuffers.mInputs, longBuffers.mOutputs, 100);
+  CHECK(std::fabs(longBuffers.mOut[0][99] - 0.75) < 1e-9);
+}
+
+/** Two scripts are compiled in turn on a background thread while another thread processes blocks, and the main thread calls OnIdle().
+ * Every block must have the output of one of the scripts in all of its frames */
+static void TestConcurrentSwaps()
+{
+  IPlugEEL eel("EELHotSwapTest", kNChans);
+  eel.SetSampleRate(48000., kBlockSize);
+  WDL_String error;
+  CHECK(eel.Compile(kGainScript, error));
+  eel.OnIdle();
+  eel.SetParameterValue(0, -6.);
+
+  const double gain = std::pow(10., -6. / 20.);
+  std::atomic<bool> compiling {true};
+  std::atomic<int> nBlocks {0}, nBad {0}, nSwapped {0};
+
+  std::thread audio([&]() {
+    Buffers buffers(kBlockSize);
+    sample prev = 0.;
+
+    while (compiling.load())
+    {
+      eel.ProcessBlock(buffers.mInputs, buffers.mOutputs, kBlockSize);
+      const sample first = buffers.mOut[0][0];
+
+      if (!(buffers.All(0, gain) && buffers.All(1, gain)) && !(buffers.All(0, gain * 0.5) && buffers.All(1, gain * 0.5)))
+        nBad++;
+
+      if (nBlocks.fetch_add(1) > 0 && first != prev)
+        nSwapped++;
+
+      prev = first;
+    }
+  });
+
+  std::thread compiler([&]() {
+    WDL_String compileError;
+
+    for (auto i = 0; i < kNSwaps; i++)
+    {
+      CHECK(eel.Compile(i % 2 ? kGainScript : kGainMixScript, compileError));
+      std::this_thread::sleep_for(std::chrono::microseconds(200));
+    }
+
+    compiling.store(false);
+  });
+
+  int nRelinked = 0;
+
+  while (compiling.load())
+  {
+    nRelinked += eel.OnIdle();
+    std::this_thread::sleep_for(std::chrono::microseconds(100));
+  }
+
+  compiler.join();
+  audio.join();
+  eel.OnIdle();
+
+  printf("%i compiles while processing %i blocks, %i swaps heard, sliders re-initialised %i times\n", kNSwaps, nBlocks.load(), nSwapped.load(), nRelinked);
+
+  CHECK(nBad.load() == 0);
+  CHECK(nSwapped.load() > 0);
+  CHECK(eel.NParams() == 1 && std::fabs(eel.GetParam(0)->Value() + 6.) < 1e-9);
+}
+
+static void Benchmark()
+{
+  static const char* kSampleScript = "slider1:g=0.5<0,1>G\n@sample\nspl0 *= g;\nspl1 *= g;\n";
+  static const char* kProcessScript = "slider1:g=0.5<0,1>G\n@process\ni = 0;\nloop(num_ch * maxframes, io[i] *= g; i += 1;);\n";
+
+  printf("%i channels x %i frames, ns per frame\n", kNChans, kBlockSize);
+
+  for (auto script : { kSampleScript, kProcessScript })
+  {
+    IPlugEEL eel("EELHotSwapTest", kNChans);
+    eel.SetSampleRate(48000., kBlockSize);
+    Buffers buffers(kBlockSize);
+    WDL_String error;
+    CHECK(eel.Compile(script, error));
+
+    const double time = TimeMicroseconds(kNRuns, [&]() { eel.ProcessBlock(buffers.mInputs, buffers.mOutputs, kBlockSize); });
+
+    CHECK(buffers.All(0, 0.5));
+    printf("  %-9s %6.2f\n", script == kSampleScript ? "@sample" : "@process", 1000. * time / kBlockSize);
+  }
+}
+
+int main()
+{
+  TestSwap();
+  TestConcurrentSwaps();
+  Benchmark();
+
+  return TestResult("EELHotSwapTest");
+}
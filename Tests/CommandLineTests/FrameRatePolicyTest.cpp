@@ -0,0 +1,157 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+// Runs a headless IGraphics with 200 controls in a draw loop driven by a real OS timer, at the rate the frame rate policy asks for, and measures
+// how often the loop wakes up and how much CPU time it uses, with the UI fully idle and with a drag followed by idle time.
+// The drawing class draws nothing, so the CPU time is that of the timer wakeups, IsDirty() and the control traversal, not of any drawing
+
+#include <ctime>
+#include <thread>
+
+#include "HeadlessGraphics.h"
+
+#include "CommandLineTest.h"
+
+static constexpr int kFPS = 60;
+static constexpr int kNControls = 200;
+static constexpr double kRunTime = 3.;
+static constexpr double kDragTime = 1.;
+
+/** A control that changes its value and redraws when dragged */
+class DragControl : public IControl
+{
+public:
+  DragControl(const IRECT& bounds)
+  : IControl(bounds)
+  {}
+
+  void Draw(IGraphics& g) override
+  {
+    g.FillRect(COLOR_GRAY, mRECT);
+    g.FillRect(COLOR_WHITE, mRECT.FracRectVertical(static_cast<float>(GetValue())));
+  }
+
+  void OnMouseDrag(float x, float y, float dX, float dY, const IMouseMod& mod) override
+  {
+    SetValue(Clip(GetValue() - dY * 0.01, 0., 1.));
+    SetDirty(false);
+  }
+};
+
+struct RunResult
+{
+  int mNWakeups = 0;
+  int mNDraws = 0;
+  double mCPUTime = 0.; // milliseconds
+};
+
+static double CPUTime()
+{
+  timespec ts;
+  clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+  return ts.tv_sec * 1000. + ts.tv_nsec / 1000000.;
+}
+
+/** Runs the draw loop for kRunTime seconds. The thread sleeps until the next tick at the rate the platform timer is set to, or, if the timer is stopped,
+ * until the next input event, as a platform event loop would. During the drag, mouse events arrive at kFPS and are handled before the tick they wake */
+static RunResult Run(EFrameRatePolicy policy, double dragTime)
+{
+  using Clock = std::chrono::steady_clock;
+
+  HeadlessDelegate delegate;
+  HeadlessGraphics<NullDrawing> graphics(delegate, 1000, 800, kFPS);
+  const float size = 40.f;
+
+  for (auto i = 0; i < kNControls; i++)
+    graphics.AttachControl(new DragControl(IRECT(size * (i % 20), size * (i / 20), size * (i % 20 + 1), size * (i / 20 + 1)).GetPadded(-2.f)));
+
+  graphics.SetFrameRatePolicy(policy);
+  graphics.Tick(); // the first frame draws everything
+
+  const Clock::time_point start = Clock::now();
+  const Clock::time_point end = start + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(kRunTime));
+  const Clock::duration eventInterval = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1. / kFPS));
+  const Clock::time_point dragEnd = start + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(dragTime));
+  Clock::time_point nextEvent = dragTime > 0. ? start : end;
+  Clock::time_point nextTick = start;
+  int nDragEvents = 0;
+  RunResult result;
+  const double startCPU = CPUTime();
+
+  while (true)
+  {
+    const int fps = graphics.GetTimerFPS();
+
+    if (fps > 0)
+      nextTick = std::max(nextTick + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1. / fps)), Clock::now());
+    else
+      nextTick = end;
+
+    const Clock::time_point wake = std::min(std::min(nextTick, nextEvent), end);
+    std::this_thread::sleep_until(wake);
+
+    if (wake >= end)
+      break;
+
+    result.mNWakeups++;
+
+    if (wake == nextEvent)
+    {
+      const std::vector<IMouseInfo> points {{100.f, 100.f, 0.f, -1.f, IMouseMod()}};
+      const bool last = nextEvent + eventInterval >= dragEnd;
+
+      if (!nDragEvents++)
+        graphics.OnMouseDown(points);
+      else if (last)
+        graphics.OnMouseUp(points);
+      else
+        graphics.OnMouseDrag(points);
+
+      nextEvent = last ? end : nextEvent + eventInterval;
+    }
+
+    // With the timer running, an event is handled in the wakeup of the tick it coincides with
+    if (wake == nextTick || fps > 0)
+      result.mNDraws += graphics.Tick() ? 1 : 0;
+  }
+
+  result.mCPUTime = CPUTime() - startCPU;
+  return result;
+}
+
+int main()
+{
+  const EFrameRatePolicy policies[] = { EFrameRatePolicy::Fixed, EFrameRatePolicy::Adaptive, EFrameRatePolicy::OnDemand };
+  const char* names[] = { "Fixed", "Adaptive", "OnDemand" };
+  RunResult idle[3], drag[3];
+
+  printf("%i controls at %i fps, %.0f s runs, wakeups / frames drawn / CPU ms\n", kNControls, kFPS, kRunTime);
+  printf("  policy      fully idle                %.0f s drag, then idle\n", kDragTime);
+
+  for (auto p = 0; p < 3; p++)
+  {
+    idle[p] = Run(policies[p], 0.);
+    drag[p] = Run(policies[p], kDragTime);
+    printf("  %-9s %6i %6i %8.1f     %6i %6i %8.1f\n", names[p],
+           idle[p].mNWakeups, idle[p].mNDraws, idle[p].mCPUTime, drag[p].mNWakeups, drag[p].mNDraws, drag[p].mCPUTime);
+  }
+
+  // Fixed ticks at the full rate all the time. Adaptive drops to DEFAULT_IDLE_FPS after DEFAULT_IDLE_DELAY, and OnDemand stops
+  const double idleTicks = DEFAULT_IDLE_DELAY / 1000. * kFPS;
+  CHECK(idle[0].mNWakeups > kRunTime * kFPS * 0.9);
+  CHECK(idle[1].mNWakeups < idleTicks + (kRunTime - DEFAULT_IDLE_DELAY / 1000.) * DEFAULT_IDLE_FPS + 10);
+  CHECK(idle[2].mNWakeups < idleTicks + 10);
+
+  // Every drag event is drawn, whatever the policy
+  for (auto p = 0; p < 3; p++)
+    CHECK(drag[p].mNDraws > kDragTime * kFPS * 0.9);
+
+  return TestResult("FrameRatePolicyTest");
+}
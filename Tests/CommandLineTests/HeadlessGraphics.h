@@ -0,0 +1,172 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+#pragma once
+
+/**
+ * @file
+ * @brief An IGraphics without a window, for the command line tests. HeadlessGraphics<DrawClass> adds a platform that does nothing to a drawing class,
+ * NullDrawing is a drawing class that only counts the draw calls, so that IGraphics can be run by itself
+ */
+
+#include "IGraphics.h"
+#include "IControl.h"
+
+using namespace iplug;
+using namespace iplug::igraphics;
+
+#if defined OS_LINUX
+/** IPlugPaths has no Linux implementation, a headless editor has no resources */
+iplug::EResourceLocation iplug::LocateResource(const char* fileNameOrResID, const char* type, WDL_String& result, const char* bundleID, void* pHInstance, const char* sharedResourcesSubPath)
+{
+  return EResourceLocation::kNotFound;
+}
+#endif
+
+/** An editor delegate for a headless IGraphics, with no plug-in behind it */
+class HeadlessDelegate : public IGEditorDelegate
+{
+public:
+  HeadlessDelegate(int nParams = 0)
+  : IGEditorDelegate(nParams)
+  {}
+
+  void BeginInformHostOfParamChangeFromUI(int paramIdx) override {}
+  void EndInformHostOfParamChangeFromUI(int paramIdx) override {}
+};
+
+/** A drawing class that draws nothing, and counts the calls IGraphics makes to it */
+class NullDrawing : public IGraphics
+{
+public:
+  NullDrawing(IGEditorDelegate& dlg, int w, int h, int fps, float scale)
+  : IGraphics(dlg, w, h, fps, scale)
+  {}
+
+  void DrawSVG(const ISVG& svg, const IRECT& bounds, const IBlend* pBlend) override { mNDrawCalls++; }
+  void DrawRotatedSVG(const ISVG& svg, float destCentreX, float destCentreY, float width, float height, double angle, const IBlend* pBlend) override { mNDrawCalls++; }
+  void DrawBitmap(const IBitmap& bitmap, const IRECT& bounds, int srcX, int srcY, const IBlend* pBlend) override { mNDrawCalls++; }
+  void DrawFittedBitmap(const IBitmap& bitmap, const IRECT& bounds, const IBlend* pBlend) override { mNDrawCalls++; }
+  void DrawRotatedBitmap(const IBitmap& bitmap, float destCentreX, float destCentreY, double angle, int yOffsetZeroDeg, const IBlend* pBlend) override { mNDrawCalls++; }
+  void DrawPoint(const IColor& color, float x, float y, const IBlend* pBlend) override { mNDrawCalls++; }
+  void DrawLine(const IColor& color, float x1, float y1, float x2, float y2, const IBlend* pBlend, float thickness) override { mNDrawCalls++; }
+  void DrawDottedLine(const IColor& color, float x1, float y1, float x2, float y2, const IBlend* pBlend, float thickness, float dashLen) override { mNDrawCalls++; }
+  void DrawTriangle(const IColor& color, float x1, float y1, float x2, float y2, float x3, float y3, const IBlend* pBlend, float thickness) override { mNDrawCalls++; }
+  void DrawRect(const IColor& color, const IRECT& bounds, const IBlend* pBlend, float thickness) override { mNDrawCalls++; }
+  void DrawRoundRect(const IColor& color, const IRECT& bounds, float cornerRadius, const IBlend* pBlend, float thickness) override { mNDrawCalls++; }
+  void DrawRoundRect(const IColor& color, const IRECT& bounds, float cRTL, float cRTR, float cRBR, float cRBL, const IBlend* pBlend, float thickness) override { mNDrawCalls++; }
+  void DrawArc(const IColor& color, float cx, float cy, float r, float a1, float a2, const IBlend* pBlend, float thickness) override { mNDrawCalls++; }
+  void DrawCircle(const IColor& color, float cx, float cy, float r, const IBlend* pBlend, float thickness) override { mNDrawCalls++; }
+  void DrawEllipse(const IColor& color, const IRECT& bounds, const IBlend* pBlend, float thickness) override { mNDrawCalls++; }
+  void DrawEllipse(const IColor& color, float x, float y, float r1, float r2, float angle, const IBlend* pBlend, float thickness) override { mNDrawCalls++; }
+  void DrawConvexPolygon(const IColor& color, float* x, float* y, int nPoints, const IBlend* pBlend, float thickness) override { mNDrawCalls++; }
+  void DrawDottedRect(const IColor& color, const IRECT& bounds, const IBlend* pBlend, float thickness, float dashLen) override { mNDrawCalls++; }
+  void FillTriangle(const IColor& color, float x1, float y1, float x2, float y2, float x3, float y3, const IBlend* pBlend) override { mNDrawCalls++; }
+  void FillRect(const IColor& color, const IRECT& bounds, const IBlend* pBlend) override { mNDrawCalls++; }
+  void FillRoundRect(const IColor& color, const IRECT& bounds, float cornerRadius, const IBlend* pBlend) override { mNDrawCalls++; }
+  void FillRoundRect(const IColor& color, const IRECT& bounds, float cRTL, float cRTR, float cRBR, float cRBL, const IBlend* pBlend) override { mNDrawCalls++; }
+  void FillCircle(const IColor& color, float cx, float cy, float r, const IBlend* pBlend) override { mNDrawCalls++; }
+  void FillEllipse(const IColor& color, const IRECT& bounds, const IBlend* pBlend) override { mNDrawCalls++; }
+  void FillEllipse(const IColor& color, float x, float y, float r1, float r2, float angle, const IBlend* pBlend) override { mNDrawCalls++; }
+  void FillArc(const IColor& color, float cx, float cy, float r, float a1, float a2, const IBlend* pBlend) override { mNDrawCalls++; }
+  void FillConvexPolygon(const IColor& color, float* x, float* y, int nPoints, const IBlend* pBlend) override { mNDrawCalls++; }
+
+  IColor GetPoint(int x, int y) override { return COLOR_TRANSPARENT; }
+  void* GetDrawContext() override { return nullptr; }
+  const char* GetDrawingAPIStr() override { return "NULL"; }
+  bool BitmapExtSupported(const char* ext) override { return false; }
+
+  /** @return The number of draw calls made since the last call */
+  int TakeNDrawCalls() { const int n = mNDrawCalls; mNDrawCalls = 0; return n; }
+
+protected:
+  void GetLayerBitmapData(const ILayerPtr& layer, RawBitmapData& data) override {}
+  void ApplyShadowMask(ILayerPtr& layer, RawBitmapData& mask, const IShadow& shadow) override {}
+
+  APIBitmap* LoadAPIBitmap(const char* fileNameOrResID, int scale, EResourceLocation location, const char* ext) override { return nullptr; }
+  APIBitmap* CreateAPIBitmap(int width, int height, int scale, double drawScale) override { return new APIBitmap(BitmapData(), width, height, scale, static_cast<float>(drawScale)); }
+  bool LoadAPIFont(const char* fontID, const PlatformFontPtr& font) override { return false; }
+  int AlphaChannel() const override { return 3; }
+  bool FlippedBitmap() const override { return false; }
+  float DoMeasureText(const IText& text, const char* str, IRECT& bounds) const override { return bounds.W(); }
+  void DoDrawText(const IText& text, const char* str, const IRECT& bounds, const IBlend* pBlend) override { mNDrawCalls++; }
+  float GetBackingPixelScale() const override { return static_cast<float>(GetScreenScale()); }
+
+private:
+  void PrepareRegion(const IRECT& bounds) override {}
+
+  int mNDrawCalls = 0;
+};
+
+/** A platform without a window, which records the rate the frame rate policy asks for instead of running a timer. The caller drives the draw loop
+ * @tparam DrawClass The drawing class, NullDrawing or one of the IGraphics drawing classes */
+template <class DrawClass>
+class HeadlessGraphics final : public DrawClass
+{
+public:
+  HeadlessGraphics(IGEditorDelegate& dlg, int w, int h, int fps = 0, float scale = 1.f)
+  : DrawClass(dlg, w, h, fps, scale)
+  {
+    mTimerFPS = this->FPS();
+  }
+
+  /** Draws what is dirty, as a platform timer tick does, see IGraphicsWin::OnDisplayTimer()
+   * @return \c true if anything was drawn */
+  bool Tick()
+  {
+    IRECTList rects;
+
+    if (!this->IsDirty(rects))
+      return false;
+
+    this->SetAllControlsClean();
+    this->Draw(rects);
+    return true;
+  }
+
+  /** @return The rate last set through PlatformSetFrameRate(), 0 if the timer would be stopped */
+  int GetTimerFPS() const { return mTimerFPS; }
+
+  /** @return The number of times the frame rate policy has changed the timer rate */
+  int NTimerChanges() const { return mNTimerChanges; }
+
+  void GetMouseLocation(float& x, float& y) const override { x = y = 0.f; }
+  void HideMouseCursor(bool hide, bool lock) override {}
+  void MoveMouseCursor(float x, float y) override {}
+  void ForceEndUserEdit() override {}
+  void* OpenWindow(void* pParentWnd) override { return nullptr; }
+  void CloseWindow() override {}
+  void* GetWindow() override { return nullptr; }
+  bool GetTextFromClipboard(WDL_String& str) override { return false; }
+  bool SetTextInClipboard(const char* str) override { return false; }
+  void UpdateTooltips() override {}
+  EMsgBoxResult ShowMessageBox(const char* str, const char* caption, EMsgBoxType type, IMsgBoxCompletionHanderFunc completionHandler) override { return kOK; }
+  void PromptForFile(WDL_String& fileName, WDL_String& path, EFileAction action, const char* extensions) override {}
+  void PromptForDirectory(WDL_String& dir) override {}
+  bool PromptForColor(IColor& color, const char* str, IColorPickerHandlerFunc func) override { return false; }
+  bool OpenURL(const char* url, const char* msgWindowTitle, const char* confirmMsg, const char* errMsgOnFailure) override { return false; }
+  PlatformFontPtr LoadPlatformFont(const char* fontID, const char* fileNameOrResID) override { return nullptr; }
+  PlatformFontPtr LoadPlatformFont(const char* fontID, const char* fontName, ETextStyle style) override { return nullptr; }
+  void CachePlatformFont(const char* fontID, const PlatformFontPtr& font) override {}
+
+protected:
+  void CreatePlatformTextEntry(int paramIdx, const IText& text, const IRECT& bounds, int length, const char* str) override {}
+  IPopupMenu* CreatePlatformPopupMenu(IPopupMenu& menu, const IRECT& bounds, bool& isAsync) override { return nullptr; }
+
+private:
+  void PlatformSetFrameRate(int fps) override
+  {
+    mTimerFPS = fps;
+    mNTimerChanges++;
+  }
+
+  int mTimerFPS;
+  int mNTimerChanges = 0;
+};
@@ -0,0 +1,171 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+// Stress tests IPlugMessageChannel with an editor thread and a processor thread. The editor sends messages of random sizes as fast as it can,
+// the processor checks every payload and keeps some of them for a few blocks before handing them back, as a plug-in swapping in a wavetable would.
+// Checks that nothing is lost, reordered or corrupted, that the processor side never allocates and that the pool stays bounded.
+// Run with CXXFLAGS="-O1 -g -fsanitize=thread" to check the synchronisation as well
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "IPlugMessageChannel.h"
+
+#include "CommandLineTest.h"
+
+using namespace iplug;
+
+static constexpr int kMaxMessages = 64;
+static constexpr size_t kMaxPoolBytes = 1024 * 1024;
+static constexpr int kMaxDataSize = 64 * 1024;
+static constexpr int kNMessages = 200000;
+static constexpr int kMaxKept = 8;
+
+// Counts the allocations made on the processor thread, which must stay zero
+static thread_local bool tIsProcessor = false;
+static std::atomic<int> sNProcessorAllocations {0};
+
+// Out of line, so that the compiler doesn't pair the malloc() and free() with the new and delete expressions they replace
+__attribute__((noinline)) static void* CountedAlloc(size_t size)
+{
+  if (tIsProcessor)
+    sNProcessorAllocations++;
+
+  return malloc(size ? size : 1);
+}
+
+__attribute__((noinline)) static void CountedFree(void* p)
+{
+  free(p);
+}
+
+void* operator new(size_t size)
+{
+  if (void* p = CountedAlloc(size))
+    return p;
+
+  throw std::bad_alloc();
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept { return CountedAlloc(size); }
+void operator delete(void* p) noexcept { CountedFree(p); }
+void operator delete(void* p, size_t) noexcept { CountedFree(p); }
+void operator delete(void* p, const std::nothrow_t&) noexcept { CountedFree(p); }
+
+/** The byte at index i of the payload of message number seq */
+static uint8_t PayloadByte(int seq, int i)
+{
+  return static_cast<uint8_t>(seq * 31 + i);
+}
+
+int main()
+{
+  IPlugMessageChannel channel(kMaxMessages, kMaxPoolBytes);
+  std::atomic<bool> editorDone {false};
+  int nSent = 0, nReceived = 0, nOutOfOrder = 0, nCorrupt = 0, maxKept = 0;
+  size_t maxPoolBytes = 0;
+
+  std::thread processor([&]() {
+    std::vector<IPlugMessage*> kept;
+    kept.reserve(kMaxKept);
+    std::mt19937 rng(2);
+    int expectedSeq = 0;
+    tIsProcessor = true;
+
+    // Each iteration is one block: return the messages kept long enough, then receive everything queued
+    while (true)
+    {
+      const bool wasDone = editorDone.load(std::memory_order_acquire);
+
+      while (!kept.empty() && (wasDone || rng() % 4 == 0))
+      {
+        channel.Return(kept.back());
+        kept.pop_back();
+      }
+
+      while (IPlugMessage* pMsg = channel.Receive())
+      {
+        const int seq = pMsg->mMsgTag;
+        const uint8_t* pData = static_cast<const uint8_t*>(pMsg->GetData());
+
+        if (seq != expectedSeq || pMsg->mCtrlTag != pMsg->mDataSize)
+          nOutOfOrder++;
+
+        expectedSeq = seq + 1;
+
+        for (auto i = 0; i < pMsg->mDataSize; i++)
+        {
+          if (pData[i] != PayloadByte(seq, i))
+          {
+            nCorrupt++;
+            break;
+          }
+        }
+
+        nReceived++;
+
+        if (!wasDone && kept.size() < kMaxKept && rng() % 8 == 0)
+          kept.push_back(pMsg);
+        else
+          channel.Return(pMsg);
+      }
+
+      maxKept = std::max(maxKept, static_cast<int>(kept.size()));
+
+      if (wasDone && kept.empty())
+        break;
+
+      std::this_thread::yield();
+    }
+  });
+
+  std::mt19937 rng(1);
+  std::vector<uint8_t> payload(kMaxDataSize);
+
+  const auto start = std::chrono::high_resolution_clock::now();
+
+  for (auto seq = 0; seq < kNMessages; seq++)
+  {
+    // Mostly small messages, with the occasional large one
+    const int dataSize = rng() % 16 ? static_cast<int>(rng() % 256) : static_cast<int>(rng() % kMaxDataSize);
+
+    for (auto i = 0; i < dataSize; i++)
+      payload[i] = PayloadByte(seq, i);
+
+    // The tags carry the sequence number and size, so the processor can check them
+    while (!channel.Send(seq, dataSize, dataSize, payload.data()))
+      std::this_thread::yield(); // all kMaxMessages are outstanding, wait for the processor to hand some back
+
+    nSent++;
+    maxPoolBytes = std::max(maxPoolBytes, channel.GetPoolBytes());
+  }
+
+  editorDone.store(true, std::memory_order_release);
+  processor.join();
+  const double time = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+  channel.Collect();
+
+  printf("%i messages sent, %i dropped while the channel was full, at most %i kept by the processor, pool at most %zu bytes\n",
+         nSent, channel.NDropped(), maxKept, maxPoolBytes);
+  printf("  %.0f messages per second\n", nSent / time);
+
+  CHECK(nReceived == kNMessages);
+  CHECK(nOutOfOrder == 0);
+  CHECK(nCorrupt == 0);
+  CHECK(sNProcessorAllocations == 0);
+  CHECK(maxPoolBytes <= kMaxPoolBytes);
+  CHECK(channel.GetPoolBytes() <= kMaxPoolBytes);
+
+  return TestResult("MessageChannelTest");
+}
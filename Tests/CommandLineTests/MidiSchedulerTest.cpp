@@ -0,0 +1,251 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+// Checks the ordering and carry-over of IMidiScheduler, then compares it with IMidiQueue and times MidiSynth on a dense MPE stream,
+// where the 15 member channels of an MPE zone each send pitch bend, channel pressure and CC74 every 4 frames
+
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "IPlugMidi.h"
+#include "MidiSynth.h"
+
+#include "CommandLineTest.h"
+
+using namespace iplug;
+
+static constexpr int kBlockSize = 512;
+static constexpr int kNMemberChannels = 15;
+static constexpr int kControlInterval = 4;
+static constexpr int kNRuns = 200;
+
+class TestVoice : public SynthVoice
+{
+public:
+  bool GetBusy() const override { return mBusy; }
+  void Trigger(double level, bool isRetrigger) override { mTriggers.push_back(static_cast<int>(mLastTriggeredTime)); mBusy = true; }
+  void Release() override { mBusy = false; }
+
+  void ProcessSamplesAccumulating(sample** inputs, sample** outputs, int nInputs, int nOutputs, int startIdx, int nFrames) override
+  {
+    for (auto s = startIdx; s < startIdx + nFrames; s++)
+      outputs[0][s] += mInputs[kVoiceControlPitchBend].endValue;
+  }
+
+  static std::vector<int> mTriggers;
+
+private:
+  bool mBusy = false;
+};
+
+std::vector<int> TestVoice::mTriggers;
+
+static void TestOrdering()
+{
+  IMidiScheduler scheduler(16, 8);
+  IMidiMsg msg {};
+
+  // messages at the same offset keep the order they were added in
+  const int offsets[] = {5, 2, 5, 40, 14};
+
+  for (auto i = 0; i < 5; i++)
+  {
+    msg.mOffset = offsets[i];
+    msg.mData1 = i + 1;
+    scheduler.Add(msg);
+  }
+
+  const int order[] = {2, 1, 3};
+
+  for (auto i = 0; i < 3; i++)
+  {
+    CHECK(scheduler.Peek().mData1 == order[i]);
+    scheduler.Remove();
+  }
+
+  // messages beyond the block move forward when it is flushed
+  CHECK(scheduler.NextOffset() == 14);
+  scheduler.Flush(10);
+  CHECK(scheduler.NextOffset() == 4 && scheduler.Peek().mData1 == 5);
+  scheduler.Remove();
+  CHECK(scheduler.NextOffset() == IMidiScheduler::kNoMessage && !scheduler.Empty());
+
+  scheduler.Flush(10);
+  scheduler.Flush(10);
+  CHECK(scheduler.NextOffset() == 10 && scheduler.Peek().mData1 == 4 && scheduler.Peek().mOffset == 10);
+  scheduler.Remove();
+  CHECK(scheduler.Empty());
+
+  // a full pool drops messages rather than allocating
+  for (auto i = 0; i < 10; i++)
+    scheduler.Add(msg);
+
+  CHECK(scheduler.NDropped() == 2 && scheduler.ToDo() == 8);
+
+  // offsets in every word of the occupancy bitmap, including the top bit of each word
+  IMidiScheduler wide(kBlockSize, 64);
+  const int wideOffsets[] = {511, 0, 63, 64, 127, 128, 300, 1};
+
+  for (auto offset : wideOffsets)
+  {
+    msg.mOffset = offset;
+    wide.Add(msg);
+  }
+
+  int last = -1, count = 0;
+
+  while (wide.NextOffset() != IMidiScheduler::kNoMessage)
+  {
+    CHECK(wide.Peek().mOffset > last);
+    last = wide.Peek().mOffset;
+    wide.Remove();
+    count++;
+  }
+
+  CHECK(count == 8 && last == 511);
+}
+
+static void TestSynthTriggers()
+{
+  MidiSynth synth(VoiceAllocator::kPolyModePoly);
+
+  for (auto v = 0; v < 4; v++)
+    synth.AddVoice(new TestVoice, 0);
+
+  synth.SetSampleRateAndBlockSize(48000., kBlockSize);
+
+  sample buffers[2][kBlockSize] = {};
+  sample* outputs[2] = {buffers[0], buffers[1]};
+  const int offsets[] = {37, 301, 600};
+  IMidiMsg msg;
+
+  for (auto offset : offsets)
+  {
+    msg.MakeNoteOnMsg(60, 100, offset);
+    synth.AddMidiMsgToQueue(msg);
+  }
+
+  TestVoice::mTriggers.clear();
+  synth.ProcessBlock(nullptr, outputs, 0, 2, kBlockSize);
+  synth.ProcessBlock(nullptr, outputs, 0, 2, kBlockSize);
+
+  // 600 is in the second block, which starts at 512
+  CHECK(TestVoice::mTriggers.size() == 3);
+
+  for (auto i = 0; i < static_cast<int>(TestVoice::mTriggers.size()) && i < 3; i++)
+    CHECK(TestVoice::mTriggers[i] == offsets[i]);
+}
+
+static std::vector<IMidiMsg> MakeDenseMPEBlock()
+{
+  // each channel's stream is added in turn, so the block as a whole is out of order, as when several sources are merged
+  std::vector<IMidiMsg> msgs;
+  IMidiMsg msg;
+
+  for (auto c = 1; c <= kNMemberChannels; c++)
+  {
+    for (auto s = 0; s < kBlockSize; s += kControlInterval)
+    {
+      msg.MakePitchWheelMsg(0.1, c, s);
+      msgs.push_back(msg);
+      msg.MakeChannelATMsg(64, s, c);
+      msgs.push_back(msg);
+      msg.MakeControlChangeMsg(IMidiMsg::kCutoffFrequency, 0.5, c, s);
+      msgs.push_back(msg);
+    }
+  }
+
+  return msgs;
+}
+
+static void BenchmarkDenseMPE()
+{
+  const std::vector<IMidiMsg> msgs = MakeDenseMPEBlock();
+  const int nMsgs = static_cast<int>(msgs.size());
+  IMidiQueue queue(nMsgs);
+  IMidiScheduler scheduler(kBlockSize, nMsgs);
+  volatile int sink = 0;
+  bool queueOrdered = true, schedulerOrdered = true;
+
+  const double queueTime = TimeMicroseconds(kNRuns, [&]() {
+    for (auto& msg : msgs)
+      queue.Add(msg);
+
+    int last = 0;
+
+    while (!queue.Empty())
+    {
+      queueOrdered &= queue.Peek().mOffset >= last;
+      last = queue.Peek().mOffset;
+      sink += queue.Peek().mData2;
+      queue.Remove();
+    }
+
+    queue.Flush(kBlockSize);
+  });
+
+  const double schedulerTime = TimeMicroseconds(kNRuns, [&]() {
+    for (auto& msg : msgs)
+      scheduler.Add(msg);
+
+    int last = 0;
+
+    while (scheduler.NextOffset() != IMidiScheduler::kNoMessage)
+    {
+      schedulerOrdered &= scheduler.Peek().mOffset >= last;
+      last = scheduler.Peek().mOffset;
+      sink += scheduler.Peek().mData2;
+      scheduler.Remove();
+    }
+
+    scheduler.Flush(kBlockSize);
+  });
+
+  CHECK(queueOrdered && schedulerOrdered);
+  printf("dense MPE, %i messages per %i frame block\n", nMsgs, kBlockSize);
+  printf("  IMidiQueue      %8.1f us per block, %6.1f ns per message\n", queueTime, queueTime * 1000. / nMsgs);
+  printf("  IMidiScheduler  %8.1f us per block, %6.1f ns per message\n", schedulerTime, schedulerTime * 1000. / nMsgs);
+
+  MidiSynth synth(VoiceAllocator::kPolyModePoly);
+
+  for (auto v = 0; v < 32; v++)
+    synth.AddVoice(new TestVoice, 0);
+
+  synth.SetSampleRateAndBlockSize(48000., kBlockSize);
+  synth.InitBasicMPE();
+
+  sample buffers[2][kBlockSize] = {};
+  sample* outputs[2] = {buffers[0], buffers[1]};
+  IMidiMsg msg;
+
+  for (auto c = 1; c <= kNMemberChannels; c++)
+  {
+    msg.MakeNoteOnMsg(48 + c, 100, 0, c);
+    synth.AddMidiMsgToQueue(msg);
+  }
+
+  const double synthTime = TimeMicroseconds(kNRuns, [&]() {
+    for (auto& m : msgs)
+      synth.AddMidiMsgToQueue(m);
+
+    synth.ProcessBlock(nullptr, outputs, 0, 2, kBlockSize);
+  });
+
+  printf("  MidiSynth, 15 voices, split at every message offset: %.1f us per block\n", synthTime);
+}
+
+int main()
+{
+  TestOrdering();
+  TestSynthTriggers();
+  BenchmarkDenseMPE();
+  return TestResult("MidiSchedulerTest");
+}
@@ -0,0 +1,326 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+// Checks NChanDelayLine: the constant delay of ProcessBlock() against the per-sample delay line it replaced, with odd block sizes, in place and across delay changes,
+// and the fractional taps of each interpolation against a delayed sine. Then times the latency compensated bypass against the previous delay line,
+// and Write() followed by ReadTap() with a growing number of modulated taps
+
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include "NChanDelay.h"
+
+#include "CommandLineTest.h"
+
+using namespace iplug;
+
+static constexpr int kNChans = 2;
+static constexpr int kBlockSize = 512;
+static constexpr int kBypassDelay = 1000;
+static constexpr int kNRuns = 2000;
+
+/** The delay line NChanDelayLine replaced, with two modulo operations per sample, kept as the reference */
+template<typename T>
+class OldDelayLine
+{
+public:
+  void SetDelayTime(int delayTimeSamples)
+  {
+    mDTSamples = delayTimeSamples;
+    mBuffer.assign(kNChans * delayTimeSamples, T(0));
+    mWriteAddress = 0;
+  }
+
+  void ProcessBlock(T** inputs, T** outputs, int nFrames)
+  {
+    T* buffer = mBuffer.data();
+
+    for (auto s = 0 ; s < nFrames; ++s)
+    {
+      int32_t readAddress = mWriteAddress - mDTSamples;
+      readAddress %= mDTSamples;
+
+      for (auto c = 0; c < kNChans; c++)
+      {
+        T input = inputs[c][s];
+        const int offset = c * mDTSamples;
+        outputs[c][s] = buffer[offset + readAddress];
+        buffer[offset + mWriteAddress] = input;
+      }
+
+      mWriteAddress++;
+      mWriteAddress %= mDTSamples;
+    }
+  }
+
+private:
+  std::vector<T> mBuffer;
+  uint32_t mWriteAddress = 0;
+  uint32_t mDTSamples = 0;
+};
+
+/** The input sample at a frame, different for every channel */
+static float Input(int64_t frame, int chan)
+{
+  return static_cast<float>(((frame * 7 + chan * 13) % 1001) - 500);
+}
+
+/** Runs a constant delay over blocks of random sizes, in place or not, and checks every output sample */
+static void TestConstantDelay(int delay, bool inPlace)
+{
+  NChanDelayLine<float> delayLine(kNChans, kNChans);
+  delayLine.SetDelayTime(delay);
+
+  std::mt19937 rng(delay);
+  std::vector<float> in(kNChans * kBlockSize), out(kNChans * kBlockSize);
+  float* inputs[kNChans] = { in.data(), in.data() + kBlockSize };
+  float* outputs[kNChans] = { out.data(), out.data() + kBlockSize };
+  int64_t frame = 0;
+  int nErrors = 0;
+
+  for (auto b = 0; b < 200; b++)
+  {
+    const int n = 1 + rng() % kBlockSize;
+
+    for (auto c = 0; c < kNChans; c++)
+    {
+      for (auto s = 0; s < n; s++)
+        inputs[c][s] = Input(frame + s, c);
+    }
+
+    delayLine.ProcessBlock(inputs, inPlace ? inputs : outputs, n);
+
+    for (auto c = 0; c < kNChans; c++)
+    {
+      for (auto s = 0; s < n; s++)
+      {
+        const int64_t src = frame + s - delay;
+
+        if ((inPlace ? inputs : outputs)[c][s] != (src >= 0 ? Input(src, c) : 0.f))
+          nErrors++;
+      }
+    }
+
+    frame += n;
+  }
+
+  CHECK(nErrors == 0);
+}
+
+/** Shortening and lengthening the delay within the maximum keeps the history, so the output jumps to the new delay straight away */
+static void TestDelayChange()
+{
+  NChanDelayLine<float> delayLine(kNChans, kNChans);
+  delayLine.SetMaxDelayTime(2000);
+  delayLine.SetDelayTime(1500);
+
+  std::vector<float> in(kNChans * kBlockSize), out(kNChans * kBlockSize);
+  float* inputs[kNChans] = { in.data(), in.data() + kBlockSize };
+  float* outputs[kNChans] = { out.data(), out.data() + kBlockSize };
+  const int delays[] = { 1500, 200, 1999, 0, 700 };
+  int64_t frame = 0;
+  int nErrors = 0;
+
+  for (auto b = 0; b < 50; b++)
+  {
+    const int delay = delays[(b / 10) % 5];
+    delayLine.SetDelayTime(delay);
+
+    for (auto c = 0; c < kNChans; c++)
+    {
+      for (auto s = 0; s < kBlockSize; s++)
+        inputs[c][s] = Input(frame + s, c);
+    }
+
+    delayLine.ProcessBlock(inputs, outputs, kBlockSize);
+
+    for (auto c = 0; c < kNChans; c++)
+    {
+      for (auto s = 0; s < kBlockSize; s++)
+      {
+        const int64_t src = frame + s - delay;
+
+        if (outputs[c][s] != (src >= 0 ? Input(src, c) : 0.f))
+          nErrors++;
+      }
+    }
+
+    frame += kBlockSize;
+  }
+
+  CHECK(nErrors == 0);
+  CHECK(delayLine.GetDelayTime() == delays[4]);
+}
+
+/** Reads a low frequency sine through a tap with a modulated fractional delay
+ * @return The largest error against the sine evaluated at the delayed time */
+template <EDelayInterp INTERP>
+static double MaxModulatedError(double minDelay)
+{
+  const double freq = 0.01; // cycles per sample
+  const int maxDelay = 64;
+  NChanDelayLine<double> delayLine(1, 1);
+  delayLine.SetMaxDelayTime(maxDelay, kBlockSize);
+
+  std::vector<double> in(kBlockSize), delays(kBlockSize), out(kBlockSize);
+  double* inputs[1] = { in.data() };
+  NChanDelayLine<double>::DelayTap tap;
+  double maxError = 0.;
+  int64_t frame = 0;
+
+  for (auto b = 0; b < 20; b++)
+  {
+    for (auto s = 0; s < kBlockSize; s++)
+    {
+      const int64_t t = frame + s;
+      in[s] = std::sin(2. * PI * freq * t);
+      delays[s] = minDelay + 20. + 15. * std::sin(2. * PI * 0.0003 * t); // a slow chorus sweep
+    }
+
+    delayLine.Write(inputs, kBlockSize);
+    delayLine.ReadTap<INTERP>(0, delays.data(), out.data(), kBlockSize, tap);
+
+    // skip the first block, where the delay reaches back before the input started
+    if (b > 0)
+    {
+      for (auto s = 0; s < kBlockSize; s++)
+        maxError = std::max(maxError, std::fabs(out[s] - std::sin(2. * PI * freq * (frame + s - delays[s]))));
+    }
+
+    frame += kBlockSize;
+  }
+
+  return maxError;
+}
+
+static void TestFractionalTaps()
+{
+  const double linear = MaxModulatedError<EDelayInterp::Linear>(0.);
+  const double lagrange = MaxModulatedError<EDelayInterp::Lagrange3>(1.);
+  const double allpass = MaxModulatedError<EDelayInterp::Allpass>(0.5);
+
+  printf("Modulated tap, max error on a 0.01 cycles/sample sine: linear %.2e, Lagrange %.2e, allpass %.2e\n", linear, lagrange, allpass);
+
+  // 3rd order Lagrange is far more accurate than linear interpolation. The allpass is exact in phase only at low frequencies
+  CHECK(linear < 1e-3);
+  CHECK(lagrange < 1e-5);
+  CHECK(lagrange < linear);
+  CHECK(allpass < 2e-3);
+
+  // A constant whole delay is a plain copy, and agrees with the constant delay of ProcessBlock()
+  NChanDelayLine<float> delayLine(1, 1);
+  delayLine.SetMaxDelayTime(100, kBlockSize);
+  std::vector<float> in(kBlockSize), out(kBlockSize);
+  float* inputs[1] = { in.data() };
+  NChanDelayLine<float>::DelayTap tap;
+  int nErrors = 0;
+
+  for (auto b = 0; b < 4; b++)
+  {
+    for (auto s = 0; s < kBlockSize; s++)
+      in[s] = Input(b * kBlockSize + s, 0);
+
+    delayLine.Write(inputs, kBlockSize);
+    delayLine.ReadTap<EDelayInterp::Lagrange3>(0, 37.f, out.data(), kBlockSize, tap);
+
+    for (auto s = 0; s < kBlockSize; s++)
+    {
+      const int src = b * kBlockSize + s - 37;
+      nErrors += out[s] != (src >= 0 ? Input(src, 0) : 0.f);
+    }
+  }
+
+  CHECK(nErrors == 0);
+}
+
+static void BenchmarkBypass()
+{
+  std::vector<float> in(kNChans * kBlockSize), out(kNChans * kBlockSize);
+  float* inputs[kNChans] = { in.data(), in.data() + kBlockSize };
+  float* outputs[kNChans] = { out.data(), out.data() + kBlockSize };
+
+  for (auto i = 0; i < kNChans * kBlockSize; i++)
+    in[i] = Input(i, 0);
+
+  OldDelayLine<float> oldDelay;
+  oldDelay.SetDelayTime(kBypassDelay);
+  NChanDelayLine<float> newDelay(kNChans, kNChans);
+  newDelay.SetDelayTime(kBypassDelay);
+
+  const double oldTime = TimeMicroseconds(kNRuns, [&]() { oldDelay.ProcessBlock(inputs, outputs, kBlockSize); });
+  const double newTime = TimeMicroseconds(kNRuns, [&]() { newDelay.ProcessBlock(inputs, outputs, kBlockSize); });
+
+  printf("Bypass delay of %i samples, %i channels, %i frame blocks\n", kBypassDelay, kNChans, kBlockSize);
+  printf("  %-8s %8.1f M frames/s\n", "previous", kBlockSize / oldTime);
+  printf("  %-8s %8.1f M frames/s\n", "masked", kBlockSize / newTime);
+}
+
+template <EDelayInterp INTERP>
+static void BenchmarkTaps(const char* name)
+{
+  const int tapCounts[] = { 1, 4, 16, 64 };
+  NChanDelayLine<float> delayLine(1, 1);
+  delayLine.SetMaxDelayTime(4800, kBlockSize);
+
+  std::vector<float> in(kBlockSize), out(kBlockSize);
+  float* inputs[1] = { in.data() };
+
+  for (auto s = 0; s < kBlockSize; s++)
+    in[s] = Input(s, 0);
+
+  printf("  %-10s", name);
+
+  for (auto nTaps : tapCounts)
+  {
+    // Each tap sweeps its own modulated delay, as in a diffusion network or a multi-voice chorus
+    std::vector<std::vector<float>> delays(nTaps, std::vector<float>(kBlockSize));
+    std::vector<NChanDelayLine<float>::DelayTap> taps(nTaps);
+
+    for (auto t = 0; t < nTaps; t++)
+    {
+      for (auto s = 0; s < kBlockSize; s++)
+        delays[t][s] = 100.f + 70.f * t + 30.f * std::sin(0.01f * (s + t * 50));
+    }
+
+    const double time = TimeMicroseconds(kNRuns / 10, [&]() {
+      delayLine.Write(inputs, kBlockSize);
+
+      for (auto t = 0; t < nTaps; t++)
+        delayLine.ReadTap<INTERP>(0, delays[t].data(), out.data(), kBlockSize, taps[t]);
+    });
+
+    printf(" %8.2f", 1000. * time / (nTaps * kBlockSize));
+  }
+
+  printf("\n");
+}
+
+int main()
+{
+  for (auto delay : { 1, 63, 64, 65, 1000, 4096 })
+  {
+    TestConstantDelay(delay, false);
+    TestConstantDelay(delay, true);
+  }
+
+  TestDelayChange();
+  TestFractionalTaps();
+
+  BenchmarkBypass();
+
+  printf("Modulated taps, ns per tap per sample, for 1, 4, 16 and 64 taps\n");
+  BenchmarkTaps<EDelayInterp::None>("none");
+  BenchmarkTaps<EDelayInterp::Linear>("linear");
+  BenchmarkTaps<EDelayInterp::Lagrange3>("Lagrange3");
+  BenchmarkTaps<EDelayInterp::Allpass>("allpass");
+
+  return TestResult("NChanDelayTest");
+}
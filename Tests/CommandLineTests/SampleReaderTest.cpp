@@ -0,0 +1,334 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+// Writes WAV files of every supported sample format and FLAC files of 8 to 24 bits, one to three channels, fixed and variable block sizes,
+// next to the test binary, then checks that ISampleReader decodes every frame of them exactly as written: read from the start in chunks,
+// at random positions, backwards, and past the end. The FLAC writer in AudioFileWriters.h cycles through the subframe types, fixed and LPC predictors,
+// residual codings and stereo channel assignments, so each file covers all of the decoder. Then checks that damaged files are refused
+
+#include <cmath>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "SampleReader.h"
+
+#include "AudioFileWriters.h"
+#include "CommandLineTest.h"
+
+using namespace iplug;
+
+static constexpr int kSampleRate = 44100;
+static constexpr int kNFrames = 50000;
+static constexpr int kChunkSize = 1000;
+static constexpr int kNRandomReads = 300;
+
+/** An integer signal of bitsPerSample bits: silence and a constant, for constant subframes, a sine with noise, a stretch of multiples of 4,
+ * for wasted bits, and the most negative and positive values */
+static AudioChannels MakeSignal(int nChans, int bitsPerSample, uint32_t seed)
+{
+  const int64_t maxValue = (1ll << (bitsPerSample - 1)) - 1;
+  std::mt19937 rng(seed);
+  AudioChannels chans(nChans, std::vector<int32_t>(kNFrames));
+
+  for (auto c = 0; c < nChans; c++)
+  {
+    for (auto i = 0; i < kNFrames; i++)
+    {
+      int64_t v;
+
+      if (i < 5000)
+        v = 0;
+      else if (i < 10000)
+        v = maxValue / 3 - c;
+      else if (i >= 40000 && i < 40100)
+        v = (i & 1) ? maxValue : -maxValue - 1;
+      else
+      {
+        const double sine = 0.8 * std::sin(0.013 * i * (c + 1)) + 0.1 * std::sin(0.31 * i);
+        v = static_cast<int64_t>(std::lround(sine * maxValue)) + static_cast<int64_t>(rng() % 33) - 16;
+        v = std::max(-maxValue - 1, std::min(maxValue, v));
+
+        if (i >= 20000 && i < 26000 && bitsPerSample > 4)
+          v = std::max(-maxValue - 1, (v / 4) * 4);
+      }
+
+      chans[c][i] = static_cast<int32_t>(v);
+    }
+  }
+
+  return chans;
+}
+
+/** Reads the file as a whole, in random ranges and backwards, and checks every sample against the expected floats */
+static void CheckReader(const char* name, const char* path, const std::vector<std::vector<float>>& expected, int bitsPerSample)
+{
+  auto pReader = ISampleReader::Open(path);
+  CHECK(pReader != nullptr);
+
+  if (!pReader)
+  {
+    printf("  %-34s couldn't be opened\n", name);
+    return;
+  }
+
+  const int nChans = static_cast<int>(expected.size());
+  CHECK(pReader->NChans() == nChans);
+  CHECK(pReader->NFrames() == kNFrames);
+  CHECK(pReader->GetSampleRate() == kSampleRate);
+  CHECK(pReader->GetBitsPerSample() == bitsPerSample);
+
+  if (pReader->NChans() != nChans)
+    return;
+
+  std::vector<std::vector<float>> buffers(nChans, std::vector<float>(kNFrames));
+  std::vector<float*> ptrs(nChans);
+  int nErrors = 0, nShortReads = 0;
+
+  auto read = [&](int64_t start, int nFrames) {
+    for (auto c = 0; c < nChans; c++)
+      ptrs[c] = buffers[c].data();
+
+    const int expectedFrames = static_cast<int>(std::max<int64_t>(0, std::min<int64_t>(nFrames, kNFrames - start)));
+    const int n = pReader->Read(start, ptrs.data(), nFrames);
+
+    nShortReads += n != expectedFrames;
+
+    for (auto c = 0; c < nChans; c++)
+    {
+      for (auto i = 0; i < std::min(n, expectedFrames); i++)
+        nErrors += buffers[c][i] != expected[c][start + i];
+    }
+  };
+
+  const auto start = std::chrono::high_resolution_clock::now();
+
+  for (auto pos = 0; pos < kNFrames; pos += kChunkSize)
+    read(pos, kChunkSize);
+
+  const double time = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+
+  std::mt19937 rng(7);
+
+  for (auto r = 0; r < kNRandomReads; r++)
+    read(rng() % kNFrames, 1 + rng() % 5000);
+
+  for (auto pos = kNFrames - 777; pos > -777; pos -= 777)
+    read(std::max(pos, 0), 777);
+
+  read(kNFrames - 10, 100); // ends early
+  read(kNFrames, 100); // nothing left
+
+  printf("  %-34s %s, %5.0f M frames/s\n", name, nErrors || nShortReads ? "FAILED" : "ok", kNFrames / time / 1e6);
+
+  CHECK(nErrors == 0);
+  CHECK(nShortReads == 0);
+}
+
+/** The floats the readers should return for integer samples, which they scale by 1 / 2^(bitsPerSample - 1) */
+static std::vector<std::vector<float>> ToFloat(const AudioChannels& chans, int bitsPerSample)
+{
+  const float scale = 1.f / static_cast<float>(1ll << (bitsPerSample - 1));
+  std::vector<std::vector<float>> result;
+
+  for (const auto& chan : chans)
+  {
+    result.emplace_back();
+
+    for (auto v : chan)
+      result.back().push_back(static_cast<float>(v) * scale);
+  }
+
+  return result;
+}
+
+static void TestWAV(const std::string& dir)
+{
+  printf("WAV\n");
+
+  const std::string path = dir + "SampleReaderTest.wav";
+
+  for (auto bps : { 8, 16, 24, 32 })
+  {
+    for (auto extensible : { false, true })
+    {
+      const AudioChannels chans = MakeSignal(2, bps, bps);
+      CHECK(WriteWAV(path.c_str(), chans, bps, kSampleRate, extensible));
+
+      const std::string name = std::to_string(bps) + " bit" + (extensible ? " extensible" : "");
+      CheckReader(name.c_str(), path.c_str(), ToFloat(chans, bps), bps);
+    }
+  }
+
+  for (auto bps : { 32, 64 })
+  {
+    for (auto extensible : { false, true })
+    {
+      // Outside -1 to 1 as well, float files are read as they are
+      std::mt19937 rng(bps);
+      std::uniform_real_distribution<double> dist(-1.5, 1.5);
+      std::vector<std::vector<double>> chans(3, std::vector<double>(kNFrames));
+      std::vector<std::vector<float>> expected(3, std::vector<float>(kNFrames));
+
+      for (auto c = 0; c < 3; c++)
+      {
+        for (auto i = 0; i < kNFrames; i++)
+        {
+          chans[c][i] = dist(rng);
+          expected[c][i] = static_cast<float>(chans[c][i]);
+        }
+      }
+
+      CHECK(WriteFloatWAV(path.c_str(), chans, bps, kSampleRate, extensible));
+
+      const std::string name = std::to_string(bps) + " bit float, 3 channels" + (extensible ? ", extensible" : "");
+      CheckReader(name.c_str(), path.c_str(), expected, bps);
+    }
+  }
+
+  remove(path.c_str());
+}
+
+static void TestFLAC(const std::string& dir)
+{
+  struct FLACFile
+  {
+    int mNChans;
+    int mBitsPerSample;
+    int mBlockSize;
+    bool mVariable;
+  };
+
+  // The block sizes are a standard one, a multiple of 576, and ones stored in 8 and in 16 bits after the header
+  const FLACFile files[] = {
+    { 2, 16, 4096, false },
+    { 2, 24, 1152, false },
+    { 1, 8, 1000, false },
+    { 3, 12, 1000, false },
+    { 2, 20, 200, false },
+    { 1, 4, 576, false },
+    { 2, 16, 4608, true },
+    { 2, 24, 300, true },
+  };
+
+  printf("FLAC\n");
+
+  const std::string path = dir + "SampleReaderTest.flac";
+  uint32_t seed = 1;
+
+  for (const auto& file : files)
+  {
+    const AudioChannels chans = MakeSignal(file.mNChans, file.mBitsPerSample, seed);
+    FLACWriterOptions options;
+    options.mBlockSize = file.mBlockSize;
+    options.mVariableBlockSize = file.mVariable;
+    options.mSeed = seed++;
+    CHECK(WriteFLAC(path.c_str(), chans, file.mBitsPerSample, kSampleRate, options));
+
+    char name[64];
+    snprintf(name, sizeof(name), "%i bit, %i channels, %s blocks of %i", file.mBitsPerSample, file.mNChans, file.mVariable ? "variable" : "fixed", file.mBlockSize);
+    CheckReader(name, path.c_str(), ToFloat(chans, file.mBitsPerSample), file.mBitsPerSample);
+  }
+
+  remove(path.c_str());
+}
+
+/** Truncated and corrupted files are refused, or read short, but never crash or return wrong samples */
+static void TestDamagedFiles(const std::string& dir)
+{
+  const std::string path = dir + "SampleReaderTest.flac";
+  const AudioChannels chans = MakeSignal(2, 16, 99);
+  const auto expected = ToFloat(chans, 16);
+  CHECK(WriteFLAC(path.c_str(), chans, 16, kSampleRate));
+
+  std::vector<uint8_t> file;
+
+  if (FILE* pFile = fopen(path.c_str(), "rb"))
+  {
+    uint8_t buf[4096];
+
+    for (size_t n; (n = fread(buf, 1, sizeof(buf), pFile)) > 0;)
+      file.insert(file.end(), buf, buf + n);
+
+    fclose(pFile);
+  }
+
+  auto writeBytes = [&](const std::vector<uint8_t>& bytes) {
+    FILE* pFile = fopen(path.c_str(), "wb");
+    fwrite(bytes.data(), 1, bytes.size(), pFile);
+    fclose(pFile);
+  };
+
+  // Headers cut short are refused
+  for (auto size : { 0, 3, 12, 30, 41 })
+  {
+    writeBytes(std::vector<uint8_t>(file.begin(), file.begin() + size));
+    CHECK(ISampleReader::Open(path.c_str()) == nullptr);
+  }
+
+  // A file cut in the middle reads what is there, and stops where the frames stop
+  writeBytes(std::vector<uint8_t>(file.begin(), file.begin() + file.size() / 2));
+
+  if (auto pReader = ISampleReader::Open(path.c_str()))
+  {
+    std::vector<float> left(kNFrames), right(kNFrames);
+    float* ptrs[2] = { left.data(), right.data() };
+    const int n = pReader->Read(0, ptrs, kNFrames);
+    int nErrors = 0;
+
+    for (auto i = 0; i < n; i++)
+      nErrors += left[i] != expected[0][i] || right[i] != expected[1][i];
+
+    CHECK(n > 0 && n < kNFrames);
+    CHECK(nErrors == 0);
+  }
+  else
+    CHECK(false);
+
+  // Corrupted bytes in the frames fail the CRC, the reader stops there rather than returning noise
+  std::vector<uint8_t> corrupted(file);
+  corrupted[corrupted.size() * 3 / 4] ^= 0x5A;
+  writeBytes(corrupted);
+
+  if (auto pReader = ISampleReader::Open(path.c_str()))
+  {
+    std::vector<float> left(kNFrames), right(kNFrames);
+    float* ptrs[2] = { left.data(), right.data() };
+    const int n = pReader->Read(0, ptrs, kNFrames);
+    int nErrors = 0;
+
+    for (auto i = 0; i < n; i++)
+      nErrors += left[i] != expected[0][i] || right[i] != expected[1][i];
+
+    CHECK(n < kNFrames);
+    CHECK(nErrors == 0);
+  }
+  else
+    CHECK(false);
+
+  // Neither WAV nor FLAC
+  writeBytes(std::vector<uint8_t>(1000, 0x42));
+  CHECK(ISampleReader::Open(path.c_str()) == nullptr);
+
+  remove(path.c_str());
+}
+
+int main(int argc, const char* argv[])
+{
+  // The files go in the folder of the test binary
+  std::string dir(argv[0]);
+  dir.erase(dir.find_last_of('/') + 1);
+
+  TestWAV(dir);
+  TestFLAC(dir);
+  TestDamagedFiles(dir);
+
+  return TestResult("SampleReaderTest");
+}
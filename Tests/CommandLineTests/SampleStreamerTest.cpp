@@ -0,0 +1,302 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+// Writes a set of stereo 16 and 24 bit WAV and 16 bit FLAC files next to the test binary, then checks SampleStreamer in two ways. With the I/O thread stopped,
+// a stream that plays past its preload must fade out over kFadeOutFrames, stay silent but in time, and fade back in once the thread is started.
+// Then many voices, retriggered at random, stream the files in real time while every frame is checked against the file,
+// except for underruns and their fades, and the time Read() takes for all the voices each block is measured.
+// Run with CXXFLAGS="-O1 -g -fsanitize=thread" to check the synchronisation with the I/O thread as well
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "SampleStreamer.h"
+
+#include "AudioFileWriters.h"
+#include "CommandLineTest.h"
+
+using namespace iplug;
+
+static constexpr int kSampleRate = 48000;
+static constexpr int kNFiles = 32;
+static constexpr int kFileFrames = kSampleRate * 2;
+static constexpr int kPreloadFrames = 8192;
+static constexpr int kBlockSize = 256;
+static constexpr int kNVoices = 256;
+static constexpr double kStressTime = 3.;
+
+/** The bit depth of each file: 16 bit WAV, 24 bit WAV, and 16 bit FLAC, which the streamer reads through the same reader interface */
+static int FileBitsPerSample(int file)
+{
+  return file % 4 == 1 ? 24 : 16;
+}
+
+static bool IsFLAC(int file)
+{
+  return file % 4 == 3;
+}
+
+/** The sample at a frame of a file, a pattern that makes any frame, channel or file mix up visible */
+static int32_t SampleValue(int file, int64_t frame, int chan)
+{
+  const int bps = FileBitsPerSample(file);
+  const uint32_t value = static_cast<uint32_t>(file * 7919 + frame * 31 + chan * 12345) << (32 - bps);
+  return static_cast<int32_t>(value) >> (32 - bps);
+}
+
+static float ExpectedValue(int file, int64_t frame, int chan)
+{
+  return static_cast<float>(SampleValue(file, frame, chan)) * (1.f / static_cast<float>(1 << (FileBitsPerSample(file) - 1)));
+}
+
+static bool WriteFile(const char* path, int file, int nFrames)
+{
+  AudioChannels chans(2, std::vector<int32_t>(nFrames));
+
+  for (auto c = 0; c < 2; c++)
+  {
+    for (auto i = 0; i < nFrames; i++)
+      chans[c][i] = SampleValue(file, i, c);
+  }
+
+  if (IsFLAC(file))
+    return WriteFLAC(path, chans, FileBitsPerSample(file), kSampleRate);
+
+  return WriteWAV(path, chans, FileBitsPerSample(file), kSampleRate);
+}
+
+/** Plays the first file past its preload with the I/O thread stopped, so that the stream underruns, then starts the thread and waits for it to recover */
+static void TestUnderrunFades(const char* path)
+{
+  SampleStreamer streamer(1, 4096, 4, 2);
+  const int preload = 1000; // not a multiple of the block size, so the fade out starts mid block
+  const SampleZone* pZone = streamer.AddZone(path, preload);
+  CHECK(pZone != nullptr);
+
+  if (!pZone)
+    return;
+
+  SampleStream* pStream = streamer.StartStream(pZone);
+  std::vector<float> left, right, block(kBlockSize * 2);
+  float* ptrs[2] = { block.data(), block.data() + kBlockSize };
+
+  auto readBlock = [&]() {
+    streamer.ProcessCompletions();
+    CHECK(pStream->Read(ptrs, 2, kBlockSize) == kBlockSize);
+    left.insert(left.end(), ptrs[0], ptrs[0] + kBlockSize);
+    right.insert(right.end(), ptrs[1], ptrs[1] + kBlockSize);
+  };
+
+  for (auto b = 0; b < 8; b++)
+    readBlock();
+
+  // The preload plays exactly, then the last frame ramps down to silence, then silence
+  int nErrors = 0;
+
+  for (auto i = 0; i < static_cast<int>(left.size()); i++)
+  {
+    const float* pOut[2] = { left.data(), right.data() };
+
+    for (auto c = 0; c < 2; c++)
+    {
+      float expected = 0.f;
+
+      if (i < preload)
+        expected = ExpectedValue(0, i, c);
+      else if (i < preload + SampleStreamer::kFadeOutFrames)
+        expected = ExpectedValue(0, preload - 1, c) * static_cast<float>(SampleStreamer::kFadeOutFrames - (i - preload + 1)) / SampleStreamer::kFadeOutFrames;
+
+      if (std::fabs(pOut[c][i] - expected) > 1e-6f)
+        nErrors++;
+    }
+  }
+
+  CHECK(nErrors == 0);
+  CHECK(pStream->NUnderruns() == 1);
+  CHECK(pStream->NUnderrunFrames() == static_cast<int64_t>(left.size()) - preload);
+  CHECK(pStream->GetPosition() == static_cast<int64_t>(left.size()));
+
+  // Once the chunks arrive the stream fades back in at the position it has kept, and then plays exactly
+  streamer.Start();
+  const int64_t underrunFrames = pStream->NUnderrunFrames();
+  int64_t resume = -1;
+
+  for (auto b = 0; b < 1000 && resume < 0; b++)
+  {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    const int64_t start = pStream->GetPosition();
+    readBlock();
+
+    if (pStream->NUnderrunFrames() - underrunFrames < kBlockSize * (b + 1))
+      resume = start + (pStream->NUnderrunFrames() - underrunFrames - kBlockSize * b);
+  }
+
+  CHECK(resume >= 0);
+
+  for (auto b = 0; b < 2; b++)
+    readBlock();
+
+  streamer.Stop();
+  nErrors = 0;
+
+  for (int64_t i = std::max<int64_t>(resume, 0); i < static_cast<int64_t>(left.size()); i++)
+  {
+    const float* pOut[2] = { left.data(), right.data() };
+    const int64_t fadePos = i - resume;
+    const float gain = fadePos < SampleStreamer::kFadeInFrames ? static_cast<float>(fadePos) / SampleStreamer::kFadeInFrames : 1.f;
+
+    for (auto c = 0; c < 2; c++)
+    {
+      if (std::fabs(pOut[c][i] - ExpectedValue(0, i, c) * gain) > 1e-6f)
+        nErrors++;
+    }
+  }
+
+  CHECK(nErrors == 0);
+  CHECK(pStream->NUnderruns() == 1);
+}
+
+/** Streams the files with kNVoices voices in real time, retriggering finished voices and a few others at random, some of them inside the preload */
+static void StressTest(const std::vector<std::string>& paths)
+{
+  SampleStreamer streamer(kNVoices, 4096, 4, 2);
+  std::vector<const SampleZone*> zones;
+
+  for (const auto& path : paths)
+    zones.push_back(streamer.AddZone(path.c_str(), kPreloadFrames));
+
+  CHECK(std::find(zones.begin(), zones.end(), nullptr) == zones.end());
+
+  if (std::find(zones.begin(), zones.end(), nullptr) != zones.end())
+    return;
+
+  struct Voice
+  {
+    SampleStream* mStream = nullptr;
+    int mFile = 0;
+    int64_t mUnderrunFrames = 0;
+    int mNSkip = 0;
+  };
+
+  using Clock = std::chrono::steady_clock;
+  const Clock::duration blockTime = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(static_cast<double>(kBlockSize) / kSampleRate));
+  const int nBlocks = static_cast<int>(kStressTime * kSampleRate / kBlockSize);
+  std::vector<Voice> voices(kNVoices);
+  std::vector<float> block(kBlockSize * 2);
+  float* ptrs[2] = { block.data(), block.data() + kBlockSize };
+  std::vector<double> times;
+  std::mt19937 rng(1);
+  int nStarted = 0, nBlocksChecked = 0, nErrors = 0, nLateBlocks = 0;
+  Clock::time_point next = Clock::now();
+
+  streamer.Start();
+
+  for (auto b = 0; b < nBlocks; b++)
+  {
+    double readTime = 0.;
+    streamer.ProcessCompletions();
+
+    for (auto& voice : voices)
+    {
+      if (!voice.mStream || !voice.mStream->IsPlaying() || rng() % 2000 == 0)
+      {
+        streamer.StopStream(voice.mStream);
+        voice.mFile = rng() % kNFiles;
+        voice.mStream = streamer.StartStream(zones[voice.mFile], rng() % 4 ? 0 : rng() % kPreloadFrames);
+        voice.mUnderrunFrames = 0;
+        voice.mNSkip = 0;
+        nStarted++;
+      }
+
+      const int64_t position = voice.mStream->GetPosition();
+      const auto start = Clock::now();
+      const int n = voice.mStream->Read(ptrs, 2, kBlockSize);
+      readTime += std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+
+      // Blocks with an underrun, and the block after it, which may hold the fade in, aren't the file's frames
+      if (voice.mStream->NUnderrunFrames() != voice.mUnderrunFrames)
+      {
+        voice.mUnderrunFrames = voice.mStream->NUnderrunFrames();
+        voice.mNSkip = 2;
+      }
+
+      if (voice.mNSkip)
+      {
+        voice.mNSkip--;
+        continue;
+      }
+
+      for (auto i = 0; i < n; i++)
+      {
+        for (auto c = 0; c < 2; c++)
+          nErrors += ptrs[c][i] != ExpectedValue(voice.mFile, position + i, c);
+      }
+
+      nBlocksChecked++;
+    }
+
+    times.push_back(readTime);
+    next += blockTime;
+
+    if (Clock::now() > next)
+      nLateBlocks++;
+
+    std::this_thread::sleep_until(next);
+  }
+
+  streamer.Stop();
+  std::sort(times.begin(), times.end());
+
+  double total = 0.;
+
+  for (auto t : times)
+    total += t;
+
+  printf("%i blocks of %i frames, %i voices, %i streams started, %i voice blocks checked\n", nBlocks, kBlockSize, kNVoices, nStarted, nBlocksChecked);
+  printf("  %i underruns, %.1f M frames read, %i late blocks\n", streamer.NUnderruns(), streamer.NFramesRead() / 1000000., nLateBlocks);
+  printf("  Read() of all voices per block: mean %.1f us, 99th percentile %.1f us, block is %.0f us\n",
+         total / times.size(), times[times.size() * 99 / 100], 1000000. * kBlockSize / kSampleRate);
+
+  CHECK(nErrors == 0);
+  CHECK(nBlocksChecked > 0);
+}
+
+int main(int argc, const char* argv[])
+{
+  // The files go in the folder of the test binary
+  std::string dir(argv[0]);
+  dir.erase(dir.find_last_of('/') + 1);
+
+  std::vector<std::string> paths;
+
+  for (auto f = 0; f < kNFiles; f++)
+  {
+    paths.push_back(dir + "SampleStreamerTest" + std::to_string(f) + (IsFLAC(f) ? ".flac" : ".wav"));
+
+    if (!WriteFile(paths.back().c_str(), f, kFileFrames))
+    {
+      printf("Couldn't write %s\n", paths.back().c_str());
+      return 1;
+    }
+  }
+
+  TestUnderrunFades(paths[0].c_str());
+  StressTest(paths);
+
+  for (const auto& path : paths)
+    remove(path.c_str());
+
+  return TestResult("SampleStreamerTest");
+}
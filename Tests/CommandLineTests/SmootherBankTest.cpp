@@ -0,0 +1,324 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+// Checks SmootherBank against a smoother at a time reference, for float and double, every number of poles and the linear mode, with a partly used last group,
+// targets queued at random offsets within and beyond the block, and blocks that write every frame or only fill ControlRamps.
+// One pole must follow LogParamSmooth. Then checks that shrinking the bank drops the targets queued for removed smoothers,
+// and times the bank against one LogParamSmooth per parameter
+
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include "Smoothers.h"
+
+#include "CommandLineTest.h"
+
+using namespace iplug;
+
+static constexpr int kNSmoothers = 203; // 25 full groups and one of 3
+static constexpr int kMaxBlockSize = 512;
+static constexpr double kSampleRate = 48000.;
+static constexpr int kNBenchSmoothers = 128;
+static constexpr int kNRuns = 1000;
+
+/** One smoother, processed a sample at a time, with the arithmetic SmootherBank documents */
+template <typename T>
+struct ReferenceSmoother
+{
+  ReferenceSmoother(ESmootherMode mode, int nPoles, double timeMs)
+  : mMode(mode)
+  , mNPoles(nPoles)
+  {
+    const double samples = std::max(timeMs * 0.001 * kSampleRate, 1.);
+    mCoeff = static_cast<T>(1. - std::exp(-6.283185307179586476925286766559 / (samples / nPoles)));
+    mRampSamples = static_cast<T>(std::ceil(samples));
+  }
+
+  void SetTarget(T value)
+  {
+    mTarget = value;
+    mStep = (value - mY[0]) / mRampSamples;
+    mRemaining = mRampSamples;
+  }
+
+  T Process()
+  {
+    if (mMode == ESmootherMode::Linear)
+    {
+      mY[0] = mRemaining > T(1) ? mY[0] + mStep : mTarget;
+      mRemaining = std::max(mRemaining - T(1), T(0));
+      return mY[0];
+    }
+
+    mY[0] += mCoeff * (mTarget - mY[0]);
+
+    for (auto p = 1; p < mNPoles; p++)
+      mY[p] += mCoeff * (mY[p - 1] - mY[p]);
+
+    return mY[mNPoles - 1];
+  }
+
+  ESmootherMode mMode;
+  int mNPoles;
+  T mCoeff, mRampSamples;
+  T mY[SmootherBank<T>::kMaxPoles] = {};
+  T mTarget = T(0), mStep = T(0), mRemaining = T(0);
+};
+
+/** Runs a bank and the references through blocks of random sizes with random targets
+ * @return The largest difference between them */
+template <typename T>
+static double MaxBankError(ESmootherMode mode, int nPoles)
+{
+  struct Queued
+  {
+    int64_t frame;
+    int idx;
+    T value;
+  };
+
+  std::mt19937 rng(nPoles + (mode == ESmootherMode::Linear ? 10 : 0));
+  std::uniform_real_distribution<double> valueDist(-1., 1.);
+  std::uniform_real_distribution<double> timeDist(0.01, 20.);
+
+  // room for every target this queues, a full queue applies targets straight away
+  SmootherBank<T> bank(kNSmoothers, mode, nPoles, 4096);
+  bank.SetSampleRate(kSampleRate);
+  std::vector<ReferenceSmoother<T>> refs;
+
+  for (auto i = 0; i < kNSmoothers; i++)
+  {
+    const double timeMs = i % 17 == 0 ? 0. : timeDist(rng); // some smoothers have the shortest time, one sample
+    bank.SetSmoothTime(i, timeMs);
+    refs.emplace_back(mode, nPoles, timeMs);
+  }
+
+  std::vector<std::vector<T>> buffers(kNSmoothers, std::vector<T>(kMaxBlockSize));
+  std::vector<T*> outputs(kNSmoothers);
+  std::vector<ControlRamp> ramps(kNSmoothers);
+  std::vector<Queued> queued;
+  int64_t frame = 0;
+  double maxError = 0.;
+
+  for (auto i = 0; i < kNSmoothers; i++)
+    outputs[i] = buffers[i].data();
+
+  for (auto b = 0; b < 300; b++)
+  {
+    const int nFrames = 1 + rng() % kMaxBlockSize;
+
+    // every few blocks, most smoothers get a new target, some of them later in this block or in the next one
+    if (b % 4 == 0)
+    {
+      for (auto t = 0; t < 100; t++)
+      {
+        const int idx = rng() % kNSmoothers;
+        const int offset = rng() % 2 ? 0 : static_cast<int>(rng() % (2 * nFrames));
+        const T value = static_cast<T>(valueDist(rng));
+
+        bank.SetTarget(idx, value, offset);
+        queued.push_back({ frame + offset, idx, value });
+      }
+    }
+
+    // Write every frame, or only the ramps of the block
+    const bool write = b % 3 != 2;
+
+    if (write)
+      bank.ProcessBlock(nFrames, outputs.data());
+    else
+      bank.ProcessBlock(nFrames, ramps.data());
+
+    for (auto s = 0; s < nFrames; s++, frame++)
+    {
+      for (const auto& q : queued)
+      {
+        if (q.frame == frame)
+          refs[q.idx].SetTarget(q.value);
+      }
+
+      for (auto i = 0; i < kNSmoothers; i++)
+      {
+        const T expected = refs[i].Process();
+
+        if (write)
+          maxError = std::max(maxError, std::fabs(static_cast<double>(outputs[i][s] - expected)));
+        else if (s == nFrames - 1)
+          maxError = std::max(maxError, std::fabs(static_cast<double>(ramps[i].endValue - expected)));
+      }
+    }
+
+    queued.erase(std::remove_if(queued.begin(), queued.end(), [frame](const Queued& q) { return q.frame < frame; }), queued.end());
+  }
+
+  return maxError;
+}
+
+static void TestAgainstReference()
+{
+  // A settled smoother jumps to its target, which moves its output by less than the settle threshold
+  const double threshold = 1e-5;
+
+  printf("Largest difference to the reference smoothers\n");
+
+  for (auto nPoles = 1; nPoles <= SmootherBank<float>::kMaxPoles + 1; nPoles++)
+  {
+    const bool linear = nPoles > SmootherBank<float>::kMaxPoles;
+    const ESmootherMode mode = linear ? ESmootherMode::Linear : ESmootherMode::Exponential;
+    const double floatError = MaxBankError<float>(mode, linear ? 1 : nPoles);
+    const double doubleError = MaxBankError<double>(mode, linear ? 1 : nPoles);
+
+    if (linear)
+      printf("  %-8s float %.2e, double %.2e\n", "linear", floatError, doubleError);
+    else
+      printf("  %i %-6s float %.2e, double %.2e\n", nPoles, nPoles > 1 ? "poles" : "pole", floatError, doubleError);
+
+    CHECK(floatError <= threshold);
+    CHECK(doubleError <= threshold);
+  }
+
+  // With one pole, each smoother follows LogParamSmooth, which has the same coefficient
+  SmootherBank<double> bank(3);
+  LogParamSmooth<double> smoothers[3];
+  std::vector<double> buffers[3];
+  double* outputs[3];
+  double maxError = 0.;
+
+  for (auto i = 0; i < 3; i++)
+  {
+    bank.SetSmoothTime(i, 2. + 3. * i);
+    smoothers[i].SetSmoothTime(2. + 3. * i, DEFAULT_SAMPLE_RATE);
+    buffers[i].resize(kMaxBlockSize);
+    outputs[i] = buffers[i].data();
+    bank.SetTarget(i, 1. - i);
+  }
+
+  bank.ProcessBlock(kMaxBlockSize, outputs);
+
+  for (auto i = 0; i < 3; i++)
+  {
+    for (auto s = 0; s < kMaxBlockSize; s++)
+      maxError = std::max(maxError, std::fabs(outputs[i][s] - smoothers[i].Process(1. - i)));
+  }
+
+  CHECK(maxError < 1e-12);
+}
+
+/** Targets queued for smoothers that a Resize() removes are dropped, and regrowing the bank starts the removed smoothers from 0 */
+static void TestResize()
+{
+  SmootherBank<float> bank(20);
+  std::vector<float> buffers[20];
+  float* outputs[20];
+
+  for (auto i = 0; i < 20; i++)
+  {
+    buffers[i].resize(kMaxBlockSize);
+    outputs[i] = buffers[i].data();
+  }
+
+  bank.SetTarget(12, 1.f);
+  bank.ProcessBlock(64, outputs);
+  CHECK(bank.GetValue(12) > 0.f);
+
+  // 17 is past the 16 smoothers the shrunk bank keeps room for
+  bank.SetTarget(3, 1.f, 100);
+  bank.SetTarget(17, 1.f, 100);
+  bank.SetTarget(12, 1.f, 100);
+  bank.Resize(10);
+
+  for (auto b = 0; b < 10; b++)
+    bank.ProcessBlock(64, outputs);
+
+  CHECK(bank.GetTarget(3) == 1.f);
+  CHECK(bank.GetValue(3) > 0.5f);
+
+  bank.Resize(20);
+
+  for (auto b = 0; b < 10; b++)
+    bank.ProcessBlock(64, outputs);
+
+  CHECK(bank.GetTarget(12) == 0.f && bank.GetValue(12) == 0.f);
+  CHECK(bank.GetTarget(17) == 0.f && bank.GetValue(17) == 0.f);
+  CHECK(!bank.IsActive(17));
+}
+
+/** Times kNBenchSmoothers smoothers that never settle, per frame, against one LogParamSmooth per parameter */
+template <typename T>
+static void Benchmark(const char* typeName)
+{
+  std::vector<std::vector<T>> buffers(kNBenchSmoothers, std::vector<T>(kMaxBlockSize));
+  std::vector<T*> outputs(kNBenchSmoothers);
+  std::vector<ControlRamp> ramps(kNBenchSmoothers);
+  T target = T(1);
+
+  for (auto i = 0; i < kNBenchSmoothers; i++)
+    outputs[i] = buffers[i].data();
+
+  std::vector<LogParamSmooth<T>> smoothers(kNBenchSmoothers, LogParamSmooth<T>(100.));
+
+  const double singleTime = TimeMicroseconds(kNRuns, [&]() {
+    target = -target;
+
+    for (auto i = 0; i < kNBenchSmoothers; i++)
+    {
+      T* output = outputs[i];
+
+      for (auto s = 0; s < kMaxBlockSize; s++)
+        output[s] = smoothers[i].Process(target);
+    }
+  });
+
+  printf("  %-6s %-22s %8.1f\n", typeName, "LogParamSmooth", 1000. * singleTime / (kNBenchSmoothers * kMaxBlockSize));
+
+  auto time = [&](const char* name, ESmootherMode mode, int nPoles, bool write) {
+    SmootherBank<T> bank(kNBenchSmoothers, mode, nPoles);
+    bank.SetSmoothTime(100.);
+
+    const double t = TimeMicroseconds(kNRuns, [&]() {
+      target = -target;
+
+      for (auto i = 0; i < kNBenchSmoothers; i++)
+        bank.SetTarget(i, target);
+
+      if (write)
+        bank.ProcessBlock(kMaxBlockSize, outputs.data());
+      else
+        bank.ProcessBlock(kMaxBlockSize, ramps.data());
+    });
+
+    printf("  %-6s %-22s %8.1f\n", typeName, name, 1000. * t / (kNBenchSmoothers * kMaxBlockSize));
+  };
+
+  time("bank, 1 pole", ESmootherMode::Exponential, 1, true);
+  time("bank, 4 poles", ESmootherMode::Exponential, 4, true);
+  time("bank, linear", ESmootherMode::Linear, 1, true);
+  time("bank, 1 pole, ramps", ESmootherMode::Exponential, 1, false);
+}
+
+int main()
+{
+  TestAgainstReference();
+  TestResize();
+
+#if defined(IPLUG_LANES_SSE2)
+  printf("%i smoothers x %i frames, SSE2, ns per smoother per frame\n", kNBenchSmoothers, kMaxBlockSize);
+#elif defined(IPLUG_LANES_NEON)
+  printf("%i smoothers x %i frames, NEON, ns per smoother per frame\n", kNBenchSmoothers, kMaxBlockSize);
+#else
+  printf("%i smoothers x %i frames, scalar, ns per smoother per frame\n", kNBenchSmoothers, kMaxBlockSize);
+#endif
+
+  Benchmark<float>("float");
+  Benchmark<double>("double");
+
+  return TestResult("SmootherBankTest");
+}
@@ -0,0 +1,143 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+// Checks IStateCodec, built with IPLUG_STATE_USE_ZLIB and the WDL/zlib sources as a plug-in that opts in to compression would be: every combination of flags
+// decodes to the state that was encoded, unencoded states are recognised, and a wrong delta reference or a damaged block is refused.
+// Then times encoding and decoding, and compares the sizes, for states of parameters only and of parameters with a wavetable as custom data
+
+#include <cmath>
+#include <vector>
+
+#include "IPlugStateCodec.h"
+
+#include "CommandLineTest.h"
+
+using namespace iplug;
+
+static constexpr int kNRuns = 200;
+
+/** A state as IPluginBase::SerializeParams() writes it, the parameter values as doubles, followed by custom data
+ * @param nChanged The number of parameters moved away from their defaults, the rest are at their defaults
+ * @param wavetableSize The number of floats of a wavetable stored as custom data, 0 for none */
+static IByteChunk MakeState(int nParams, int nChanged, int wavetableSize)
+{
+  IByteChunk chunk;
+
+  for (auto i = 0; i < nParams; i++)
+  {
+    double value = (i % 7) * 0.125 + (i % 3 == 0 ? 100. : 0.);
+
+    if (i < nChanged)
+      value += 0.01 * (i + 1);
+
+    chunk.Put(&value);
+  }
+
+  for (auto i = 0; i < wavetableSize; i++)
+  {
+    const float sample = static_cast<float>(std::sin(6.283185307179586 * i / 2048.) + 0.3 * std::sin(6.283185307179586 * 5. * i / 2048.));
+    chunk.Put(&sample);
+  }
+
+  return chunk;
+}
+
+static bool Equal(const IByteChunk& a, const IByteChunk& b)
+{
+  return a.Size() == b.Size() && memcmp(a.GetData(), b.GetData(), a.Size()) == 0;
+}
+
+static void TestRoundTrip()
+{
+  const IByteChunk reference = MakeState(500, 0, 4096);
+  const IByteChunk state = MakeState(500, 40, 4096);
+  const int allFlags[] = { kStateCodecNone, kStateCodecDeflate, kStateCodecDelta | kStateCodecDeflate, kStateCodecDelta };
+
+  for (auto flags : allFlags)
+  {
+    // The block follows other data in the chunk, as in a VST3 or AU state
+    IByteChunk chunk;
+    const int32_t before = 1234;
+    chunk.Put(&before);
+    CHECK(IStateCodec::Encode(state, flags, &reference, chunk));
+    CHECK(IStateCodec::IsEncoded(chunk, sizeof(int32_t)));
+
+    IByteChunk decoded;
+    CHECK(IStateCodec::Decode(chunk, sizeof(int32_t), &reference, decoded) == chunk.Size());
+    CHECK(Equal(decoded, state));
+
+    // Delta encoding is only used with compression, where the zeros it makes save space
+    uint32_t hash = 0;
+    CHECK(IStateCodec::GetReferenceHash(chunk, sizeof(int32_t), hash) == (flags == (kStateCodecDelta | kStateCodecDeflate)));
+  }
+
+  // A state saved without encoding starts with parameter values, not the magic number
+  CHECK(!IStateCodec::IsEncoded(state, 0));
+
+  // A delta encoded state can't be decoded against another reference, or without one
+  IByteChunk chunk, decoded;
+  CHECK(IStateCodec::Encode(state, kStateCodecDelta | kStateCodecDeflate, &reference, chunk));
+  const IByteChunk otherReference = MakeState(500, 1, 4096);
+  CHECK(IStateCodec::Decode(chunk, 0, &otherReference, decoded) == -1);
+  CHECK(IStateCodec::Decode(chunk, 0, nullptr, decoded) == -1);
+
+  // A damaged payload fails to decompress, a truncated one is refused from its size
+  IByteChunk damaged;
+  damaged.PutChunk(&chunk);
+  damaged.GetData()[IStateCodec::kHeaderSize + 10] ^= 0x5A;
+  CHECK(IStateCodec::Decode(damaged, 0, &reference, decoded) == -1);
+
+  damaged.Resize(chunk.Size() - 1);
+  CHECK(IStateCodec::Decode(damaged, 0, &reference, decoded) == -1);
+}
+
+static void Benchmark(const char* name, int nParams, int nChanged, int wavetableSize)
+{
+  const IByteChunk reference = MakeState(nParams, 0, wavetableSize);
+  const IByteChunk state = MakeState(nParams, nChanged, wavetableSize);
+
+  printf("%s, %i bytes\n", name, state.Size());
+
+  struct Codec
+  {
+    const char* name;
+    int flags;
+  };
+
+  const Codec codecs[] = { { "none", kStateCodecNone }, { "deflate", kStateCodecDeflate }, { "delta + deflate", kStateCodecDelta | kStateCodecDeflate } };
+
+  for (const auto& codec : codecs)
+  {
+    IByteChunk chunk, decoded;
+
+    const double encodeTime = TimeMicroseconds(kNRuns, [&]() {
+      chunk.Clear();
+      IStateCodec::Encode(state, codec.flags, &reference, chunk);
+    });
+
+    const double decodeTime = TimeMicroseconds(kNRuns, [&]() { IStateCodec::Decode(chunk, 0, &reference, decoded); });
+
+    CHECK(Equal(decoded, state));
+
+    printf("  %-16s %8i bytes %6.1f%%, save %8.1f us, load %8.1f us\n", codec.name, chunk.Size(), 100. * chunk.Size() / state.Size(), encodeTime, decodeTime);
+  }
+}
+
+int main()
+{
+  TestRoundTrip();
+
+  // A few parameters moved from their defaults, as in most saved sessions
+  Benchmark("100 parameters, 10 changed", 100, 10, 0);
+  Benchmark("1000 parameters, 50 changed", 1000, 50, 0);
+  Benchmark("1000 parameters, 50 changed, 64 KB wavetable", 1000, 50, 16384);
+
+  return TestResult("StateCodecTest");
+}
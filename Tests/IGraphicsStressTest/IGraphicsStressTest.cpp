@@ -16,6 +16,48 @@ IGraphicsStressTest::IGraphicsStressTest(const InstanceInfo& info)
 }
 
 #if IPLUG_EDITOR
+/** Test 17: a grid of knobs that only changes when the number of things does, drawn via a display list, which is recorded once
+ * and replayed on every frame that the animated test control redraws - press D to draw them directly instead */
+class DisplayListKnobsControl : public IControl
+{
+public:
+  DisplayListKnobsControl(const IRECT& bounds, const int& kindOfThing, const int& numberOfThings)
+  : IControl(bounds)
+  , mKindOfThing(kindOfThing)
+  , mNumberOfThings(numberOfThings)
+  {
+    SetUseDisplayList(true);
+  }
+
+  void Draw(IGraphics& g) override { DrawKnobs(g); }
+  void RecordDisplayList(IGraphics& g, IDisplayList& list) override { DrawKnobs(list); }
+
+private:
+  template <class G>
+  void DrawKnobs(G& g)
+  {
+    if (mKindOfThing != 17)
+      return;
+
+    for (int i = 0; i < mNumberOfThings; i++)
+    {
+      IRECT cell = mRECT.GetGridCell(i % 64, 8, 8).GetCentredInside(std::min(mRECT.W(), mRECT.H()) / 10.f);
+      const float cx = cell.MW(), cy = cell.MH(), r = cell.W() * 0.4f;
+      const float angle = -135.f + static_cast<float>(i % 11) * 27.f;
+      const float radians = DegToRad(angle - 90.f);
+
+      g.FillRoundRect(COLOR_LIGHT_GRAY, cell, 4.f);
+      g.DrawArc(COLOR_MID_GRAY, cx, cy, r, -135.f, 135.f, nullptr, 3.f);
+      g.FillArc(COLOR_ORANGE, cx, cy, r, -135.f, angle);
+      g.FillCircle(COLOR_DARK_GRAY, cx, cy, r * 0.8f);
+      g.DrawLine(COLOR_WHITE, cx, cy, cx + r * 0.8f * std::cos(radians), cy + r * 0.8f * std::sin(radians), nullptr, 2.f);
+    }
+  }
+
+  const int& mKindOfThing;
+  const int& mNumberOfThings;
+};
+
 void IGraphicsStressTest::LayoutUI(IGraphics* pGraphics)
 {
   IRECT bounds = pGraphics->GetBounds();
@@ -23,6 +65,7 @@ void IGraphicsStressTest::LayoutUI(IGraphics* pGraphics)
   if(pGraphics->NControls()) {
     pGraphics->GetBackgroundControl()->SetTargetAndDrawRECTs(bounds);
     pGraphics->GetControl(1)->SetTargetAndDrawRECTs(bounds);
+    pGraphics->GetControlWithTag(kCtrlTagDisplayList)->SetTargetAndDrawRECTs(bounds);
     pGraphics->GetControlWithTag(kCtrlTagNumThings)->SetTargetAndDrawRECTs(bounds.GetGridCell(0, 2, 1));
     pGraphics->GetControlWithTag(kCtrlTagTestNum)->SetTargetAndDrawRECTs(bounds.GetGridCell(1, 2, 1));
     
@@ -55,13 +98,29 @@ void IGraphicsStressTest::LayoutUI(IGraphics* pGraphics)
     GetUI()->SetAllControlsDirty();
   };
   
-  pGraphics->SetKeyHandlerFunc([DoFunc](const IKeyPress& key, bool isUp)
+  pGraphics->SetKeyHandlerFunc([DoFunc, pGraphics](const IKeyPress& key, bool isUp)
   {
     if(!isUp) {
       switch (key.VK) {
         case kVK_UP: DoFunc(EFunc::More); return true;
         case kVK_DOWN: DoFunc(EFunc::Less); return true;
         case kVK_TAB: key.S ? DoFunc(EFunc::Prev) : DoFunc(EFunc::Next); return true;
+        case kVK_P: pGraphics->ShowProfilerDisplay(!pGraphics->ShowingProfilerDisplay()); return true;
+        case kVK_D:
+        {
+          IControl* pKnobs = pGraphics->GetControlWithTag(kCtrlTagDisplayList);
+          pKnobs->SetUseDisplayList(!pKnobs->GetDisplayList());
+          pKnobs->SetDirty(false);
+          return true;
+        }
+        case kVK_C:
+        {
+          static bool cacheSVGs = true;
+          cacheSVGs = !cacheSVGs;
+          pGraphics->SetSVGRasterCacheBudget(cacheSVGs ? 32 * 1024 * 1024 : 0);
+          pGraphics->SetAllControlsDirty();
+          return true;
+        }
         default: return false;
       }
     }
@@ -69,11 +128,15 @@ void IGraphicsStressTest::LayoutUI(IGraphics* pGraphics)
   });
   
   pGraphics->EnableMouseOver(false);
+  pGraphics->SetSVGRasterCacheRotationSteps(256);
   pGraphics->LoadFont("Roboto-Regular", ROBOTO_FN);
   pGraphics->AttachPanelBackground(COLOR_GRAY);
   pGraphics->AttachControl(new ILambdaControl(bounds, [&](ILambdaControl* pCaller, IGraphics& g, IRECT& r) {
     static IBitmap smiley = g.LoadBitmap(SMILEY_FN);
     static ISVG tiger = g.LoadSVG(TIGER_FN);
+    static const char* labels[] = {"Cutoff", "Resonance", "Attack", "Decay", "Sustain", "Release", "Drive", "Dry/Wet",
+                                   "-12.0 dB", "440.0 Hz", "1/16 dotted", "Preset 001: Init"};
+    static const int nLabels = sizeof(labels) / sizeof(labels[0]);
     
     if(mKindOfThing == 0)
       g.DrawText(IText(40), "Press tab to go to next test, up/down to change the # of things", r);
@@ -107,6 +170,33 @@ void IGraphicsStressTest::LayoutUI(IGraphics* pGraphics)
           case 10: g.DrawDottedLine(rc, dir == 0 ? rr.L : rr.R, rr.B, dir == 0 ? rr.R : rr.L, rr.T, &rb, thickness); break;
           case 11: g.DrawFittedBitmap(smiley, rr, &rb); break;
           case 12: g.DrawSVG(tiger, rr); break;
+          case 13: g.DrawText(IText(12.f + 2.f * (i % 4), rc), labels[i % nLabels], rr, &rb); break;
+          case 14: // fixed size, like knobs - press C to toggle the SVG raster cache
+          {
+            IRECT cell = r.GetGridCell(i % 64, 8, 8);
+            g.DrawRotatedSVG(tiger, cell.MW(), cell.MH(), cell.W(), cell.H(), rrad1);
+            break;
+          }
+          case 15: // multi-stop linear and radial gradients, as used by IVStyle
+          {
+            static const EPatternExtend extends[] = {EPatternExtend::Pad, EPatternExtend::Reflect, EPatternExtend::Repeat};
+            IPattern pattern = (i % 2) ? IPattern::CreateRadialGradient(rr.MW(), rr.MH(), std::max(rr.W(), rr.H()) * 0.5f, {{rc, 0.f}, {COLOR_WHITE, 0.3f}, {rc.WithOpacity(0.5f), 1.f}})
+                                       : IPattern::CreateLinearGradient(rr.L, rr.T, rr.R, rr.B, {{rc, 0.f}, {COLOR_BLACK, 0.5f}, {rc, 1.f}});
+            pattern.mExtend = extends[i % 3];
+            g.PathRoundRect(rr, roundness);
+            g.PathFill(pattern, IFillOptions(), &rb);
+            break;
+          }
+          case 16: // fixed size knobs with gradient drop shadows
+          {
+            IRECT cell = r.GetGridCell(i % 64, 8, 8).GetCentredInside(std::min(r.W(), r.H()) / 10.f);
+            g.StartLayer(nullptr, cell.GetPadded(8.f));
+            g.FillEllipse(rc, cell);
+            ILayerPtr layer = g.EndLayer();
+            g.ApplyLayerDropShadow(layer, IShadow(IPattern::CreateLinearGradient(cell, EDirection::Vertical, {{COLOR_BLACK, 0.f}, {rc, 1.f}}), 4.f, 3.f, 3.f, 0.7f, true));
+            g.DrawLayer(layer, &rb);
+            break;
+          }
           default:
             break;
         }
@@ -120,6 +210,7 @@ void IGraphicsStressTest::LayoutUI(IGraphics* pGraphics)
     
   }, 10000, false, false));
   
+  pGraphics->AttachControl(new DisplayListKnobsControl(bounds, mKindOfThing, mNumberOfThings), kCtrlTagDisplayList);
   pGraphics->AttachControl(new ITextControl(bounds.GetGridCell(0, 2, 1), "", IText(100)), kCtrlTagNumThings);
   pGraphics->AttachControl(new ITextControl(bounds.GetGridCell(1, 2, 1), "", IText(100)), kCtrlTagTestNum);
   
@@ -132,7 +223,7 @@ void IGraphicsStressTest::LayoutUI(IGraphics* pGraphics)
       switch (button) {
         case 0:
         {
-          static IPopupMenu menu {"Test", {"DrawRect", "FillRect", "DrawRoundRect", "FillRoundRect", "DrawEllipse", "FillEllipse", "DrawArc", "FillArc", "DrawLine", "DrawDottedLine", "DrawFittedBitmap", "DrawSVG"},
+          static IPopupMenu menu {"Test", {"DrawRect", "FillRect", "DrawRoundRect", "FillRoundRect", "DrawEllipse", "FillEllipse", "DrawArc", "FillArc", "DrawLine", "DrawDottedLine", "DrawFittedBitmap", "DrawSVG", "DrawText", "DrawRotatedSVG", "Gradients", "GradientShadows", "DisplayList"},
             [DoFunc](IPopupMenu* pMenu) {
               DoFunc(EFunc::Set, pMenu->GetChosenItemIdx());
             }};
@@ -42,6 +42,9 @@
 #define WDL_HEAPBUF_TRACEPARM(x)
 #endif
 
+#include <stdlib.h>
+#include <string.h>
+
 #include "wdltypes.h"
 
 class WDL_HeapBuf